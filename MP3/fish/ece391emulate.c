@@ -1,9 +1,18 @@
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <unistd.h>
 
 #include "ece391support.h"
@@ -11,9 +20,72 @@
 #include "ece391sysnum.h"
 
 
+/*
+ * Benchmark harness.  The environment turns it on, so programs run
+ * unchanged:
+ *   ECE391_BENCH=1          count and time every system call, and report on
+ *                           stderr when the program halts
+ *   ECE391_BENCH=<file>     append the report to the file instead
+ *   ECE391_REPLAY=<file>    terminal reads return the lines of the file, one
+ *                           per read, instead of waiting for the keyboard
+ *   ECE391_RTC_FAST=1       rtc reads return at once, so that frames/sec is
+ *                           the speed of the program and not of the clock
+ * The report has a line per system call used and a summary, as read by
+ * MP3/tools/emubench.py:
+ *   EMU <prog> call=<name> count=<n> errors=<n> ns=<n> bytes=<n>
+ *   EMU <prog> total ns=<n> read=<n> written=<n> frames=<n>
+ * Every read of the rtc is one frame.  An execute includes the time of the
+ * child, which reports on its own.
+ */
+
+#define NUM_CALLS        (SYS_THREAD_JOIN + 1)
+#define RTC_DEFAULT_FREQ 2
+#define REPLAY_LEN       1024
+#define NS_PER_SEC       1000000000
+#define EMU_SHM_NUM      8
+#define EMU_THREAD_NUM   8
+
+typedef struct call_stat {
+    uint32_t count;
+    uint32_t errors;
+    uint64_t ns;
+    uint64_t bytes;
+} call_stat_t;
+
+static const char* call_name[NUM_CALLS] = {
+    "", "halt", "execute", "read", "write", "open", "close", "getargs",
+    "vidmap", "set_handler", "sigreturn", "getdents", "vgamode",
+    "shmget", "shmat", "shmdt", "futex", "thread_create", "thread_join"
+};
+
 static uint32_t start_esp;
 static int32_t dir_fd = -1;
 static DIR* dir = NULL;
+static int32_t rtc_fd = -1;
+static uint32_t rtc_freq;
+static struct timespec rtc_next;
+/* segments attached by shmat, so that shmdt finds the id */
+static struct {
+    void* addr;
+    int32_t shmid;
+} shm_at[EMU_SHM_NUM];
+/* threads started by thread_create, the index is the thread id */
+static struct {
+    pthread_t id;
+    int32_t (*func)(void*);
+    void* arg;
+    int32_t used;
+} emu_thread[EMU_THREAD_NUM];
+static pthread_mutex_t emu_thread_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* bench_file = NULL;
+static uint64_t bench_begin;
+static call_stat_t stats[NUM_CALLS];
+static uint32_t frames = 0;
+static int rtc_fast = 0;
+static FILE* replay = NULL;
+
+void ece391_bench_start (void);
 
 
 /* 
@@ -41,31 +113,189 @@ asm volatile ("                    \
 ")
 
 /* these wrappers require no changes */
+extern int32_t __ece391_halt (uint8_t status);
 extern int32_t __ece391_read (int32_t fd, void* buf, int32_t nbytes);
 extern int32_t __ece391_write (int32_t fd, const void* buf, int32_t nbytes);
 extern int32_t __ece391_close (int32_t fd);
 void fake_function () {
-DO_CALL(ece391_halt,1 /* SYS_HALT */);
+DO_CALL(__ece391_halt,1 /* SYS_HALT */);
 DO_CALL(__ece391_read,3 /* SYS_READ */);
 DO_CALL(__ece391_write,4 /* SYS_WRITE */);
 DO_CALL(__ece391_close,6 /* SYS_CLOSE */);
 
-/* Call the main() function, then halt with its return value. */
+/*
+ * Call the main() function, then halt with its return value.  Programs
+ * linked with ece391stdio.o get their buffered output flushed first.
+ */
 
 asm volatile ("                         \n\
+.WEAK ece391_stdio_exit                 \n\
 .GLOBAL _start                          \n\
 _start:                                 \n\
 	MOVL	%ESP,start_esp          \n\
+	CALL	ece391_bench_start      \n\
         CALL	main                    \n\
+	MOVL	$ece391_stdio_exit,%ECX \n\
+	TESTL	%ECX,%ECX               \n\
+	JZ	1f                      \n\
 	PUSHL	%EAX                    \n\
+	CALL	*%ECX                   \n\
+	POPL	%EAX                    \n\
+1:	PUSHL	%EAX                    \n\
 	CALL	ece391_halt             \n\
 ");
 
 /* end of fake container function */
 }
 
-int32_t 
-ece391_execute (const uint8_t* command)
+/* 
+ * Environment variable from the initial stack, which _start saved before
+ * the C library is of any use.
+ */
+static const char*
+bench_env (const char* name)
+{
+    int32_t argc = *(uint32_t*)start_esp;
+    char** envp = (char**)(start_esp + 4 * (argc + 2));
+    uint32_t len = strlen (name);
+
+    for (; NULL != *envp; envp++)
+        if (0 == strncmp (*envp, name, len) && '=' == (*envp)[len])
+	    return *envp + len + 1;
+    return NULL;
+}
+
+static uint64_t
+now_ns (void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* called by _start before main */
+void
+ece391_bench_start (void)
+{
+    const char* name;
+
+    if (NULL != (name = bench_env ("ECE391_REPLAY")) &&
+        NULL == (replay = fopen (name, "r")))
+	perror (name);
+    rtc_fast = (NULL != bench_env ("ECE391_RTC_FAST"));
+    if (NULL != (bench_file = bench_env ("ECE391_BENCH")))
+        bench_begin = now_ns ();
+}
+
+/* start time of a system call, 0 when not benchmarking */
+static uint64_t
+bench_time (void)
+{
+    return (NULL == bench_file ? 0 : now_ns ());
+}
+
+/* account one system call that returned ret, ret bytes for reads and writes */
+static void
+bench_count (int32_t num, uint64_t start, int32_t ret)
+{
+    call_stat_t* st = &stats[num];
+
+    if (NULL == bench_file)
+        return;
+    st->ns += now_ns () - start;
+    st->count++;
+    if (-1 == ret)
+        st->errors++;
+    else if (SYS_READ == num || SYS_WRITE == num || SYS_GETDENTS == num)
+        st->bytes += ret;
+}
+
+static void
+bench_report (void)
+{
+    uint64_t elapsed = now_ns () - bench_begin;
+    const char* prog = *(char**)(start_esp + 4);
+    const char* slash;
+    FILE* out = stderr;
+    int32_t num;
+
+    if (NULL == bench_file)
+        return;
+    if (0 != strcmp (bench_file, "1") && NULL == (out = fopen (bench_file, "a"))) {
+        perror (bench_file);
+	return;
+    }
+    if (NULL != (slash = strrchr (prog, '/')))
+        prog = slash + 1;
+    for (num = 1; NUM_CALLS > num; num++) {
+        if (0 == stats[num].count)
+	    continue;
+	fprintf (out, "EMU %s call=%s count=%u errors=%u ns=%llu bytes=%llu\n",
+		 prog, call_name[num], stats[num].count, stats[num].errors,
+		 (unsigned long long)stats[num].ns,
+		 (unsigned long long)stats[num].bytes);
+    }
+    fprintf (out, "EMU %s total ns=%llu read=%llu written=%llu frames=%u\n",
+	     prog, (unsigned long long)elapsed,
+	     (unsigned long long)stats[SYS_READ].bytes,
+	     (unsigned long long)stats[SYS_WRITE].bytes, frames);
+    if (stderr == out)
+        (void)fflush (out);
+    else
+        (void)fclose (out);
+}
+
+/* 
+ * Wait for the next tick of the emulated RTC.  A program that fell behind
+ * waits for one tick from now, as the real RTC would not queue the ticks
+ * it missed.
+ */
+static int32_t
+rtc_wait (void)
+{
+    struct timespec now;
+
+    if (rtc_fast)
+        return 0;
+    rtc_next.tv_nsec += NS_PER_SEC / rtc_freq;
+    if (NS_PER_SEC <= rtc_next.tv_nsec) {
+        rtc_next.tv_sec++;
+	rtc_next.tv_nsec -= NS_PER_SEC;
+    }
+    (void)clock_gettime (CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > rtc_next.tv_sec ||
+        (now.tv_sec == rtc_next.tv_sec && now.tv_nsec > rtc_next.tv_nsec)) {
+        rtc_next = now;
+	return rtc_wait ();
+    }
+    (void)clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &rtc_next, NULL);
+    return 0;
+}
+
+/* 
+ * Next recorded line of keyboard input, without its newline as the
+ * terminal returns it; 0 once the recording is over.
+ */
+static int32_t
+replay_line (void* buf, int32_t nbytes)
+{
+    char line[REPLAY_LEN];
+    int32_t len;
+
+    if (NULL == fgets (line, REPLAY_LEN, replay))
+        return 0;
+    len = strlen (line);
+    if (0 < len && '\n' == line[len - 1])
+        len--;
+    if (len > nbytes)
+        len = nbytes;
+    memcpy (buf, line, len);
+    return len;
+}
+
+static int32_t 
+emu_execute (const uint8_t* command)
 {
     int status;
     uint8_t buf[1026];
@@ -110,8 +340,8 @@ ece391_execute (const uint8_t* command)
     return 256;
 }
 
-int32_t 
-ece391_open (const uint8_t* filename)
+static int32_t 
+emu_open (const uint8_t* filename)
 {
     uint32_t rval;
 
@@ -120,6 +350,15 @@ ece391_open (const uint8_t* filename)
         dir_fd = open ("/dev/null", O_RDONLY);
 	return dir_fd;
     }
+    /* the RTC is a timer, one open at a time like the directory */
+    if (0 == ece391_strcmp (filename, (uint8_t*)"rtc")) {
+        if (-1 != rtc_fd)
+	    return -1;
+        rtc_fd = open ("/dev/null", O_RDONLY);
+	rtc_freq = RTC_DEFAULT_FREQ;
+	(void)clock_gettime (CLOCK_MONOTONIC, &rtc_next);
+	return rtc_fd;
+    }
 
     asm volatile ("INT $0x80" : "=a" (rval) :
 		  "a" (5), "b" (filename), "c" (O_RDONLY));
@@ -128,8 +367,8 @@ ece391_open (const uint8_t* filename)
     return rval;
 }
 
-int32_t 
-ece391_getargs (uint8_t* buf, int32_t nbytes)
+static int32_t 
+emu_getargs (uint8_t* buf, int32_t nbytes)
 {
     int32_t argc = *(uint32_t*)start_esp;
     uint8_t** argv = (uint8_t**)(start_esp + 4);
@@ -156,8 +395,8 @@ ece391_getargs (uint8_t* buf, int32_t nbytes)
     return 0;
 }
 
-int32_t 
-ece391_vidmap (uint8_t** screen_start)
+static int32_t 
+emu_vidmap (uint8_t** screen_start)
 {
     static int mem_fd = -1;
     void* mem_image;
@@ -176,14 +415,138 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
-int32_t 
-ece391_read (int32_t fd, void* buf, int32_t nbytes)
+/* 
+ * A Linux process cannot take the VGA away from the console, graphics
+ * programs have to run on the real kernel (MP2 shows the ioperm way).
+ */
+static int32_t 
+emu_vgamode (uint32_t mode, uint8_t** screen_start)
+{
+    return (ECE391_VGA_TEXT == mode ? 0 : -1);
+}
+
+/*
+ * Shared memory is System V shared memory, and futex the Linux one.  A
+ * segment is removed when the last shmdt leaves it unattached; one left
+ * attached by a program that exits stays until ipcrm.
+ */
+static int32_t 
+emu_shmget (uint32_t key, uint32_t size)
+{
+    return shmget (ECE391_SHM_PRIVATE == key ? IPC_PRIVATE : (key_t)key,
+                   size, 0 == size ? 0600 : IPC_CREAT | 0600);
+}
+
+static int32_t 
+emu_shmat (int32_t shmid, void* addr)
+{
+    void* at = shmat (shmid, addr, 0);
+    int32_t i;
+
+    if ((void*)-1 == at)
+        return -1;
+    for (i = 0; EMU_SHM_NUM > i && NULL != shm_at[i].addr; i++);
+    if (EMU_SHM_NUM > i) {
+        shm_at[i].addr = at;
+        shm_at[i].shmid = shmid;
+    }
+    return (int32_t)(intptr_t)at;
+}
+
+static int32_t 
+emu_shmdt (void* addr)
+{
+    struct shmid_ds ds;
+    int32_t i;
+
+    if (-1 == shmdt (addr))
+        return -1;
+    for (i = 0; EMU_SHM_NUM > i && addr != shm_at[i].addr; i++);
+    if (EMU_SHM_NUM == i)
+        return 0;
+    shm_at[i].addr = NULL;
+    if (0 == shmctl (shm_at[i].shmid, IPC_STAT, &ds) && 0 == ds.shm_nattch)
+        (void)shmctl (shm_at[i].shmid, IPC_RMID, NULL);
+    return 0;
+}
+
+static int32_t 
+emu_futex (uint32_t* addr, int32_t op, uint32_t val)
+{
+    if (ECE391_FUTEX_WAIT == op) {
+        return (-1 == syscall (SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0) &&
+                EINTR != errno ? -1 : 0);
+    }
+    if (ECE391_FUTEX_WAKE == op)
+        return syscall (SYS_futex, addr, FUTEX_WAKE, val, NULL, NULL, 0);
+    return -1;
+}
+
+/*
+ * Threads are POSIX threads.  A thread that calls ece391_halt ends the
+ * whole program here, and the system call counts are not kept per thread.
+ */
+static void*
+emu_thread_main (void* t)
+{
+    int32_t i = (int32_t)(intptr_t)t;
+
+    return (void*)(intptr_t)(uint8_t)emu_thread[i].func (emu_thread[i].arg);
+}
+
+static int32_t 
+emu_thread_create (int32_t (*func)(void*), void* arg)
+{
+    int32_t i;
+
+    (void)pthread_mutex_lock (&emu_thread_lock);
+    for (i = 0; EMU_THREAD_NUM > i && emu_thread[i].used; i++);
+    if (EMU_THREAD_NUM > i) {
+        emu_thread[i].func = func;
+        emu_thread[i].arg = arg;
+        if (0 == pthread_create (&emu_thread[i].id, NULL, emu_thread_main,
+                                 (void*)(intptr_t)i))
+            emu_thread[i].used = 1;
+        else
+            i = EMU_THREAD_NUM;
+    }
+    (void)pthread_mutex_unlock (&emu_thread_lock);
+    return (EMU_THREAD_NUM > i ? i : -1);
+}
+
+static int32_t 
+emu_thread_join (int32_t tid)
+{
+    pthread_t id;
+    void* ret;
+
+    (void)pthread_mutex_lock (&emu_thread_lock);
+    if (0 > tid || EMU_THREAD_NUM <= tid || !emu_thread[tid].used) {
+        (void)pthread_mutex_unlock (&emu_thread_lock);
+        return -1;
+    }
+    id = emu_thread[tid].id;
+    (void)pthread_mutex_unlock (&emu_thread_lock);
+    if (0 != pthread_join (id, &ret))
+        return -1;
+    (void)pthread_mutex_lock (&emu_thread_lock);
+    emu_thread[tid].used = 0;
+    (void)pthread_mutex_unlock (&emu_thread_lock);
+    return (int32_t)(intptr_t)ret;
+}
+
+static int32_t 
+emu_read (int32_t fd, void* buf, int32_t nbytes)
 {
     struct dirent* de;
     int32_t copied;
     uint8_t* from;
     uint8_t* to;
 
+    if (-1 != rtc_fd && rtc_fd == fd)
+        return rtc_wait ();
+    if (0 == fd && NULL != replay)
+        return replay_line (buf, nbytes);
     if (NULL == dir || dir_fd != fd)
         return __ece391_read (fd, buf, nbytes);
     if (NULL == (de = readdir (dir)))
@@ -205,17 +568,80 @@ ece391_read (int32_t fd, void* buf, int32_t nbytes)
     return copied;
 }
 
-int32_t 
-ece391_write (int32_t fd, const void* buf, int32_t nbytes)
+static int32_t 
+emu_getdents (int32_t fd, void* buf, int32_t nbytes)
+{
+    struct dirent* de;
+    struct stat st;
+    ece391_dirent_t* ent;
+    int32_t filled, len;
+    long pos;
+
+    if (NULL == dir || dir_fd != fd)
+        return -1;
+    filled = 0;
+    while (1) {
+        pos = telldir (dir);
+        if (NULL == (de = readdir (dir)))
+	    break;
+	len = ece391_strlen ((uint8_t*)de->d_name);
+	if (32 < len)
+	    len = 32;
+	if (filled + (int32_t)sizeof (*ent) + len > nbytes) {
+	    /* put it back for the next call */
+	    seekdir (dir, pos);
+	    if (0 == filled)
+	        return -1;
+	    break;
+	}
+	ent = (ece391_dirent_t*)((uint8_t*)buf + filled);
+	ent->inode = de->d_ino;
+	ent->size = 0;
+	ent->type = ECE391_TYPE_RTC;
+	if (0 == stat (de->d_name, &st)) {
+	    if (S_ISDIR (st.st_mode)) {
+	        ent->type = ECE391_TYPE_DIR;
+	    } else if (S_ISREG (st.st_mode)) {
+	        ent->type = ECE391_TYPE_FILE;
+		ent->size = st.st_size;
+	    }
+	}
+	ent->name_len = len;
+	for (pos = 0; pos < len; pos++)
+	    ent->name[pos] = de->d_name[pos];
+	filled += sizeof (*ent) + len;
+    }
+    return filled;
+}
+
+static int32_t 
+emu_write (int32_t fd, const void* buf, int32_t nbytes)
 {
+    uint32_t freq;
+
+    if (-1 != rtc_fd && rtc_fd == fd) {
+	/* a power of two from 2 to 1024 Hz, as the real driver takes */
+        if (4 != nbytes)
+	    return -1;
+	freq = *(const uint32_t*)buf;
+	if (2 > freq || 1024 < freq || 0 != (freq & (freq - 1)))
+	    return -1;
+	rtc_freq = freq;
+	return 0;
+    }
     if (NULL == dir || dir_fd != fd)
         return __ece391_write (fd, buf, nbytes);
     return -1;
 }
 
-int32_t 
-ece391_close (int32_t fd)
+static int32_t 
+emu_close (int32_t fd)
 {
+    if (-1 != rtc_fd && rtc_fd == fd) {
+        (void)close (rtc_fd);
+	rtc_fd = -1;
+	return 0;
+    }
     if (NULL == dir || dir_fd != fd)
         return __ece391_close (fd);
     (void)closedir (dir);
@@ -225,3 +651,168 @@ ece391_close (int32_t fd)
     return 0;
 }
 
+/* 
+ * The system calls seen by programs: the emulation above, counted and
+ * timed when benchmarking.
+ */
+
+int32_t 
+ece391_halt (uint8_t status)
+{
+    bench_count (SYS_HALT, bench_time (), 0);
+    bench_report ();
+    return __ece391_halt (status);
+}
+
+int32_t 
+ece391_execute (const uint8_t* command)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_execute (command);
+
+    bench_count (SYS_EXECUTE, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_read (int32_t fd, void* buf, int32_t nbytes)
+{
+    uint64_t start = bench_time ();
+    int32_t ret;
+
+    if (-1 != rtc_fd && rtc_fd == fd)
+        frames++;
+    ret = emu_read (fd, buf, nbytes);
+    bench_count (SYS_READ, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_write (int32_t fd, const void* buf, int32_t nbytes)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_write (fd, buf, nbytes);
+
+    bench_count (SYS_WRITE, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_open (const uint8_t* filename)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_open (filename);
+
+    bench_count (SYS_OPEN, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_close (int32_t fd)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_close (fd);
+
+    bench_count (SYS_CLOSE, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_getargs (uint8_t* buf, int32_t nbytes)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_getargs (buf, nbytes);
+
+    bench_count (SYS_GETARGS, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_vidmap (uint8_t** screen_start)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_vidmap (screen_start);
+
+    bench_count (SYS_VIDMAP, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_getdents (int32_t fd, void* buf, int32_t nbytes)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_getdents (fd, buf, nbytes);
+
+    bench_count (SYS_GETDENTS, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_vgamode (uint32_t mode, uint8_t** screen_start)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_vgamode (mode, screen_start);
+
+    bench_count (SYS_VGAMODE, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_shmget (uint32_t key, uint32_t size)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_shmget (key, size);
+
+    bench_count (SYS_SHMGET, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_shmat (int32_t shmid, void* addr)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_shmat (shmid, addr);
+
+    bench_count (SYS_SHMAT, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_shmdt (void* addr)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_shmdt (addr);
+
+    bench_count (SYS_SHMDT, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_futex (uint32_t* addr, int32_t op, uint32_t val)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_futex (addr, op, val);
+
+    bench_count (SYS_FUTEX, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_thread_create (int32_t (*func)(void*), void* arg)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_thread_create (func, arg);
+
+    bench_count (SYS_THREAD_CREATE, start, ret);
+    return ret;
+}
+
+int32_t 
+ece391_thread_join (int32_t tid)
+{
+    uint64_t start = bench_time ();
+    int32_t ret = emu_thread_join (tid);
+
+    bench_count (SYS_THREAD_JOIN, start, ret);
+    return ret;
+}
@@ -0,0 +1,330 @@
+#include <stdint.h>
+#include <stdarg.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391stdio.h"
+
+#define NULL 0
+
+/* width of a converted number: 10 digits, a sign and room for padding */
+#define NUM_LEN 12
+
+/* entries 0 and 1 are the terminal, opened before main by the kernel */
+static ECE391_FILE files[ECE391_FOPEN_MAX] = {
+    {0, 0, 0},
+    {1, 1, 1},
+    {-1}, {-1}, {-1}, {-1}, {-1}, {-1}
+};
+
+ECE391_FILE* ece391_stdin = &files[0];
+ECE391_FILE* ece391_stdout = &files[1];
+
+ECE391_FILE*
+ece391_fopen (const uint8_t* name, const char* mode)
+{
+    ECE391_FILE* f;
+    int32_t i;
+
+    if (('r' != mode[0] && 'w' != mode[0]) || '\0' != mode[1])
+        return NULL;
+    for (i = 0; ECE391_FOPEN_MAX > i && -1 != files[i].fd; i++);
+    if (ECE391_FOPEN_MAX == i)
+        return NULL;
+
+    f = &files[i];
+    if (-1 == (f->fd = ece391_open (name)))
+        return NULL;
+    f->writing = ('w' == mode[0]);
+    f->line_buf = 0;
+    f->pos = f->len = 0;
+    f->eof = f->err = 0;
+    return f;
+}
+
+int32_t
+ece391_fflush (ECE391_FILE* f)
+{
+    int32_t i, done, ret = 0;
+
+    if (NULL == f) {
+        for (i = 0; ECE391_FOPEN_MAX > i; i++)
+            if (-1 != files[i].fd && -1 == ece391_fflush (&files[i]))
+                ret = ECE391_EOF;
+        return ret;
+    }
+
+    /* unread input is dropped */
+    if (!f->writing) {
+        f->pos = f->len = 0;
+        return 0;
+    }
+    for (i = 0; f->len > i; i += done) {
+        if (0 >= (done = ece391_write (f->fd, f->buf + i, f->len - i))) {
+            f->err = 1;
+            ret = ECE391_EOF;
+            break;
+        }
+    }
+    f->len = 0;
+    return ret;
+}
+
+int32_t
+ece391_fclose (ECE391_FILE* f)
+{
+    int32_t ret = ece391_fflush (f);
+
+    if (-1 == ece391_close (f->fd))
+        ret = ECE391_EOF;
+    f->fd = -1;
+    return ret;
+}
+
+/* refill the buffer of an input stream, return 0 at the end or on error */
+static int32_t
+fill (ECE391_FILE* f)
+{
+    int32_t cnt;
+
+    if (f->eof || f->err)
+        return 0;
+    /* a prompt written without a newline shows before the program waits */
+    if (f == ece391_stdin)
+        (void)ece391_fflush (ece391_stdout);
+
+    cnt = ece391_read (f->fd, f->buf, ECE391_BUFSIZ);
+    if (0 > cnt) {
+        f->err = 1;
+        return 0;
+    }
+    if (0 == cnt) {
+        f->eof = 1;
+        return 0;
+    }
+    /*
+     * The terminal hands over one line per read without its newline;
+     * put it back so that fgets sees line ends as it does in files.
+     */
+    if (f == ece391_stdin && ECE391_BUFSIZ > cnt && '\n' != f->buf[cnt - 1])
+        f->buf[cnt++] = '\n';
+    f->pos = 0;
+    f->len = cnt;
+    return cnt;
+}
+
+int32_t
+ece391_fgetc (ECE391_FILE* f)
+{
+    if (f->pos == f->len && 0 == fill (f))
+        return ECE391_EOF;
+    return f->buf[f->pos++];
+}
+
+uint8_t*
+ece391_fgets (uint8_t* s, int32_t size, ECE391_FILE* f)
+{
+    int32_t i = 0, c;
+
+    while (size - 1 > i) {
+        if (ECE391_EOF == (c = ece391_fgetc (f)))
+            break;
+        s[i++] = c;
+        if ('\n' == c)
+            break;
+    }
+    if (0 == i)
+        return NULL;
+    s[i] = '\0';
+    return s;
+}
+
+int32_t
+ece391_fread (void* ptr, int32_t size, int32_t nmemb, ECE391_FILE* f)
+{
+    uint8_t* dst = ptr;
+    int32_t want = size * nmemb, got = 0, cnt;
+
+    if (0 >= size)
+        return 0;
+    while (want > got) {
+        if (f->pos == f->len && 0 == fill (f))
+            break;
+        cnt = f->len - f->pos;
+        if (cnt > want - got)
+            cnt = want - got;
+        for (; 0 < cnt; cnt--)
+            dst[got++] = f->buf[f->pos++];
+    }
+    return got / size;
+}
+
+int32_t
+ece391_fputc (int32_t c, ECE391_FILE* f)
+{
+    if (ECE391_BUFSIZ == f->len && -1 == ece391_fflush (f))
+        return ECE391_EOF;
+    f->buf[f->len++] = c;
+    if ((f->line_buf && '\n' == c) || ECE391_BUFSIZ == f->len) {
+        if (-1 == ece391_fflush (f))
+            return ECE391_EOF;
+    }
+    return (uint8_t)c;
+}
+
+int32_t
+ece391_fwrite (const void* ptr, int32_t size, int32_t nmemb, ECE391_FILE* f)
+{
+    const uint8_t* src = ptr;
+    int32_t total = size * nmemb, i;
+
+    if (0 >= size)
+        return 0;
+    for (i = 0; total > i; i++)
+        if (ECE391_EOF == ece391_fputc (src[i], f))
+            break;
+    return i / size;
+}
+
+int32_t
+ece391_fputs (const uint8_t* s, ECE391_FILE* f)
+{
+    int32_t len = ece391_strlen (s);
+
+    return (len == ece391_fwrite (s, 1, len, f) ? len : ECE391_EOF);
+}
+
+/*
+ * Put one converted field, padded to width with pad on the left, or with
+ * spaces on the right if left is set.  Return the number of bytes put.
+ */
+static int32_t
+put_field (ECE391_FILE* f, const uint8_t* s, int32_t len, int32_t width,
+           int32_t left, uint8_t pad)
+{
+    int32_t cnt = 0;
+
+    /* zero padding goes after the sign */
+    if ('0' == pad && '-' == *s && width > len) {
+        (void)ece391_fputc (*s++, f);
+        len--;
+        width--;
+        cnt++;
+    }
+    for (; !left && width > len; width--, cnt++)
+        (void)ece391_fputc (pad, f);
+    cnt += ece391_fwrite (s, 1, len, f);
+    for (; left && width > len; width--, cnt++)
+        (void)ece391_fputc (' ', f);
+    return cnt;
+}
+
+/* convert an unsigned number, return the start of the digits in buf */
+static uint8_t*
+convert (uint32_t val, uint32_t base, int32_t neg, uint8_t buf[NUM_LEN])
+{
+    uint8_t* s = &buf[NUM_LEN - 1];
+
+    *s = '\0';
+    do {
+        *--s = "0123456789abcdef"[val % base];
+        val /= base;
+    } while (0 != val);
+    if (neg)
+        *--s = '-';
+    return s;
+}
+
+static int32_t
+format_out (ECE391_FILE* f, const char* format, va_list ap)
+{
+    uint8_t buf[NUM_LEN];
+    const uint8_t* s;
+    int32_t cnt = 0, width, left, val;
+    uint8_t pad;
+
+    for (; '\0' != *format; format++) {
+        if ('%' != *format) {
+            (void)ece391_fputc (*format, f);
+            cnt++;
+            continue;
+        }
+
+        left = 0;
+        pad = ' ';
+        for (format++; '-' == *format || '0' == *format; format++) {
+            if ('-' == *format)
+                left = 1;
+            else
+                pad = '0';
+        }
+        if (left)
+            pad = ' ';
+        for (width = 0; '0' <= *format && '9' >= *format; format++)
+            width = width * 10 + (*format - '0');
+
+        switch (*format) {
+            case 'd':
+                val = va_arg (ap, int32_t);
+                s = convert ((0 > val ? -(uint32_t)val : (uint32_t)val), 10,
+                             (0 > val), buf);
+                break;
+            case 'u':
+                s = convert (va_arg (ap, uint32_t), 10, 0, buf);
+                break;
+            case 'x':
+                s = convert (va_arg (ap, uint32_t), 16, 0, buf);
+                break;
+            case 'c':
+                buf[0] = va_arg (ap, int32_t);
+                cnt += put_field (f, buf, 1, width, left, ' ');
+                continue;
+            case 's':
+                if (NULL == (s = va_arg (ap, const uint8_t*)))
+                    s = (const uint8_t*)"(null)";
+                cnt += put_field (f, s, ece391_strlen (s), width, left, ' ');
+                continue;
+            case '%':
+                (void)ece391_fputc ('%', f);
+                cnt++;
+                continue;
+            default:
+                /* unknown conversion, or the format ended after '%' */
+                if ('\0' == *format)
+                    return cnt;
+                continue;
+        }
+        cnt += put_field (f, s, ece391_strlen (s), width, left, pad);
+    }
+    return cnt;
+}
+
+int32_t
+ece391_printf (const char* format, ...)
+{
+    va_list ap;
+    int32_t cnt;
+
+    va_start (ap, format);
+    cnt = format_out (ece391_stdout, format, ap);
+    va_end (ap);
+    return cnt;
+}
+
+int32_t
+ece391_fprintf (ECE391_FILE* f, const char* format, ...)
+{
+    va_list ap;
+    int32_t cnt;
+
+    va_start (ap, format);
+    cnt = format_out (f, format, ap);
+    va_end (ap);
+    return cnt;
+}
+
+void
+ece391_stdio_exit (void)
+{
+    (void)ece391_fflush (NULL);
+}
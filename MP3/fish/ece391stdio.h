@@ -0,0 +1,62 @@
+#if !defined(ECE391STDIO_H)
+#define ECE391STDIO_H
+
+#include <stdint.h>
+
+/*
+ * Buffered I/O on top of the ece391 system calls, so that a program makes
+ * one read or write per buffer instead of one per string or character.
+ * It only uses ece391_open/read/write/close, and works the same against the
+ * kernel and against ece391emulate.c.  Output to ece391_stdout is flushed at
+ * every newline, other output when the buffer is full; all of it is flushed
+ * when main returns.
+ */
+
+#define ECE391_BUFSIZ       1024
+#define ECE391_FOPEN_MAX    8
+#define ECE391_EOF          (-1)
+
+typedef struct ece391_file {
+    int32_t fd;             /* descriptor, -1 for a free entry           */
+    int32_t writing;        /* opened with "w"                           */
+    int32_t line_buf;       /* flush output at every newline             */
+    int32_t pos;            /* next byte of buf to read                  */
+    int32_t len;            /* bytes in buf                              */
+    int32_t eof;            /* read returned 0                           */
+    int32_t err;            /* a system call failed                      */
+    uint8_t buf[ECE391_BUFSIZ];
+} ECE391_FILE;
+
+extern ECE391_FILE* ece391_stdin;
+extern ECE391_FILE* ece391_stdout;
+
+/* open a file for reading ("r") or writing ("w"), NULL on failure */
+extern ECE391_FILE* ece391_fopen (const uint8_t* name, const char* mode);
+/* flush and close, 0 or ECE391_EOF */
+extern int32_t ece391_fclose (ECE391_FILE* f);
+/* write out buffered output, of every stream if f is NULL */
+extern int32_t ece391_fflush (ECE391_FILE* f);
+
+/* next byte, ECE391_EOF at the end or on error */
+extern int32_t ece391_fgetc (ECE391_FILE* f);
+/* read a line of at most size - 1 bytes, with its newline; NULL at the end */
+extern uint8_t* ece391_fgets (uint8_t* s, int32_t size, ECE391_FILE* f);
+/* read nmemb items of size bytes, return the number of whole items read */
+extern int32_t ece391_fread (void* ptr, int32_t size, int32_t nmemb, ECE391_FILE* f);
+
+extern int32_t ece391_fputc (int32_t c, ECE391_FILE* f);
+extern int32_t ece391_fputs (const uint8_t* s, ECE391_FILE* f);
+/* write nmemb items of size bytes, return the number of whole items written */
+extern int32_t ece391_fwrite (const void* ptr, int32_t size, int32_t nmemb, ECE391_FILE* f);
+
+/*
+ * Formatted output with %d %u %x %s %c and %%, an optional '-' or '0' flag
+ * and a field width.  Return the number of bytes produced.
+ */
+extern int32_t ece391_printf (const char* format, ...);
+extern int32_t ece391_fprintf (ECE391_FILE* f, const char* format, ...);
+
+/* flush everything, called by _start when main returns */
+extern void ece391_stdio_exit (void);
+
+#endif /* ECE391STDIO_H */
@@ -3,6 +3,55 @@
 
 #include <stdint.h>
 
+/* screen modes of ece391_vgamode */
+#define ECE391_VGA_TEXT     0
+#define ECE391_VGA_MODE_X   1
+#define ECE391_VGA_MODE_13H 2
+/* mode X: ECE391_VGA_PLANES | mask selects the planes written, bit n for plane n */
+#define ECE391_VGA_PLANES   0x10
+
+/* shared memory: the window segments are attached in, and the most one may take */
+#define ECE391_SHM_ADDR     0x08400000
+#define ECE391_SHM_MAX      0x400000
+/* key of ece391_shmget that always makes a new segment */
+#define ECE391_SHM_PRIVATE  0
+/* operations of ece391_futex */
+#define ECE391_FUTEX_WAIT   0
+#define ECE391_FUTEX_WAKE   1
+
+/* file types of ece391_dirent_t */
+#define ECE391_TYPE_RTC     0
+#define ECE391_TYPE_DIR     1
+#define ECE391_TYPE_FILE    2
+
+/*
+ * Directory entry returned by ece391_getdents.  Entries are packed one after
+ * another, each followed by name_len bytes of name without a terminating NUL.
+ */
+typedef struct ece391_dirent {
+    uint32_t inode;
+    uint32_t size;
+    uint8_t type;
+    uint8_t name_len;
+    uint8_t name[0];
+} __attribute__((packed)) ece391_dirent_t;
+
+/*
+ * Record written to the "blink" file.  The kernel shows on_char for
+ * on_length ticks and off_char for off_length ticks, at ECE391_BLINK_FREQ,
+ * at location (row * 80 + column) of the program's terminal until the
+ * location is written again or the program halts; an on_length of 0 stops
+ * the cell.  The cells of one write start together.
+ */
+#define ECE391_BLINK_FREQ   32
+typedef struct ece391_blink {
+    uint16_t location;
+    uint8_t on_char;
+    uint8_t off_char;
+    uint16_t on_length;
+    uint16_t off_length;
+} __attribute__((packed)) ece391_blink_t;
+
 /* All calls return >= 0 on success or -1 on failure. */
 
 /*  
@@ -19,6 +68,53 @@ extern int32_t ece391_open (const uint8_t* filename);
 extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
+extern int32_t ece391_set_handler (int32_t signum, void* handler_address);
+extern int32_t ece391_sigreturn (void);
+/*
+ * Fill buf with as many directory entries as fit, from a descriptor opened
+ * on ".".  Returns the number of bytes filled, 0 at the end of the directory
+ * and -1 if not even one entry fits.
+ */
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+/*
+ * Switch the screen to mode X or mode 13h (320x200, 256 colors) and put the
+ * address of the 64kB graphics window in *screen_start, or go back to text
+ * mode.  Only a program on the terminal being shown can take the screen, it
+ * is given back in text mode when the program halts.  In mode X, pass
+ * ECE391_VGA_PLANES | mask to choose the planes that writes go to.
+ */
+extern int32_t ece391_vgamode (uint32_t mode, uint8_t** screen_start);
+/*
+ * Find the shared memory segment of key, or make it with size bytes of
+ * zeros.  Returns its id.  The segment lives while a process holds it:
+ * ece391_shmget and ece391_shmat take a hold, ece391_shmdt and halt drop it.
+ */
+extern int32_t ece391_shmget (uint32_t key, uint32_t size);
+/*
+ * Map a segment at addr, page aligned in the 4MB at ECE391_SHM_ADDR, or
+ * wherever there is room if addr is NULL.  Returns the address.
+ */
+extern int32_t ece391_shmat (int32_t shmid, void* addr);
+extern int32_t ece391_shmdt (void* addr);
+/*
+ * ECE391_FUTEX_WAIT sleeps while *addr == val, and returns -1 at once if it
+ * is not.  ECE391_FUTEX_WAKE wakes up to val sleepers on addr and returns
+ * how many it woke.  Sleepers may come back early, so check again.
+ */
+extern int32_t ece391_futex (uint32_t* addr, int32_t op, uint32_t val);
+/*
+ * Start a thread running func (arg) in this program, with its own stack and
+ * the same memory and open files.  Returns its id.  The thread halts when
+ * func returns, with what it returns as its status, or by ece391_halt.
+ * A program has few threads: they take process slots of the kernel.
+ */
+extern int32_t ece391_thread_create (int32_t (*func)(void*), void* arg);
+/*
+ * Wait for a thread of this program to halt and return its status (256
+ * if an exception killed it), or -1.  Every thread has to be joined once;
+ * the ones left when the first thread of the program halts are stopped.
+ */
+extern int32_t ece391_thread_join (int32_t tid);
 
 #endif /* ECE391SYSCALL_H */
 
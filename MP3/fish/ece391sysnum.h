@@ -11,5 +11,13 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_GETDENTS   11
+#define SYS_VGAMODE    12
+#define SYS_SHMGET     13
+#define SYS_SHMAT      14
+#define SYS_SHMDT      15
+#define SYS_FUTEX      16
+#define SYS_THREAD_CREATE  17
+#define SYS_THREAD_JOIN    18
 
 #endif /* ECE391SYSNUM_H */
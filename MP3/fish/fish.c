@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include "ece391support.h"
 #include "ece391syscall.h"
+#include "ece391stdio.h"
 #include "blink.h"
 
 #define NULL 0
@@ -20,28 +21,83 @@ extern void mp1_rtc_tasklet(unsigned long trash);
 
 static struct mp1_blink_struct blink_array[80*25];
 
+/*
+ * With the kernel's "blink" file, the cells are written there in one batch
+ * and animated by the kernel; fish only sleeps on the RTC.  Without it
+ * (an older kernel, or the Linux emulation), the MP1 code animates them.
+ */
+static int32_t blink_fd = -1;
+static ece391_blink_t blink_batch[80*25];
+static int32_t blink_batch_num = 0;
+
+/* start a cell, in the batch for the blink file or in the MP1 list */
+static void
+blink_add(struct mp1_blink_struct *b)
+{
+    ece391_blink_t *rec;
+
+    if(blink_fd == -1) {
+        mp1_ioctl((unsigned long)b, RTC_ADD);
+        return;
+    }
+    rec = &blink_batch[blink_batch_num++];
+    rec->location = b->location;
+    rec->on_char = b->on_char;
+    rec->off_char = b->off_char;
+    rec->on_length = b->on_length;
+    rec->off_length = b->off_length;
+}
+
+/* the batched cell at a location, NULL if there is none */
+static ece391_blink_t *
+blink_find(uint16_t location)
+{
+    int32_t i;
+
+    for(i = 0; i < blink_batch_num; i++) {
+        if(blink_batch[i].location == location)
+            return &blink_batch[i];
+    }
+    return NULL;
+}
+
+/* let WAIT frames go by */
+static void
+wait_frames(int32_t rtc_fd)
+{
+    int i, garbage;
+
+    for(i=0; i<WAIT; i++) {
+        ece391_read(rtc_fd, &garbage, 4);
+        if(blink_fd == -1)
+            mp1_rtc_tasklet(garbage);
+    }
+}
+
 int main(void)
 {
-    int rtc_fd, ret_val, i, garbage;
+    int rtc_fd, ret_val;
     struct mp1_blink_struct blink_struct;
+    ece391_blink_t *rec, sync[2];
 
     ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
 
-    if(mp1_set_video_mode() == NULL) {
+    blink_fd = ece391_open((uint8_t*)"blink");
+    if(blink_fd == -1 && mp1_set_video_mode() == NULL) {
         return -1;
     }
 
     rtc_fd = ece391_open((uint8_t*)"rtc");
 
     add_frames(file0, file1, rtc_fd);
+    if(blink_fd != -1) {
+        ece391_write(blink_fd, blink_batch, blink_batch_num * sizeof(ece391_blink_t));
+    }
 
     ret_val = 32;
     ret_val = ece391_write(rtc_fd, &ret_val, 4);
 
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
-    }
+    wait_frames(rtc_fd);
 
     blink_struct.on_char = 'I';
     blink_struct.off_char = 'M';
@@ -49,28 +105,39 @@ int main(void)
     blink_struct.off_length = 6;
     blink_struct.location = 6*80+60;
 
-    mp1_ioctl((unsigned long)&blink_struct, RTC_ADD);
-
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+    blink_add(&blink_struct);
+    if(blink_fd != -1) {
+        ece391_write(blink_fd, blink_find(6*80+60), sizeof(ece391_blink_t));
     }
 
-    mp1_ioctl((40 << 16 | (6*80+60)), RTC_SYNC);
+    wait_frames(rtc_fd);
 
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+    if(blink_fd == -1) {
+        mp1_ioctl((40 << 16 | (6*80+60)), RTC_SYNC);
+    } else if((rec = blink_find(40)) != NULL) {
+        /* written together, the two cells start in step */
+        sync[0] = *rec;
+        sync[1] = *blink_find(6*80+60);
+        ece391_write(blink_fd, sync, sizeof(sync));
     }
 
-    mp1_ioctl(6*80+60, RTC_REMOVE);
+    wait_frames(rtc_fd);
 
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+    if(blink_fd == -1) {
+        mp1_ioctl(6*80+60, RTC_REMOVE);
+    } else {
+        blink_struct.on_length = 0;
+        blink_batch_num = 0;
+        blink_add(&blink_struct);
+        ece391_write(blink_fd, blink_batch, sizeof(ece391_blink_t));
     }
 
+    wait_frames(rtc_fd);
+
     ece391_close(rtc_fd);
+    if(blink_fd != -1) {
+        ece391_close(blink_fd);
+    }
 
     return 0;
 }
@@ -78,8 +145,8 @@ int main(void)
 void
 add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 {
-    int32_t row, col, offset = 40, eof0 = 0, eof1 = 0, num_bytes;
-    int32_t fd0, fd1;
+    int32_t row, col, offset = 40, eof0 = 0, eof1 = 0, c;
+    ECE391_FILE *fp0, *fp1;
     struct mp1_blink_struct blink_struct;
     uint8_t c0 = '0', c1 = '0';
 
@@ -88,10 +155,11 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 
     row = 0;
 
-    if( (fd0 = ece391_open(f0)) < 0 ) {
+    /* buffered, the frames are read one character at a time */
+    if( (fp0 = ece391_fopen(f0, "r")) == NULL ) {
         ece391_halt(-1);
     }
-    if( (fd1 = ece391_open(f1)) < 0 ) {
+    if( (fp1 = ece391_fopen(f1, "r")) == NULL ) {
         ece391_halt(-1);
     }
 
@@ -100,18 +168,20 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
         while(1) {
 
             if(c0 != '\n') {
-                num_bytes = ece391_read(fd0, &c0, 1);
-                if(num_bytes == 0) {
+                if((c = ece391_fgetc(fp0)) == ECE391_EOF) {
                     c0 = '\n';
                     eof0 = 1;
+                } else {
+                    c0 = c;
                 }
             }
 
             if(c1 != '\n') {
-                num_bytes = ece391_read(fd1, &c1, 1);
-                if(num_bytes == 0) {
+                if((c = ece391_fgetc(fp1)) == ECE391_EOF) {
                     c1 = '\n';
                     eof1 = 1;
+                } else {
+                    c1 = c;
                 }
             }
 
@@ -123,7 +193,7 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
                     blink_struct.on_char = ( (c0 == '\n') ? ' ' : c0);
                     blink_struct.off_char = ( (c1 == '\n') ? ' ' : c1);
                     blink_struct.location = row*80 + col + offset;
-                    mp1_ioctl((unsigned long)&blink_struct, RTC_ADD);
+                    blink_add(&blink_struct);
                 }
             }
             col++;
@@ -131,20 +201,21 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 
         if(eof0) {
             c0 = '\n';
-            ece391_close(fd0);
         } else {
             c0 = '0';
         }
 
         if(eof1) {
             c1 = '\n';
-            ece391_close(fd1);
         } else {
             c1 = '0';
         }
 
         row++;
     }
+
+    ece391_fclose(fp0);
+    ece391_fclose(fp1);
 }
 
 uint8_t*
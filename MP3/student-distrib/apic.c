@@ -0,0 +1,295 @@
+/*
+    apic
+    local APIC and I/O APIC, used in place of the 8259 when the kernel runs on several processors
+*/
+
+#include "apic.h"
+#include "i8259.h"
+#include "paging.h"
+#include "schedule.h"
+#include "lib.h"
+
+uint32_t apic_enabled = 0;
+
+/* registers, identity mapped by paging_map_mmio */
+static volatile uint32_t* lapic_base = NULL;
+static volatile uint32_t* ioapic_base = NULL;
+/* I/O APIC pin of each ISA IRQ, e.g. the PIT is usually on pin 2 */
+static uint8_t ioapic_pin[APIC_ISA_IRQ_NUM];
+/* device interrupts go to the bootstrap processor */
+static uint32_t ioapic_dest = 0;
+/* local APIC timer ticks (divided by 16) per millisecond */
+static uint32_t lapic_ticks_per_ms = 0;
+
+/*
+ * lapic_read / lapic_write
+ * DESCRIPTION: access a local APIC register
+ * INPUT: reg -- register offset
+ *        val -- value to write
+ * OUTPUT: none
+ * RETURN: register value for lapic_read
+ * SIDE AFFECTS: none
+ */
+static uint32_t lapic_read(uint32_t reg)
+{
+    return lapic_base[reg / sizeof(uint32_t)];
+}
+static void lapic_write(uint32_t reg, uint32_t val)
+{
+    lapic_base[reg / sizeof(uint32_t)] = val;
+    /* read back so that the write is done before going on */
+    lapic_read(LAPIC_ID);
+}
+
+/*
+ * ioapic_write
+ * DESCRIPTION: write an I/O APIC register through the select/window pair
+ * INPUT: reg -- register index
+ *        val -- value
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void ioapic_write(uint32_t reg, uint32_t val)
+{
+    ioapic_base[IOAPIC_REGSEL / sizeof(uint32_t)] = reg;
+    ioapic_base[IOAPIC_WIN / sizeof(uint32_t)] = val;
+}
+
+/*
+ * ioapic_read
+ * DESCRIPTION: read an I/O APIC register through the select/window pair
+ * INPUT: reg -- register index
+ * OUTPUT: none
+ * RETURN: register value
+ * SIDE AFFECTS: none
+ */
+static uint32_t ioapic_read(uint32_t reg)
+{
+    ioapic_base[IOAPIC_REGSEL / sizeof(uint32_t)] = reg;
+    return ioapic_base[IOAPIC_WIN / sizeof(uint32_t)];
+}
+
+/*
+ * lapic_calibrate
+ * DESCRIPTION: count local APIC timer ticks during APIC_CALIBRATE_MS, measured with PIT channel 2
+ *              which is not used by anything else
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: lapic_ticks_per_ms set
+ */
+static void lapic_calibrate()
+{
+    uint32_t count = PIT_MAX_FREQ / APIC_MS_PER_SECOND * APIC_CALIBRATE_MS;    /* PIT ticks to wait */
+    uint8_t gate;                                                               /* port 0x61 value   */
+
+    /* gate on, speaker off, one shot countdown on channel 2 */
+    gate = (inb(APIC_PIT_CH2_GATE) & ~(APIC_PIT_SPEAKER_BIT | APIC_PIT_GATE_BIT));
+    outb(gate, APIC_PIT_CH2_GATE);
+    outb(APIC_PIT_CH2_CMD, APIC_PIT_CMD);
+    outb(count & PIT_BITMASK, APIC_PIT_CH2_DATA);
+    outb(count >> PIT_MSB_OFFSET, APIC_PIT_CH2_DATA);
+
+    /* start both counters */
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    outb(gate | APIC_PIT_GATE_BIT, APIC_PIT_CH2_GATE);
+    lapic_write(LAPIC_TIMER_INIT, LAPIC_TIMER_MAX);
+
+    while (!(inb(APIC_PIT_CH2_GATE) & APIC_PIT_OUT_BIT));
+
+    lapic_ticks_per_ms = (LAPIC_TIMER_MAX - lapic_read(LAPIC_TIMER_CUR)) / APIC_CALIBRATE_MS;
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    outb(gate, APIC_PIT_CH2_GATE);
+}
+
+/*
+ * apic_init
+ * DESCRIPTION: map the local APIC and I/O APIC, mask every 8259 line and every I/O APIC pin,
+ *              enable the local APIC of the bootstrap processor and calibrate its timer.
+ *              From now on enable_irq, disable_irq and send_eoi work on the APICs.
+ * INPUT: lapic_addr -- physical address of the local APICs
+ *        ioapic_addr -- physical address of the I/O APIC
+ *        isa_pin -- I/O APIC pin of each ISA IRQ
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 for fail
+ * SIDE AFFECTS: interrupt delivery changed
+ */
+int32_t apic_init(uint32_t lapic_addr, uint32_t ioapic_addr, uint8_t* isa_pin)
+{
+    uint32_t i;         /* loop index for pins and IRQs */
+    uint32_t pin_num;   /* number of I/O APIC pins      */
+
+    if (paging_map_mmio(lapic_addr) == -1 || paging_map_mmio(ioapic_addr) == -1)
+        return -1;
+    lapic_base = (volatile uint32_t*)lapic_addr;
+    ioapic_base = (volatile uint32_t*)ioapic_addr;
+    memcpy(ioapic_pin, isa_pin, sizeof(ioapic_pin));
+
+    /* the 8259 stays initialized but never raises anything again */
+    outb(INIT_MASK, MASTER_8259_DATA);
+    outb(INIT_MASK, SLAVE_8259_DATA);
+
+    pin_num = ((ioapic_read(IOAPIC_VER) >> IOAPIC_MAX_REDIR_SHIFT) & IOAPIC_MAX_REDIR_MASK) + 1;
+    for (i = 0; i < pin_num; i++)
+    {
+        ioapic_write(IOAPIC_REDTBL + 2*i, IOAPIC_MASKED);
+        ioapic_write(IOAPIC_REDTBL + 2*i + 1, 0);
+    }
+
+    lapic_init();
+    ioapic_dest = lapic_id();
+    lapic_calibrate();
+
+    apic_enabled = 1;
+    return 0;
+}
+
+/*
+ * lapic_init
+ * DESCRIPTION: enable the local APIC of the calling processor with its local interrupts masked
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void lapic_init()
+{
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    /* error status is cleared by two writes */
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_EOI, 0);
+    /* accept every interrupt */
+    lapic_write(LAPIC_TPR, 0);
+}
+
+/*
+ * lapic_id
+ * DESCRIPTION: local APIC id of the calling processor
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: local APIC id
+ * SIDE AFFECTS: none
+ */
+uint32_t lapic_id()
+{
+    return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/*
+ * lapic_eoi
+ * DESCRIPTION: signal end of interrupt to the local APIC of the calling processor
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: lower priority interrupts can come
+ */
+void lapic_eoi()
+{
+    lapic_base[LAPIC_EOI / sizeof(uint32_t)] = 0;
+}
+
+/*
+ * lapic_timer_start
+ * DESCRIPTION: start the local APIC timer of the calling processor, periodic at PIT_FREQ
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: APIC_TIMER_VECTOR comes PIT_FREQ times per second
+ */
+void lapic_timer_start()
+{
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, lapic_ticks_per_ms * APIC_MS_PER_SECOND / PIT_FREQ);
+}
+
+/*
+ * lapic_delay_us
+ * DESCRIPTION: busy wait by counting down the local APIC timer once, only used
+ *              on a processor whose timer is not running periodically
+ * INPUT: us -- microseconds to wait
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: busy waits
+ */
+void lapic_delay_us(uint32_t us)
+{
+    uint32_t ticks = lapic_ticks_per_ms * us / APIC_US_PER_MS;    /* timer ticks to wait */
+
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, ticks ? ticks : 1);
+    while (lapic_read(LAPIC_TIMER_CUR) != 0);
+}
+
+/*
+ * lapic_send_ipi
+ * DESCRIPTION: send an inter-processor interrupt and wait until it is delivered
+ * INPUT: apic_id -- destination local APIC id
+ *        icr -- low word of the interrupt command
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: busy waits
+ */
+static void lapic_send_ipi(uint32_t apic_id, uint32_t icr)
+{
+    lapic_write(LAPIC_ICR_HI, apic_id << LAPIC_ICR_DEST_SHIFT);
+    lapic_write(LAPIC_ICR_LO, icr);
+    while (lapic_read(LAPIC_ICR_LO) & LAPIC_ICR_PENDING);
+}
+
+/*
+ * lapic_start_ap
+ * DESCRIPTION: wake an application processor with the INIT, STARTUP, STARTUP sequence,
+ *              it starts in real mode at start_addr
+ * INPUT: apic_id -- local APIC id of the processor
+ *        start_addr -- 4kB aligned physical address below 1MB
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: busy waits about 10ms
+ */
+void lapic_start_ap(uint32_t apic_id, uint32_t start_addr)
+{
+    int i;  /* loop index for STARTUP IPIs */
+
+    lapic_write(LAPIC_ESR, 0);
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    lapic_delay_us(LAPIC_SIPI_DELAY_US);
+    lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+    lapic_delay_us(LAPIC_INIT_DELAY_US);
+
+    for (i = 0; i < LAPIC_SIPI_NUM; i++)
+    {
+        lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | (start_addr >> MEM_OFFSET_BITS));
+        lapic_delay_us(LAPIC_SIPI_DELAY_US);
+    }
+}
+
+/*
+ * ioapic_set_irq
+ * DESCRIPTION: route an ISA IRQ to the bootstrap processor with the vector the 8259 used,
+ *              or mask it. The slave cascade line has no meaning here.
+ * INPUT: irq -- ISA IRQ number
+ *        enable -- 1 to unmask, 0 to mask
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: I/O APIC redirection entry changed
+ */
+void ioapic_set_irq(uint32_t irq, uint32_t enable)
+{
+    uint32_t pin;   /* I/O APIC pin of the IRQ */
+
+    if (irq >= APIC_ISA_IRQ_NUM || irq == SLAVE_IRQ)
+        return;
+
+    pin = ioapic_pin[irq];
+    ioapic_write(IOAPIC_REDTBL + 2*pin + 1, ioapic_dest << IOAPIC_DEST_SHIFT);
+    ioapic_write(IOAPIC_REDTBL + 2*pin, (APIC_IRQ_VECTOR_BASE + irq) | (enable ? 0 : IOAPIC_MASKED));
+}
@@ -0,0 +1,97 @@
+/*
+    apic.h header file
+*/
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+/* Reference: Intel SDM Vol.3 chapter 10, 82093AA I/O APIC datasheet */
+
+/* default physical addresses, the MP table may give others */
+#define LAPIC_DEFAULT_ADDR      0xFEE00000
+#define IOAPIC_DEFAULT_ADDR     0xFEC00000
+
+/* local APIC registers, offsets from its base */
+#define LAPIC_ID                0x020
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_ESR               0x280
+#define LAPIC_ICR_LO            0x300
+#define LAPIC_ICR_HI            0x310
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_LVT_ERROR         0x370
+#define LAPIC_TIMER_INIT        0x380
+#define LAPIC_TIMER_CUR         0x390
+#define LAPIC_TIMER_DIV         0x3E0
+/* register values */
+#define LAPIC_ID_SHIFT          24
+#define LAPIC_SVR_ENABLE        0x100
+#define LAPIC_LVT_MASKED        0x10000
+#define LAPIC_TIMER_PERIODIC    0x20000
+#define LAPIC_TIMER_DIV_16      0x3
+#define LAPIC_ICR_INIT          0x500
+#define LAPIC_ICR_STARTUP       0x600
+#define LAPIC_ICR_PENDING       0x1000
+#define LAPIC_ICR_ASSERT        0x4000
+#define LAPIC_ICR_LEVEL         0x8000
+#define LAPIC_ICR_DEST_SHIFT    24
+#define LAPIC_TIMER_MAX         0xFFFFFFFF
+/* waits of the INIT, STARTUP, STARTUP sequence */
+#define LAPIC_INIT_DELAY_US     10000
+#define LAPIC_SIPI_DELAY_US     200
+#define LAPIC_SIPI_NUM          2
+
+/* I/O APIC registers */
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WIN              0x10
+#define IOAPIC_VER              0x01
+#define IOAPIC_REDTBL           0x10    /* entry n is at 0x10 + 2n (low) and 0x11 + 2n (high) */
+#define IOAPIC_MAX_REDIR_SHIFT  16
+#define IOAPIC_MAX_REDIR_MASK   0xFF
+#define IOAPIC_MASKED           0x10000
+#define IOAPIC_DEST_SHIFT       24
+
+/* vectors */
+#define APIC_IRQ_VECTOR_BASE    0x20    /* ISA IRQ n keeps the vector the 8259 gave it  */
+#define APIC_TIMER_VECTOR       0x30    /* local APIC timer of application processors   */
+#define APIC_SPURIOUS_VECTOR    0xFF
+#define APIC_ISA_IRQ_NUM        16
+
+/* PIT channel 2 is the reference clock when calibrating the local APIC timer */
+#define APIC_PIT_CH2_DATA       0x42
+#define APIC_PIT_CMD            0x43
+#define APIC_PIT_CH2_GATE       0x61
+#define APIC_PIT_CH2_CMD        0xB0    /* channel 2, lobyte/hibyte, mode 0             */
+#define APIC_PIT_GATE_BIT       0x01
+#define APIC_PIT_SPEAKER_BIT    0x02
+#define APIC_PIT_OUT_BIT        0x20
+#define APIC_CALIBRATE_MS       10
+#define APIC_MS_PER_SECOND      1000
+#define APIC_US_PER_MS          1000
+
+/* set once the I/O APIC delivers device interrupts instead of the 8259 */
+extern uint32_t apic_enabled;
+
+/* map the APICs, mask the 8259 and calibrate the timer, on the bootstrap processor */
+extern int32_t apic_init(uint32_t lapic_addr, uint32_t ioapic_addr, uint8_t* isa_pin);
+/* enable the local APIC of the calling processor */
+extern void lapic_init();
+/* local APIC id of the calling processor */
+extern uint32_t lapic_id();
+/* end of interrupt to the local APIC */
+extern void lapic_eoi();
+/* start the periodic local APIC timer at PIT_FREQ on the calling processor */
+extern void lapic_timer_start();
+/* busy wait using the local APIC timer of the calling processor */
+extern void lapic_delay_us(uint32_t us);
+/* send INIT and two STARTUP IPIs to another processor */
+extern void lapic_start_ap(uint32_t apic_id, uint32_t start_addr);
+/* unmask or mask an ISA IRQ in the I/O APIC */
+extern void ioapic_set_irq(uint32_t irq, uint32_t enable);
+
+#endif
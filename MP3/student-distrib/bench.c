@@ -0,0 +1,338 @@
+/*
+    bench
+    kernel workloads of the benchmark suite. Results are written to the serial port as
+        BENCH <name> key=value ...
+    lines, the user side (the "bench" program) writes the same lines through the serial
+    pseudo file, and MP3/tools/bench.py collects them from a headless QEMU.
+    Cycle counts are the low 32 bits of TSC differences, so every workload is kept
+    well below 2^32 cycles.
+*/
+
+#include "bench.h"
+#include "proc.h"
+#include "serial.h"
+#include "filesys.h"
+#include "paging.h"
+#include "schedule.h"
+#include "syscall.h"
+#include "x86_desc.h"
+#include "lib.h"
+
+/* read buffer of the read_data workload */
+static uint8_t bench_buf[BENCH_READ_CHUNK];
+
+/* buffers of the string workloads */
+static uint8_t bench_src[BENCH_MEM_MAX];
+static uint8_t bench_dst[BENCH_MEM_MAX];
+static int8_t bench_str1[BENCH_STR_LEN + 1];
+static int8_t bench_str2[BENCH_STR_LEN + 1];
+
+/* block sizes of memcpy and memset: a dentry, a screen of text (scrolling, terminal
+   switches), and a large block as in execute and copy-on-write */
+static const uint32_t bench_mem_size[] = {64, VIDBUF_SIZE, BENCH_MEM_MAX};
+#define BENCH_MEM_SIZE_NUM  (sizeof(bench_mem_size) / sizeof(bench_mem_size[0]))
+
+/* a memcpy variant */
+typedef void* (*bench_mem_t)(void* dest, const void* src, uint32_t n);
+
+/*
+ * bench_tsc
+ * DESCRIPTION: read the low 32 bits of the time-stamp counter
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: TSC
+ * SIDE AFFECTS: none
+ */
+static uint32_t bench_tsc()
+{
+    uint32_t lo, hi;    /* TSC halves */
+
+    rdtsc(lo, hi);
+    return lo;
+}
+
+/*
+ * bench_tsc_khz
+ * DESCRIPTION: calibrate the TSC against BENCH_CALIB_TICKS PIT ticks, interrupts must be enabled
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: TSC frequency in kHz
+ * SIDE AFFECTS: busy waits BENCH_CALIB_TICKS + 1 ticks
+ */
+uint32_t bench_tsc_khz()
+{
+    volatile uint32_t* uptime = &proc_uptime;   /* PIT ticks, changed by the PIT handler */
+    uint32_t start_tick;                        /* tick the measurement starts at         */
+    uint32_t start;                             /* TSC when it starts                     */
+
+    /* start right at a tick edge */
+    start_tick = *uptime;
+    while (*uptime == start_tick);
+    start_tick = *uptime;
+    start = bench_tsc();
+
+    while (*uptime - start_tick < BENCH_CALIB_TICKS);
+    return (bench_tsc() - start) / (BENCH_CALIB_TICKS * (1000 / PIT_FREQ));
+}
+
+/*
+ * bench_report
+ * DESCRIPTION: write one result line to the serial port
+ * INPUT: name -- workload name
+ *        iters -- number of operations
+ *        cycles -- TSC cycles for all of them
+ *        bytes -- bytes moved by all of them, 0 if not meaningful
+ * OUTPUT: "BENCH <name> iters=<n> cycles=<n> bytes=<n>" on the serial port
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void bench_report(const int8_t* name, uint32_t iters, uint32_t cycles, uint32_t bytes)
+{
+    int8_t num[BENCH_LINE_LEN];     /* number to string buffer */
+
+    serial_puts("BENCH ");
+    serial_puts(name);
+    serial_puts(" iters=");
+    serial_puts(itoa(iters, num, 10));
+    serial_puts(" cycles=");
+    serial_puts(itoa(cycles, num, 10));
+    serial_puts(" bytes=");
+    serial_puts(itoa(bytes, num, 10));
+    serial_putc('\n');
+}
+
+/*
+ * bench_read_data
+ * DESCRIPTION: file system throughput, read every regular file through read_data
+ *              in BENCH_READ_CHUNK pieces, BENCH_READ_ROUNDS times
+ * INPUT: none
+ * OUTPUT: result line on the serial port
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void bench_read_data()
+{
+    uint32_t idx;       /* dentry index                 */
+    uint32_t round;     /* loop index for passes        */
+    uint32_t offset;    /* offset in the current file   */
+    uint32_t calls;     /* read_data calls              */
+    uint32_t bytes;     /* bytes read                   */
+    uint32_t cycles;    /* TSC cycles                   */
+    int32_t cnt;        /* bytes read by one call       */
+    dentry_t dentry;    /* current dentry               */
+
+    calls = bytes = 0;
+    cycles = bench_tsc();
+    for (round = 0; round < BENCH_READ_ROUNDS; round++)
+    {
+        for (idx = 0; read_dentry_by_index(idx, &dentry) == 0; idx++)
+        {
+            if (dentry.file_type != FILE_TYPE)
+                continue;
+            offset = 0;
+            while ((cnt = read_data(dentry.inode_idx, offset, bench_buf, BENCH_READ_CHUNK)) > 0)
+            {
+                offset += cnt;
+                calls++;
+            }
+            bytes += offset;
+        }
+    }
+    cycles = bench_tsc() - cycles;
+    bench_report("read_data", calls, cycles, bytes);
+}
+
+/*
+ * bench_switch
+ * DESCRIPTION: address space switch cost, i.e. what the scheduler does to switch
+ *              between two processes besides swapping stacks: user page, video
+ *              page and TSS. The TLB flush is included.
+ * INPUT: none
+ * OUTPUT: result line on the serial port
+ * RETURN: none
+ * SIDE AFFECTS: paging left set for pid 0, the first process sets it again
+ */
+static void bench_switch()
+{
+    uint32_t i;         /* loop index for switches  */
+    uint32_t cycles;    /* TSC cycles               */
+
+    cycles = bench_tsc();
+    for (i = 0; i < BENCH_SWITCH_ITERS; i++)
+    {
+        set_paging(i & 1);
+        vid_remap((uint8_t*)VIDEO);
+        this_cpu()->tss->esp0 = KS_BASE_ADDR - KS_SIZE * (i & 1) - sizeof(int32_t);
+    }
+    cycles = bench_tsc() - cycles;
+    set_paging(0);
+    bench_report("ctx_switch", BENCH_SWITCH_ITERS, cycles, 0);
+}
+
+/*
+ * bench_name
+ * DESCRIPTION: make a workload name "<base>_<size>"
+ * INPUT: buf -- BENCH_NAME_LEN bytes for the name
+ *        base -- variant name
+ *        size -- block size
+ * OUTPUT: none
+ * RETURN: buf
+ * SIDE AFFECTS: none
+ */
+static int8_t* bench_name(int8_t* buf, const int8_t* base, uint32_t size)
+{
+    int8_t num[BENCH_LINE_LEN];     /* number to string buffer */
+
+    strncpy(buf, base, BENCH_NAME_LEN);
+    strncpy(buf + strlen(buf), "_", 2);
+    itoa(size, num, 10);
+    strncpy(buf + strlen(buf), num, BENCH_NAME_LEN - strlen(buf) - 1);
+    buf[BENCH_NAME_LEN - 1] = '\0';
+    return buf;
+}
+
+/*
+ * bench_memcpy
+ * DESCRIPTION: copy BENCH_MEM_BYTES in blocks of every size with one memcpy variant
+ * INPUT: base -- variant name
+ *        copy -- the variant
+ * OUTPUT: result lines on the serial port
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void bench_memcpy(const int8_t* base, bench_mem_t copy)
+{
+    int8_t name[BENCH_NAME_LEN];    /* workload name        */
+    uint32_t i, j;                  /* loop indices         */
+    uint32_t iters;                 /* blocks copied        */
+    uint32_t cycles;                /* TSC cycles           */
+
+    for (i = 0; i < BENCH_MEM_SIZE_NUM; i++)
+    {
+        iters = BENCH_MEM_BYTES / bench_mem_size[i];
+        cycles = bench_tsc();
+        for (j = 0; j < iters; j++)
+            copy(bench_dst, bench_src, bench_mem_size[i]);
+        cycles = bench_tsc() - cycles;
+        bench_report(bench_name(name, base, bench_mem_size[i]), iters, cycles, iters * bench_mem_size[i]);
+    }
+}
+
+/*
+ * bench_memset
+ * DESCRIPTION: set BENCH_MEM_BYTES in blocks of every size with one memset variant
+ * INPUT: base -- variant name
+ *        set -- the variant
+ * OUTPUT: result lines on the serial port
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void bench_memset(const int8_t* base, void* (*set)(void* s, int32_t c, uint32_t n))
+{
+    int8_t name[BENCH_NAME_LEN];    /* workload name        */
+    uint32_t i, j;                  /* loop indices         */
+    uint32_t iters;                 /* blocks set           */
+    uint32_t cycles;                /* TSC cycles           */
+
+    for (i = 0; i < BENCH_MEM_SIZE_NUM; i++)
+    {
+        iters = BENCH_MEM_BYTES / bench_mem_size[i];
+        cycles = bench_tsc();
+        for (j = 0; j < iters; j++)
+            set(bench_dst, j, bench_mem_size[i]);
+        cycles = bench_tsc() - cycles;
+        bench_report(bench_name(name, base, bench_mem_size[i]), iters, cycles, iters * bench_mem_size[i]);
+    }
+}
+
+/*
+ * bench_string
+ * DESCRIPTION: compare every variant of the string routines: strlen and strncmp on
+ *              file name sized strings, memcpy and memset over a range of block sizes,
+ *              and memmove on an overlapping screen of text both ways. The SSE2
+ *              variants are only run if lib_init enabled them.
+ * INPUT: none
+ * OUTPUT: result lines on the serial port
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void bench_string()
+{
+    uint32_t i;                         /* loop index           */
+    uint32_t cycles;                    /* TSC cycles           */
+    volatile uint32_t sink = 0;         /* keeps results used   */
+
+    for (i = 0; i < BENCH_STR_LEN; i++)
+        bench_str1[i] = bench_str2[i] = 'a' + i % 26;
+    bench_str1[BENCH_STR_LEN] = bench_str2[BENCH_STR_LEN] = '\0';
+
+    cycles = bench_tsc();
+    for (i = 0; i < BENCH_STR_ITERS; i++)
+        sink += strlen_byte(bench_str1);
+    cycles = bench_tsc() - cycles;
+    bench_report("strlen_byte", BENCH_STR_ITERS, cycles, BENCH_STR_ITERS * BENCH_STR_LEN);
+
+    cycles = bench_tsc();
+    for (i = 0; i < BENCH_STR_ITERS; i++)
+        sink += strlen(bench_str1);
+    cycles = bench_tsc() - cycles;
+    bench_report("strlen_word", BENCH_STR_ITERS, cycles, BENCH_STR_ITERS * BENCH_STR_LEN);
+
+    cycles = bench_tsc();
+    for (i = 0; i < BENCH_STR_ITERS; i++)
+        sink += strncmp_byte(bench_str1, bench_str2, BENCH_STR_LEN);
+    cycles = bench_tsc() - cycles;
+    bench_report("strncmp_byte", BENCH_STR_ITERS, cycles, BENCH_STR_ITERS * BENCH_STR_LEN);
+
+    cycles = bench_tsc();
+    for (i = 0; i < BENCH_STR_ITERS; i++)
+        sink += strncmp(bench_str1, bench_str2, BENCH_STR_LEN);
+    cycles = bench_tsc() - cycles;
+    bench_report("strncmp_word", BENCH_STR_ITERS, cycles, BENCH_STR_ITERS * BENCH_STR_LEN);
+
+    bench_memcpy("memcpy_rep", memcpy_rep);
+    bench_memset("memset_rep", memset_rep);
+    if (cpu_features & CPUID_EDX_SSE2)
+    {
+        bench_memcpy("memcpy_sse2", memcpy_sse2);
+        bench_memset("memset_sse2", memset_sse2);
+    }
+
+    /* a screen of text moved one line up (scrolling) and one line down */
+    cycles = bench_tsc();
+    for (i = 0; i < BENCH_MEM_BYTES / (VIDBUF_SIZE); i++)
+        memmove(bench_dst, bench_dst + 2 * NUM_COLS, VIDBUF_SIZE);
+    cycles = bench_tsc() - cycles;
+    bench_report("memmove_up", i, cycles, i * VIDBUF_SIZE);
+
+    cycles = bench_tsc();
+    for (i = 0; i < BENCH_MEM_BYTES / (VIDBUF_SIZE); i++)
+        memmove(bench_dst + 2 * NUM_COLS, bench_dst, VIDBUF_SIZE);
+    cycles = bench_tsc() - cycles;
+    bench_report("memmove_down", i, cycles, i * VIDBUF_SIZE);
+}
+
+/*
+ * bench_kernel
+ * DESCRIPTION: calibrate the TSC and run the kernel workloads with interrupts disabled,
+ *              called before the first process when the kernel is built with RUN_BENCH
+ * INPUT: none
+ * OUTPUT: result lines on the serial port
+ * RETURN: none
+ * SIDE AFFECTS: interrupts enabled on return
+ */
+void bench_kernel()
+{
+    int8_t num[BENCH_LINE_LEN];     /* number to string buffer */
+
+    serial_puts("BENCH start\n");
+    serial_puts("BENCH tsc khz=");
+    serial_puts(itoa(bench_tsc_khz(), num, 10));
+    serial_putc('\n');
+
+    cli();
+    bench_read_data();
+    bench_switch();
+    bench_string();
+    sti();
+}
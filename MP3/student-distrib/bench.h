@@ -0,0 +1,32 @@
+/*
+    bench.h header file
+    kernel side of the benchmark suite, see MP3/tools/bench.py
+*/
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "types.h"
+
+#define BENCH_PROGRAM       "bench"     /* user side of the suite, run instead of the shell */
+#define BENCH_CALIB_TICKS   10          /* PIT ticks used to calibrate the TSC */
+#define BENCH_READ_ROUNDS   8           /* passes over all files for read_data */
+#define BENCH_READ_CHUNK    4096        /* bytes per read_data call */
+#define BENCH_SWITCH_ITERS  10000       /* address space switches */
+#define BENCH_LINE_LEN      128
+#define BENCH_STR_ITERS     20000       /* strlen and strncmp calls per variant */
+#define BENCH_STR_LEN       32          /* MAX_FILE_NAME_LEN, what name lookups compare */
+#define BENCH_MEM_BYTES     0x400000    /* bytes moved per memcpy/memset variant and size */
+#define BENCH_MEM_MAX       0x10000     /* largest block */
+#define BENCH_NAME_LEN      32
+
+/* calibrate the TSC against the PIT, interrupts must be enabled */
+uint32_t bench_tsc_khz();
+
+/* write one result line "BENCH <name> iters=<n> cycles=<n> bytes=<n>" to the serial port */
+void bench_report(const int8_t* name, uint32_t iters, uint32_t cycles, uint32_t bytes);
+
+/* run the kernel workloads and report them on the serial port */
+void bench_kernel();
+
+#endif
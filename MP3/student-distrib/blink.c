@@ -0,0 +1,246 @@
+/*
+    blink
+    the MP1 blink engine moved into the kernel. A process writes batches of blink_rec_t to
+    the "blink" pseudo file and the RTC handler animates them in the text of the process'
+    terminal, on the screen if it is shown and in its video buffer if not. Nothing has to
+    run in user space per frame, the process may sleep or exit its loop and the cells keep
+    blinking until it writes them away or halts.
+*/
+
+#include "blink.h"
+#include "rtc.h"
+#include "syscall.h"
+#include "terminal.h"
+#include "filesys.h"
+#include "vga.h"
+
+/* one animated cell */
+typedef struct blink_cell_t {
+    blink_rec_t rec;        /* as written by the process            */
+    uint16_t countdown;     /* ticks left in the current phase      */
+    uint8_t status;         /* 1 while on_char is shown             */
+    uint8_t term_id;        /* terminal whose text it is drawn into */
+    uint32_t pid;           /* process that wrote it                */
+} blink_cell_t;
+
+/* the animated cells, packed at the start of the array */
+static blink_cell_t blink_cells[BLINK_MAX];
+static uint32_t blink_num = 0;
+/* index + 1 in blink_cells of every location of every terminal, 0 if not animated */
+static uint16_t blink_index[TERMINAL_MAX][BLINK_CELL_NUM];
+/* RTC interrupts since the last tick */
+static uint32_t blink_rtc_count = 0;
+
+/*
+ * blink_init
+ * DESCRIPTION: register the blink pseudo file
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: "blink" appears in the directory
+ */
+void blink_init()
+{
+    pseudo_register(BLINK_FILE_NAME, blink_read, blink_write);
+}
+
+/*
+ * blink_draw
+ * DESCRIPTION: put the character of the current phase of a cell into its terminal's text,
+ *              the screen if the terminal is shown in text mode, its video buffer otherwise
+ * INPUT: cell -- cell to draw
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: video memory changed
+ */
+static void blink_draw(blink_cell_t* cell)
+{
+    uint8_t* mem;   /* text the cell is drawn into */
+
+    if (cell->term_id == curr_term_id && vga_owner == -1)
+        mem = (uint8_t*)VIDEO;
+    else
+        mem = terminals[cell->term_id].vid_buf;
+    if (mem == NULL)
+        return;
+    mem[cell->rec.location << 1] = cell->status ? cell->rec.on_char : cell->rec.off_char;
+}
+
+/*
+ * blink_remove
+ * DESCRIPTION: stop animating a cell, the last cell takes its place. The screen keeps the
+ *              character shown last, as MP1's RTC_REMOVE did.
+ * INPUT: idx -- index of the cell in blink_cells
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: cell table changed
+ */
+static void blink_remove(uint32_t idx)
+{
+    blink_cell_t* cell = &blink_cells[idx];     /* cell removed */
+    blink_cell_t* last;                         /* cell moved   */
+
+    blink_index[cell->term_id][cell->rec.location] = 0;
+    last = &blink_cells[--blink_num];
+    if (last != cell)
+    {
+        *cell = *last;
+        blink_index[cell->term_id][cell->rec.location] = idx + 1;
+    }
+}
+
+/*
+ * blink_tick
+ * DESCRIPTION: count RTC interrupts and every 1/BLINK_FREQ second count down every cell,
+ *              showing the other character of a cell whose phase is over
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: video memory changed
+ */
+void blink_tick()
+{
+    uint32_t i;             /* loop index for cells */
+    blink_cell_t* cell;     /* current cell         */
+
+    if (blink_num == 0 || ++blink_rtc_count < RTC_MAX_FRE / BLINK_FREQ)
+        return;
+    blink_rtc_count = 0;
+
+    for (i = 0; i < blink_num; i++)
+    {
+        cell = &blink_cells[i];
+        if (--cell->countdown != 0)
+            continue;
+        cell->status = !cell->status;
+        cell->countdown = cell->status ? cell->rec.on_length : cell->rec.off_length;
+        blink_draw(cell);
+    }
+}
+
+/*
+ * blink_release
+ * DESCRIPTION: called by halt, stop every cell of a halting process
+ * INPUT: pid -- halting process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: cell table changed
+ */
+void blink_release(uint32_t pid)
+{
+    uint32_t i = 0;     /* loop index for cells */
+
+    /* a removed cell is replaced by the last one, which is looked at next */
+    while (i < blink_num)
+    {
+        if (blink_cells[i].pid == pid)
+            blink_remove(i);
+        else
+            i++;
+    }
+}
+
+/*
+ * blink_read
+ * DESCRIPTION: read routine of the blink pseudo file, the cells of the calling process as
+ *              blink_rec_t, in no particular order. Only whole records are copied.
+ * INPUT: offset -- byte offset in the file
+ *        buf -- buffer to be filled in
+ *        nbytes -- number of bytes needed to be copied
+ * OUTPUT: none
+ * RETURN: number of copied bytes
+ * SIDE AFFECTS: none
+ */
+int32_t blink_read(uint32_t offset, uint8_t* buf, uint32_t nbytes)
+{
+    uint32_t i;             /* loop index for cells             */
+    uint32_t skip;          /* records before the offset        */
+    uint32_t copied = 0;    /* bytes copied                     */
+    uint32_t flags;         /* saved eflags                     */
+
+    skip = offset / sizeof(blink_rec_t);
+    cli_and_save(flags);
+    for (i = 0; i < blink_num && copied + sizeof(blink_rec_t) <= nbytes; i++)
+    {
+        if (blink_cells[i].pid != curr_pid)
+            continue;
+        if (skip > 0)
+        {
+            skip--;
+            continue;
+        }
+        memcpy(buf + copied, &blink_cells[i].rec, sizeof(blink_rec_t));
+        copied += sizeof(blink_rec_t);
+    }
+    restore_flags(flags);
+    return copied;
+}
+
+/*
+ * blink_write
+ * DESCRIPTION: write routine of the blink pseudo file. Every record adds or replaces the cell
+ *              at its location in the terminal of the calling process, or removes it if
+ *              on_length is 0. The cells of one write start showing on_char together.
+ * INPUT: buf -- blink_rec_t records
+ *        nbytes -- size of the records
+ * OUTPUT: none
+ * RETURN: number of bytes of the records applied, less than nbytes if the table is full,
+ *         -1 if a record is invalid, and then none is applied
+ * SIDE AFFECTS: cell table and video memory changed
+ */
+int32_t blink_write(const uint8_t* buf, uint32_t nbytes)
+{
+    const blink_rec_t* rec = (const blink_rec_t*)buf;   /* records written          */
+    uint32_t num = nbytes / sizeof(blink_rec_t);        /* number of records        */
+    uint32_t term_id = get_pcb_ptr(curr_pid)->term_id;  /* terminal of the caller   */
+    blink_cell_t* cell;                                 /* cell of a record         */
+    uint32_t i;                                         /* loop index for records   */
+    uint32_t flags;                                     /* saved eflags             */
+
+    if (nbytes % sizeof(blink_rec_t) != 0)
+        return -1;
+    for (i = 0; i < num; i++)
+    {
+        if (rec[i].location >= BLINK_CELL_NUM)
+            return -1;
+        if (rec[i].on_length != 0 && rec[i].off_length == 0)
+            return -1;
+    }
+
+    /* the handler may run on this processor between any two records */
+    cli_and_save(flags);
+    /* the lengths count interrupts at the highest rate, which rtc_open sets too */
+    if (blink_num == 0)
+        rtc_set_fre(RTC_MAX_FRE);
+
+    for (i = 0; i < num; i++)
+    {
+        if (blink_index[term_id][rec[i].location] != 0)
+        {
+            cell = &blink_cells[blink_index[term_id][rec[i].location] - 1];
+        }
+        else
+        {
+            if (rec[i].on_length == 0)
+                continue;
+            if (blink_num >= BLINK_MAX)
+                break;
+            cell = &blink_cells[blink_num++];
+            blink_index[term_id][rec[i].location] = blink_num;
+        }
+        if (rec[i].on_length == 0)
+        {
+            blink_remove(cell - blink_cells);
+            continue;
+        }
+        cell->rec = rec[i];
+        cell->countdown = rec[i].on_length;
+        cell->status = 1;
+        cell->term_id = term_id;
+        cell->pid = curr_pid;
+        blink_draw(cell);
+    }
+    restore_flags(flags);
+
+    return i * sizeof(blink_rec_t);
+}
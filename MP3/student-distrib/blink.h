@@ -0,0 +1,45 @@
+/*
+    blink.h header file
+    the MP1 blink engine in the kernel, driven by the RTC through the "blink" pseudo file
+*/
+
+#ifndef _BLINK_H
+#define _BLINK_H
+
+#include "types.h"
+#include "lib.h"
+
+#define BLINK_FILE_NAME     "blink"
+#define BLINK_MAX           4096                    /* cells animated at once, all terminals together */
+#define BLINK_FREQ          32                      /* lengths are in ticks of this rate, as fish used */
+#define BLINK_CELL_NUM      (NUM_COLS * NUM_ROWS)   /* locations on a screen                           */
+
+/*
+ * one record written to the blink file, mp1_blink_struct of MP1 without the bookkeeping.
+ * Writing a location that is animated already replaces it, and every record of one write
+ * starts with on_char at the same tick, which is how cells are put in step (RTC_SYNC).
+ */
+typedef struct blink_rec_t {
+    uint16_t location;      /* row * NUM_COLS + column                  */
+    uint8_t on_char;
+    uint8_t off_char;
+    uint16_t on_length;     /* ticks showing on_char, 0 removes the cell */
+    uint16_t off_length;    /* ticks showing off_char                   */
+} __attribute__((packed)) blink_rec_t;
+
+/* register the blink pseudo file */
+void blink_init();
+
+/* advance the animations, called by the RTC handler every interrupt */
+void blink_tick();
+
+/* stop the animations of a halting process */
+void blink_release(uint32_t pid);
+
+/* read the blink file, the records of the calling process */
+int32_t blink_read(uint32_t offset, uint8_t* buf, uint32_t nbytes);
+
+/* write the blink file, a batch of records for the terminal of the calling process */
+int32_t blink_write(const uint8_t* buf, uint32_t nbytes);
+
+#endif
@@ -0,0 +1,312 @@
+/*
+    bootlog
+    boot phase timestamps. entry() takes a TSC timestamp at its start and after every
+    init step, the "boottime" pseudo file shows the cycles each step took and the time
+    from entry() to the first program. The TSC is calibrated against the PIT in the
+    background once interrupts are on, so boot itself never waits for it.
+    The kernel command line is kept here too, options are looked up with boot_param.
+*/
+
+#include "bootlog.h"
+#include "schedule.h"
+#include "proc.h"
+#include "filesys.h"
+#include "lib.h"
+
+/* one boot phase, ended by boot_mark */
+typedef struct boot_phase_t {
+    const int8_t* name;     /* init step that just finished */
+    uint32_t tsc_lo;        /* TSC at its end               */
+    uint32_t tsc_hi;
+} boot_phase_t;
+
+uint32_t boot_quiet = 0;
+
+/* phase 0 is the start of entry() */
+static boot_phase_t boot_phase[BOOT_MAX_PHASE];
+static uint32_t boot_phase_num = 0;
+/* the first program was started, the timeline is complete */
+static uint32_t boot_finished = 0;
+
+/* the command line split into options at spaces */
+static int8_t boot_cmdline[BOOT_CMDLINE_LEN];
+static int8_t* boot_opt[BOOT_CMDLINE_LEN / 2];
+static uint32_t boot_opt_num = 0;
+
+/* TSC frequency, 0 until the calibration is over */
+static uint32_t boot_tsc_khz = 0;
+static uint32_t calib_started = 0;
+static uint32_t calib_tick;
+static uint32_t calib_tsc;
+
+static int8_t boot_buf[BOOT_BUF_SIZE];
+
+/*
+ * boot_start
+ * DESCRIPTION: take the first timestamp and split a copy of the kernel command line into options,
+ *              the first word is the kernel image and is skipped. Called first thing in entry().
+ * INPUT: cmdline -- multiboot command line, NULL if the boot loader gave none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: boot_quiet set from the command line
+ */
+void boot_start(const int8_t* cmdline)
+{
+    uint32_t i;     /* loop index for the command line  */
+    uint32_t word;  /* number of words seen so far      */
+
+    boot_phase_num = 0;
+    boot_mark("entry");
+
+    if (cmdline == NULL)
+        return;
+    strncpy(boot_cmdline, cmdline, BOOT_CMDLINE_LEN - 1);
+    boot_cmdline[BOOT_CMDLINE_LEN - 1] = '\0';
+
+    word = 0;
+    for (i = 0; boot_cmdline[i] != '\0'; i++)
+    {
+        if (boot_cmdline[i] == ' ')
+        {
+            boot_cmdline[i] = '\0';
+            continue;
+        }
+        if (i > 0 && boot_cmdline[i - 1] != '\0')
+            continue;
+        if (word++ > 0)
+            boot_opt[boot_opt_num++] = &boot_cmdline[i];
+    }
+
+    boot_quiet = (boot_param(BOOT_OPT_QUIET) != NULL);
+}
+
+/*
+ * boot_param
+ * DESCRIPTION: look an option up on the kernel command line
+ * INPUT: name -- option name
+ * OUTPUT: none
+ * RETURN: the value of "name=value", "" for "name", NULL if the option is not given
+ * SIDE AFFECTS: none
+ */
+const int8_t* boot_param(const int8_t* name)
+{
+    uint32_t i;                     /* loop index for options   */
+    uint32_t len = strlen(name);    /* length of the name       */
+
+    for (i = 0; i < boot_opt_num; i++)
+    {
+        if (strncmp(boot_opt[i], name, len) != 0)
+            continue;
+        if (boot_opt[i][len] == '\0')
+            return boot_opt[i] + len;
+        if (boot_opt[i][len] == '=')
+            return boot_opt[i] + len + 1;
+    }
+    return NULL;
+}
+
+/*
+ * boot_param_num
+ * DESCRIPTION: look a numeric option up on the kernel command line
+ * INPUT: name -- option name
+ *        def -- value if the option is not given or is not a decimal number
+ * OUTPUT: none
+ * RETURN: value of the option
+ * SIDE AFFECTS: none
+ */
+uint32_t boot_param_num(const int8_t* name, uint32_t def)
+{
+    const int8_t* val = boot_param(name);   /* text of the value    */
+    uint32_t num = 0;                       /* converted value      */
+
+    if (val == NULL || *val == '\0')
+        return def;
+    for (; *val != '\0'; val++)
+    {
+        if (*val < '0' || *val > '9')
+            return def;
+        num = num * 10 + (*val - '0');
+    }
+    return num;
+}
+
+/*
+ * boot_mark
+ * DESCRIPTION: record the end of a boot phase, steps past BOOT_MAX_PHASE are not recorded
+ * INPUT: name -- name of the phase, must stay valid
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void boot_mark(const int8_t* name)
+{
+    boot_phase_t* phase;    /* new phase */
+
+    if (boot_phase_num >= BOOT_MAX_PHASE)
+        return;
+    phase = &boot_phase[boot_phase_num++];
+    phase->name = name;
+    rdtsc(phase->tsc_lo, phase->tsc_hi);
+}
+
+/*
+ * boot_finish
+ * DESCRIPTION: record the last phase, the start of the first program. Called by every execute,
+ *              only the first call counts.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void boot_finish()
+{
+    if (boot_finished)
+        return;
+    boot_finished = 1;
+    boot_mark("exec");
+}
+
+/*
+ * boot_init
+ * DESCRIPTION: register the boottime pseudo file
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: "boottime" appears in the directory
+ */
+void boot_init()
+{
+    pseudo_register(BOOT_FILE_NAME, boot_read, NULL);
+}
+
+/*
+ * boot_tick
+ * DESCRIPTION: measure the TSC over BOOT_CALIB_TICKS PIT ticks, from the first tick on. Called by
+ *              the PIT handler every tick, it returns at once when the frequency is known.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void boot_tick()
+{
+    uint32_t lo, hi;    /* TSC halves */
+
+    if (boot_tsc_khz != 0)
+        return;
+    rdtsc(lo, hi);
+    if (!calib_started)
+    {
+        calib_started = 1;
+        calib_tick = proc_uptime;
+        calib_tsc = lo;
+    }
+    else if (proc_uptime - calib_tick >= BOOT_CALIB_TICKS)
+    {
+        boot_tsc_khz = (lo - calib_tsc) / ((proc_uptime - calib_tick) * (1000 / PIT_FREQ));
+    }
+}
+
+/*
+ * boot_cycles
+ * DESCRIPTION: TSC cycles between two phases, saturated to 32 bits
+ * INPUT: from, to -- phases
+ * OUTPUT: none
+ * RETURN: cycles
+ * SIDE AFFECTS: none
+ */
+static uint32_t boot_cycles(boot_phase_t* from, boot_phase_t* to)
+{
+    /* high half of the difference, with the borrow from the low half */
+    if (to->tsc_hi - from->tsc_hi - (to->tsc_lo < from->tsc_lo ? 1 : 0) != 0)
+        return 0xFFFFFFFF;
+    return to->tsc_lo - from->tsc_lo;
+}
+
+/*
+ * boot_put_str
+ * DESCRIPTION: append a string to the timeline, left aligned and padded with spaces to width
+ * INPUT: len -- current length of the timeline
+ *        s -- string to append
+ *        width -- column width
+ * OUTPUT: none
+ * RETURN: new length of the timeline
+ * SIDE AFFECTS: timeline buffer changed
+ */
+static uint32_t boot_put_str(uint32_t len, const int8_t* s, uint32_t width)
+{
+    uint32_t i;     /* number of chars appended */
+
+    for (i = 0; s[i] != '\0' && len < BOOT_BUF_SIZE; i++)
+        boot_buf[len++] = s[i];
+    for (; i < width && len < BOOT_BUF_SIZE; i++)
+        boot_buf[len++] = ' ';
+    return len;
+}
+
+/*
+ * boot_put_phase
+ * DESCRIPTION: append a line "<name> <cycles> <microseconds>" to the timeline, the microseconds
+ *              are "-" while the TSC frequency is not known yet
+ * INPUT: len -- current length of the timeline
+ *        name -- phase name
+ *        cycles -- TSC cycles of the phase
+ * OUTPUT: none
+ * RETURN: new length of the timeline
+ * SIDE AFFECTS: timeline buffer changed
+ */
+static uint32_t boot_put_phase(uint32_t len, const int8_t* name, uint32_t cycles)
+{
+    int8_t conv_buf[36];    /* converted number */
+
+    len = boot_put_str(len, name, BOOT_COL_WIDTH);
+    len = boot_put_str(len, itoa(cycles, conv_buf, 10), BOOT_COL_WIDTH);
+    if (boot_tsc_khz >= 1000)
+        len = boot_put_str(len, itoa(cycles / (boot_tsc_khz / 1000), conv_buf, 10), 0);
+    else
+        len = boot_put_str(len, "-", 0);
+    return boot_put_str(len, "\n", 0);
+}
+
+/*
+ * boot_read
+ * DESCRIPTION: read routine of the boottime pseudo file:
+ *                  PHASE       CYCLES      US
+ *                  <step>      <n>         <n>
+ *                  ...
+ *                  total       <n>         <n>
+ *              every line is the time from the end of the previous step, "total" is from the
+ *              start of entry() to the last step recorded, the start of the first program
+ * INPUT: offset -- byte offset in the file
+ *        buf -- buffer to be filled in
+ *        nbytes -- number of bytes needed to be copied
+ * OUTPUT: none
+ * RETURN: number of copied bytes
+ * SIDE AFFECTS: timeline buffer changed
+ */
+int32_t boot_read(uint32_t offset, uint8_t* buf, uint32_t nbytes)
+{
+    uint32_t len = 0;   /* length of the timeline   */
+    uint32_t i;         /* loop index for phases    */
+    uint32_t flags;     /* saved eflags             */
+
+    /* the timeline buffer is shared, do not let another reader be scheduled in */
+    cli_and_save(flags);
+
+    len = boot_put_str(len, "PHASE", BOOT_COL_WIDTH);
+    len = boot_put_str(len, "CYCLES", BOOT_COL_WIDTH);
+    len = boot_put_str(len, "US\n", 0);
+    for (i = 1; i < boot_phase_num; i++)
+        len = boot_put_phase(len, boot_phase[i].name, boot_cycles(&boot_phase[i - 1], &boot_phase[i]));
+    if (boot_phase_num > 0)
+        len = boot_put_phase(len, "total", boot_cycles(&boot_phase[0], &boot_phase[boot_phase_num - 1]));
+
+    if (offset >= len)
+        nbytes = 0;
+    else if (nbytes > len - offset)
+        nbytes = len - offset;
+    memcpy(buf, boot_buf + offset, nbytes);
+
+    restore_flags(flags);
+    return nbytes;
+}
@@ -0,0 +1,48 @@
+/*
+    bootlog.h header file
+    boot phase timestamps, kernel command line and the "boottime" pseudo file
+*/
+
+#ifndef _BOOTLOG_H
+#define _BOOTLOG_H
+
+#include "types.h"
+
+#define BOOT_FILE_NAME      "boottime"
+#define BOOT_BUF_SIZE       1024
+#define BOOT_COL_WIDTH      12
+#define BOOT_MAX_PHASE      32
+#define BOOT_CMDLINE_LEN    128
+#define BOOT_CALIB_TICKS    10      /* PIT ticks the TSC is calibrated over after boot */
+
+/* kernel command line option for a quiet boot: no multiboot dump, no messages */
+#define BOOT_OPT_QUIET      "quiet"
+
+/* non zero if the command line asks for a quiet boot */
+extern uint32_t boot_quiet;
+
+/* take the first timestamp and keep a copy of the kernel command line */
+void boot_start(const int8_t* cmdline);
+
+/* value of a "name=value" command line option, "" for a plain "name", NULL if absent */
+const int8_t* boot_param(const int8_t* name);
+
+/* decimal value of a "name=value" command line option, def if absent or not a number */
+uint32_t boot_param_num(const int8_t* name, uint32_t def);
+
+/* record the end of a boot phase */
+void boot_mark(const int8_t* name);
+
+/* record the start of the first program, the end of boot */
+void boot_finish();
+
+/* register the boottime pseudo file */
+void boot_init();
+
+/* calibrate the TSC in the background, called by the PIT handler */
+void boot_tick();
+
+/* generate the boot timeline and read part of it */
+int32_t boot_read(uint32_t offset, uint8_t* buf, uint32_t nbytes);
+
+#endif
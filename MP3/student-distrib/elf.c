@@ -0,0 +1,227 @@
+/*
+    elf
+    ELF32 program loader. The headers of an executable are checked before a process is
+    created for it. Only the pages holding PT_LOAD file data are mapped and copied, read-only
+    unless the segment is writable. The rest of the program page, .bss and the stack, is
+    mapped on the first access and filled with zeros by elf_lazy_fault.
+    elf_page_flags and elf_page_fill describe the pages filled at execute one by one, so
+    that the image cache (imgcache.c) can fill them into its own frames instead.
+*/
+
+#include "elf.h"
+#include "syscall.h"
+#include "filesys.h"
+#include "lib.h"
+
+/*
+ * elf_check
+ * DESCRIPTION: read the file and program headers of an executable and reject anything the loader
+ *              cannot place: not a little endian i386 ELF32 executable, headers or segments
+ *              outside the file, segments out of order, overlapping or outside the user area,
+ *              or an entry point that is not in an executable segment
+ * INPUT: inode_idx -- inode of the file
+ *        file_size -- size of the file
+ *        image -- filled with the loadable segments
+ * OUTPUT: none
+ * RETURN: 0 if the program can be loaded, -1 if not
+ * SIDE AFFECTS: none
+ */
+int32_t elf_check(uint32_t inode_idx, uint32_t file_size, elf_image_t* image)
+{
+    elf_ehdr_t ehdr;        /* file header                          */
+    elf_phdr_t* phdr;       /* current program header               */
+    uint32_t i;             /* loop index for program headers       */
+    uint32_t prev_end;      /* end of the previous loadable segment */
+    uint32_t file_end;      /* end of file data of all segments     */
+    uint32_t entry_ok;      /* whether the entry point was found    */
+
+    if (file_size < sizeof(elf_ehdr_t) ||
+        read_data(inode_idx, 0, (uint8_t*)&ehdr, sizeof(elf_ehdr_t)) != sizeof(elf_ehdr_t))
+        return -1;
+
+    /* the whole identification, not only the magic number */
+    if (*(uint32_t*)ehdr.ident != ELF_MAGIC || ehdr.ident[ELF_IDENT_CLASS] != ELF_CLASS_32 ||
+        ehdr.ident[ELF_IDENT_DATA] != ELF_DATA_LSB || ehdr.ident[ELF_IDENT_VERSION] != ELF_VERSION_CURRENT)
+        return -1;
+    if (ehdr.type != ELF_TYPE_EXEC || ehdr.machine != ELF_MACHINE_386 || ehdr.version != ELF_VERSION_CURRENT)
+        return -1;
+
+    /* program header table inside the file, sizes are small enough not to overflow */
+    if (ehdr.phentsize != sizeof(elf_phdr_t) || ehdr.phnum == 0 || ehdr.phnum > ELF_MAX_PHDR ||
+        ehdr.phoff > file_size || ehdr.phnum * sizeof(elf_phdr_t) > file_size - ehdr.phoff)
+        return -1;
+
+    image->inode_idx = inode_idx;
+    image->entry = ehdr.entry;
+    image->seg_num = 0;
+    prev_end = ELF_USER_START;
+    file_end = ELF_USER_START;
+    entry_ok = 0;
+
+    for (i = 0; i < ehdr.phnum; i++)
+    {
+        phdr = &image->seg[image->seg_num];
+        if (read_data(inode_idx, ehdr.phoff + i * sizeof(elf_phdr_t), (uint8_t*)phdr, sizeof(elf_phdr_t)) != sizeof(elf_phdr_t))
+            return -1;
+        if (phdr->type != ELF_PT_LOAD)
+            continue;
+
+        /* file part inside the file and memory part inside the user area, in address order */
+        if (phdr->filesz > phdr->memsz || phdr->offset > file_size || phdr->filesz > file_size - phdr->offset)
+            return -1;
+        if (phdr->vaddr < prev_end || phdr->vaddr >= ELF_USER_END || phdr->memsz > ELF_USER_END - phdr->vaddr)
+            return -1;
+        /* file data is copied page by page, so it must have the same offset in a page */
+        if ((phdr->offset ^ phdr->vaddr) & (PAGE_4KB_SIZE - 1))
+            return -1;
+
+        if ((phdr->flags & ELF_PF_X) && ehdr.entry >= phdr->vaddr && ehdr.entry < phdr->vaddr + phdr->filesz)
+            entry_ok = 1;
+        prev_end = phdr->vaddr + phdr->memsz;
+        if (phdr->filesz > 0)
+            file_end = phdr->vaddr + phdr->filesz;
+        image->seg_num++;
+    }
+
+    if (image->seg_num == 0 || !entry_ok)
+        return -1;
+
+    /* pages after the last one with file data are zero-filled on demand */
+    image->lazy_start = (file_end + PAGE_4KB_SIZE - 1) & ~(PAGE_4KB_SIZE - 1);
+    /* anything above the segments is free for thread stacks */
+    image->mem_end = (prev_end + PAGE_4KB_SIZE - 1) & ~(PAGE_4KB_SIZE - 1);
+    return 0;
+}
+
+/*
+ * elf_page_flags
+ * DESCRIPTION: tell whether a page of a program is filled at execute: a page below the lazy area
+ *              that holds any part of a loadable segment. It is writable if any segment in it is.
+ * INPUT: image -- program checked by elf_check
+ *        page -- start of the page
+ * OUTPUT: none
+ * RETURN: 0 for a page left to elf_lazy_fault, ELF_PAGE_LOAD otherwise, with ELF_PAGE_WRITE
+ *         for a writable page
+ * SIDE AFFECTS: none
+ */
+uint32_t elf_page_flags(elf_image_t* image, uint32_t page)
+{
+    uint32_t i;             /* loop index for segments  */
+    uint32_t flags = 0;     /* flags of the page        */
+    elf_phdr_t* phdr;       /* current segment          */
+
+    if (page >= image->lazy_start)
+        return 0;
+    for (i = 0; i < image->seg_num; i++)
+    {
+        phdr = &image->seg[i];
+        if (phdr->memsz == 0 || page >= phdr->vaddr + phdr->memsz || page + PAGE_4KB_SIZE <= phdr->vaddr)
+            continue;
+        flags |= ELF_PAGE_LOAD;
+        if (phdr->flags & ELF_PF_W)
+            flags |= ELF_PAGE_WRITE;
+    }
+    return flags;
+}
+
+/*
+ * elf_page_fill
+ * DESCRIPTION: build the content of a program page: the file data of every segment in it, zeros
+ *              everywhere else (.bss, gaps between segments)
+ * INPUT: image -- program checked by elf_check
+ *        page -- start of the page in the program
+ *        dest -- kernel address of a page to fill
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 if the file could not be read
+ * SIDE AFFECTS: none
+ */
+int32_t elf_page_fill(elf_image_t* image, uint32_t page, uint8_t* dest)
+{
+    uint32_t i;             /* loop index for segments              */
+    uint32_t lo, hi;        /* part of the file data in the page    */
+    elf_phdr_t* phdr;       /* current segment                      */
+
+    memset(dest, 0, PAGE_4KB_SIZE);
+    for (i = 0; i < image->seg_num; i++)
+    {
+        phdr = &image->seg[i];
+        lo = (phdr->vaddr > page) ? phdr->vaddr : page;
+        hi = (phdr->vaddr + phdr->filesz < page + PAGE_4KB_SIZE) ? phdr->vaddr + phdr->filesz : page + PAGE_4KB_SIZE;
+        if (lo >= hi)
+            continue;
+        if (read_data(image->inode_idx, phdr->offset + (lo - phdr->vaddr), dest + (lo - page), hi - lo) != hi - lo)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * elf_load
+ * DESCRIPTION: load a program privately, without the image cache: map the pages filled at execute
+ *              (elf_page_flags) in the process' page table and fill them, then take write
+ *              permission away from the read-only ones. The other pages stay unmapped until
+ *              elf_lazy_fault fills them. The process' pages must be the current ones (set_paging).
+ * INPUT: pid -- process
+ *        image -- program checked by elf_check
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 if the file could not be read
+ * SIDE AFFECTS: user page table of the process changed, TLB flushed
+ */
+int32_t elf_load(uint32_t pid, elf_image_t* image)
+{
+    uint32_t page;          /* loop index for pages         */
+    uint32_t start;         /* first page of the program    */
+    uint32_t flags;         /* ELF_PAGE_* of a page         */
+
+    user_page_reset(pid);
+    flush_TLB();
+
+    /* writable while it is filled, CR0.WP applies to the kernel too */
+    start = image->seg[0].vaddr & ~(PAGE_4KB_SIZE - 1);
+    for (page = start; page < image->lazy_start; page += PAGE_4KB_SIZE)
+    {
+        if (elf_page_flags(image, page) == 0)
+            continue;
+        user_page_map(pid, page, 1);
+        if (elf_page_fill(image, page, (uint8_t*)page) == -1)
+            return -1;
+    }
+
+    for (page = start; page < image->lazy_start; page += PAGE_4KB_SIZE)
+    {
+        flags = elf_page_flags(image, page);
+        if ((flags & ELF_PAGE_LOAD) && !(flags & ELF_PAGE_WRITE))
+            user_pte(pid, page)->r_w = 0;
+    }
+    flush_TLB();
+    return 0;
+}
+
+/*
+ * elf_lazy_fault
+ * DESCRIPTION: page fault handler part of the loader. A page of the current process between the
+ *              end of its file data and the top of its program page (.bss, heap, stack) is mapped
+ *              writable and cleared on its first access, from user or kernel mode.
+ * INPUT: addr -- faulting address
+ * OUTPUT: none
+ * RETURN: 0 if the fault was handled, -1 if it is a real fault
+ * SIDE AFFECTS: user page table of the current process changed
+ */
+int32_t elf_lazy_fault(uint32_t addr)
+{
+    pcb_t* pcb;     /* current process */
+
+    if (curr_pid == -1 || addr >= ADDR_132MB)
+        return -1;
+    /* a thread faults in the pages of its program's leader */
+    pcb = get_pcb_ptr(curr_mm);
+    if (addr < pcb->lazy_start)
+        return -1;
+
+    /* a page that is already present faulted for a protection violation */
+    if (user_page_map(pcb->pid, addr, 1) != 1)
+        return -1;
+    /* not present entries are never cached in the TLB, no flush is needed */
+    memset((void*)(addr & ~(PAGE_4KB_SIZE - 1)), 0, PAGE_4KB_SIZE);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+    elf.h header file
+    ELF32 program loader
+*/
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "types.h"
+#include "paging.h"
+
+/* Reference: Tool Interface Standard (TIS) ELF Specification 1.2, Book I */
+#define ELF_MAGIC           0x464C457F  /* "\177ELF" read as a little endian word */
+#define ELF_IDENT_SIZE      16
+#define ELF_IDENT_CLASS     4
+#define ELF_IDENT_DATA      5
+#define ELF_IDENT_VERSION   6
+#define ELF_CLASS_32        1
+#define ELF_DATA_LSB        1
+#define ELF_VERSION_CURRENT 1
+#define ELF_TYPE_EXEC       2
+#define ELF_MACHINE_386     3
+#define ELF_PT_LOAD         1
+#define ELF_PF_X            0x1
+#define ELF_PF_W            0x2
+#define ELF_PF_R            0x4
+
+/* at most this many program headers are looked at */
+#define ELF_MAX_PHDR        16
+/* a program must fit between 128MB and the top of its 4MB page minus the stack */
+#define ELF_USER_START      ADDR_128MB
+#define ELF_STACK_RESERVE   0x10000
+#define ELF_USER_END        (ADDR_132MB - ELF_STACK_RESERVE)
+
+/* elf_page_flags of a page */
+#define ELF_PAGE_LOAD       0x1     /* filled at execute    */
+#define ELF_PAGE_WRITE      0x2     /* writable             */
+
+#ifndef ASM
+
+/* ELF file header */
+typedef struct elf_ehdr_t {
+    uint8_t ident[ELF_IDENT_SIZE];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf_ehdr_t;
+
+/* ELF program header */
+typedef struct elf_phdr_t {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) elf_phdr_t;
+
+/* an executable that passed elf_check, everything elf_load needs */
+typedef struct elf_image_t {
+    uint32_t inode_idx;                 /* file of the program                      */
+    uint32_t entry;                     /* first instruction                        */
+    uint32_t seg_num;                   /* number of loadable segments              */
+    elf_phdr_t seg[ELF_MAX_PHDR];       /* loadable segments in address order       */
+    uint32_t lazy_start;                /* first page without file data, the rest
+                                           up to the stack is zero-filled on demand */
+    uint32_t mem_end;                   /* first page after all segments            */
+} elf_image_t;
+
+/* read and validate the headers of an executable */
+int32_t elf_check(uint32_t inode_idx, uint32_t file_size, elf_image_t* image);
+
+/* whether a page of a program is filled at execute, and writable */
+uint32_t elf_page_flags(elf_image_t* image, uint32_t page);
+
+/* build the content of a program page in a kernel buffer */
+int32_t elf_page_fill(elf_image_t* image, uint32_t page, uint8_t* dest);
+
+/* map and load the segments of a checked executable into a process */
+int32_t elf_load(uint32_t pid, elf_image_t* image);
+
+/* zero-fill a page of the current process on a fault, if it is in its lazy area */
+int32_t elf_lazy_fault(uint32_t addr);
+
+#endif
+#endif
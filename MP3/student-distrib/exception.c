@@ -1,8 +1,14 @@
 #include "lib.h"
 #include "exception.h"
 #include "syscall.h"
+#include "signal.h"
+#include "proc.h"
+#include "serial.h"
+#include "elf.h"
+#include "imgcache.h"
+#include "fpu.h"
 
-void exc_handler(unsigned int vec);
+void exc_handler(hw_context_t* context, uint32_t cr2);
 
 /* string array contains exception message */
 static char* exception_info[EXC_NUM] = {
@@ -30,44 +36,57 @@ static char* exception_info[EXC_NUM] = {
 
 /* 
  * exc_handler
- *   DESCRIPTION: exception handler, print out the exception info
- *   INPUTS: vec -- corresponding exception
+ *   DESCRIPTION: exception handler, called by the exception linkage code.
+ *                An exception in a user program raises DIV_ZERO (divide error) or
+ *                SEGFAULT (any other exception) for it if the program handles that signal,
+ *                otherwise print out the exception info and halt the program.
+ *   INPUTS: context -- hardware context saved by the linkage code
+ *           cr2 -- CR2 read by the linkage code on entry, the faulting address of a page fault
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: none
+ *   SIDE EFFECTS: signal raised or current program halted
  */
-void exc_handler(unsigned int vec){
+void exc_handler(hw_context_t* context, uint32_t cr2){
+    unsigned int vec = context->irq_exc_no;     /* exception vector */
+    uint32_t signum;                            /* signal for this exception */
+    pcb_t* pcb;                                 /* current process' pcb */
+
     if(vec >= EXC_NUM)
         return;
     cli();
+
+    /* the first FPU or SSE instruction since a context switch loads the process' state */
+    if(vec == FPU_EXC_VEC && fpu_trap() == 0)
+        return;
+
+    /* account page faults, a first touch of .bss or stack and a first write to a
+       shared data page of a cached program are handled here */
+    if(vec == 0x0E){
+        proc_page_fault();
+        if(!(context->error_code & EXC_PF_PRESENT) && elf_lazy_fault(cr2) == 0)
+            return;
+        if((context->error_code & EXC_PF_PRESENT) && (context->error_code & EXC_PF_WRITE) &&
+           imgcache_cow_fault(cr2) == 0)
+            return;
+    }
+
+    /* a user program with a handler for the signal deals with the exception itself */
+    if((context->cs & SIGNAL_CPL_MASK) != 0 && curr_pid != -1){
+        signum = (vec == 0x00) ? SIGNAL_DIV_ZERO : SIGNAL_SEGFAULT;
+        pcb = get_pcb_ptr(curr_pid);
+        if(pcb->sig_handler[signum] != NULL && !(pcb->sig_masked & (1 << signum))){
+            signal_send(curr_pid, signum);
+            return;
+        }
+    }
+
     printf("EXCEPTION %d:\n", vec);
     printf("%s\n", exception_info[vec]);
     /* halt the current program if there is */
     if(cur_fd_array != NULL)
         halt(HALT_EXCEPTION);
+    /* nothing runs after this, push the report out to a serial console */
+    serial_flush();
     /* end with infinite loop according to the document */
     while(1);
 }
-
-/* handler for exceptions in Linux */
-/* just print out the exception corresponding to the interrupt vector */
-void exc_divide_error()              {exc_handler(0x00);}
-void exc_single_step()               {exc_handler(0x01);}
-void exc_nmi()                       {exc_handler(0x02);}
-void exc_breakpoint()                {exc_handler(0x03);}
-void exc_overflow()                  {exc_handler(0x04);}
-void exc_bounds()                    {exc_handler(0x05);}
-void exc_invalid_opcode()            {exc_handler(0x06);}
-void exc_coprocessor_not_avaliable() {exc_handler(0x07);}
-void exc_double_fault()              {exc_handler(0x08);}
-void exc_coprocessor_segment_fault() {exc_handler(0x09);}
-void exc_invalid_tss()               {exc_handler(0x0A);}
-void exc_segment_not_present()       {exc_handler(0x0B);}
-void exc_stack_fault()               {exc_handler(0x0C);}
-void exc_general_protection_fault()  {exc_handler(0x0D);}
-void exc_page_fault()                {exc_handler(0x0E);}
-void exc_reserved()                  {exc_handler(0x0F);}
-void exc_math_fault()                {exc_handler(0x10);}
-void exc_alignment_check()           {exc_handler(0x11);}
-void exc_machine_check()             {exc_handler(0x12);}
-void exc_simd_floating_point()       {exc_handler(0x13);}
@@ -3,8 +3,12 @@
 
 /* exception number */
 #define EXC_NUM     20
+/* page fault error code bit, set if the page was present (protection violation) */
+#define EXC_PF_PRESENT  0x1
+/* page fault error code bit, set for a write access */
+#define EXC_PF_WRITE    0x2
 
-/* handler for exceptions in Linux */
+/* exception linkage code, see interrupt_linkage.S */
 extern void exc_divide_error();
 extern void exc_single_step();
 extern void exc_nmi();
@@ -6,7 +6,12 @@ void* filesys_addr;             /* pointer points to the start of file system */
 boot_block_t* boot_block;       /* pointer points to the boot block */
 data_block_t* data_block_arr;   /* pointer points to the data block array */
 inode_t* inode_arr;             /* pointer points to the inode array */
-int cur_dentry_idx;             /* current file dentry index */
+
+static dentry_t pseudo_dentry_arr[MAX_PSEUDO_NUM];      /* dentries of pseudo files, listed after the boot block ones */
+static pseudo_read_t pseudo_read_arr[MAX_PSEUDO_NUM];   /* read routines of pseudo files */
+static pseudo_write_t pseudo_write_arr[MAX_PSEUDO_NUM]; /* write routines of pseudo files, NULL if read only */
+static uint32_t pseudo_num = 0;                         /* number of registered pseudo files */
+static dcache_entry_t dcache[DCACHE_SIZE];              /* dentry cache, direct mapped by (parent, name) */
 
 /*
  * filesys_init
@@ -22,58 +27,184 @@ void filesys_init(void* filesys){
     /* make the inode and datablock as arrays for the convenience of accessing */
     inode_arr = &((inode_t*)filesys)[1];
     data_block_arr = &((data_block_t*)filesys)[1+boot_block->inode_num];
-    /* init some global variables (which will be file descriptor array in the future) */
-    cur_dentry_idx = -1;
+    /* files of an image in an unknown format cannot be read */
+    if(boot_block->version > FS_VERSION_EXTENT)
+        printf("unknown file system version %d\n", boot_block->version);
+}
+
+/*
+ * dcache_hash
+ * DESCRIPTION: hash a (parent directory inode, name) pair into the dentry cache
+ * INPUT: parent -- inode index of the directory
+ *        name -- NUL padded name of MAX_FILE_NAME_LEN bytes
+ * OUTPUT: none
+ * RETURN: dentry cache index
+ * SIDE AFFECTS: none
+ */
+static uint32_t dcache_hash(uint32_t parent, const char* name){
+    int i;                  /* loop index for name characters   */
+    uint32_t hash = parent; /* hash value                       */
+
+    for(i = 0; i < MAX_FILE_NAME_LEN && name[i] != '\0'; i++)
+        hash = hash * DCACHE_HASH_MULT + (uint8_t)name[i];
+    return hash & (DCACHE_SIZE - 1);
+}
+
+/*
+ * dcache_flush
+ * DESCRIPTION: drop every entry of the dentry cache, e.g. when a pseudo file is registered
+ *              and a negative entry for its name may exist
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: dentry cache cleared
+ */
+static void dcache_flush(){
+    memset(dcache, 0, sizeof(dcache));
+}
+
+/*
+ * lookup_dir
+ * DESCRIPTION: Find a name in one directory without the cache. The root directory is the
+ *              boot block followed by the pseudo files, any other directory is an inode
+ *              whose data is an array of dentries.
+ * INPUT: parent -- inode index of the directory, FS_ROOT_INODE for the root
+ *        name -- NUL padded name of MAX_FILE_NAME_LEN bytes
+ *        dentry -- pointer points to a dentry which needs to be filled in
+ * OUTPUT: fields of the corresponding dentry
+ * RETURN: 0 for success, -1 if there is no such name
+ * SIDE AFFECTS: none
+ */
+static int32_t lookup_dir(uint32_t parent, const char* name, dentry_t* dentry){
+    uint32_t i;         /* iterated index for dentries */
+
+    for(i = 0; read_dentry_in_dir(parent, i, dentry) == 0; i++){
+        /* compare the file name */
+        if(!strncmp((int8_t*)name, (int8_t*)(dentry->file_name), MAX_FILE_NAME_LEN)){
+            /* "." of the root refers to the root itself */
+            if(parent == FS_ROOT_INODE && dentry->file_type == DIR_TYPE && !strncmp((int8_t*)name, ".", MAX_FILE_NAME_LEN))
+                dentry->inode_idx = FS_ROOT_INODE;
+            return 0;
+        }
+    }
+    /* file not found, return -1 */
+    return -1;
+}
+
+/*
+ * lookup_dir_cached
+ * DESCRIPTION: Find a name in one directory through the dentry cache. Misses are cached
+ *              as negative entries, so repeated failing lookups do not scan either.
+ * INPUT: parent -- inode index of the directory, FS_ROOT_INODE for the root
+ *        name -- NUL padded name of MAX_FILE_NAME_LEN bytes
+ *        dentry -- pointer points to a dentry which needs to be filled in
+ * OUTPUT: fields of the corresponding dentry
+ * RETURN: 0 for success, -1 if there is no such name
+ * SIDE AFFECTS: dentry cache entry replaced on a miss
+ */
+static int32_t lookup_dir_cached(uint32_t parent, const char* name, dentry_t* dentry){
+    dcache_entry_t* entry = &dcache[dcache_hash(parent, name)];  /* cache slot of the pair */
+
+    /* hit */
+    if(entry->valid && entry->parent == parent && !strncmp((int8_t*)name, (int8_t*)entry->name, MAX_FILE_NAME_LEN)){
+        if(entry->negative)
+            return -1;
+        *dentry = entry->dentry;
+        return 0;
+    }
+
+    /* miss, look it up and replace the slot */
+    entry->valid = 1;
+    entry->parent = parent;
+    memcpy(entry->name, name, MAX_FILE_NAME_LEN);
+    entry->negative = (lookup_dir(parent, name, &entry->dentry) != 0);
+    if(entry->negative)
+        return -1;
+    *dentry = entry->dentry;
+    return 0;
 }
 
 /*
  * read_dentry_by_name
- * DESCRIPTION: Find dentry with the corresponding filename and copy data through input dentry pointer
- *              Assume that only 32 length file name would not have a '\0' at the end 
- * INPUT: fname -- string of the file name
+ * DESCRIPTION: Find dentry with the corresponding path and copy data through input dentry pointer.
+ *              The path is walked from the root one "/" separated component at a time, every
+ *              component but the last must be a directory. Each component is looked up through
+ *              the dentry cache.
+ * INPUT: fname -- path, e.g. "shell", "bin/shell" or "/bin/shell"
  *        dentry -- pointer points to a dentry which needs to be filled in
  * OUTPUT: fields of the corresponding dentry
  * RETURN: 0 for success, -1 for fail
- * SIDE AFFECTS: none
+ * SIDE AFFECTS: dentry cache changed
  */
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry){
-    int i;                                       /* iterated index for dentries in boot block */
-    int fname_len;                               /* length of filename */
-    uint8_t* fname_buf[MAX_FILE_NAME_LEN] = {0}; /* filename buffer for string comparing */
-    dentry_t* cur_dentry;                        /* pointer to current dentry */
-
-    /* get the length of the file name */
-    fname_len = strlen((int8_t*)fname);
+    int len;                                /* length of the current component  */
+    uint32_t parent;                        /* directory being searched         */
+    char name_buf[MAX_FILE_NAME_LEN];       /* NUL padded current component     */
 
     /* sanity check */
-    if(fname == NULL || dentry == NULL || fname_len > MAX_FILE_NAME_LEN)
+    if(fname == NULL || dentry == NULL || *fname == '\0')
         return -1;
 
-    /* deal with very long file name */
-    if(fname_len == MAX_FILE_NAME_LEN)
-        strncpy((int8_t*)fname_buf, (int8_t*)fname, MAX_FILE_NAME_LEN);
-    else
-        strcpy((int8_t*)fname_buf, (int8_t*)fname);
+    /* the root itself, it has no dentry of its own in the boot block but "." */
+    parent = FS_ROOT_INODE;
+    while(*fname == FS_PATH_SEP)
+        fname++;
+    if(*fname == '\0')
+        return lookup_dir_cached(FS_ROOT_INODE, ".", dentry);
 
-    /* traverse all dentry until finding the corresponding dentry */
-    for(i = 0; i < boot_block->dir_num; i++){
-        cur_dentry = &(boot_block->dentry_arr[i]);
-        /* compare the file name */
-        if(!strncmp((int8_t*)fname_buf, (int8_t*)(cur_dentry->file_name), MAX_FILE_NAME_LEN)){
-            /* copy the contents */
-            *dentry = *cur_dentry;
-            /* success, return 0 */
+    while(1){
+        /* split the next component */
+        for(len = 0; fname[len] != '\0' && fname[len] != FS_PATH_SEP; len++);
+        if(len > MAX_FILE_NAME_LEN)
+            return -1;
+        memset(name_buf, 0, MAX_FILE_NAME_LEN);
+        memcpy(name_buf, fname, len);
+        fname += len;
+        while(*fname == FS_PATH_SEP)
+            fname++;
+
+        if(lookup_dir_cached(parent, name_buf, dentry) != 0)
+            return -1;
+        /* last component */
+        if(*fname == '\0')
             return 0;
-        }
+        /* anything in the middle of a path must be a directory */
+        if(dentry->file_type != DIR_TYPE)
+            return -1;
+        parent = dentry->inode_idx;
     }
-    /* file not found, return -1 */
-    return -1;
+}
+
+/*
+ * read_dentry_in_dir
+ * DESCRIPTION: Find dentry with the corresponding index in a directory and copy data through
+ *              input dentry pointer. The root directory is the boot block followed by the pseudo
+ *              files, any other directory is an inode whose data is an array of dentries.
+ * INPUT: parent -- inode index of the directory, FS_ROOT_INODE for the root
+ *        idx -- dentry index in the directory
+ *        dentry -- pointer points to a dentry which needs to be filled in
+ * OUTPUT: fields of the corresponding dentry
+ * RETURN: 0 for success, -1 for fail or the end of the directory
+ * SIDE AFFECTS: none
+ */
+int32_t read_dentry_in_dir(uint32_t parent, uint32_t idx, dentry_t* dentry){
+    /* the root */
+    if(parent == FS_ROOT_INODE)
+        return read_dentry_by_index(idx, dentry);
+
+    /* sanity check */
+    if(parent >= boot_block->inode_num || (idx + 1) * sizeof(dentry_t) > inode_arr[parent].file_size)
+        return -1;
+    if(read_data(parent, idx * sizeof(dentry_t), (uint8_t*)dentry, sizeof(dentry_t)) != sizeof(dentry_t))
+        return -1;
+    return 0;
 }
 
 /*
  * read_dentry_by_index
  * DESCRIPTION: Find dentry with the corresponding index in boot block and 
- *              copy data through input dentry pointer
+ *              copy data through input dentry pointer. Indices past the boot block
+ *              dentries refer to the pseudo files
  * INPUT: idx -- dentry index in boot block
  *        dentry -- pointer points to a dentry which needs to be filled in
  * OUTPUT: fields of the corresponding dentry
@@ -81,9 +212,14 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry){
  * SIDE AFFECTS: none
  */
 int32_t read_dentry_by_index(uint32_t idx, dentry_t* dentry){
-    /* sanity check */
-    if(idx >= boot_block->dir_num)
-        return -1;
+    /* pseudo files are indexed right after the boot block dentries */
+    if(idx >= boot_block->dir_num){
+        /* sanity check */
+        if(idx - boot_block->dir_num >= pseudo_num)
+            return -1;
+        *dentry = pseudo_dentry_arr[idx - boot_block->dir_num];
+        return 0;
+    }
     /* copy the dentry */
     *dentry = boot_block->dentry_arr[idx];
     /* success */
@@ -91,10 +227,9 @@ int32_t read_dentry_by_index(uint32_t idx, dentry_t* dentry){
 }
 
 /*
- * read_data
- * DESCRIPTION: Read the data in the file corresponding the the given inode. Read n bytes start from
- *              offset in this file and copy to the buffer.
- * INPUT: inode_idx -- inode index
+ * read_data_direct
+ * DESCRIPTION: read_data of FS_VERSION_DIRECT images, the inode lists every data block.
+ * INPUT: inode_idx -- inode index, already checked
  *        offset -- byte offset in the file
  *        buf -- buffer needs to be filled in
  *        nbytes -- number of bytes need to be copied
@@ -102,7 +237,7 @@ int32_t read_dentry_by_index(uint32_t idx, dentry_t* dentry){
  * RETURN: number of copied bytes, -1 for fail
  * SIDE AFFECTS: none
  */
-int32_t read_data(uint32_t inode_idx, uint32_t offset, uint8_t* buf, uint32_t nbytes){
+static int32_t read_data_direct(uint32_t inode_idx, uint32_t offset, uint8_t* buf, uint32_t nbytes){
     int read_bytes;             /* already read bytes                       */
     int cur_block_num;          /* number of block that has been read       */
     int cur_block_idx;          /* index of the current read block          */
@@ -110,10 +245,6 @@ int32_t read_data(uint32_t inode_idx, uint32_t offset, uint8_t* buf, uint32_t nb
     data_block_t* cur_block;    /* pointer points to the current read block */
     inode_t* cur_inode = &(inode_arr[inode_idx]);   /* pointer points to the innode with corresponding index */
 
-    /* sanity check */
-    if(buf == NULL || inode_idx >= boot_block->inode_num)
-        return -1;
-
     /* calculate info of current read block */
     cur_block_num = offset/BLOCK_SIZE_BYTE;
     cur_block_idx = cur_inode->data_block_idx[cur_block_num];
@@ -143,6 +274,99 @@ int32_t read_data(uint32_t inode_idx, uint32_t offset, uint8_t* buf, uint32_t nb
     return read_bytes;
 }
 
+/*
+ * read_data_extent
+ * DESCRIPTION: read_data of FS_VERSION_EXTENT images. The extent holding the offset is
+ *              found by binary search, then every extent is copied with a single memcpy
+ *              because its data blocks are contiguous.
+ * INPUT: inode_idx -- inode index, already checked
+ *        offset -- byte offset in the file
+ *        buf -- buffer needs to be filled in
+ *        nbytes -- number of bytes need to be copied
+ * OUTPUT: nbytes file data in buf
+ * RETURN: number of copied bytes, -1 for fail
+ * SIDE AFFECTS: none
+ */
+static int32_t read_data_extent(uint32_t inode_idx, uint32_t offset, uint8_t* buf, uint32_t nbytes){
+    uint32_t read_bytes;        /* already read bytes                           */
+    uint32_t file_block;        /* block of the file the offset is in           */
+    uint32_t extent_offset;     /* byte offset in the current extent            */
+    uint32_t run;               /* bytes copied from the current extent         */
+    uint32_t lo, hi, mid;       /* binary search bounds, lo is the extent found */
+    extent_t* extent;           /* current extent                               */
+    extent_inode_t* cur_inode = (extent_inode_t*)&(inode_arr[inode_idx]);
+
+    /* if at the end of file, stop reading */
+    if(offset >= cur_inode->file_size)
+        return 0;
+    if(nbytes > cur_inode->file_size - offset)
+        nbytes = cur_inode->file_size - offset;
+    /* sanity check */
+    if(cur_inode->extent_num == 0 || cur_inode->extent_num > MAX_INODE_EXTENT_NUM)
+        return -1;
+
+    /* last extent starting at or before the block of offset */
+    file_block = offset/BLOCK_SIZE_BYTE;
+    lo = 0;
+    hi = cur_inode->extent_num;
+    while(hi - lo > 1){
+        mid = (lo + hi)/2;
+        if(cur_inode->extent[mid].file_block <= file_block)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    /* stream the extents */
+    for(read_bytes = 0; read_bytes < nbytes; lo++){
+        extent = &(cur_inode->extent[lo]);
+        file_block = offset/BLOCK_SIZE_BYTE;
+        /* sanity check, holes and bad block ranges */
+        if(lo >= cur_inode->extent_num || file_block < extent->file_block || file_block - extent->file_block >= extent->len)
+            return -1;
+        if(extent->start >= boot_block->data_block_num || extent->len > boot_block->data_block_num - extent->start)
+            return -1;
+
+        extent_offset = offset - extent->file_block*BLOCK_SIZE_BYTE;
+        run = extent->len*BLOCK_SIZE_BYTE - extent_offset;
+        if(run > nbytes - read_bytes)
+            run = nbytes - read_bytes;
+        memcpy(buf + read_bytes, data_block_arr[extent->start].data + extent_offset, run);
+        read_bytes += run;
+        offset += run;
+    }
+    /* return the number of bytes read */
+    return read_bytes;
+}
+
+/*
+ * read_data
+ * DESCRIPTION: Read the data in the file corresponding the the given inode. Read n bytes start from
+ *              offset in this file and copy to the buffer. The inode format depends on the image version.
+ * INPUT: inode_idx -- inode index
+ *        offset -- byte offset in the file
+ *        buf -- buffer needs to be filled in
+ *        nbytes -- number of bytes need to be copied
+ * OUTPUT: nbytes file data in buf
+ * RETURN: number of copied bytes, -1 for fail
+ * SIDE AFFECTS: none
+ */
+int32_t read_data(uint32_t inode_idx, uint32_t offset, uint8_t* buf, uint32_t nbytes){
+    /* sanity check */
+    if(buf == NULL || inode_idx >= boot_block->inode_num)
+        return -1;
+
+    switch(boot_block->version){
+        case FS_VERSION_DIRECT:
+            return read_data_direct(inode_idx, offset, buf, nbytes);
+        case FS_VERSION_EXTENT:
+            return read_data_extent(inode_idx, offset, buf, nbytes);
+        default:
+            /* unknown format */
+            return -1;
+    }
+}
+
 /*
  * file_open
  * DESCRIPTION: Open a file with the given filename.
@@ -216,14 +440,14 @@ int32_t file_write(int32_t fd, void* buf, int32_t nbytes){
 
 /*
  * dir_open
- * DESCRIPTION: Open a directory. Initialize the global index of dentry.
+ * DESCRIPTION: Open a directory. The directory is the inode index of the descriptor and
+ *              the position in it is the file offset, which open sets to 0.
  * INPUT: filename -- not used
  * OUTPUT: none
  * RETURN: 0
- * SIDE AFFECTS: global index of dentry is initialized
+ * SIDE AFFECTS: none
  */
 int32_t dir_open(const char* filename){
-    cur_dentry_idx = 0;
     return 0;
 }
 
@@ -241,31 +465,33 @@ int32_t dir_close(int32_t fd){
 
 /*
  * dir_read
- * DESCRIPTION: Read filename from dentry. Read nbytes of one name for one call and fill the given buffer.
- * INPUT: fd -- file descriptor. Not used.
+ * DESCRIPTION: Read filename of the next dentry. Read nbytes of one name for one call and fill the given buffer.
+ * INPUT: fd -- file descriptor, its file offset is the index of the next dentry
  *        buf -- buffer to be filled
  *        nbytes -- number of bytes need to be read from current file name
  * OUTPUT: none
  * RETURN: length of read
- * SIDE AFFECTS: none
+ * SIDE AFFECTS: file offset changed
  */
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes){
     int read_len;       /* length of read file name */
     char* filename;     /* file name string */
     char strbuf[MAX_FILE_NAME_LEN]; 
     int i;              /* loop index in string copying */
+    dentry_t dentry;    /* current dentry, either in boot block or a pseudo file */
 
     /* sanity check */
-    if(buf == NULL || cur_dentry_idx == -1)
+    if(buf == NULL)
         return -1;
 
     /* if at the end of dentry array, return 0 */
-    if(cur_dentry_idx >= boot_block->dir_num)
+    if(read_dentry_in_dir(cur_fd_array[fd].inode_idx, cur_fd_array[fd].file_offset, &dentry) != 0)
         return 0;
+    cur_fd_array[fd].file_offset++;
 
     /* if the file name is bigger than 32, just copy 32 char */
     read_len = MAX_FILE_NAME_LEN<nbytes?MAX_FILE_NAME_LEN:nbytes;
-    filename = boot_block->dentry_arr[cur_dentry_idx++].file_name;
+    filename = dentry.file_name;
 
     /* copy the filename to the buffer*/
     for(i = 0; i < read_len; i++)
@@ -276,6 +502,50 @@ int32_t dir_read(int32_t fd, void* buf, int32_t nbytes){
     return read_len;
 }
 
+/*
+ * dir_getdents
+ * DESCRIPTION: Fill the buffer with as many packed directory entries (see dirent_t) as fit,
+ *              starting from the dentry at the file offset of the descriptor.
+ * INPUT: fd -- file descriptor of an opened directory
+ *        buf -- buffer to be filled
+ *        nbytes -- size of the buffer
+ * OUTPUT: none
+ * RETURN: number of bytes filled, 0 at the end of the directory,
+ *         -1 if not even the next entry fits
+ * SIDE AFFECTS: file offset advanced past the returned entries
+ */
+int32_t dir_getdents(int32_t fd, void* buf, int32_t nbytes){
+    uint32_t filled;    /* bytes filled so far          */
+    uint32_t name_len;  /* length of the current name   */
+    dirent_t* dirent;   /* entry being filled           */
+    dentry_t dentry;    /* current dentry               */
+
+    filled = 0;
+    while(read_dentry_in_dir(cur_fd_array[fd].inode_idx, cur_fd_array[fd].file_offset, &dentry) == 0){
+        /* names of 32 chars have no terminating NUL */
+        for(name_len = 0; name_len < MAX_FILE_NAME_LEN && dentry.file_name[name_len] != '\0'; name_len++);
+
+        if(filled + sizeof(dirent_t) + name_len > (uint32_t)nbytes){
+            /* buffer too small for a single entry */
+            if(filled == 0)
+                return -1;
+            break;
+        }
+
+        dirent = (dirent_t*)((uint8_t*)buf + filled);
+        dirent->inode_idx = dentry.inode_idx;
+        dirent->file_size = get_file_size(&dentry);
+        dirent->file_type = dentry.file_type;
+        dirent->name_len = name_len;
+        memcpy(dirent->name, dentry.file_name, name_len);
+
+        filled += sizeof(dirent_t) + name_len;
+        cur_fd_array[fd].file_offset++;
+    }
+
+    return filled;
+}
+
 /*
  * dir_write
  * DESCRIPTION: Not used.
@@ -306,3 +576,115 @@ uint32_t get_file_size(dentry_t* dentry){
         /* RTC or dir */
         return 0;
 }
+
+/*
+ * pseudo_register
+ * DESCRIPTION: Register a pseudo file. It is listed in the directory after the files in
+ *              the boot block and its content is generated by the read routine when read.
+ * INPUT: filename -- name of the pseudo file
+ *        read -- read routine, reads nbytes at offset of the content into buf
+ *        write -- write routine, NULL for a read only file
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 for fail
+ * SIDE AFFECTS: pseudo file table changed
+ */
+int32_t pseudo_register(const char* filename, pseudo_read_t read, pseudo_write_t write){
+    dentry_t* dentry;   /* new pseudo dentry */
+
+    /* sanity check */
+    if(filename == NULL || read == NULL || pseudo_num >= MAX_PSEUDO_NUM || strlen((int8_t*)filename) > MAX_FILE_NAME_LEN)
+        return -1;
+
+    dentry = &(pseudo_dentry_arr[pseudo_num]);
+    strncpy((int8_t*)dentry->file_name, (int8_t*)filename, MAX_FILE_NAME_LEN);
+    dentry->file_type = PSEUDO_TYPE;
+    /* the inode index of a pseudo file is its index in the pseudo file table */
+    dentry->inode_idx = pseudo_num;
+    pseudo_write_arr[pseudo_num] = write;
+    pseudo_read_arr[pseudo_num++] = read;
+
+    /* the name may be cached as missing */
+    dcache_flush();
+
+    /* success, return 0 */
+    return 0;
+}
+
+/*
+ * pseudo_open
+ * DESCRIPTION: Open a pseudo file.
+ * INPUT: filename -- name of the pseudo file
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 for fail
+ * SIDE AFFECTS: none
+ */
+int32_t pseudo_open(const char* filename){
+    dentry_t dentry;    /* temp dentry variable */
+
+    /* read dentry by filename & sanity check */
+    if(read_dentry_by_name((uint8_t*)filename, &dentry) != 0 || dentry.file_type != PSEUDO_TYPE)
+        return -1;
+
+    /* success, return 0 */
+    return 0;
+}
+
+/*
+ * pseudo_close
+ * DESCRIPTION: Close a pseudo file.
+ * INPUT: fd -- file descriptor. Not used.
+ * OUTPUT: none
+ * RETURN: 0
+ * SIDE AFFECTS: none
+ */
+int32_t pseudo_close(int32_t fd){
+    return 0;
+}
+
+/*
+ * pseudo_read
+ * DESCRIPTION: Read the kernel generated content of a pseudo file from the file offset.
+ * INPUT: fd -- file descriptor
+ *        buf -- buffer to be filled in
+ *        nbytes -- number of bytes needed to be copied
+ * OUTPUT: none
+ * RETURN: number of read bytes, 0 at the end of the content, -1 for fail
+ * SIDE AFFECTS: file offset changed
+ */
+int32_t pseudo_read(int32_t fd, void* buf, int32_t nbytes){
+    int32_t read_bytes;     /* number of read bytes */
+    uint32_t idx;           /* pseudo file index    */
+
+    /* sanity check */
+    idx = cur_fd_array[fd].inode_idx;
+    if(idx >= pseudo_num || nbytes < 0)
+        return -1;
+
+    /* read the generated content */
+    if((read_bytes = pseudo_read_arr[idx](cur_fd_array[fd].file_offset, buf, nbytes)) == -1)
+        return -1;
+    /* update offset if success */
+    cur_fd_array[fd].file_offset += read_bytes;
+    return read_bytes;
+}
+
+/*
+ * pseudo_write
+ * DESCRIPTION: Pass written bytes to the write routine of a pseudo file.
+ * INPUT: fd -- file descriptor
+ *        buf -- bytes to write
+ *        nbytes -- number of bytes to write
+ * OUTPUT: none
+ * RETURN: return value of the write routine, -1 for fail or a read only file
+ * SIDE AFFECTS: depends on the pseudo file
+ */
+int32_t pseudo_write(int32_t fd, void* buf, int32_t nbytes){
+    uint32_t idx;           /* pseudo file index    */
+
+    /* sanity check */
+    idx = cur_fd_array[fd].inode_idx;
+    if(idx >= pseudo_num || buf == NULL || nbytes < 0 || pseudo_write_arr[idx] == NULL)
+        return -1;
+
+    return pseudo_write_arr[idx](buf, nbytes);
+}
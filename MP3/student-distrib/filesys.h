@@ -6,15 +6,28 @@
 #define BLOCK_SIZE_BYTE             4096
 #define MAX_FILE_NAME_LEN           32
 #define DENTRY_RESERVED_BYTE        24
-#define BOOT_BLOCK_RESERVED_BYTE    52
+#define BOOT_BLOCK_RESERVED_BYTE    48
 #define MAX_DENTRY_NUM              (BLOCK_SIZE_BYTE-64)/64
 #define MAX_INODE_DATA_BLOCK_NUM    (BLOCK_SIZE_BYTE-4)/4
+#define MAX_INODE_EXTENT_NUM        (BLOCK_SIZE_BYTE-8)/12
 
-#define FILE_TYPE_NUM   4
+/* image formats, in boot_block_t::version which is reserved (0) in old images */
+#define FS_VERSION_DIRECT   0   /* inode_t, one index per data block, at most 4MB per file */
+#define FS_VERSION_EXTENT   1   /* extent_inode_t, (start, length) runs of data blocks     */
+
+#define FILE_TYPE_NUM   5
 #define RTC_TYPE        0
 #define DIR_TYPE        1
 #define FILE_TYPE       2
 #define STD_TYPE        3
+#define PSEUDO_TYPE     4
+
+#define MAX_PSEUDO_NUM  8
+
+#define FS_ROOT_INODE       0xFFFFFFFF  /* stands for the root directory, which lives in the boot block */
+#define FS_PATH_SEP         '/'
+#define DCACHE_SIZE         64          /* entries of the dentry cache, must be a power of 2 */
+#define DCACHE_HASH_MULT    31
 
 typedef struct dentry_t{
     char        file_name[MAX_FILE_NAME_LEN];
@@ -27,6 +40,7 @@ typedef struct boot_block_t{
     uint32_t    dir_num;
     uint32_t    inode_num;
     uint32_t    data_block_num;
+    uint32_t    version;    // image format, FS_VERSION_*
     uint8_t     reserved[BOOT_BLOCK_RESERVED_BYTE];
     dentry_t    dentry_arr[MAX_DENTRY_NUM];
 } boot_block_t;
@@ -36,16 +50,58 @@ typedef struct inode_t{
     uint32_t    data_block_idx[MAX_INODE_DATA_BLOCK_NUM];
 } inode_t;
 
+/* run of contiguous data blocks of a file */
+typedef struct extent_t{
+    uint32_t    file_block; // index of the first block in the file
+    uint32_t    start;      // index of the first data block
+    uint32_t    len;        // number of data blocks
+} extent_t;
+
+/* inode of FS_VERSION_EXTENT images, extents are sorted by file_block and do not overlap */
+typedef struct extent_inode_t{
+    uint32_t    file_size;  // file length in Byte, same place as in inode_t
+    uint32_t    extent_num;
+    extent_t    extent[MAX_INODE_EXTENT_NUM];
+} extent_inode_t;
+
 typedef struct data_block_t{
     uint8_t     data[BLOCK_SIZE_BYTE];
 } data_block_t;
 
+/* dentry cache entry, a negative entry records that the name does not exist */
+typedef struct dcache_entry_t{
+    uint32_t    valid;
+    uint32_t    negative;
+    uint32_t    parent;                     /* inode index of the directory */
+    char        name[MAX_FILE_NAME_LEN];    /* NUL padded name              */
+    dentry_t    dentry;
+} dcache_entry_t;
+
+/*
+ * directory entry returned by getdents, entries are packed one after another and
+ * each is followed by name_len bytes of file name without a terminating NUL
+ */
+typedef struct dirent_t{
+    uint32_t    inode_idx;
+    uint32_t    file_size;
+    uint8_t     file_type;
+    uint8_t     name_len;
+    char        name[0];
+} __attribute__((packed)) dirent_t;
+
+/* read routine of a pseudo file, content is generated by the kernel on demand */
+typedef int32_t (*pseudo_read_t)(uint32_t offset, uint8_t* buf, uint32_t nbytes);
+/* write routine of a pseudo file, used to control the kernel */
+typedef int32_t (*pseudo_write_t)(const uint8_t* buf, uint32_t nbytes);
+
 /* initialize the file system */
 extern void filesys_init(void* filesys);
-/* read dentry with the corresponding filename */
+/* read dentry with the corresponding path */
 extern int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
 /* read entry with the corresponding index in boot block */
 extern int32_t read_dentry_by_index(uint32_t idx, dentry_t* dentry);
+/* read entry with the corresponding index in a directory */
+extern int32_t read_dentry_in_dir(uint32_t parent, uint32_t idx, dentry_t* dentry);
 /* Read the data in the file corresponding the the given inode. */
 extern int32_t read_data(uint32_t inode_idx, uint32_t offset, uint8_t* buf, uint32_t nbytes);
 
@@ -58,16 +114,29 @@ extern int32_t file_read(int32_t fd, void* buf, int32_t nbytes);
 /* Write bytes into the current opened file. Not used. */
 extern int32_t file_write(int32_t fd, void* buf, int32_t nbytes);
 
-/* Open a directory. Initialize the global index of dentry. */
+/* Open a directory. */
 extern int32_t dir_open(const char* filename);
 /* Close a directory. Not used. */
 extern int32_t dir_close(int32_t fd);
-/* Read filename from dentry. Read nbytes of one name for one call and fill the given buffer. */
+/* Read filename of the next dentry. Read nbytes of one name for one call and fill the given buffer. */
 extern int32_t dir_read(int32_t fd, void* buf, int32_t nbytes);
+/* Fill the buffer with as many packed directory entries as fit. */
+extern int32_t dir_getdents(int32_t fd, void* buf, int32_t nbytes);
 /* Not used. */
 extern int32_t dir_write(int32_t fd, void* buf, int32_t nbytes);
 
 /* Get the file size in byte of the given dentry. */
 extern uint32_t get_file_size(dentry_t* dentry);
 
+/* Register a pseudo file which is listed in the directory and read/written through the given routines. */
+extern int32_t pseudo_register(const char* filename, pseudo_read_t read, pseudo_write_t write);
+/* Open a pseudo file. */
+extern int32_t pseudo_open(const char* filename);
+/* Close a pseudo file. */
+extern int32_t pseudo_close(int32_t fd);
+/* Read the kernel generated content of a pseudo file. */
+extern int32_t pseudo_read(int32_t fd, void* buf, int32_t nbytes);
+/* Pass written bytes to the write routine of a pseudo file. */
+extern int32_t pseudo_write(int32_t fd, void* buf, int32_t nbytes);
+
 #endif
@@ -0,0 +1,138 @@
+/*
+    fpu
+    lazy switching of the x87, MMX and SSE registers of user programs. A processor sets
+    CR0.TS whenever it stops running a process, so the first FPU or SSE instruction of the
+    next one traps with #NM and only then is its state loaded. A process that never uses
+    them costs nothing more than the TS check per switch. The state of a process that
+    used them during its time slice is saved into its pcb when it is switched out, so the
+    pcb is always current while the process is not running and any processor may run it
+    next. The registers are not cleared by FXSAVE: a process coming back to the processor
+    it last used, with nobody else loaded in between, only has TS cleared on its trap.
+*/
+
+#include "fpu.h"
+#include "syscall.h"
+#include "lib.h"
+
+/* state of a new process, as after FNINIT with SSE exceptions masked and zero registers */
+static fpu_state_t fpu_init_state;
+/* set by fpu_init if the processor has FXSAVE and SSE2, otherwise nothing is switched */
+static uint32_t fpu_on = 0;
+
+/*
+ * fpu_init
+ * DESCRIPTION: build the initial FPU state of new processes and let the bootstrap processor
+ *              switch lazily. Called after lib_init, which enabled SSE.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: CR0.TS set
+ */
+void fpu_init()
+{
+    if ((cpu_features & (CPUID_EDX_FXSR | CPUID_EDX_SSE2)) != (CPUID_EDX_FXSR | CPUID_EDX_SSE2))
+        return;
+    memset(&fpu_init_state, 0, sizeof(fpu_init_state));
+    *(uint16_t*)&fpu_init_state.image[FPU_FCW_OFFSET] = FPU_FCW_DEFAULT;
+    *(uint32_t*)&fpu_init_state.image[FPU_MXCSR_OFFSET] = FPU_MXCSR_DEFAULT;
+    fpu_on = 1;
+    fpu_cpu_init(this_cpu());
+}
+
+/*
+ * fpu_cpu_init
+ * DESCRIPTION: the calling processor holds nobody's state yet, the first process to use the
+ *              FPU traps. Called by fpu_init and by every application processor.
+ * INPUT: cpu -- this processor
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: CR0.TS set
+ */
+void fpu_cpu_init(cpu_t* cpu)
+{
+    cpu->fpu_owner = -1;
+    if (!fpu_on)
+        return;
+    stts();
+}
+
+/*
+ * fpu_init_pcb
+ * DESCRIPTION: give a new process the initial state, it is loaded on its first use
+ * INPUT: pcb -- pcb of the new process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void fpu_init_pcb(pcb_t* pcb)
+{
+    pcb->fpu_used = 0;
+    pcb->fpu_cpu = -1;
+}
+
+/*
+ * fpu_switch
+ * DESCRIPTION: called whenever a processor stops running a process: by the scheduler, by
+ *              execute for the parent and by halt. If TS is clear the process used the FPU
+ *              since it was switched in and its state is saved. TS is set for whatever runs next.
+ *              Called with interrupts disabled.
+ * INPUT: cpu -- this processor
+ *        prev -- process switched out, NULL for the idle loop or a halted process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: CR0.TS set, prev's FPU state saved
+ */
+void fpu_switch(cpu_t* cpu, pcb_t* prev)
+{
+    uint32_t cr0;       /* control register 0 */
+
+    if (!fpu_on)
+        return;
+    get_cr0(cr0);
+    if (cr0 & CR0_TS)
+        return;
+    if (prev != NULL && cpu->fpu_owner == prev->pid)
+    {
+        asm volatile ("fxsave %0" : "=m"(prev->fpu));
+        prev->acct.fpu_saves++;
+    }
+    stts();
+}
+
+/*
+ * fpu_trap
+ * DESCRIPTION: #NM handler. The current process used the FPU for the first time since it was
+ *              switched in: load its state, unless the registers still hold it.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: 0 if the FPU is the current process' now, -1 if the trap is not a lazy switch
+ * SIDE AFFECTS: CR0.TS cleared, FPU registers changed
+ */
+int32_t fpu_trap()
+{
+    cpu_t* cpu = this_cpu();    /* this processor           */
+    pcb_t* pcb;                 /* current process' pcb     */
+
+    if (!fpu_on || curr_pid == -1)
+        return -1;
+    pcb = get_pcb_ptr(curr_pid);
+    clts();
+
+    /* nobody else used the registers since it was last here */
+    if (cpu->fpu_owner == curr_pid && pcb->fpu_cpu == cpu->id)
+        return 0;
+
+    if (pcb->fpu_used)
+    {
+        asm volatile ("fxrstor %0" : : "m"(pcb->fpu));
+    }
+    else
+    {
+        asm volatile ("fxrstor %0" : : "m"(fpu_init_state));
+        pcb->fpu_used = 1;
+    }
+    pcb->acct.fpu_loads++;
+    pcb->fpu_cpu = cpu->id;
+    cpu->fpu_owner = curr_pid;
+    return 0;
+}
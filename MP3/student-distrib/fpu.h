@@ -0,0 +1,73 @@
+/*
+    fpu.h header file
+    lazy switching of the x87/SSE state of user programs
+*/
+
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+#include "smp.h"
+
+#define FPU_STATE_SIZE      512         /* FXSAVE image                         */
+#define FPU_STATE_ALIGN     16          /* FXSAVE/FXRSTOR need 16-byte alignment */
+#define FPU_FCW_OFFSET      0           /* x87 control word in the image        */
+#define FPU_MXCSR_OFFSET    24          /* MXCSR in the image                   */
+#define FPU_FCW_DEFAULT     0x037F      /* FNINIT: all x87 exceptions masked    */
+#define FPU_MXCSR_DEFAULT   0x1F80      /* reset: all SSE exceptions masked     */
+#define FPU_EXC_VEC         0x07        /* #NM, device not available            */
+
+#ifndef ASM
+
+/* x87, MMX and SSE registers of a process as stored by FXSAVE */
+typedef struct fpu_state_t {
+    uint8_t image[FPU_STATE_SIZE];
+} __attribute__((aligned(FPU_STATE_ALIGN))) fpu_state_t;
+
+struct pcb_t;
+
+/* read CR0 */
+#define get_cr0(cr0)                            \
+do {                                            \
+    asm volatile ("movl %%cr0, %0"              \
+            : "=r"(cr0)                         \
+    );                                          \
+} while (0)
+
+/* clear CR0.TS, FPU and SSE instructions run without #NM */
+#define clts()                                  \
+do {                                            \
+    asm volatile ("clts" : : : "memory");       \
+} while (0)
+
+/* set CR0.TS, the next FPU or SSE instruction raises #NM */
+#define stts()                                  \
+do {                                            \
+    asm volatile ("                             \n\
+            movl    %%cr0, %%eax                \n\
+            orl     %0, %%eax                   \n\
+            movl    %%eax, %%cr0                \n\
+            "                                   \
+            :                                   \
+            : "i"(CR0_TS)                       \
+            : "eax", "memory", "cc"             \
+    );                                          \
+} while (0)
+
+/* set up the initial state of new processes and this processor, after lib_init */
+void fpu_init();
+
+/* let the calling processor switch lazily, called by every processor */
+void fpu_cpu_init(cpu_t* cpu);
+
+/* a new process starts with the initial state on first use */
+void fpu_init_pcb(struct pcb_t* pcb);
+
+/* the processor stops running prev, save its state if it touched it */
+void fpu_switch(cpu_t* cpu, struct pcb_t* prev);
+
+/* #NM handler, give the FPU to the current process */
+int32_t fpu_trap();
+
+#endif
+#endif
@@ -3,6 +3,7 @@
  */
 
 #include "i8259.h"
+#include "apic.h"
 #include "lib.h"
 
 /* Reference: https://wiki.osdev.org/PIC & Lectures*/
@@ -59,6 +60,12 @@ void enable_irq(uint32_t irq_num) {
     /* range judge. If it is out of range, immediately return*/
     if (irq_num > MAX_IRQ_NUM || irq_num <0)
         return;
+    /* the 8259 is masked once the I/O APIC delivers interrupts, see apic.c */
+    if (apic_enabled)
+    {
+        ioapic_set_irq(irq_num, 1);
+        return;
+    }
     /* check whether it is master IRQ_num, i.e. 0-7*/
     if (irq_num < MAX_MASTER_IRQ_NUM)
     {
@@ -87,6 +94,11 @@ void disable_irq(uint32_t irq_num) {
     /* range judge. If it is out of range, immediately return*/
     if (irq_num > MAX_IRQ_NUM || irq_num < 0)
         return;
+    if (apic_enabled)
+    {
+        ioapic_set_irq(irq_num, 0);
+        return;
+    }
     /* check whether it is master IRQ_num, i.e. 0-7*/
     if (irq_num < MAX_MASTER_IRQ_NUM)
     {
@@ -115,6 +127,12 @@ void send_eoi(uint32_t irq_num) {
     /* range judge. If it is out of range, immediately return*/
     if (irq_num > MAX_IRQ_NUM || irq_num < 0)
         return;
+    /* the local APIC takes the EOI for every I/O APIC interrupt */
+    if (apic_enabled)
+    {
+        lapic_eoi();
+        return;
+    }
     /* check whether it is master IRQ_num, i.e. 0-7*/
     if (irq_num < MAX_MASTER_IRQ_NUM)
     {
@@ -44,7 +44,10 @@ void idt_init(){
     // Interrupt
     set_intr_gate(0x20, int_pit);
     set_intr_gate(0x21, int_keyboard);
+    set_intr_gate(0x24, int_serial);
     set_intr_gate(0x28, int_rtc);
+    set_intr_gate(0x30, int_lapic_timer);
+    set_intr_gate(0xFF, int_spurious);
     // System Call
     set_trap_gate(0x80, system_call);
     return;
@@ -53,7 +56,8 @@ void idt_init(){
 /* 
  * set_intr_gate
  *   DESCRIPTION: Set interrupt gate in IDT (interrupt descripter table) of one interrupt
- *                using the address of the interrupt handler
+ *                using the address of the interrupt handler. Interrupts are disabled on
+ *                entry, so e.g. CR2 cannot be changed by a preemption before it is read
  *                see x86_desc.h for formats
  *   INPUTS: vec -- corresponding interrupt vector
  *           addr -- address of interrupt handler
@@ -67,7 +71,7 @@ void set_intr_gate(unsigned int vec, void *addr){
     SET_IDT_ENTRY(idt[vec], addr);
     idt[vec].seg_selector = KERNEL_CS;      // kernel segment code
     idt[vec].reserved4 = 0;                 // interrupt specified
-    idt[vec].reserved3 = 1;                 // interrupt specified
+    idt[vec].reserved3 = 0;                 // interrupt gate, IF is cleared on entry
     idt[vec].reserved2 = 1;                 // interrupt specified
     idt[vec].reserved1 = 1;                 // interrupt specified
     idt[vec].size = 1;                      // indicate 32 bit interrupt gate
@@ -0,0 +1,271 @@
+/*
+    imgcache
+    Cache of loaded executable images, keyed by the inode of the program file. The pages
+    elf_load would fill at execute are filled once into frames of a 4MB area of physical
+    memory reserved for the cache, and every process running the program maps them
+    instead of reading the file again. Text pages stay read-only and shared, data pages
+    are mapped read-only with PTE_AVAIL_COW and the writer gets its own copy in its
+    program page on the first write (imgcache_cow_fault). CR0.WP makes kernel writes
+    fault as well, so a read() into a data buffer is copied the same way.
+    The file system is read-only, a cached image never goes stale. Entries nobody runs
+    stay cached and are dropped least recently used first when room is needed.
+*/
+
+#include "imgcache.h"
+#include "syscall.h"
+#include "paging.h"
+#include "lib.h"
+
+/* physical and kernel virtual address of a cache frame */
+#define IMGCACHE_FRAME_ADDR(f)  (IMGCACHE_ADDR + (f) * PAGE_4KB_SIZE)
+
+imgcache_stat_t imgcache_stat;
+
+static imgcache_entry_t imgcache[IMGCACHE_ENTRY_NUM];
+/* stack of free frame indexes */
+static uint16_t free_frame[IMGCACHE_FRAME_NUM];
+static uint32_t free_frame_num;
+/* bumped on every execute of a cached program */
+static uint32_t use_stamp;
+/* the cache memory could be mapped */
+static uint32_t imgcache_on;
+
+/*
+ * imgcache_init
+ * DESCRIPTION: map the cache memory for the kernel and put all its frames on the free stack.
+ *              Must run before the application processors copy the page directory.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: page directory changed, cache emptied
+ */
+void imgcache_init()
+{
+    uint32_t i;     /* loop index */
+
+    if (paging_map_kernel(IMGCACHE_ADDR) == -1)
+        return;
+
+    for (i = 0; i < IMGCACHE_FRAME_NUM; i++)
+        free_frame[i] = IMGCACHE_FRAME_NUM - 1 - i;
+    free_frame_num = IMGCACHE_FRAME_NUM;
+    imgcache_on = 1;
+}
+
+/*
+ * imgcache_release
+ * DESCRIPTION: give the frames of an entry back and mark it unused
+ * INPUT: entry -- entry to drop
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: free frame stack changed
+ */
+static void imgcache_release(imgcache_entry_t* entry)
+{
+    uint32_t i;     /* loop index for pages */
+
+    for (i = 0; i < entry->page_num; i++)
+        free_frame[free_frame_num++] = entry->frame[i];
+    imgcache_stat.frames_used -= entry->page_num;
+    entry->page_num = 0;
+    entry->used = 0;
+}
+
+/*
+ * imgcache_reserve
+ * DESCRIPTION: find an unused entry with enough free frames for a program, evicting the least
+ *              recently used entries that no process runs until there is room
+ * INPUT: page_num -- frames needed
+ * OUTPUT: none
+ * RETURN: index of the unused entry, -1 if everything left is in use
+ * SIDE AFFECTS: entries may be evicted
+ */
+static int32_t imgcache_reserve(uint32_t page_num)
+{
+    int32_t i;          /* loop index for entries       */
+    int32_t free_idx;   /* an unused entry              */
+    int32_t lru;        /* oldest entry nobody runs     */
+
+    while (1)
+    {
+        free_idx = -1;
+        lru = -1;
+        for (i = 0; i < IMGCACHE_ENTRY_NUM; i++)
+        {
+            if (!imgcache[i].used)
+                free_idx = i;
+            else if (imgcache[i].refcnt == 0 && (lru == -1 || imgcache[i].last_use < imgcache[lru].last_use))
+                lru = i;
+        }
+        if (free_idx != -1 && free_frame_num >= page_num)
+            return free_idx;
+        if (lru == -1)
+            return -1;
+        imgcache_release(&imgcache[lru]);
+        imgcache_stat.evictions++;
+    }
+}
+
+/*
+ * imgcache_get
+ * DESCRIPTION: look a program up by its file. On a hit the checked headers are copied out and a
+ *              reference is taken, the caller skips elf_check.
+ * INPUT: inode_idx -- inode of the program file
+ *        image -- filled with the cached headers on a hit
+ * OUTPUT: none
+ * RETURN: index of the entry, -1 if the program is not cached
+ * SIDE AFFECTS: reference count of the entry increased
+ */
+int32_t imgcache_get(uint32_t inode_idx, elf_image_t* image)
+{
+    int32_t i;      /* loop index for entries */
+
+    for (i = 0; i < IMGCACHE_ENTRY_NUM; i++)
+    {
+        if (!imgcache[i].used || imgcache[i].image.inode_idx != inode_idx)
+            continue;
+        imgcache[i].refcnt++;
+        imgcache[i].last_use = ++use_stamp;
+        memcpy(image, &imgcache[i].image, sizeof(elf_image_t));
+        imgcache_stat.hits++;
+        return i;
+    }
+    return -1;
+}
+
+/*
+ * imgcache_add
+ * DESCRIPTION: fill the pages elf_load would fill for a program into cache frames and take a
+ *              reference. A program with more than IMGCACHE_MAX_PAGES such pages, or one that
+ *              does not fit next to the programs being run, is not cached.
+ * INPUT: image -- program checked by elf_check
+ * OUTPUT: none
+ * RETURN: index of the entry, -1 if the program is not cached
+ * SIDE AFFECTS: entries may be evicted, reference count of the entry is 1
+ */
+int32_t imgcache_add(elf_image_t* image)
+{
+    int32_t idx;                /* entry for the program        */
+    imgcache_entry_t* entry;    /* the entry                    */
+    uint32_t page;              /* loop index for pages         */
+    uint32_t start;             /* first page of the program    */
+    uint32_t flags;             /* ELF_PAGE_* of a page         */
+    uint32_t page_num;          /* pages filled at execute      */
+    uint16_t frame;             /* frame of a page              */
+
+    if (!imgcache_on)
+        return -1;
+
+    start = image->seg[0].vaddr & ~(PAGE_4KB_SIZE - 1);
+    page_num = 0;
+    for (page = start; page < image->lazy_start; page += PAGE_4KB_SIZE)
+    {
+        if (elf_page_flags(image, page) != 0)
+            page_num++;
+    }
+    if (page_num > IMGCACHE_MAX_PAGES || (idx = imgcache_reserve(page_num)) == -1)
+        return -1;
+
+    entry = &imgcache[idx];
+    entry->page_num = 0;
+    for (page = start; page < image->lazy_start; page += PAGE_4KB_SIZE)
+    {
+        if ((flags = elf_page_flags(image, page)) == 0)
+            continue;
+        frame = free_frame[--free_frame_num];
+        entry->page_vaddr[entry->page_num] = page;
+        entry->frame[entry->page_num] = frame;
+        entry->writable[entry->page_num] = (flags & ELF_PAGE_WRITE) ? 1 : 0;
+        entry->page_num++;
+        imgcache_stat.frames_used++;
+        if (elf_page_fill(image, page, (uint8_t*)IMGCACHE_FRAME_ADDR(frame)) == -1)
+        {
+            imgcache_release(entry);
+            return -1;
+        }
+    }
+
+    memcpy(&entry->image, image, sizeof(elf_image_t));
+    entry->used = 1;
+    entry->refcnt = 1;
+    entry->last_use = ++use_stamp;
+    imgcache_stat.misses++;
+    return idx;
+}
+
+/*
+ * imgcache_put
+ * DESCRIPTION: drop a reference to a cached program, when a process halts or its execute fails.
+ *              The pages stay cached for the next execute.
+ * INPUT: idx -- entry, -1 for a program that is not cached
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: reference count decreased
+ */
+void imgcache_put(int32_t idx)
+{
+    if (idx < 0 || idx >= IMGCACHE_ENTRY_NUM || imgcache[idx].refcnt == 0)
+        return;
+    imgcache[idx].refcnt--;
+}
+
+/*
+ * imgcache_map
+ * DESCRIPTION: point the program page table of a process at the frames of a cached program, text
+ *              read-only and data copy-on-write. Everything else is zero-filled on demand by
+ *              elf_lazy_fault as with a private load.
+ * INPUT: idx -- entry from imgcache_get or imgcache_add
+ *        pid -- process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: user page table of the process changed, TLB flushed
+ */
+void imgcache_map(int32_t idx, uint32_t pid)
+{
+    imgcache_entry_t* entry = &imgcache[idx];   /* the program  */
+    page_table_entry_t* pte;                    /* its pages    */
+    uint32_t i;                                 /* loop index   */
+
+    user_page_reset(pid);
+    for (i = 0; i < entry->page_num; i++)
+    {
+        pte = user_pte(pid, entry->page_vaddr[i]);
+        pte->base_addr = IMGCACHE_FRAME_ADDR(entry->frame[i]) >> MEM_OFFSET_BITS;
+        pte->avail = entry->writable[i] ? PTE_AVAIL_COW : 0;
+        pte->r_w = 0;
+        pte->p = 1;
+    }
+    flush_TLB();
+}
+
+/*
+ * imgcache_cow_fault
+ * DESCRIPTION: page fault handler part of the cache. A write to a copy-on-write page of the current
+ *              process, from user or kernel mode, moves the page to the process' own frame, makes
+ *              it writable and copies the cached data there.
+ * INPUT: addr -- faulting address
+ * OUTPUT: none
+ * RETURN: 0 if the fault was handled, -1 if it is a real fault
+ * SIDE AFFECTS: user page table of the current process changed, TLB flushed
+ */
+int32_t imgcache_cow_fault(uint32_t addr)
+{
+    page_table_entry_t* pte;    /* entry of the page        */
+    uint32_t page;              /* start of the page        */
+    uint32_t src;               /* cache frame of the page  */
+
+    if (curr_pid == -1 || (pte = user_pte(curr_mm, addr)) == NULL || !pte->p || !(pte->avail & PTE_AVAIL_COW))
+        return -1;
+
+    page = addr & ~(PAGE_4KB_SIZE - 1);
+    src = pte->base_addr << MEM_OFFSET_BITS;
+    pte->base_addr = user_frame(curr_mm, page) >> MEM_OFFSET_BITS;
+    pte->avail = 0;
+    pte->r_w = 1;
+    /* the read-only translation of the cache frame may be in the TLB */
+    flush_TLB();
+
+    memcpy((void*)page, (void*)src, PAGE_4KB_SIZE);
+    imgcache_stat.cow_copies++;
+    return 0;
+}
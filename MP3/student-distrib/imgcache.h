@@ -0,0 +1,56 @@
+/*
+    imgcache.h header file
+    cache of loaded executable images, shared between the processes running a program
+*/
+
+#ifndef _IMGCACHE_H
+#define _IMGCACHE_H
+
+#include "types.h"
+#include "elf.h"
+
+/* physical memory of the cache: the 4MB after the program pages of all processes */
+#define IMGCACHE_ADDR           0x6800000   /* 8MB + NUM_PROCESS * 4MB */
+#define IMGCACHE_FRAME_NUM      (PAGE_4MB_SIZE / PAGE_4KB_SIZE)
+/* number of programs kept, and the most pages one of them may have; bigger ones are
+   loaded privately by elf_load */
+#define IMGCACHE_ENTRY_NUM      8
+#define IMGCACHE_MAX_PAGES      64
+
+/* one cached program */
+typedef struct imgcache_entry_t {
+    uint32_t used;                          /* holds a program                          */
+    uint32_t refcnt;                        /* processes running it                     */
+    uint32_t last_use;                      /* stamp of the last execute, for eviction  */
+    elf_image_t image;                      /* checked headers, a hit skips elf_check   */
+    uint32_t page_num;                      /* pages loaded at execute                  */
+    uint32_t page_vaddr[IMGCACHE_MAX_PAGES];/* user address of each page                */
+    uint16_t frame[IMGCACHE_MAX_PAGES];     /* frame index in the cache memory          */
+    uint8_t writable[IMGCACHE_MAX_PAGES];   /* data page, copied on the first write     */
+} imgcache_entry_t;
+
+/* counters shown in proc */
+typedef struct imgcache_stat_t {
+    uint32_t hits;          /* executes served from the cache           */
+    uint32_t misses;        /* executes that filled an entry            */
+    uint32_t evictions;     /* unused entries dropped to make room      */
+    uint32_t cow_copies;    /* data pages copied on a write             */
+    uint32_t frames_used;   /* cache frames holding program pages       */
+} imgcache_stat_t;
+
+extern imgcache_stat_t imgcache_stat;
+
+/* map the cache memory, all frames free */
+void imgcache_init();
+/* find a cached program by its file, take a reference */
+int32_t imgcache_get(uint32_t inode_idx, elf_image_t* image);
+/* load a checked program into the cache, take a reference */
+int32_t imgcache_add(elf_image_t* image);
+/* drop a reference taken by imgcache_get or imgcache_add */
+void imgcache_put(int32_t idx);
+/* map a cached program into a process */
+void imgcache_map(int32_t idx, uint32_t pid);
+/* give the current process its own copy of a shared data page on a write */
+int32_t imgcache_cow_fault(uint32_t addr);
+
+#endif
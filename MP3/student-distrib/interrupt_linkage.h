@@ -1,5 +1,11 @@
 #ifndef _INTERRUPT_LINKAGE_H
 #define _INTERRUPT_LINKAGE_H
+
+/* offset of the saved code segment in hw_context_t (see signal.h) */
+#define HW_CONTEXT_CS       52
+/* offset of the saved eax in hw_context_t (see signal.h) */
+#define HW_CONTEXT_EAX      24
+
 #ifndef ASM
 
 /* RTC interrupt linkage code */
@@ -8,6 +14,12 @@ extern void int_rtc();
 extern void int_keyboard();
 /* PIT interrupt linkage code */
 extern void int_pit();
+/* serial port interrupt linkage code */
+extern void int_serial();
+/* local APIC timer linkage code */
+extern void int_lapic_timer();
+/* spurious local APIC interrupt */
+extern void int_spurious();
 
 #endif
 #endif
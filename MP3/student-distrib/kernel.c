@@ -16,35 +16,39 @@
 #include "syscall.h"
 #include "terminal.h"
 #include "schedule.h"
+#include "proc.h"
+#include "trace.h"
+#include "prof.h"
+#include "serial.h"
+#include "bench.h"
+#include "smp.h"
+#include "imgcache.h"
+#include "bootlog.h"
+#include "vga.h"
+#include "blink.h"
+#include "fpu.h"
+#include "shm.h"
 
 /* If it is set to 1, run test for CP1&2 (but tests may not be compatible with the code after CP3) */
 #define RUN_TESTS   0
 
+/* If it is set to 1, the first terminal reads and writes COM1 and printf is mirrored there,
+ * for running headless (e.g. qemu -nographic) */
+#ifndef SERIAL_CONSOLE
+#define SERIAL_CONSOLE  0
+#endif
+
+/* If it is set to 1, run the benchmark suite and report on the serial port, see MP3/tools/bench.py */
+#ifndef RUN_BENCH
+#define RUN_BENCH   0
+#endif
+
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
-/* Check if MAGIC is valid and print the Multiboot information structure
-   pointed by ADDR. */
-void entry(unsigned long magic, unsigned long addr) {
-
-    multiboot_info_t *mbi;
-
-    /* start addr of the file system image */
-    uint32_t filesys_start_addr;
-
-    /* Clear the screen. */
-    clear();
-
-    /* Am I booted by a Multiboot-compliant boot loader? */
-    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
-        printf("Invalid magic number: 0x%#x\n", (unsigned)magic);
-        return;
-    }
-
-    /* Set MBI to the address of the Multiboot information structure. */
-    mbi = (multiboot_info_t *) addr;
-
+/* Print the Multiboot information structure pointed by MBI. */
+static void multiboot_dump(multiboot_info_t *mbi) {
     /* Print out the flags. */
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
 
@@ -64,9 +68,6 @@ void entry(unsigned long magic, unsigned long addr) {
         int mod_count = 0;
         int i;
         module_t* mod = (module_t*)mbi->mods_addr;
-        /* get the start of the filesys */
-        filesys_start_addr = mod->mod_start;
-
         while (mod_count < mbi->mods_count) {
             printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
             printf("Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
@@ -79,11 +80,6 @@ void entry(unsigned long magic, unsigned long addr) {
             mod++;
         }
     }
-    /* Bits 4 and 5 are mutually exclusive! */
-    if (CHECK_FLAG(mbi->flags, 4) && CHECK_FLAG(mbi->flags, 5)) {
-        printf("Both bits 4 and 5 are set.\n");
-        return;
-    }
 
     /* Is the section header table of ELF valid? */
     if (CHECK_FLAG(mbi->flags, 5)) {
@@ -109,6 +105,45 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->length_high,
                     (unsigned)mmap->length_low);
     }
+}
+
+/* Check if MAGIC is valid and print the Multiboot information structure
+   pointed by ADDR. */
+void entry(unsigned long magic, unsigned long addr) {
+
+    multiboot_info_t *mbi;
+
+    /* start addr of the file system image */
+    uint32_t filesys_start_addr;
+
+    /* Clear the screen. */
+    clear();
+
+    /* Am I booted by a Multiboot-compliant boot loader? */
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        printf("Invalid magic number: 0x%#x\n", (unsigned)magic);
+        return;
+    }
+
+    /* Set MBI to the address of the Multiboot information structure. */
+    mbi = (multiboot_info_t *) addr;
+
+    /* the first timestamp, and the command line decides how much is printed */
+    boot_start(CHECK_FLAG(mbi->flags, 2) ? (int8_t*)mbi->cmdline : NULL);
+
+    /* Bits 4 and 5 are mutually exclusive! */
+    if (CHECK_FLAG(mbi->flags, 4) && CHECK_FLAG(mbi->flags, 5)) {
+        printf("Both bits 4 and 5 are set.\n");
+        return;
+    }
+
+    /* get the start of the filesys */
+    if (CHECK_FLAG(mbi->flags, 3))
+        filesys_start_addr = ((module_t*)mbi->mods_addr)->mod_start;
+
+    /* printing to VGA is slow, a quiet boot skips the multiboot information */
+    if (!boot_quiet)
+        multiboot_dump(mbi);
 
     /* Construct an LDT entry in the GDT */
     {
@@ -151,51 +186,124 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
 
+    /* per-processor data of this processor, curr_pid lives there */
+    smp_init_bsp();
+    boot_mark("gdt");
+
     /* prevent scheduling when first shell has not been executed */
     curr_pid = -1;
 
+    /* detect the processor's features, pick the string routines and switch the FPU lazily */
+    lib_init();
+    fpu_init();
+    boot_mark("lib");
+
     /* init IDT */
     idt_init();
+    boot_mark("idt");
     /* init paging */
     paging_init();
+    boot_mark("paging");
+    /* map the graphics memory and save the font while the screen is still in text mode */
+    vga_init();
+    boot_mark("vga");
     /* Init the PIC */
     i8259_init();
+    boot_mark("pic");
+    /* find other processors, device interrupts go through the I/O APIC if there are */
+    smp_init();
+    boot_mark("smp");
 
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
 
     /* init RTC */
     rtc_init();
+    boot_mark("rtc");
     /* init keyboard */
     keyboard_init();
+    boot_mark("keyboard");
     /* init PIT */
     pit_init();
+    boot_mark("pit");
 
     /* init file system */
     filesys_init((void*)filesys_start_addr);
+    boot_mark("filesys");
+
+    /* init executable image cache, before the processors copy the page directory */
+    imgcache_init();
+    boot_mark("imgcache");
+
+    /* init shared memory segments, before the processors copy the page directory too */
+    shm_init();
+    boot_mark("shm");
 
     /* init file operation table */
     file_op_table_init();
+    boot_mark("fileops");
+
+    /* init serial port and its pseudo file */
+    serial_init();
+    boot_mark("serial");
+
+    /* init process accounting and its pseudo file */
+    proc_init();
+    boot_mark("proc");
+
+    /* init event trace and its pseudo file */
+    trace_init();
+    boot_mark("trace");
+
+    /* init sampling profiler and its pseudo file */
+    prof_init();
+    boot_mark("prof");
+
+    /* init the blink engine and its pseudo file */
+    blink_init();
+    boot_mark("blink");
+
+    /* boot timeline pseudo file */
+    boot_init();
 
     /* init multi-terminals */
     terminal_init();
+    boot_mark("terminal");
+
+#if SERIAL_CONSOLE
+    /* the first terminal and kernel messages go to COM1 */
+    terminal_set_backend(FIRST_TERMINAL_ID, TERMINAL_BACKEND_SERIAL);
+    printf_mirror = 1;
+#endif
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
      * IDT correctly otherwise QEMU will triple fault and simple close
      * without showing you any output */
-    printf("Enabling Interrupts\n");
+    /* hold the kernel lock from now on like any kernel path, and start the other processors */
+    kernel_enter();
+    smp_boot_aps();
+    boot_mark("aps");
+
+    if (!boot_quiet)
+        printf("Enabling Interrupts\n");
     sti();
 
     /* clear the screen */
-    clear();
+    if (!boot_quiet)
+        clear();
 
 #if RUN_TESTS
     /* Run tests */
     launch_tests();
+#elif RUN_BENCH
+    /* run kernel workloads, then the user ones in place of the shell */
+    bench_kernel();
+    if(launch_first_terminal((uint8_t*)BENCH_PROGRAM) == -1)
+        printf("\n fail to launch benchmark.\n");
 #else
     /* launch the first terminal */
-    if(launch_first_terminal() == -1)
+    if(launch_first_terminal((uint8_t*)"shell") == -1)
         printf("\n fail to launch first terminal.\n");
 #endif
 
@@ -3,12 +3,27 @@
 #include "i8259.h"
 #include "terminal.h"
 #include "syscall.h"
+#include "signal.h"
+#include "trace.h"
+#include "softirq.h"
+#include "schedule.h"
 
 static unsigned char caps_state = 0;
 static unsigned char shift_state = 0;
 static unsigned char ctrl_state = 0;
 static unsigned char alt_state = 0;
 
+/* alt+F<n> switches to terminal n-1 */
+static const unsigned char fkey_table[TERMINAL_MAX] = {F1, F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12};
+
+/* scancodes read by the interrupt handler and not yet handled by the bottom half */
+static unsigned char scancode_ring[KEYBOARD_RING_SIZE];
+static volatile uint32_t scancode_head = 0;    /* next slot to fill, free running      */
+static volatile uint32_t scancode_tail = 0;    /* next scancode to handle, free running */
+
+static void keyboard_bh();
+static void keyboard_process(unsigned char scancode);
+
 // array for basic key inputs
 unsigned char key_table[4][KEY_NUM] = {
 	// default
@@ -41,27 +56,23 @@ unsigned char key_table[4][KEY_NUM] = {
 *	effects:	enables line for keyboard on the master PIC
 */
 void keyboard_init(){
+    softirq_open(SOFTIRQ_KEYBOARD, keyboard_bh);
     enable_irq(KEYBOARD_IRQ);
 }
 
 /*
 *	keyboard_handler
-*	Description: If a valid key is pressed, the function echo it onto screen (foreground terminal regardless of scheduler).
+*	Description: Top half of the keyboard interrupt, read the scancode and leave it to the bottom half.
 *	inputs:	 nothing
 *	outputs: nothing
-*	side effects: echo current pressed key to screen
+*	side effects: scancode queued, SOFTIRQ_KEYBOARD raised
 */
 void keyboard_handler(){
     unsigned char scancode = 0;     /* scanned code */
-    int i;                          /* loop index for tab */
 
     /* enable pic interrupt */
     send_eoi(KEYBOARD_IRQ);
 
-    /* get current foreground terminal and its buffer */
-    terminal_t* curr_term = &terminals[curr_term_id];
-    volatile uint8_t* read_buffer = curr_term->term_buf;
-
     /* wait for interrupt */
     while(1){
         if (inb(KEYBOARD_PORT)){
@@ -69,6 +80,54 @@ void keyboard_handler(){
             break;
         }
     }
+    TRACE(TRACE_KEYBOARD, scancode, 0);
+
+    /* drop the key if the bottom half is too far behind */
+    if (scancode_head - scancode_tail < KEYBOARD_RING_SIZE){
+        scancode_ring[scancode_head & (KEYBOARD_RING_SIZE - 1)] = scancode;
+        scancode_head++;
+    }
+    softirq_raise(SOFTIRQ_KEYBOARD);
+}
+
+/*
+*	keyboard_bh
+*	Description: Bottom half of the keyboard interrupt, handle every queued scancode with interrupts enabled.
+*	inputs:	 nothing
+*	outputs: nothing
+*	side effects: see keyboard_process
+*/
+static void keyboard_bh(){
+    unsigned char scancode;     /* scancode to handle */
+    uint32_t flags;             /* saved eflags       */
+
+    while (1){
+        cli_and_save(flags);
+        if (scancode_tail == scancode_head){
+            restore_flags(flags);
+            return;
+        }
+        scancode = scancode_ring[scancode_tail & (KEYBOARD_RING_SIZE - 1)];
+        scancode_tail++;
+        restore_flags(flags);
+
+        keyboard_process(scancode);
+    }
+}
+
+/*
+*	keyboard_process
+*	Description: If a valid key is pressed, echo it onto screen (foreground terminal regardless of scheduler).
+*	inputs:	 scancode -- scanned code
+*	outputs: nothing
+*	side effects: echo current pressed key to screen, terminal may be switched
+*/
+static void keyboard_process(unsigned char scancode){
+    int i;                          /* loop index for tab */
+
+    /* get current foreground terminal and its buffer */
+    terminal_t* curr_term = &terminals[curr_term_id];
+    volatile uint8_t* read_buffer = curr_term->term_buf;
 
     switch (scancode){
         case CAPS_LOCK:
@@ -103,6 +162,7 @@ void keyboard_handler(){
             curr_term->term_buf_offset += 1;
             /* if enter is pressed, set flag is_enter to tell the foreground terminal ready to read */
             terminals[curr_term_id].is_enter = 1;
+            sched_wakeup(&terminals[curr_term_id]);
             newline();
             break;
         case BACKSPACE:
@@ -137,6 +197,7 @@ void keyboard_handler(){
 */
 void print_key(unsigned char scancode){
     unsigned char key;  /* corresponding key value */
+    uint32_t i;         /* loop index for function keys */
     
     /* get current foreground terminal and its buffer */
     terminal_t* curr_term = &terminals[curr_term_id];
@@ -144,12 +205,10 @@ void print_key(unsigned char scancode){
 
     /* for alt+Fkeys, switch the terminal */
     if(alt_state){
-        if (scancode == F1)
-            terminal_switch(0);
-        else if (scancode == F2)
-            terminal_switch(1);
-        else if (scancode == F3)
-            terminal_switch(2);
+        for (i = 0; i < terminal_num; i++){
+            if (scancode == fkey_table[i])
+                terminal_switch(i);
+        }
     }
 
     /* select different key modes based on shift and cpas state */
@@ -179,8 +238,12 @@ void print_key(unsigned char scancode){
             update_cursor(0,0);
             return;
         }
-        else if (key == 'c')
+        /* for ctrl+C, interrupt the foreground terminal's program */
+        else if (key == 'c' || key == 'C'){
+            if (curr_term->is_running)
+                signal_send(curr_term->active_pid, SIGNAL_INTERRUPT);
             return;
+        }
     }
     /* print the correct key to the foreground */
     else if (curr_term->term_buf_offset < READ_BUFFER_SIZE){
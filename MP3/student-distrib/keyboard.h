@@ -5,6 +5,7 @@
 #define KEYBOARD_PORT       0x60
 #define KEYBOARD_IRQ        1
 #define READ_BUFFER_SIZE    127
+#define KEYBOARD_RING_SIZE  64      /* scancodes waiting for the bottom half, must be a power of 2 */
 #define BACKSPACE	        0x0E
 #define TAB			        0x0F
 #define ENTER		        0x1C
@@ -20,6 +21,15 @@
 #define F1          		0x3B
 #define F2          		0x3C
 #define F3          		0x3D
+#define F4          		0x3E
+#define F5          		0x3F
+#define F6          		0x40
+#define F7          		0x41
+#define F8          		0x42
+#define F9          		0x43
+#define F10         		0x44
+#define F11         		0x57
+#define F12         		0x58
 
 /* init the keyboard by enabling the corresponding irq line */
 extern void keyboard_init();
@@ -4,11 +4,65 @@
 #include "lib.h"
 #include "terminal.h"
 #include "syscall.h"
+#include "serial.h"
+#include "smp.h"
+#include "fpu.h"
+
+/* if set, printf also copies its output to COM1 */
+int32_t printf_mirror = 0;
 
 static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
 
+/* CPUID leaf 1 feature flags of the bootstrap processor, 0 before lib_init */
+uint32_t cpu_features = 0;
+/* routines for blocks of LIB_SSE_MIN bytes and more, chosen by lib_init */
+static void* (*memcpy_large)(void* dest, const void* src, uint32_t n) = memcpy_rep;
+static void* (*memset_large)(void* s, int32_t c, uint32_t n) = memset_rep;
+
+/* void lib_init(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: read the feature flags with CPUID and, if the processor has
+ *           SSE2 and FXSAVE, enable SSE and use the SSE2 routines for large
+ *           memcpy and memset. Called once on the bootstrap processor */
+void lib_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(CPUID_FEATURES, eax, ebx, ecx, edx);
+    cpu_features = edx;
+    if ((cpu_features & (CPUID_EDX_FXSR | CPUID_EDX_SSE2)) != (CPUID_EDX_FXSR | CPUID_EDX_SSE2))
+        return;
+    lib_cpu_enable();
+    memcpy_large = memcpy_sse2;
+    memset_large = memset_sse2;
+}
+
+/* void lib_cpu_enable(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: let the calling processor run what lib_init chose: SSE
+ *           instructions need CR4.OSFXSR, and CR0.EM clear. Called by
+ *           lib_init and by every application processor */
+void lib_cpu_enable(void) {
+    if ((cpu_features & CPUID_EDX_SSE2) == 0)
+        return;
+    asm volatile ("                     \n\
+            movl    %%cr0, %%eax        \n\
+            andl    %0, %%eax           \n\
+            orl     %1, %%eax           \n\
+            movl    %%eax, %%cr0        \n\
+            movl    %%cr4, %%eax        \n\
+            orl     %2, %%eax           \n\
+            movl    %%eax, %%cr4        \n\
+            "
+            :
+            : "i"(~CR0_EM), "i"(CR0_MP), "i"(CR4_OSFXSR | CR4_OSXMMEXCPT)
+            : "eax", "memory", "cc"
+    );
+}
+
 /* void clear(void);
  * Inputs: void
  * Return Value: none
@@ -31,6 +85,29 @@ void reset_screen_xy(){
     return;
 }
 
+/* void printf_putc(uint8_t c);
+ * Inputs: uint_8* c = character to print
+ * Return Value: void
+ *  Function: Output a character of printf to the console, and to COM1 if mirrored */
+static void printf_putc(uint8_t c) {
+    putc(c);
+    if (printf_mirror)
+        serial_putc(c);
+}
+
+/* int32_t printf_puts(int8_t* s);
+ *   Inputs: int_8* s = pointer to a string of characters
+ *   Return Value: Number of bytes written
+ *    Function: Output a string of printf to the console, and to COM1 if mirrored */
+static int32_t printf_puts(int8_t* s) {
+    register int32_t index = 0;
+    while (s[index] != '\0') {
+        printf_putc(s[index]);
+        index++;
+    }
+    return index;
+}
+
 /* Standard printf().
  * Only supports the following format strings:
  * %%  - print a literal '%' character
@@ -69,7 +146,7 @@ format_char_switch:
                     switch (*buf) {
                         /* Print a literal '%' character */
                         case '%':
-                            putc('%');
+                            printf_putc('%');
                             break;
 
                         /* Use alternate formatting */
@@ -87,7 +164,7 @@ format_char_switch:
                                 int8_t conv_buf[64];
                                 if (alternate == 0) {
                                     itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    puts(conv_buf);
+                                    printf_puts(conv_buf);
                                 } else {
                                     int32_t starting_index;
                                     int32_t i;
@@ -97,7 +174,7 @@ format_char_switch:
                                         conv_buf[i] = '0';
                                         i++;
                                     }
-                                    puts(&conv_buf[starting_index]);
+                                    printf_puts(&conv_buf[starting_index]);
                                 }
                                 esp++;
                             }
@@ -108,7 +185,7 @@ format_char_switch:
                             {
                                 int8_t conv_buf[36];
                                 itoa(*((uint32_t *)esp), conv_buf, 10);
-                                puts(conv_buf);
+                                printf_puts(conv_buf);
                                 esp++;
                             }
                             break;
@@ -124,20 +201,20 @@ format_char_switch:
                                 } else {
                                     itoa(value, conv_buf, 10);
                                 }
-                                puts(conv_buf);
+                                printf_puts(conv_buf);
                                 esp++;
                             }
                             break;
 
                         /* Print a single character */
                         case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
+                            printf_putc((uint8_t) *((int32_t *)esp));
                             esp++;
                             break;
 
                         /* Print a NULL-terminated string */
                         case 's':
-                            puts(*((int8_t **)esp));
+                            printf_puts(*((int8_t **)esp));
                             esp++;
                             break;
 
@@ -149,7 +226,7 @@ format_char_switch:
                 break;
 
             default:
-                putc(*buf);
+                printf_putc(*buf);
                 break;
         }
         buf++;
@@ -299,24 +376,57 @@ int8_t* strrev(int8_t* s) {
     return s;
 }
 
-/* uint32_t strlen(const int8_t* s);
+/* uint32_t strlen_byte(const int8_t* s);
  * Inputs: const int8_t* s = string to take length of
  * Return Value: length of string s
- * Function: return length of string s */
-uint32_t strlen(const int8_t* s) {
+ * Function: return length of string s, one byte at a time. Kept for the
+ *           string benchmark, strlen is the word at a time version */
+uint32_t strlen_byte(const int8_t* s) {
     register uint32_t len = 0;
     while (s[len] != '\0')
         len++;
     return len;
 }
 
+/* uint32_t strlen(const int8_t* s);
+ * Inputs: const int8_t* s = string to take length of
+ * Return Value: length of string s
+ * Function: return length of string s, four bytes at a time once s is aligned.
+ *           An aligned word never crosses a page, so reading past the end of
+ *           the string cannot fault */
+uint32_t strlen(const int8_t* s) {
+    const int8_t* p = s;
+    const uint32_t* w;
+
+    for (; ((uint32_t)p & LIB_WORD_MASK) != 0; p++) {
+        if (*p == '\0')
+            return p - s;
+    }
+    for (w = (const uint32_t*)p; !HAS_ZERO_BYTE(*w); w++);
+    for (p = (const int8_t*)w; *p != '\0'; p++);
+    return p - s;
+}
+
 /* void* memset(void* s, int32_t c, uint32_t n);
  * Inputs:    void* s = pointer to memory
  *          int32_t c = value to set memory to
  *         uint32_t n = number of bytes to set
  * Return Value: new string
- * Function: set n consecutive bytes of pointer s to value c */
+ * Function: set n consecutive bytes of pointer s to value c, large blocks
+ *           go to the routine lib_init chose for this processor */
 void* memset(void* s, int32_t c, uint32_t n) {
+    if (n >= LIB_SSE_MIN)
+        return memset_large(s, c, n);
+    return memset_rep(s, c, n);
+}
+
+/* void* memset_rep(void* s, int32_t c, uint32_t n);
+ * Inputs:    void* s = pointer to memory
+ *          int32_t c = value to set memory to
+ *         uint32_t n = number of bytes to set
+ * Return Value: new string
+ * Function: set n consecutive bytes of pointer s to value c with rep stosl */
+void* memset_rep(void* s, int32_t c, uint32_t n) {
     c &= 0xFF;
     asm volatile ("                 \n\
             .memset_top:            \n\
@@ -398,8 +508,21 @@ void* memset_dword(void* s, int32_t c, uint32_t n) {
  *         const void* src = source of copy
  *              uint32_t n = number of byets to copy
  * Return Value: pointer to dest
- * Function: copy n bytes of src to dest */
+ * Function: copy n bytes of src to dest, large blocks go to the routine
+ *           lib_init chose for this processor */
 void* memcpy(void* dest, const void* src, uint32_t n) {
+    if (n >= LIB_SSE_MIN)
+        return memcpy_large(dest, src, n);
+    return memcpy_rep(dest, src, n);
+}
+
+/* void* memcpy_rep(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of byets to copy
+ * Return Value: pointer to dest
+ * Function: copy n bytes of src to dest with rep movsl */
+void* memcpy_rep(void* dest, const void* src, uint32_t n) {
     asm volatile ("                 \n\
             .memcpy_top:            \n\
             testl   %%ecx, %%ecx    \n\
@@ -438,34 +561,172 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
     return dest;
 }
 
+/* void* memcpy_sse2(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of byets to copy
+ * Return Value: pointer to dest
+ * Function: copy n bytes of src to dest, 64 bytes per iteration through
+ *           xmm0-xmm3 once dest is 16-byte aligned. The registers belong to
+ *           whatever the kernel interrupted, so they are kept on the stack and
+ *           put back, which also makes nested use from an interrupt safe.
+ *           Interrupts are off meanwhile so that no context switch hands the
+ *           registers to a process, and CR0.TS, set while the FPU state of
+ *           another process is loaded (see fpu.c), is cleared for the copy.
+ *           Only called once lib_init found SSE2 and enabled it */
+void* memcpy_sse2(void* dest, const void* src, uint32_t n) {
+    uint8_t xmm_save[LIB_SSE_BLOCK];    /* xmm0-xmm3 of the interrupted code */
+    uint32_t head;                      /* bytes before dest is aligned      */
+    uint32_t blocks;                    /* 64-byte blocks                    */
+    uint32_t flags;                     /* saved eflags                      */
+    uint32_t cr0;                       /* CR0.TS of the interrupted code    */
+    uint8_t* d;
+    const uint8_t* s;
+
+    if (n < 2 * LIB_SSE_BLOCK)
+        return memcpy_rep(dest, src, n);
+    head = (-(uint32_t)dest) & LIB_SSE_ALIGN_MASK;
+    memcpy_rep(dest, src, head);
+    d = (uint8_t*)dest + head;
+    s = (const uint8_t*)src + head;
+    n -= head;
+    blocks = n / LIB_SSE_BLOCK;
+
+    cli_and_save(flags);
+    get_cr0(cr0);
+    if (cr0 & CR0_TS)
+        clts();
+    asm volatile ("                         \n\
+            movdqu  %%xmm0, 0(%3)           \n\
+            movdqu  %%xmm1, 16(%3)          \n\
+            movdqu  %%xmm2, 32(%3)          \n\
+            movdqu  %%xmm3, 48(%3)          \n\
+            1:                              \n\
+            movdqu  0(%1), %%xmm0           \n\
+            movdqu  16(%1), %%xmm1          \n\
+            movdqu  32(%1), %%xmm2          \n\
+            movdqu  48(%1), %%xmm3          \n\
+            movdqa  %%xmm0, 0(%0)           \n\
+            movdqa  %%xmm1, 16(%0)          \n\
+            movdqa  %%xmm2, 32(%0)          \n\
+            movdqa  %%xmm3, 48(%0)          \n\
+            addl    $64, %1                 \n\
+            addl    $64, %0                 \n\
+            decl    %2                      \n\
+            jnz     1b                      \n\
+            movdqu  0(%3), %%xmm0           \n\
+            movdqu  16(%3), %%xmm1          \n\
+            movdqu  32(%3), %%xmm2          \n\
+            movdqu  48(%3), %%xmm3          \n\
+            "
+            : "+D"(d), "+S"(s), "+c"(blocks)
+            : "r"(xmm_save)
+            : "memory", "cc"
+    );
+    if (cr0 & CR0_TS)
+        stts();
+    restore_flags(flags);
+
+    memcpy_rep(d, s, n % LIB_SSE_BLOCK);
+    return dest;
+}
+
+/* void* memset_sse2(void* s, int32_t c, uint32_t n);
+ * Inputs:    void* s = pointer to memory
+ *          int32_t c = value to set memory to
+ *         uint32_t n = number of bytes to set
+ * Return Value: new string
+ * Function: set n consecutive bytes of pointer s to value c, 64 bytes per
+ *           iteration from xmm0 once s is 16-byte aligned. xmm0 is kept on
+ *           the stack and CR0.TS handled like in memcpy_sse2 */
+void* memset_sse2(void* s, int32_t c, uint32_t n) {
+    uint8_t xmm_save[LIB_SSE_BLOCK / 4];    /* xmm0 of the interrupted code */
+    uint32_t head;                          /* bytes before s is aligned    */
+    uint32_t blocks;                        /* 64-byte blocks               */
+    uint32_t flags;                         /* saved eflags                 */
+    uint32_t cr0;                           /* CR0.TS of the interrupted code */
+    uint8_t* d;
+
+    if (n < 2 * LIB_SSE_BLOCK)
+        return memset_rep(s, c, n);
+    head = (-(uint32_t)s) & LIB_SSE_ALIGN_MASK;
+    memset_rep(s, c, head);
+    d = (uint8_t*)s + head;
+    n -= head;
+    blocks = n / LIB_SSE_BLOCK;
+    c &= 0xFF;
+
+    cli_and_save(flags);
+    get_cr0(cr0);
+    if (cr0 & CR0_TS)
+        clts();
+    asm volatile ("                         \n\
+            movdqu  %%xmm0, 0(%3)           \n\
+            movd    %2, %%xmm0              \n\
+            pshufd  $0, %%xmm0, %%xmm0      \n\
+            1:                              \n\
+            movdqa  %%xmm0, 0(%0)           \n\
+            movdqa  %%xmm0, 16(%0)          \n\
+            movdqa  %%xmm0, 32(%0)          \n\
+            movdqa  %%xmm0, 48(%0)          \n\
+            addl    $64, %0                 \n\
+            decl    %1                      \n\
+            jnz     1b                      \n\
+            movdqu  0(%3), %%xmm0           \n\
+            "
+            : "+D"(d), "+c"(blocks)
+            : "r"(c << 24 | c << 16 | c << 8 | c), "r"(xmm_save)
+            : "memory", "cc"
+    );
+    if (cr0 & CR0_TS)
+        stts();
+    restore_flags(flags);
+
+    memset_rep(d, c, n % LIB_SSE_BLOCK);
+    return s;
+}
+
 /* void* memmove(void* dest, const void* src, uint32_t n);
  * Description: Optimized memmove (used for overlapping memory areas)
  * Inputs:      void* dest = destination of move
  *         const void* src = source of move
  *              uint32_t n = number of byets to move
  * Return Value: pointer to dest
- * Function: move n bytes of src to dest */
+ * Function: move n bytes of src to dest. Unless dest starts inside src the
+ *           forward memcpy is safe, otherwise copy backward, four bytes at
+ *           a time after the odd bytes at the top */
 void* memmove(void* dest, const void* src, uint32_t n) {
+    uint8_t* d;
+    const uint8_t* s;
+    uint32_t words;
+
+    /* dest below src, or no overlap at all (the difference wraps around) */
+    if ((uint32_t)dest - (uint32_t)src >= n)
+        return memcpy(dest, src, n);
+
+    d = (uint8_t*)dest + n;
+    s = (const uint8_t*)src + n;
+    for (words = n & LIB_WORD_MASK; words > 0; words--)
+        *--d = *--s;
+    /* rep movsl going down starts at the top word */
+    words = n >> 2;
+    d -= 4;
+    s -= 4;
     asm volatile ("                             \n\
             movw    %%ds, %%dx                  \n\
             movw    %%dx, %%es                  \n\
-            cld                                 \n\
-            cmp     %%edi, %%esi                \n\
-            jae     .memmove_go                 \n\
-            leal    -1(%%esi, %%ecx), %%esi     \n\
-            leal    -1(%%edi, %%ecx), %%edi     \n\
             std                                 \n\
-            .memmove_go:                        \n\
-            rep     movsb                       \n\
+            rep     movsl                       \n\
+            cld                                 \n\
             "
+            : "+D"(d), "+S"(s), "+c"(words)
             :
-            : "D"(dest), "S"(src), "c"(n)
             : "edx", "memory", "cc"
     );
     return dest;
 }
 
-/* int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n)
+/* int32_t strncmp_byte(const int8_t* s1, const int8_t* s2, uint32_t n)
  * Inputs: const int8_t* s1 = first string to compare
  *         const int8_t* s2 = second string to compare
  *               uint32_t n = number of bytes to compare
@@ -475,8 +736,9 @@ void* memmove(void* dest, const void* src, uint32_t n) {
  *               character that does not match has a greater value
  *               in str1 than in str2; And a value less than zero
  *               indicates the opposite.
- * Function: compares string 1 and string 2 for equality */
-int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
+ * Function: compares string 1 and string 2 for equality, one byte at a time.
+ *           Kept for the string benchmark and for the tail of strncmp */
+int32_t strncmp_byte(const int8_t* s1, const int8_t* s2, uint32_t n) {
     int32_t i;
     for (i = 0; i < n; i++) {
         if ((s1[i] != s2[i]) || (s1[i] == '\0') /* || s2[i] == '\0' */) {
@@ -492,6 +754,31 @@ int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
     return 0;
 }
 
+/* int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n)
+ * Inputs: const int8_t* s1 = first string to compare
+ *         const int8_t* s2 = second string to compare
+ *               uint32_t n = number of bytes to compare
+ * Return Value: as strncmp_byte
+ * Function: compares string 1 and string 2 for equality, four bytes at a time
+ *           while both are aligned the same way. The first word that differs
+ *           or holds the end of s1 is finished byte by byte */
+int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
+    const uint32_t* w1;
+    const uint32_t* w2;
+
+    if ((((uint32_t)s1 ^ (uint32_t)s2) & LIB_WORD_MASK) != 0)
+        return strncmp_byte(s1, s2, n);
+
+    for (; n > 0 && ((uint32_t)s1 & LIB_WORD_MASK) != 0; n--, s1++, s2++) {
+        if (*s1 != *s2 || *s1 == '\0')
+            return *s1 - *s2;
+    }
+    w1 = (const uint32_t*)s1;
+    w2 = (const uint32_t*)s2;
+    for (; n >= 4 && *w1 == *w2 && !HAS_ZERO_BYTE(*w1); n -= 4, w1++, w2++);
+    return strncmp_byte((const int8_t*)w1, (const int8_t*)w2, n);
+}
+
 /* int8_t* strcpy(int8_t* dest, const int8_t* src)
  * Inputs:      int8_t* dest = destination string of copy
  *         const int8_t* src = source string of copy
@@ -13,6 +13,26 @@
 #define ATTRIB      0x7
 #define VIDBUF_SIZE 2*NUM_COLS*NUM_ROWS
 
+/* string routines */
+#define LIB_WORD_MASK       0x3         /* low address bits of a 4-byte word                */
+#define LIB_SSE_BLOCK       64          /* bytes per iteration of the SSE2 loops            */
+#define LIB_SSE_ALIGN_MASK  0xF         /* low address bits of a 16-byte SSE2 store         */
+#define LIB_SSE_MIN         512         /* memcpy and memset from this size on use SSE2     */
+/* a word has a zero byte: the subtraction borrows into bit 7 of that byte only */
+#define HAS_ZERO_BYTE(w)    ((((w) - 0x01010101) & ~(w) & 0x80808080) != 0)
+
+/* CPUID leaf 1 feature flags */
+#define CPUID_FEATURES      1
+#define CPUID_EDX_FXSR      0x01000000  /* FXSAVE and FXRSTOR   */
+#define CPUID_EDX_SSE       0x02000000
+#define CPUID_EDX_SSE2      0x04000000
+
+/* CPUID leaf 1 feature flags, see lib_init */
+extern uint32_t cpu_features;
+
+/* if set, printf also copies its output to COM1 */
+extern int32_t printf_mirror;
+
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
 void delc();
@@ -33,12 +53,22 @@ int get_screen_x();
 int get_screen_y();
 void set_screen_xy(int x, int y);
 
+void lib_init(void);
+void lib_cpu_enable(void);
+
 void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
 void* memset_dword(void* s, int32_t c, uint32_t n);
 void* memcpy(void* dest, const void* src, uint32_t n);
 void* memmove(void* dest, const void* src, uint32_t n);
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
+/* the variants behind them, for the string benchmark */
+uint32_t strlen_byte(const int8_t* s);
+int32_t strncmp_byte(const int8_t* s1, const int8_t* s2, uint32_t n);
+void* memset_rep(void* s, int32_t c, uint32_t n);
+void* memset_sse2(void* s, int32_t c, uint32_t n);
+void* memcpy_rep(void* dest, const void* src, uint32_t n);
+void* memcpy_sse2(void* dest, const void* src, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
 int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
 
@@ -181,4 +211,25 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Read time-stamp counter
+ * Puts the low and high 32 bits of the processor's time-stamp
+ * counter into the variables "lo" and "hi" */
+#define rdtsc(lo, hi)                   \
+do {                                    \
+    asm volatile ("rdtsc"               \
+            : "=a"(lo), "=d"(hi)        \
+    );                                  \
+} while (0)
+
+/* CPUID
+ * Puts the registers CPUID returns for a leaf into the variables
+ * "a", "b", "c" and "d" */
+#define cpuid(leaf, a, b, c, d)         \
+do {                                    \
+    asm volatile ("cpuid"               \
+            : "=a"(a), "=b"(b), "=c"(c), "=d"(d) \
+            : "a"(leaf), "c"(0)         \
+    );                                  \
+} while (0)
+
 #endif /* _LIB_H */
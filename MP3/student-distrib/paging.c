@@ -3,8 +3,15 @@
 */
 
 #include "paging.h"
+#include "smp.h"
+#include "syscall.h"
 #include "lib.h"
 
+/* 4kB page tables of the program page (128MB-132MB), one per process */
+page_table_entry_t user_page_table[NUM_PROCESS][NUM_PT_ENTRY] __attribute__((aligned(PAGE_4KB_SIZE)));
+/* 4kB page tables of the shared memory window (132MB-136MB), one per process */
+page_table_entry_t shm_page_table[NUM_PROCESS][NUM_PT_ENTRY] __attribute__((aligned(PAGE_4KB_SIZE)));
+
 /*
 *	paging_init
 *	Description:    init paging when booting system
@@ -118,8 +125,9 @@ void enable_paging()
 
         /* MSE: enable paging */
         "movl %cr0, %eax;"
-        /* set the bit 31 to be 1 */
-        "orl $0x80000000, %eax;"
+        /* set the bit 31 to be 1, and bit 16 (WP) so that kernel writes to
+           read-only user pages fault too, copy-on-write pages rely on it */
+        "orl $0x80010000, %eax;"
         "movl %eax, %cr0;"
     );
 }
@@ -142,29 +150,181 @@ void activate_video()
 *	Description:    set a page for according process
 *	inputs:		    process id
 *	outputs:	    nothing
-*	effects:	    page directory entry in 128MB/4MB is changed
+*	effects:	    page directory entries in 128MB/4MB and 132MB/4MB are changed to the
+*	                process' page tables
 */
 void set_paging(uint32_t pid)
 {
-    // magic number here
-    uint32_t index = 0x8000000 / 0x400000;  // 128mB / 4mB
-    uint32_t physical_addr = 0x800000 + pid * 0x400000;
+    uint32_t index = ADDR_128MB / PAGE_4MB_SIZE;
+    /* each processor has its own page directory */
+    page_dir_entry_t* pd = this_cpu()->pd;
+
+    /* the program 4MB is mapped with 4kB pages, see elf.c for which are present */
+    pd[index].p           = 1;    // present
+    pd[index].r_w         = 1;    // page table entries decide
+    pd[index].u_s         = 1;    // user mode
+    pd[index].pwt         = 0;
+    pd[index].pcd         = 0;
+    pd[index].a           = 0;
+    pd[index].reserved    = 0;
+    pd[index].ps          = 0;    // 4kB pages
+    pd[index].g           = 0;
+    pd[index].avail       = 0;
+    pd[index].base_addr   = (uint32_t)user_page_table[pid] >> MEM_OFFSET_BITS;
+
+    /* the shared memory window, only the pages of attached segments are present */
+    index = SHM_VIRTUAL_ADDR / PAGE_4MB_SIZE;
+    pd[index].p           = 1;
+    pd[index].r_w         = 1;
+    pd[index].u_s         = 1;
+    pd[index].ps          = 0;
+    pd[index].base_addr   = (uint32_t)shm_page_table[pid] >> MEM_OFFSET_BITS;
+
+    /* flush TLB */
+    flush_TLB();
+}
+
+/*
+*	user_page_reset
+*	Description:    clear the program page table of a process before a program is loaded,
+*	                every page points to its frame in the process' 4MB but is not present
+*	inputs:		    pid -- process id
+*	outputs:	    nothing
+*	effects:	    the process' page table is changed, the caller flushes the TLB
+*/
+void user_page_reset(uint32_t pid)
+{
+    int i;
+    uint32_t physical_addr = USER_PHYS_BASE + pid * PAGE_4MB_SIZE;
+
+    for (i = 0; i < NUM_PT_ENTRY; i++)
+    {
+        user_page_table[pid][i].p = 0;
+        user_page_table[pid][i].r_w = 0;
+        user_page_table[pid][i].u_s = 1;
+        user_page_table[pid][i].pwt = 0;
+        user_page_table[pid][i].pcd = 0;
+        user_page_table[pid][i].a = 0;
+        user_page_table[pid][i].d = 0;
+        user_page_table[pid][i].pat = 0;
+        user_page_table[pid][i].g = 0;
+        user_page_table[pid][i].avail = 0;
+        user_page_table[pid][i].base_addr = (physical_addr >> MEM_OFFSET_BITS) + i;
+    }
+}
+
+/*
+*	user_page_map
+*	Description:    make a page of a process' program page present, a page that is already
+*	                present only gains write permission if asked
+*	inputs:		    pid -- process id
+*	                vaddr -- any address in the page, 128MB-132MB
+*	                writable -- non zero for a writable page
+*	outputs:	    nothing
+*	return:         1 if the page was not present, 0 if it was, -1 for an address out of range
+*	effects:	    the process' page table is changed, the caller flushes the TLB if needed
+*/
+int32_t user_page_map(uint32_t pid, uint32_t vaddr, uint32_t writable)
+{
+    page_table_entry_t* pte;
+
+    if ((pte = user_pte(pid, vaddr)) == NULL)
+        return -1;
+    if (writable)
+        pte->r_w = 1;
+    if (pte->p)
+        return 0;
+    pte->p = 1;
+    return 1;
+}
+
+/*
+*	user_pte
+*	Description:    find the page table entry of an address in a process' program page
+*	inputs:		    pid -- process id
+*	                vaddr -- any address in the page, 128MB-132MB
+*	outputs:	    nothing
+*	return:         the entry, NULL for an address out of range
+*	effects:	    none
+*/
+page_table_entry_t* user_pte(uint32_t pid, uint32_t vaddr)
+{
+    if (vaddr < ADDR_128MB || vaddr >= ADDR_132MB)
+        return NULL;
+    return &user_page_table[pid][(vaddr - ADDR_128MB) >> MEM_OFFSET_BITS];
+}
+
+/*
+*	user_frame
+*	Description:    physical address of the process' own frame for a page of its program page,
+*	                where user_page_reset points the entry
+*	inputs:		    pid -- process id
+*	                vaddr -- any address in the page, 128MB-132MB
+*	outputs:	    nothing
+*	return:         physical address of the frame
+*	effects:	    none
+*/
+uint32_t user_frame(uint32_t pid, uint32_t vaddr)
+{
+    return USER_PHYS_BASE + pid * PAGE_4MB_SIZE + ((vaddr - ADDR_128MB) & ~(PAGE_4KB_SIZE - 1));
+}
+
+/*
+*	map_4mb_identity
+*	Description:    map a 4MB page at the same virtual address for the kernel only
+*	inputs:		    addr -- any address in the page
+*	                uncached -- non zero for device registers
+*	outputs:	    nothing
+*	return:         0 for success, -1 if the page is already used by something else
+*	effects:	    page directory entry of the address is changed
+*/
+static int32_t map_4mb_identity(uint32_t addr, uint32_t uncached)
+{
+    uint32_t index = addr / PAGE_4MB_SIZE;
+    uint32_t base = (addr & ~(PAGE_4MB_SIZE - 1)) >> MEM_OFFSET_BITS;
+
+    if (page_directory[index].p)
+        return (page_directory[index].ps && page_directory[index].base_addr == base) ? 0 : -1;
 
-    /* initialize the program 4MB page */
-    page_directory[index].p           = 1;    // present
     page_directory[index].r_w         = 1;
-    page_directory[index].u_s         = 1;    // user mode
-    page_directory[index].pwt         = 0;
-    page_directory[index].pcd         = 0;
-    page_directory[index].a           = 0;
-    page_directory[index].reserved    = 0;
+    page_directory[index].u_s         = 0;    // kernel only
+    page_directory[index].pwt         = uncached ? 1 : 0;
+    page_directory[index].pcd         = uncached ? 1 : 0;
     page_directory[index].ps          = 1;    // 4mB page
-    page_directory[index].g           = 0;
-    page_directory[index].avail       = 0;
-    page_directory[index].base_addr   = physical_addr >> MEM_OFFSET_BITS;
+    page_directory[index].base_addr   = base;
+    page_directory[index].p           = 1;
 
-    /* flush TLB */
     flush_TLB();
+    return 0;
+}
+
+/*
+*	paging_map_mmio
+*	Description:    map the 4MB page holding a device's registers (e.g. a local APIC) at the
+*	                same virtual address, uncached and for the kernel only
+*	inputs:		    addr -- physical address of the registers
+*	outputs:	    nothing
+*	return:         0 for success, -1 if the page is already used by something else
+*	effects:	    page directory entry of the address is changed
+*/
+int32_t paging_map_mmio(uint32_t addr)
+{
+    /* registers must not be cached */
+    return map_4mb_identity(addr, 1);
+}
+
+/*
+*	paging_map_kernel
+*	Description:    map a 4MB page of memory at the same virtual address for the kernel only,
+*	                must be called before the application processors copy the page directory
+*	inputs:		    addr -- physical address in the page
+*	outputs:	    nothing
+*	return:         0 for success, -1 if the page is already used by something else
+*	effects:	    page directory entry of the address is changed
+*/
+int32_t paging_map_kernel(uint32_t addr)
+{
+    return map_4mb_identity(addr, 0);
 }
 
 /*
@@ -22,6 +22,7 @@
 #define VID_PHYS_ADDR       0xB8000
 #define VID_VIRTUAL_ADDR    ADDR_140MB
 #define VIDMAP_OFFSET       VID_VIRTUAL_ADDR/PAGE_4MB_SIZE          /* 140/4 */
+#define SHM_VIRTUAL_ADDR    ADDR_132MB  /* window of shared memory segments, see shm.c */
 
 /* struct for page directory entry */
 typedef struct page_dir_entry
@@ -62,6 +63,18 @@ page_table_entry_t page_table[NUM_PT_ENTRY] __attribute__((aligned(PAGE_4KB_SIZE
 /* page table for virtual video memory */
 page_table_entry_t vid_page_table[NUM_PT_ENTRY] __attribute__((aligned(PAGE_4KB_SIZE)));
 
+/* physical address of the program page of process 0, each process has the next 4MB */
+#define USER_PHYS_BASE      0x800000
+
+/* avail bits of a program page table entry: a read-only view of a page of the image
+   cache that gets a private copy on the first write (see imgcache.c) */
+#define PTE_AVAIL_COW       0x1
+
+/* 4kB page tables of the program page (128MB-132MB), one per process, see user_page_map */
+extern page_table_entry_t user_page_table[][NUM_PT_ENTRY];
+/* 4kB page tables of the shared memory window (132MB-136MB), one per process */
+extern page_table_entry_t shm_page_table[][NUM_PT_ENTRY];
+
 /* init paging */
 void paging_init();
 /* init page directory */
@@ -74,6 +87,18 @@ void enable_paging();
 void activate_video();
 /* set a page for according process */
 void set_paging(uint32_t pid);
+/* clear the program page table of a process, nothing is present */
+void user_page_reset(uint32_t pid);
+/* make a page of a process' program page present */
+int32_t user_page_map(uint32_t pid, uint32_t vaddr, uint32_t writable);
+/* page table entry of an address in a process' program page */
+page_table_entry_t* user_pte(uint32_t pid, uint32_t vaddr);
+/* physical address of a process' own frame for a program page */
+uint32_t user_frame(uint32_t pid, uint32_t vaddr);
+/* map a 4MB page of device registers at the same address */
+int32_t paging_map_mmio(uint32_t addr);
+/* map a 4MB page of memory at the same address for the kernel */
+int32_t paging_map_kernel(uint32_t addr);
 /* flush TLB */
 void flush_TLB();
 
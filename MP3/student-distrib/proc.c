@@ -0,0 +1,301 @@
+/*
+    proc
+    per-process accounting (CPU ticks, context switches, system calls, I/O bytes, page faults)
+    reported in text through the "proc" pseudo file, e.g. "cat proc"
+*/
+
+#include "proc.h"
+#include "syscall.h"
+#include "filesys.h"
+#include "schedule.h"
+#include "imgcache.h"
+#include "lib.h"
+
+/* ticks since the first PIT interrupt */
+uint32_t proc_uptime = 0;
+
+/* column titles of the system call table, by system call number */
+static char* syscall_name[SYSCALL_NUM + 1] = {
+    "", "HALT", "EXEC", "READ", "WRITE", "OPEN", "CLOSE", "ARGS", "VMAP", "SIGH", "SIGR", "DENTS", "VGA",
+    "SHMGET", "SHMAT", "SHMDT", "FUTEX", "THCRT", "THJOIN"
+};
+
+/* text snapshot of the proc file for each reading program, and its length */
+static uint8_t proc_buf[NUM_PROCESS][PROC_BUF_SIZE];
+static uint32_t proc_len[NUM_PROCESS];
+/* snapshot being generated */
+static uint8_t* proc_snap;
+
+/*
+ * proc_init
+ * DESCRIPTION: register the proc pseudo file
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: "proc" appears in the directory
+ */
+void proc_init()
+{
+    pseudo_register(PROC_FILE_NAME, proc_read, NULL);
+}
+
+/*
+ * proc_tick
+ * DESCRIPTION: account a PIT tick to the current process, called by the PIT handler
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: uptime and current process' cpu ticks increased
+ */
+void proc_tick()
+{
+    proc_uptime++;
+    proc_cpu_tick();
+}
+
+/*
+ * proc_cpu_tick
+ * DESCRIPTION: account a timer tick of the calling processor to its current process, called by
+ *              proc_tick and by the local timer of application processors, which do not count uptime
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: current process' cpu ticks increased
+ */
+void proc_cpu_tick()
+{
+    if (curr_pid != -1)
+        get_pcb_ptr(curr_pid)->acct.cpu_ticks++;
+}
+
+/*
+ * proc_syscall
+ * DESCRIPTION: account a system call to the current process, called by the system call linkage
+ * INPUT: num -- system call number, already checked by the linkage
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: current process' system call counter increased
+ */
+void proc_syscall(uint32_t num)
+{
+    if (curr_pid != -1 && num <= SYSCALL_NUM)
+        get_pcb_ptr(curr_pid)->acct.syscall_cnt[num]++;
+}
+
+/*
+ * proc_page_fault
+ * DESCRIPTION: account a page fault to the current process
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: current process' page fault counter increased
+ */
+void proc_page_fault()
+{
+    if (curr_pid != -1)
+        get_pcb_ptr(curr_pid)->acct.page_faults++;
+}
+
+/*
+ * proc_put_str
+ * DESCRIPTION: append a string to the snapshot, left aligned and padded with spaces to width
+ * INPUT: len -- current length of the snapshot
+ *        s -- string to append
+ *        width -- column width
+ * OUTPUT: none
+ * RETURN: new length of the snapshot
+ * SIDE AFFECTS: snapshot buffer changed
+ */
+static uint32_t proc_put_str(uint32_t len, const int8_t* s, uint32_t width)
+{
+    uint32_t i;     /* number of chars appended */
+
+    for (i = 0; s[i] != '\0' && len < PROC_BUF_SIZE; i++)
+        proc_snap[len++] = s[i];
+    for (; i < width && len < PROC_BUF_SIZE; i++)
+        proc_snap[len++] = ' ';
+    return len;
+}
+
+/*
+ * proc_put_num
+ * DESCRIPTION: append an unsigned number in decimal to the snapshot, padded to width
+ * INPUT: len -- current length of the snapshot
+ *        value -- number to append
+ *        width -- column width
+ * OUTPUT: none
+ * RETURN: new length of the snapshot
+ * SIDE AFFECTS: snapshot buffer changed
+ */
+static uint32_t proc_put_num(uint32_t len, uint32_t value, uint32_t width)
+{
+    int8_t conv_buf[36];    /* converted number */
+
+    itoa(value, conv_buf, 10);
+    return proc_put_str(len, conv_buf, width);
+}
+
+/*
+ * proc_generate
+ * DESCRIPTION: generate the text snapshot of all running processes:
+ *                  uptime <ticks>
+ *                  PID PPID TERM TICKS SWITCH RBYTES WBYTES PGFLT NAME
+ *                  ...
+ *                  PID HALT EXEC READ ... (system calls by number, PROC_SYSCALL_ROW at a time)
+ *                  ...
+ *                  CPU PID QUEUED LOAD TICKS IDLE BUSY SWITCH STEALS STOLEN
+ *                  ...
+ *                  imgcache hits <n> misses <n> evictions <n> cow <n> frames <n>
+ * INPUT: snap -- buffer of the snapshot, PROC_BUF_SIZE bytes
+ * OUTPUT: none
+ * RETURN: length of the snapshot
+ * SIDE AFFECTS: snapshot buffer changed
+ */
+static uint32_t proc_generate(uint8_t* snap)
+{
+    uint32_t len = 0;   /* length of the snapshot       */
+    uint32_t pid;       /* loop index for processes     */
+    uint32_t num;       /* loop index for system calls  */
+    uint32_t first;     /* first system call of a table */
+    uint32_t last;      /* last system call of a table  */
+    pcb_t* pcb;         /* pcb of the process           */
+    uint32_t cpu;       /* loop index for processors    */
+    runqueue_t* rq;     /* run queue of the processor   */
+
+    proc_snap = snap;
+    len = proc_put_str(len, "uptime ", 0);
+    len = proc_put_num(len, proc_uptime, 0);
+    len = proc_put_str(len, "\n", 0);
+
+    /* process table */
+    len = proc_put_str(len, "PID", PROC_COL_WIDTH);
+    len = proc_put_str(len, "PPID", PROC_COL_WIDTH);
+    len = proc_put_str(len, "TERM", PROC_COL_WIDTH);
+    len = proc_put_str(len, "TICKS", PROC_COL_WIDTH);
+    len = proc_put_str(len, "SWITCH", PROC_COL_WIDTH);
+    len = proc_put_str(len, "RBYTES", PROC_COL_WIDTH);
+    len = proc_put_str(len, "WBYTES", PROC_COL_WIDTH);
+    len = proc_put_str(len, "PGFLT", PROC_COL_WIDTH);
+    len = proc_put_str(len, "FPULD", PROC_COL_WIDTH);
+    len = proc_put_str(len, "NAME\n", 0);
+    for (pid = 0; pid < NUM_PROCESS; pid++)
+    {
+        if (!is_pid_used(pid))
+            continue;
+        pcb = get_pcb_ptr(pid);
+        len = proc_put_num(len, pid, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->parent_pid, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->term_id, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->acct.cpu_ticks, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->acct.ctx_switches, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->acct.read_bytes, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->acct.write_bytes, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->acct.page_faults, PROC_COL_WIDTH);
+        len = proc_put_num(len, pcb->acct.fpu_loads, PROC_COL_WIDTH);
+        len = proc_put_str(len, (int8_t*)pcb->name, 0);
+        len = proc_put_str(len, "\n", 0);
+    }
+
+    /* system call table, PROC_SYSCALL_ROW system calls at a time */
+    for (first = 1; first <= SYSCALL_NUM; first += PROC_SYSCALL_ROW)
+    {
+        last = (first + PROC_SYSCALL_ROW - 1 < SYSCALL_NUM) ? first + PROC_SYSCALL_ROW - 1 : SYSCALL_NUM;
+        len = proc_put_str(len, "PID", PROC_COL_WIDTH - 1);
+        for (num = first; num <= last; num++)
+            len = proc_put_str(len, syscall_name[num], PROC_COL_WIDTH - 1);
+        len = proc_put_str(len, "\n", 0);
+        for (pid = 0; pid < NUM_PROCESS; pid++)
+        {
+            if (!is_pid_used(pid))
+                continue;
+            pcb = get_pcb_ptr(pid);
+            len = proc_put_num(len, pid, PROC_COL_WIDTH - 1);
+            for (num = first; num <= last; num++)
+                len = proc_put_num(len, pcb->acct.syscall_cnt[num], PROC_COL_WIDTH - 1);
+            len = proc_put_str(len, "\n", 0);
+        }
+    }
+
+    /* run queues, the load and the busy share are shown in hundredths */
+    len = proc_put_str(len, "CPU", PROC_COL_WIDTH);
+    len = proc_put_str(len, "PID", PROC_COL_WIDTH);
+    len = proc_put_str(len, "QUEUED", PROC_COL_WIDTH);
+    len = proc_put_str(len, "LOAD%", PROC_COL_WIDTH);
+    len = proc_put_str(len, "TICKS", PROC_COL_WIDTH);
+    len = proc_put_str(len, "IDLE", PROC_COL_WIDTH);
+    len = proc_put_str(len, "BUSY%", PROC_COL_WIDTH);
+    len = proc_put_str(len, "SWITCH", PROC_COL_WIDTH);
+    len = proc_put_str(len, "STEALS", PROC_COL_WIDTH);
+    len = proc_put_str(len, "STOLEN\n", 0);
+    for (cpu = 0; cpu < cpu_num; cpu++)
+    {
+        rq = &runqueues[cpu];
+        len = proc_put_num(len, cpu, PROC_COL_WIDTH);
+        if (cpus[cpu].pid == -1)
+            len = proc_put_str(len, "-", PROC_COL_WIDTH);
+        else
+            len = proc_put_num(len, cpus[cpu].pid, PROC_COL_WIDTH);
+        len = proc_put_num(len, rq->nr, PROC_COL_WIDTH);
+        len = proc_put_num(len, rq->load_avg * PROC_PERCENT / RQ_LOAD_FIXED_1, PROC_COL_WIDTH);
+        len = proc_put_num(len, rq->ticks, PROC_COL_WIDTH);
+        len = proc_put_num(len, rq->idle_ticks, PROC_COL_WIDTH);
+        /* share of the ticks not spent halted in the idle loop */
+        len = proc_put_num(len, rq->ticks ? (rq->ticks - rq->idle_ticks) * PROC_PERCENT / rq->ticks : 0, PROC_COL_WIDTH);
+        len = proc_put_num(len, rq->switches, PROC_COL_WIDTH);
+        len = proc_put_num(len, rq->steals, PROC_COL_WIDTH);
+        len = proc_put_num(len, rq->stolen, 0);
+        len = proc_put_str(len, "\n", 0);
+    }
+
+    /* image cache, frames are the 4kB pages it holds */
+    len = proc_put_str(len, "imgcache hits ", 0);
+    len = proc_put_num(len, imgcache_stat.hits, 0);
+    len = proc_put_str(len, " misses ", 0);
+    len = proc_put_num(len, imgcache_stat.misses, 0);
+    len = proc_put_str(len, " evictions ", 0);
+    len = proc_put_num(len, imgcache_stat.evictions, 0);
+    len = proc_put_str(len, " cow ", 0);
+    len = proc_put_num(len, imgcache_stat.cow_copies, 0);
+    len = proc_put_str(len, " frames ", 0);
+    len = proc_put_num(len, imgcache_stat.frames_used, 0);
+    len = proc_put_str(len, "\n", 0);
+
+    return len;
+}
+
+/*
+ * proc_read
+ * DESCRIPTION: read routine of the proc pseudo file. A read at offset 0 takes a new snapshot
+ *              for the calling program, later reads go on in that same snapshot, so a reader
+ *              may read the file in pieces.
+ * INPUT: offset -- byte offset in the file
+ *        buf -- buffer to be filled in
+ *        nbytes -- number of bytes needed to be copied
+ * OUTPUT: none
+ * RETURN: number of copied bytes, -1 without a process
+ * SIDE AFFECTS: snapshot buffer changed
+ */
+int32_t proc_read(uint32_t offset, uint8_t* buf, uint32_t nbytes)
+{
+    uint32_t len;       /* length of the snapshot */
+    uint32_t flags;     /* saved eflags           */
+
+    if (curr_pid == -1)
+        return -1;
+
+    /* proc_snap is shared, do not let another reader be scheduled in */
+    cli_and_save(flags);
+
+    /* threads of a program share the file position, so they share the snapshot too */
+    if (offset == 0)
+        proc_len[curr_mm] = proc_generate(proc_buf[curr_mm]);
+    len = proc_len[curr_mm];
+    if (offset >= len)
+        nbytes = 0;
+    else if (nbytes > len - offset)
+        nbytes = len - offset;
+    memcpy(buf, proc_buf[curr_mm] + offset, nbytes);
+
+    restore_flags(flags);
+    return nbytes;
+}
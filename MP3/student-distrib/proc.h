@@ -0,0 +1,39 @@
+/*
+    proc.h header file
+    per-process accounting and the "proc" pseudo file
+*/
+
+#ifndef _PROC_H
+#define _PROC_H
+
+#include "types.h"
+
+#define PROC_FILE_NAME      "proc"
+#define PROC_BUF_SIZE       8192
+#define PROC_COL_WIDTH      8
+#define PROC_PERCENT        100
+/* system calls in one row of the system call table, so that a row fits the console */
+#define PROC_SYSCALL_ROW    9
+
+/* ticks since the first PIT interrupt */
+extern uint32_t proc_uptime;
+
+/* register the proc pseudo file */
+void proc_init();
+
+/* account a PIT tick to the current process */
+void proc_tick();
+
+/* account a timer tick of this processor to its current process */
+void proc_cpu_tick();
+
+/* account a system call to the current process, called by the system call linkage */
+void proc_syscall(uint32_t num);
+
+/* account a page fault to the current process */
+void proc_page_fault();
+
+/* generate the content of the proc pseudo file and read part of it */
+int32_t proc_read(uint32_t offset, uint8_t* buf, uint32_t nbytes);
+
+#endif
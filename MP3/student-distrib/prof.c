@@ -0,0 +1,202 @@
+/*
+    prof
+    sampling profiler. Every PIT interrupt, and every local timer interrupt of the application
+    processors, records the interrupted instruction pointer and process into a histogram,
+    which is dumped through the "prof" pseudo file and symbolized on the host against bootimg
+    and the programs in fsdir.
+*/
+
+#include "prof.h"
+#include "syscall.h"
+#include "schedule.h"
+#include "filesys.h"
+#include "lib.h"
+
+/* name of the kernel image, symbolized against bootimg */
+#define PROF_KERNEL_NAME    "bootimg"
+
+/* the histogram being recorded into */
+static prof_hist_t prof_hist;
+/* copy of the histogram served by the prof pseudo file */
+static prof_hist_t prof_dump;
+
+/*
+ * prof_init
+ * DESCRIPTION: register the prof pseudo file, the profiler is stopped until a rate is written
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: "prof" appears in the directory
+ */
+void prof_init()
+{
+    prof_hist.magic = PROF_MAGIC;
+    prof_hist.hist_size = PROF_HIST_SIZE;
+    prof_hist.prog_num = 1;
+    strncpy((int8_t*)prof_hist.prog_name[PROF_PROG_KERNEL], PROF_KERNEL_NAME, PROF_NAME_LEN);
+    pseudo_register(PROF_FILE_NAME, prof_read, prof_write);
+}
+
+/*
+ * prof_prog
+ * DESCRIPTION: find the index of a program name, adding it if it is new
+ * INPUT: name -- program name
+ * OUTPUT: none
+ * RETURN: program index, -1 if the table is full
+ * SIDE AFFECTS: program table may be changed
+ */
+static int32_t prof_prog(const uint8_t* name)
+{
+    uint32_t i;     /* loop index for programs */
+
+    for (i = PROF_PROG_KERNEL + 1; i < prof_hist.prog_num; i++)
+    {
+        if (!strncmp((int8_t*)prof_hist.prog_name[i], (int8_t*)name, PROF_NAME_LEN))
+            return i;
+    }
+
+    if (prof_hist.prog_num >= PROF_PROG_NUM)
+        return -1;
+    strncpy((int8_t*)prof_hist.prog_name[i], (int8_t*)name, PROF_NAME_LEN);
+    return prof_hist.prog_num++;
+}
+
+/*
+ * prof_sample
+ * DESCRIPTION: record the interrupted instruction pointer and process into the histogram,
+ *              called by the PIT handler and by the local timer of application processors with
+ *              interrupts disabled. Those timers are not sped up with the PIT, the application
+ *              processors are sampled PIT_FREQ times per second whatever the rate.
+ * INPUT: context -- hardware context of the interrupted code
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: histogram changed
+ */
+void prof_sample(hw_context_t* context)
+{
+    uint32_t i;             /* loop index for probing           */
+    uint32_t idx;           /* bucket index                     */
+    uint32_t pid;           /* sampled process                  */
+    int32_t prog;           /* sampled program index            */
+    prof_bucket_t* bucket;  /* probed bucket                    */
+
+    if (prof_hist.rate == 0)
+        return;
+
+    prof_hist.samples++;
+    pid = (curr_pid == -1) ? 0 : curr_pid;
+
+    /* user samples are symbolized against the program that is running */
+    if ((context->cs & SIGNAL_CPL_MASK) == 0 || curr_pid == -1)
+        prog = PROF_PROG_KERNEL;
+    else if ((prog = prof_prog(get_pcb_ptr(curr_pid)->name)) == -1)
+    {
+        prof_hist.dropped++;
+        return;
+    }
+
+    /* open addressing with linear probing */
+    idx = ((context->eip >> 2) ^ (context->eip >> 13) ^ (pid * 0x9E37)) & (PROF_HIST_SIZE - 1);
+    for (i = 0; i < PROF_PROBE_MAX; i++, idx = (idx + 1) & (PROF_HIST_SIZE - 1))
+    {
+        bucket = &prof_hist.bucket[idx];
+        if (bucket->count == 0)
+        {
+            bucket->eip = context->eip;
+            bucket->pid = pid;
+            bucket->prog = prog;
+        }
+        else if (bucket->eip != context->eip || bucket->pid != pid || bucket->prog != prog)
+            continue;
+        bucket->count++;
+        return;
+    }
+
+    prof_hist.dropped++;
+}
+
+/*
+ * prof_start
+ * DESCRIPTION: clear the histogram and start sampling at the given rate, or stop sampling.
+ *              The rate is rounded down to a multiple of PIT_FREQ, see pit_set_mult.
+ * INPUT: rate -- sampling rate in Hz, PIT_FREQ to PIT_FREQ * PIT_MAX_MULT, 0 to stop
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 for fail
+ * SIDE AFFECTS: histogram cleared when started, PIT reprogrammed
+ */
+int32_t prof_start(uint32_t rate)
+{
+    uint32_t flags;     /* saved flags                      */
+    uint32_t mult;      /* PIT interrupts per scheduler tick */
+
+    /* stop, keep the histogram for reading */
+    if (rate == 0)
+    {
+        prof_hist.rate = 0;
+        return pit_set_mult(1);
+    }
+
+    /* sanity check */
+    mult = rate / PIT_FREQ;
+    if (mult == 0 || mult > PIT_MAX_MULT)
+        return -1;
+
+    cli_and_save(flags);
+    memset(prof_hist.bucket, 0, sizeof(prof_hist.bucket));
+    prof_hist.samples = 0;
+    prof_hist.dropped = 0;
+    prof_hist.prog_num = PROF_PROG_KERNEL + 1;
+    prof_hist.rate = mult * PIT_FREQ;
+    pit_set_mult(mult);
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * prof_read
+ * DESCRIPTION: read routine of the prof pseudo file. The content is a prof_hist_t,
+ *              copied from the live histogram when reading at offset 0.
+ * INPUT: offset -- byte offset in the file
+ *        buf -- buffer to be filled in
+ *        nbytes -- number of bytes needed to be copied
+ * OUTPUT: none
+ * RETURN: number of copied bytes
+ * SIDE AFFECTS: dump copy changed at offset 0
+ */
+int32_t prof_read(uint32_t offset, uint8_t* buf, uint32_t nbytes)
+{
+    uint32_t flags;     /* saved flags */
+
+    if (offset == 0)
+    {
+        cli_and_save(flags);
+        memcpy(&prof_dump, &prof_hist, sizeof(prof_hist_t));
+        restore_flags(flags);
+    }
+
+    if (offset >= sizeof(prof_hist_t))
+        return 0;
+    if (nbytes > sizeof(prof_hist_t) - offset)
+        nbytes = sizeof(prof_hist_t) - offset;
+    memcpy(buf, (uint8_t*)&prof_dump + offset, nbytes);
+    return nbytes;
+}
+
+/*
+ * prof_write
+ * DESCRIPTION: write routine of the prof pseudo file, takes a 4-byte sampling rate in Hz
+ *              like rtc_write, 0 stops the profiler
+ * INPUT: buf -- the rate
+ *        nbytes -- must be 4
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 for fail
+ * SIDE AFFECTS: see prof_start
+ */
+int32_t prof_write(const uint8_t* buf, uint32_t nbytes)
+{
+    /* sanity check */
+    if (nbytes != sizeof(int32_t))
+        return -1;
+
+    return prof_start(*(uint32_t*)buf);
+}
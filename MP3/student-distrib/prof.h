@@ -0,0 +1,55 @@
+/*
+    prof.h header file
+    PIT driven sampling profiler, see MP3/tools/prof_report.py
+*/
+
+#ifndef _PROF_H
+#define _PROF_H
+
+#include "types.h"
+#include "signal.h"
+
+#define PROF_FILE_NAME      "prof"
+#define PROF_MAGIC          0x31465250  /* "PRF1" */
+#define PROF_HIST_SIZE      2048        /* number of buckets, must be a power of 2 */
+#define PROF_PROBE_MAX      16          /* buckets tried before a sample is dropped */
+#define PROF_PROG_NUM       16          /* number of distinct programs in one profile */
+#define PROF_PROG_KERNEL    0           /* program index of kernel samples */
+#define PROF_NAME_LEN       32
+
+/* one histogram bucket, count samples at the same address of the same process */
+typedef struct prof_bucket_t {
+    uint32_t eip;           /* sampled instruction pointer          */
+    uint16_t pid;           /* process running when sampled         */
+    uint16_t prog;          /* index in prog_name, 0 for the kernel */
+    uint32_t count;         /* 0 for an empty bucket                */
+} __attribute__((packed)) prof_bucket_t;
+
+/* the histogram, which is also the exact content of the prof pseudo file */
+typedef struct prof_hist_t {
+    uint32_t magic;         /* PROF_MAGIC                               */
+    uint32_t rate;          /* sampling rate in Hz, 0 when stopped      */
+    uint32_t samples;       /* samples taken                            */
+    uint32_t dropped;       /* samples dropped because of a full table  */
+    uint32_t prog_num;      /* used entries of prog_name                */
+    uint32_t hist_size;     /* PROF_HIST_SIZE                           */
+    uint8_t prog_name[PROF_PROG_NUM][PROF_NAME_LEN + 1];    /* program names, kernel first */
+    prof_bucket_t bucket[PROF_HIST_SIZE];
+} __attribute__((packed)) prof_hist_t;
+
+/* register the prof pseudo file */
+void prof_init();
+
+/* record the interrupted instruction pointer, called by the PIT handler */
+void prof_sample(hw_context_t* context);
+
+/* start the profiler at the given rate, 0 to stop it */
+int32_t prof_start(uint32_t rate);
+
+/* read the prof pseudo file, a frozen copy of the histogram taken at offset 0 */
+int32_t prof_read(uint32_t offset, uint8_t* buf, uint32_t nbytes);
+
+/* write the prof pseudo file, a 4-byte sampling rate in Hz like rtc_write */
+int32_t prof_write(const uint8_t* buf, uint32_t nbytes);
+
+#endif
@@ -4,6 +4,10 @@
 #include "i8259.h"
 #include "tests.h"
 #include "terminal.h"
+#include "trace.h"
+#include "smp.h"
+#include "schedule.h"
+#include "blink.h"
 
 /* Reference: https://wiki.osdev.org/RTC */
 
@@ -119,6 +123,11 @@ void rtc_handler() {
     inb(RTC_DATA); // throw the contents in register C to reset status bits in register C
 
     rtc_counter++; // update counter
+    TRACE(TRACE_RTC, rtc_counter, 0);
+    /* processes in rtc_read check whether their period is over */
+    sched_wakeup(&rtc_counter);
+    /* animations written to the blink file */
+    blink_tick();
 
     /* send EOI to indicate the handler finishes the work*/
     send_eoi(RTC_IRQ);
@@ -155,7 +164,7 @@ int32_t rtc_close(int32_t fd)
 
     /* set default frequency and clear virtual rtc ratio array */
     rtc_set_fre(RTC_MAX_FRE);
-    virt_rtc_ratio[curr_pid] = RTC_MAX_FRE/RTC_MAX_FRE;
+    virt_rtc_ratio[curr_mm] = RTC_MAX_FRE/RTC_MAX_FRE;
 
     /* return 0 for success*/
     return 0;
@@ -171,19 +180,25 @@ int32_t rtc_close(int32_t fd)
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes)
 {
-    /* record the current rtc_interrupt_status */
-    int32_t current_status = rtc_counter;
+    uint32_t target;    /* rtc counter at the end of the wait */
     /* calculate wait period, because there is scheduling, divide it by the number of running terminals */
-    int32_t wait_period = virt_rtc_ratio[curr_pid] / running_term_num;
+    int32_t wait_period = virt_rtc_ratio[curr_mm] / running_term_num;
 
     /* if wait period is too short, set it to 1 */
     if(wait_period == 0)
         wait_period = 1;
 
-    /* if next rtc interrupt doesn't come, wait */
-    while(current_status == rtc_counter);
-    /* wait for several period */
-    while(rtc_counter % wait_period);
+    /* no interrupt may come between the check and the sleep */
+    cli();
+
+    /* wait for the next rtc interrupt that ends a period, the process may only be scheduled */
+    /* some interrupts after it, so it is compared by distance and not by equality         */
+    target = rtc_counter + wait_period - rtc_counter % wait_period;
+    while((int32_t)(rtc_counter - target) < 0)
+        sched_sleep(&rtc_counter);
+    TRACE(TRACE_WAKEUP, TRACE_RTC, 0);
+
+    sti();
 
     /* return 0 for success*/
     return 0;
@@ -222,7 +237,7 @@ int32_t rtc_write(int32_t fd, void* buf, int32_t nbytes)
 
     /* set freqency ratio, i.e. wait periods for virtualized rtc read */
     /* e.g. if we want 512 Hz freqency, wait every 1024/512 = 2 interrupt period */
-    virt_rtc_ratio[curr_pid] = RTC_MAX_FRE / virt_freq;
+    virt_rtc_ratio[curr_mm] = RTC_MAX_FRE / virt_freq;
 
     /* success, return 0 */
     return 0;
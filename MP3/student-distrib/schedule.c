@@ -1,11 +1,32 @@
 #include "schedule.h"
 #include "terminal.h"
 #include "syscall.h"
+#include "signal.h"
+#include "proc.h"
+#include "trace.h"
+#include "prof.h"
+#include "softirq.h"
+#include "smp.h"
+#include "apic.h"
+#include "bootlog.h"
+#include "vga.h"
 #include "x86_desc.h"
 #include "lib.h"
+#include "fpu.h"
+#include "thread.h"
 
 /* Reference: https://wiki.osdev.org/Programmable_Interval_Timer */
 
+/*
+ * per-processor run queues of processes ready to run, linked through pcb_t.rq_next.
+ * A process is running on one processor, waiting in exactly one run queue, sleeping
+ * (sched_sleep) or waiting in execute for its child. They are protected by the kernel lock.
+ */
+runqueue_t runqueues[SMP_MAX_CPU];
+
+static uint32_t pit_mult = 1;       /* PIT interrupts per scheduler tick            */
+static uint32_t pit_subtick = 0;    /* PIT interrupts since the last scheduler tick */
+
 /*
  * pit_init
  * DESCRIPTION: initialize the PIT, see schedule.h file for command details
@@ -16,26 +37,56 @@
  */
 void pit_init()
 {
+    /* program the PIT at PIT_FREQ */
+    pit_set_mult(1);
+    /* enable interrupt */
+    enable_irq(PIT_IRQ);
+    return;
+}
+
+/*
+ * pit_set_mult
+ * DESCRIPTION: run the PIT mult times faster than PIT_FREQ, only every mult-th interrupt
+ *              is a scheduler tick so time slices and accounting stay at PIT_FREQ.
+ *              Used by the profiler to sample faster.
+ * INPUT: mult -- PIT interrupts per scheduler tick, 1 to PIT_MAX_MULT
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 for fail
+ * SIDE AFFECTS: PIT reprogrammed
+ */
+int32_t pit_set_mult(uint32_t mult)
+{
+    uint32_t flags;     /* saved flags          */
+    uint32_t latch;     /* PIT period in cycles */
+
+    /* sanity check */
+    if (mult == 0 || mult > PIT_MAX_MULT)
+        return -1;
+
+    latch = (PIT_MAX_FREQ + PIT_FREQ * mult / 2) / (PIT_FREQ * mult);
+
+    cli_and_save(flags);
     /* sent command to pit */
     outb(PIT_CMD, PIT_CMD_PORT);
     /* sent least significant bits of period */
-    outb(PIT_LATCH && PIT_BITMASK, PIT_CHANNEL_0);
+    outb(latch & PIT_BITMASK, PIT_CHANNEL_0);
     /* sent most significant bits of period */
-    outb(PIT_LATCH >> PIT_MSB_OFFSET, PIT_CHANNEL_0);
-    /* enable interrupt */
-    enable_irq(PIT_IRQ);
-    return;
+    outb(latch >> PIT_MSB_OFFSET, PIT_CHANNEL_0);
+    pit_mult = mult;
+    pit_subtick = 0;
+    restore_flags(flags);
+    return 0;
 }
 
 /*
  * pit_handler
- * DESCRIPTION: PIT handler, call scheduler to do scheduling
- * INPUT: none
+ * DESCRIPTION: PIT handler, take a profiler sample and call scheduler to do scheduling
+ * INPUT: context -- hardware context of the interrupted code
  * OUTPUT: none
  * RETURN: none
  * SIDE AFFECTS: none
  */
-void pit_handler()
+void pit_handler(hw_context_t* context)
 {
     /* 
      * this send eoi CANNOT be put after scheduler because when the new executed 
@@ -44,86 +95,418 @@ void pit_handler()
      * fail because PIT has the highest priority.
      */
     send_eoi(PIT_IRQ);
+    TRACE(TRACE_PIT, 0, 0);
+    /* sample the interrupted code */
+    prof_sample(context);
+    /* the PIT may run faster for the profiler, only every pit_mult-th interrupt is a tick */
+    if (++pit_subtick < pit_mult)
+        return;
+    pit_subtick = 0;
+    /* account the tick to the current process */
+    proc_tick();
+    /* calibrate the TSC for the boot timeline */
+    boot_tick();
+    /* count time for ALARM signal */
+    signal_tick();
     /* call scheduler */
     scheduler();
 }
 
 /*
- * scheduler
- * DESCRIPTION: do scheduling, switch between current running processes in different terminals
- * INPUT: none
+ * lapic_timer_handler
+ * DESCRIPTION: local APIC timer handler of application processors, the PIT only interrupts
+ *              the bootstrap processor, so this is their scheduler tick
+ * INPUT: context -- hardware context of the interrupted code
  * OUTPUT: none
  * RETURN: none
  * SIDE AFFECTS: none
  */
-void scheduler()
+void lapic_timer_handler(hw_context_t* context)
+{
+    lapic_eoi();
+    this_cpu()->ticks++;
+    /* sample the interrupted code, at the scheduler tick rate on these processors */
+    prof_sample(context);
+    /* account the tick to the current process */
+    proc_cpu_tick();
+    /* call scheduler */
+    scheduler();
+}
+
+/*
+ * rq_enqueue
+ * DESCRIPTION: put a process at the tail of a processor's run queue
+ * INPUT: cpu_id -- processor
+ *        pid -- process ready to run, not running and not queued anywhere
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: run queue changed
+ */
+void rq_enqueue(uint32_t cpu_id, uint32_t pid)
+{
+    runqueue_t* rq = &runqueues[cpu_id];    /* run queue */
+
+    if (rq->nr == 0)
+        rq->head = pid;
+    else
+        get_pcb_ptr(rq->tail)->rq_next = pid;
+    rq->tail = pid;
+    rq->nr++;
+}
+
+/*
+ * rq_dequeue
+ * DESCRIPTION: take the process at the head of a processor's run queue
+ * INPUT: cpu_id -- processor
+ * OUTPUT: none
+ * RETURN: process id, -1 if the queue is empty
+ * SIDE AFFECTS: run queue changed
+ */
+int32_t rq_dequeue(uint32_t cpu_id)
+{
+    runqueue_t* rq = &runqueues[cpu_id];    /* run queue        */
+    uint32_t pid;                           /* process taken    */
+
+    if (rq->nr == 0)
+        return -1;
+    pid = rq->head;
+    rq->head = get_pcb_ptr(pid)->rq_next;
+    rq->nr--;
+    return pid;
+}
+
+/*
+ * rq_steal
+ * DESCRIPTION: take the longest waiting process of the busiest processor, if it has at least
+ *              two runnable processes more than this one. Otherwise moving one would only
+ *              move the imbalance.
+ * INPUT: cpu_id -- processor looking for work
+ * OUTPUT: none
+ * RETURN: process id, -1 if there is nothing worth stealing
+ * SIDE AFFECTS: run queues and steal counters changed
+ */
+static int32_t rq_steal(uint32_t cpu_id)
+{
+    uint32_t i;             /* loop index for processors    */
+    uint32_t busiest;       /* processor with most load     */
+    uint32_t load;          /* runnable processes of one    */
+    uint32_t max_load;      /* runnable processes of busiest */
+    uint32_t self_load;     /* runnable processes of caller */
+    int32_t pid;            /* process stolen               */
+
+    self_load = runqueues[cpu_id].nr + (cpus[cpu_id].pid != -1);
+    busiest = cpu_id;
+    max_load = 0;
+    for (i = 0; i < cpu_num; i++)
+    {
+        load = runqueues[i].nr + (cpus[i].pid != -1);
+        if (i != cpu_id && runqueues[i].nr > 0 && load > max_load)
+        {
+            busiest = i;
+            max_load = load;
+        }
+    }
+    if (busiest == cpu_id || max_load < self_load + RQ_STEAL_IMBALANCE)
+        return -1;
+
+    pid = rq_dequeue(busiest);
+    runqueues[busiest].stolen++;
+    runqueues[cpu_id].steals++;
+    return pid;
+}
+
+/*
+ * rq_tick
+ * DESCRIPTION: update the load statistics of the calling processor on its timer tick. The load is
+ *              the number of runnable processes (running and queued) averaged over about a second.
+ * INPUT: cpu -- calling processor
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: run queue statistics changed
+ */
+static void rq_tick(cpu_t* cpu)
 {
-    int i;                          /* loop index for finding new process' terminal */
-    pcb_t* curr_pcb;                /* current running process' pcb                 */
+    runqueue_t* rq = &runqueues[cpu->id];   /* run queue of this processor  */
+    uint32_t load;                          /* runnable processes now       */
+
+    load = rq->nr + (cpu->pid != -1);
+    rq->ticks++;
+    if (cpu->pid == -1)
+        rq->idle_ticks++;
+    rq->load_avg = (rq->load_avg * RQ_LOAD_EXP + load * RQ_LOAD_FIXED_1 * (RQ_LOAD_FIXED_1 - RQ_LOAD_EXP)) >> RQ_LOAD_FSHIFT;
+}
+
+/*
+ * schedule
+ * DESCRIPTION: switch this processor to the next process of its run queue, or one stolen from the
+ *              busiest processor. A runnable current process goes to the tail of the queue, a
+ *              sleeping or exited one stays out of it. With nothing else to run a runnable process
+ *              keeps the processor, any other gives it to the idle loop (cpu_idle), which is started on
+ *              its own stack the first time, and so is a new thread (thread_start). A thread runs
+ *              with the page tables and files of its program's leader. The context saved and
+ *              restored is the one of the caller's frame: the timer handler, sched_sleep or the idle loop.
+ *              Called with interrupts disabled and the kernel lock held.
+ * INPUT: cpu -- this processor
+ * OUTPUT: none
+ * RETURN: none, maybe much later when the current context is switched back in
+ * SIDE AFFECTS: run queues, paging and current process changed
+ */
+static void schedule(cpu_t* cpu)
+{
+    pcb_t* curr_pcb;                /* current running process' pcb, NULL when idle */
     pcb_t* next_pcb;                /* next process' pcb                            */
-    uint32_t curr_process_term_id;  /* current running process' terminal id         */
     uint32_t next_term_id;          /* next process' terminal id                    */
-    uint32_t next_pid;              /* next process id                              */
+    int32_t next_pid;               /* next process id, -1 for the idle loop        */
+    uint32_t next_ebp = 0;          /* context switched to, a new thread has none   */
+    uint32_t next_esp = 0;
 
-    /* if curr_pid is -1, which means the first process has not executed, just return */
-    /* this cannot be removed because if it is removed, scheduler would switch to an inexistent */
-    /* place and mess every thing up when the first shell hasn't been executed                  */
-    if(curr_pid == -1)
-        return;
+    curr_pcb = (curr_pid == -1) ? NULL : get_pcb_ptr(curr_pid);
 
-    /* get current process ralevent info */
-    curr_pcb = get_pcb_ptr(curr_pid);
-    curr_process_term_id = curr_pcb->term_id;
-    next_term_id = (curr_process_term_id + 1)%TERMINAL_NUM;
-
-    /* get next process's terminal's id */
-    for(i = 0; i < TERMINAL_NUM && !terminals[next_term_id].is_running; i++)
-        next_term_id = (next_term_id + 1)%TERMINAL_NUM;
-    
-    /* if process does not change, which means there is only one process running, just return */
-    if(next_term_id == curr_process_term_id)
-        return;
+    /* take the next process of this processor, or steal one */
+    if((next_pid = rq_dequeue(cpu->id)) == -1 && (next_pid = rq_steal(cpu->id)) == -1){
+        /* only a process going to sleep has to give the processor up */
+        if(curr_pcb == NULL || curr_pcb->state == PROC_RUNNABLE)
+            return;
+    }
 
-    /* get next process's id */
-    next_pid = terminals[next_term_id].curr_pid;
+    /* the current process waits at the tail */
+    if(curr_pcb != NULL && curr_pcb->state == PROC_RUNNABLE)
+        rq_enqueue(cpu->id, curr_pid);
+    runqueues[cpu->id].switches++;
+    /* the FPU state goes with the process if it used it, the next one traps on first use */
+    fpu_switch(cpu, curr_pcb);
 
-    /* set paging */
-    set_paging(next_pid);
+    if(next_pid != -1){
+        /* get next process's pcb and terminal */
+        next_pcb = get_pcb_ptr(next_pid);
+        next_term_id = next_pcb->term_id;
 
-    /* remap video memory */
-    if(next_term_id == curr_term_id)
-        vid_remap((uint8_t *)VIDEO);
-    else
-        vid_remap(terminals[next_term_id].vid_buf);
+        /* set paging, a thread uses its leader's */
+        set_paging(next_pcb->mm_pid);
 
-    /* get next process's pcb */
-    next_pcb = get_pcb_ptr(next_pid);
+        /* remap video memory */
+        if(next_term_id == curr_term_id)
+            vid_remap((uint8_t *)VIDEO);
+        else
+            vid_remap(terminals[next_term_id].vid_buf);
+        /* only the owner of a graphics mode sees the framebuffer */
+        vga_map(next_pcb->mm_pid);
 
-    /* set current fd array */
-    cur_fd_array = next_pcb->fd_array;
+        /* set current fd array */
+        cur_fd_array = get_pcb_ptr(next_pcb->mm_pid)->fd_array;
 
-    /* set kernel stack pointer */
-    tss.esp0 = KS_BASE_ADDR - KS_SIZE * next_pid - sizeof(int32_t);
+        /* set kernel stack pointer */
+        cpu->tss->esp0 = KS_BASE_ADDR - KS_SIZE * next_pid - sizeof(int32_t);
+    }
 
     /* update current pid */
+    TRACE(TRACE_SCHED, next_pid, 0);
     curr_pid = next_pid;
 
-    /* store current's esp, ebp */
-    asm volatile("                                \n\
-        movl %%ebp, %0                            \n\
-        movl %%esp, %1                            \n\
-        "
-        : "=r"(curr_pcb->ebp), "=r"(curr_pcb->esp)
-        :
-    );
+    /* save the current context, the kernel lock nesting goes with it */
+    if(curr_pcb != NULL){
+        /* account the switch to the process being switched out */
+        curr_pcb->acct.ctx_switches++;
+        curr_pcb->lock_depth = cpu->lock_depth;
+        asm volatile("                                \n\
+            movl %%ebp, %0                            \n\
+            movl %%esp, %1                            \n\
+            "
+            : "=r"(curr_pcb->ebp), "=r"(curr_pcb->esp)
+            :
+        );
+    }else{
+        cpu->idle_lock_depth = cpu->lock_depth;
+        asm volatile("                                \n\
+            movl %%ebp, %0                            \n\
+            movl %%esp, %1                            \n\
+            "
+            : "=r"(cpu->idle_ebp), "=r"(cpu->idle_esp)
+            :
+        );
+    }
 
-    /* get next process's esp, ebp */
+    if(next_pid == -1){
+        /* the first time, the idle loop starts on its own stack outside the kernel lock */
+        if(!cpu->idle_on){
+            cpu->idle_on = 1;
+            kernel_release();
+            asm volatile("                            \n\
+                movl %0, %%esp                        \n\
+                xorl %%ebp, %%ebp                     \n\
+                jmp *%1                               \n\
+                "
+                :
+                : "r"(cpu->idle_stack), "r"(cpu_idle)
+            );
+        }
+        cpu->lock_depth = cpu->idle_lock_depth;
+        next_ebp = cpu->idle_ebp;
+        next_esp = cpu->idle_esp;
+    }else if(next_pcb->esp == 0){
+        /* a new thread starts on the top of its kernel stack, it gives the kernel lock up itself */
+        asm volatile("                            \n\
+            movl %0, %%esp                        \n\
+            xorl %%ebp, %%ebp                     \n\
+            jmp *%1                               \n\
+            "
+            :
+            : "r"(cpu->tss->esp0), "r"(thread_start)
+        );
+    }else{
+        cpu->lock_depth = next_pcb->lock_depth;
+        next_ebp = next_pcb->ebp;
+        next_esp = next_pcb->esp;
+    }
+
+    /* get next context's esp, ebp */
     asm volatile("                                \n\
         movl %0, %%ebp                            \n\
         movl %1, %%esp                            \n\
         "
         :
-        : "r"(next_pcb->ebp), "r"(next_pcb->esp)
+        : "r"(next_ebp), "r"(next_esp)
     );
 }
 
+/*
+ * scheduler
+ * DESCRIPTION: timer tick part of scheduling: update the load statistics and switch to the next
+ *              process, see schedule. An idle application processor picks up work as soon as
+ *              another processor has a backlog.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void scheduler()
+{
+    cpu_t* cpu;                     /* this processor */
+
+    cpu = this_cpu();
+
+    /* if curr_pid is -1 before the idle loop started, the first process has not executed, just return */
+    /* this cannot be removed because if it is removed, scheduler would switch to an inexistent */
+    /* place and mess every thing up when the first shell hasn't been executed                  */
+    if(curr_pid == -1 && !cpu->idle_on)
+        return;
+
+    rq_tick(cpu);
+
+    /* a bottom half is running in the current context, let it finish first */
+    if(softirq_busy())
+        return;
+
+    schedule(cpu);
+}
+
+/*
+ * sched_sleep
+ * DESCRIPTION: put the current process to sleep until sched_wakeup is called for chan (or
+ *              sched_wakeup_pid for it) and it is scheduled again. The caller checks its wait
+ *              condition with interrupts disabled and calls this in a loop until it holds, so a
+ *              wakeup cannot come between the check and the sleep.
+ * INPUT: chan -- anything identifying the event, e.g. the terminal waited for
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: other processes or the idle loop run in the meantime
+ */
+void sched_sleep(void* chan)
+{
+    uint32_t flags;     /* saved eflags     */
+    pcb_t* pcb;         /* current process  */
+
+    cli_and_save(flags);
+    pcb = get_pcb_ptr(curr_pid);
+    pcb->state = PROC_SLEEPING;
+    pcb->wait_chan = chan;
+    schedule(this_cpu());
+    restore_flags(flags);
+}
+
+/*
+ * sched_exit
+ * DESCRIPTION: switch away from a process that halted without a parent to return to, e.g. the
+ *              base shell of a terminal that is closed, or a thread. Its pid must be free already,
+ *              or be freed by thread_join, the context saved for it is never switched back to.
+ *              Called with interrupts disabled.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: never returns
+ * SIDE AFFECTS: other processes or the idle loop run
+ */
+void sched_exit()
+{
+    get_pcb_ptr(curr_pid)->state = PROC_EXITED;
+    schedule(this_cpu());
+}
+
+/*
+ * sched_wakeup_pid
+ * DESCRIPTION: make a sleeping process runnable on this processor's run queue, it checks its wait
+ *              condition again when it runs. A process that is not sleeping is left alone.
+ * INPUT: pid -- process id
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: run queue changed
+ */
+void sched_wakeup_pid(uint32_t pid)
+{
+    pcb_t* pcb;         /* the process */
+
+    if (pid >= NUM_PROCESS || !is_pid_used(pid))
+        return;
+    pcb = get_pcb_ptr(pid);
+    if (pcb->state != PROC_SLEEPING)
+        return;
+    pcb->state = PROC_RUNNABLE;
+    pcb->wait_chan = NULL;
+    rq_enqueue(this_cpu()->id, pid);
+}
+
+/*
+ * sched_wakeup
+ * DESCRIPTION: wake every process sleeping on chan, called by interrupt handlers and bottom halves
+ * INPUT: chan -- event, as given to sched_sleep
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: run queue changed
+ */
+void sched_wakeup(void* chan)
+{
+    uint32_t pid;       /* loop index for processes */
+
+    for (pid = 0; pid < NUM_PROCESS; pid++)
+    {
+        if (is_pid_used(pid) && get_pcb_ptr(pid)->state == PROC_SLEEPING && get_pcb_ptr(pid)->wait_chan == chan)
+            sched_wakeup_pid(pid);
+    }
+}
+
+/*
+ * cpu_idle
+ * DESCRIPTION: idle loop of a processor, the context that runs when none of its processes can.
+ *              It halts with interrupts enabled, and after every interrupt looks for a process
+ *              the interrupt woke up, so that a wakeup does not wait for the next timer tick.
+ *              An idle processor only uses power for the interrupts it takes, and the host of a
+ *              virtual machine gets its core back.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: never returns
+ * SIDE AFFECTS: none
+ */
+void cpu_idle()
+{
+    cpu_t* cpu;     /* this processor */
+
+    while (1)
+    {
+        cli();
+        cpu = this_cpu();
+        kernel_enter();
+        schedule(cpu);
+        kernel_exit();
+        /* sti takes effect after the next instruction, no interrupt comes before hlt */
+        asm volatile ("sti; hlt");
+    }
+}
@@ -2,6 +2,8 @@
 #define _SCHEDULE_H
 
 #include "i8259.h"
+#include "signal.h"
+#include "smp.h"
 
 #define PIT_CMD_PORT        0x43
 #define PIT_CHANNEL_0       0x40
@@ -12,17 +14,67 @@
 #define PIT_CMD             ((PIT_CHANNEL << 6) | (PIT_AC_MODE << 4) | (PIT_OP_MODE << 1) | (PIT_BINARY_MODE))
 #define PIT_FREQ            100         /* PIT frequency in Hz              */
 #define PIT_MAX_FREQ        1193180     /* PIT max freqncy in Hz            */
-#define PIT_LATCH           ((int)((PIT_MAX_FREQ + PIT_FREQ / 2) / PIT_FREQ))   /* number of periods to wait */
 #define PIT_BITMASK         0xff        /* mask most significant bits       */
 #define PIT_MSB_OFFSET      8
+#define PIT_MAX_MULT        100         /* PIT runs at most 100 times faster than PIT_FREQ */
+
+/* a processor steals when the busiest one has at least this many more runnable processes */
+#define RQ_STEAL_IMBALANCE  2
+/* load average in fixed point, decayed every tick by exp(-1/PIT_FREQ), i.e. over about a second */
+#define RQ_LOAD_FSHIFT      11
+#define RQ_LOAD_FIXED_1     (1 << RQ_LOAD_FSHIFT)
+#define RQ_LOAD_EXP         2028
+
+/* run queue and load statistics of one processor */
+typedef struct runqueue_t {
+    uint32_t head;          /* first process to run, valid if nr > 0    */
+    uint32_t tail;          /* last process, valid if nr > 0            */
+    uint32_t nr;            /* number of queued processes               */
+    uint32_t load_avg;      /* runnable processes, fixed point average  */
+    uint32_t ticks;         /* scheduler ticks                          */
+    uint32_t idle_ticks;    /* ticks spent in the idle loop             */
+    uint32_t switches;      /* context switches                         */
+    uint32_t steals;        /* processes taken from other processors    */
+    uint32_t stolen;        /* processes taken by other processors      */
+} runqueue_t;
+
+/* run queues by processor id */
+extern runqueue_t runqueues[SMP_MAX_CPU];
 
 /* initialize pit */
 extern void pit_init();
 
+/* set the number of PIT interrupts per scheduler tick */
+extern int32_t pit_set_mult(uint32_t mult);
+
 /* pit handler */
-extern void pit_handler();
+extern void pit_handler(hw_context_t* context);
+
+/* local APIC timer handler of application processors */
+extern void lapic_timer_handler(hw_context_t* context);
+
+/* put a process at the tail of a processor's run queue */
+void rq_enqueue(uint32_t cpu_id, uint32_t pid);
+
+/* take the process at the head of a processor's run queue */
+int32_t rq_dequeue(uint32_t cpu_id);
 
 /* do scheduling, switch between current running processes in different terminals */
 void scheduler();
 
+/* put the current process to sleep until chan is woken up */
+void sched_sleep(void* chan);
+
+/* wake every process sleeping on chan */
+void sched_wakeup(void* chan);
+
+/* wake a sleeping process, e.g. for a signal */
+void sched_wakeup_pid(uint32_t pid);
+
+/* give the processor up for good, the current process has halted */
+void sched_exit();
+
+/* idle loop of a processor, halts until there is something to run */
+void cpu_idle();
+
 #endif
@@ -0,0 +1,289 @@
+#include "serial.h"
+#include "filesys.h"
+#include "terminal.h"
+#include "i8259.h"
+#include "softirq.h"
+#include "lib.h"
+
+/* transmit ring, filled by serial_putc and drained into the FIFO by the interrupt handler */
+static uint8_t tx_ring[SERIAL_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;   /* next slot to fill, free running  */
+static volatile uint32_t tx_tail = 0;   /* next byte to send, free running  */
+/* receive ring, filled by the interrupt handler */
+static uint8_t rx_ring[SERIAL_RX_RING_SIZE];
+static volatile uint32_t rx_head = 0;   /* next slot to fill, free running  */
+static volatile uint32_t rx_tail = 0;   /* next byte to consume, free running */
+/* terminal taking the received characters as keyboard input */
+static int32_t serial_term = SERIAL_NO_TERM;
+/* interrupt enable register value, the transmit interrupt is only on while the ring is not empty */
+static uint8_t serial_ier = 0;
+
+static void serial_rx_action(uint32_t data);
+/* bottom half feeding received characters to the attached terminal */
+static tasklet_t serial_rx_tasklet = { NULL, serial_rx_action, 0, 0 };
+
+/*
+ * serial_rx_action
+ * DESCRIPTION: bottom half of the receive interrupt, run received characters through the
+ *              attached terminal's line discipline with interrupts enabled
+ * INPUT: data -- not used
+ * OUTPUT: echo on COM1
+ * RETURN: none
+ * SIDE AFFECTS: receive ring drained, terminal's input buffer changed
+ */
+static void serial_rx_action(uint32_t data)
+{
+    uint8_t c;          /* received character   */
+    uint32_t flags;     /* saved eflags         */
+
+    while (1)
+    {
+        cli_and_save(flags);
+        if (serial_term == SERIAL_NO_TERM || rx_tail == rx_head)
+        {
+            restore_flags(flags);
+            return;
+        }
+        c = rx_ring[rx_tail & (SERIAL_RX_RING_SIZE - 1)];
+        rx_tail++;
+        restore_flags(flags);
+
+        terminal_input(serial_term, c);
+    }
+}
+
+/*
+ * serial_tx_kick
+ * DESCRIPTION: move bytes from the transmit ring into the FIFO if the transmitter is empty,
+ *              and keep the transmit interrupt enabled only while bytes are left in the ring.
+ *              Must be called with interrupts disabled.
+ * INPUT: none
+ * OUTPUT: bytes on COM1
+ * RETURN: none
+ * SIDE AFFECTS: transmit ring drained, IER changed
+ */
+static void serial_tx_kick()
+{
+    int i;          /* loop index for FIFO slots    */
+    uint8_t ier;    /* new interrupt enable value   */
+
+    if (inb(SERIAL_LSR) & SERIAL_LSR_THRE)
+    {
+        for (i = 0; i < SERIAL_FIFO_SIZE && tx_tail != tx_head; i++)
+        {
+            outb(tx_ring[tx_tail & (SERIAL_TX_RING_SIZE - 1)], SERIAL_DATA);
+            tx_tail++;
+        }
+    }
+
+    ier = (tx_tail != tx_head) ? (serial_ier | SERIAL_IER_THRE) : (serial_ier & ~SERIAL_IER_THRE);
+    if (ier != serial_ier)
+    {
+        serial_ier = ier;
+        outb(serial_ier, SERIAL_IER);
+    }
+}
+
+/*
+ * serial_init
+ * DESCRIPTION: initialize COM1 at 115200 baud 8N1, interrupt driven in both directions,
+ *              and register the serial pseudo file so that user programs can
+ *              write to it (e.g. benchmark results in a headless QEMU)
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: "serial" appears in the directory, COM1 line enabled on the PIC
+ */
+void serial_init()
+{
+    /* no interrupts while programming the UART */
+    outb(0, SERIAL_IER);
+    /* set baud rate divisor */
+    outb(SERIAL_LCR_DLAB, SERIAL_LCR);
+    outb(SERIAL_BAUD_DIVISOR & SERIAL_BYTE_MASK, SERIAL_DATA);
+    outb(SERIAL_BAUD_DIVISOR >> SERIAL_BYTE_SHIFT, SERIAL_IER);
+    /* 8N1, which also clears DLAB */
+    outb(SERIAL_LCR_8N1, SERIAL_LCR);
+    outb(SERIAL_FCR_ENABLE, SERIAL_FCR);
+    outb(SERIAL_MCR_DTR_RTS | SERIAL_MCR_OUT2, SERIAL_MCR);
+
+    /* receive interrupt always on, transmit interrupt turned on by serial_tx_kick */
+    serial_ier = SERIAL_IER_RDA;
+    outb(serial_ier, SERIAL_IER);
+    enable_irq(SERIAL_IRQ);
+
+    pseudo_register(SERIAL_FILE_NAME, serial_file_read, serial_file_write);
+}
+
+/*
+ * serial_putc
+ * DESCRIPTION: queue a character for COM1, "\n" is sent as "\r\n".
+ *              When the ring is full the oldest byte is sent by polling to make room,
+ *              so output is never dropped, even before interrupts are enabled.
+ * INPUT: c -- character
+ * OUTPUT: character on COM1
+ * RETURN: none
+ * SIDE AFFECTS: transmit ring changed
+ */
+void serial_putc(uint8_t c)
+{
+    uint32_t flags;     /* saved eflags */
+
+    if (c == '\n')
+        serial_putc('\r');
+
+    cli_and_save(flags);
+    if (tx_head - tx_tail == SERIAL_TX_RING_SIZE)
+    {
+        while (!(inb(SERIAL_LSR) & SERIAL_LSR_THRE));
+        outb(tx_ring[tx_tail & (SERIAL_TX_RING_SIZE - 1)], SERIAL_DATA);
+        tx_tail++;
+    }
+    tx_ring[tx_head & (SERIAL_TX_RING_SIZE - 1)] = c;
+    tx_head++;
+    serial_tx_kick();
+    restore_flags(flags);
+}
+
+/*
+ * serial_puts
+ * DESCRIPTION: queue a string for COM1
+ * INPUT: s -- string
+ * OUTPUT: string on COM1
+ * RETURN: none
+ * SIDE AFFECTS: see serial_putc
+ */
+void serial_puts(const int8_t* s)
+{
+    while (*s != '\0')
+        serial_putc(*s++);
+}
+
+/*
+ * serial_flush
+ * DESCRIPTION: transmit everything in the ring by polling, used where interrupts
+ *              will not come again (e.g. the kernel stops after an exception)
+ * INPUT: none
+ * OUTPUT: bytes on COM1
+ * RETURN: none
+ * SIDE AFFECTS: busy waits until the ring is empty
+ */
+void serial_flush()
+{
+    uint32_t flags;     /* saved eflags */
+
+    cli_and_save(flags);
+    while (tx_tail != tx_head)
+        serial_tx_kick();
+    restore_flags(flags);
+}
+
+/*
+ * serial_attach
+ * DESCRIPTION: choose the terminal whose input comes from COM1
+ * INPUT: term_id -- terminal id, SERIAL_NO_TERM to keep received characters for the pseudo file
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: received characters go to another place
+ */
+void serial_attach(int32_t term_id)
+{
+    uint32_t flags;     /* saved eflags */
+
+    cli_and_save(flags);
+    serial_term = term_id;
+    restore_flags(flags);
+}
+
+/*
+ * serial_handler
+ * DESCRIPTION: COM1 interrupt handler. Received bytes go into the receive ring, and to the
+ *              attached terminal through the bottom half if there is one. An empty transmitter
+ *              is refilled from the transmit ring.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: rings changed, tasklet may be scheduled
+ */
+void serial_handler()
+{
+    uint8_t iir;    /* interrupt identification */
+
+    send_eoi(SERIAL_IRQ);
+
+    while (!((iir = inb(SERIAL_IIR)) & SERIAL_IIR_NONE))
+    {
+        switch (iir & SERIAL_IIR_ID_MASK)
+        {
+            case SERIAL_IIR_RDA:
+            case SERIAL_IIR_TIMEOUT:
+                while (inb(SERIAL_LSR) & SERIAL_LSR_DR)
+                {
+                    /* drop the oldest byte if nobody consumes them */
+                    if (rx_head - rx_tail == SERIAL_RX_RING_SIZE)
+                        rx_tail++;
+                    rx_ring[rx_head & (SERIAL_RX_RING_SIZE - 1)] = inb(SERIAL_DATA);
+                    rx_head++;
+                }
+                break;
+            case SERIAL_IIR_THRE:
+                serial_tx_kick();
+                break;
+            case SERIAL_IIR_LSR:
+                /* reading LSR clears the error */
+                inb(SERIAL_LSR);
+                break;
+            default:
+                /* reading MSR clears the modem status change */
+                inb(SERIAL_MSR);
+                break;
+        }
+    }
+
+    if (serial_term != SERIAL_NO_TERM && rx_tail != rx_head)
+        tasklet_schedule(&serial_rx_tasklet);
+}
+
+/*
+ * serial_file_read
+ * DESCRIPTION: read routine of the serial pseudo file, return the received characters
+ *              which are not taken by a terminal, does not wait for more
+ * INPUT: offset -- not used, the device has no position
+ *        buf -- buffer to fill
+ *        nbytes -- size of buffer
+ * OUTPUT: received characters
+ * RETURN: number of bytes read
+ * SIDE AFFECTS: receive ring drained
+ */
+int32_t serial_file_read(uint32_t offset, uint8_t* buf, uint32_t nbytes)
+{
+    uint32_t i;         /* number of bytes read */
+    uint32_t flags;     /* saved eflags         */
+
+    cli_and_save(flags);
+    for (i = 0; i < nbytes && rx_tail != rx_head; i++)
+    {
+        buf[i] = rx_ring[rx_tail & (SERIAL_RX_RING_SIZE - 1)];
+        rx_tail++;
+    }
+    restore_flags(flags);
+    return i;
+}
+
+/*
+ * serial_file_write
+ * DESCRIPTION: write routine of the serial pseudo file, the bytes go out on COM1
+ * INPUT: buf -- bytes to write
+ *        nbytes -- number of bytes
+ * OUTPUT: bytes on COM1
+ * RETURN: number of written bytes
+ * SIDE AFFECTS: see serial_putc
+ */
+int32_t serial_file_write(const uint8_t* buf, uint32_t nbytes)
+{
+    uint32_t i;     /* loop index for bytes */
+
+    for (i = 0; i < nbytes; i++)
+        serial_putc(buf[i]);
+    return nbytes;
+}
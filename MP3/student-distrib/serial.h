@@ -0,0 +1,65 @@
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "types.h"
+
+/* Reference: https://wiki.osdev.org/Serial_Ports */
+
+/* ports of COM1 */
+#define SERIAL_PORT         0x3F8
+#define SERIAL_DATA         (SERIAL_PORT + 0)   /* data, divisor low byte when DLAB is set  */
+#define SERIAL_IER          (SERIAL_PORT + 1)   /* interrupt enable, divisor high byte      */
+#define SERIAL_IIR          (SERIAL_PORT + 2)   /* interrupt identification, read only      */
+#define SERIAL_FCR          (SERIAL_PORT + 2)   /* FIFO control, write only                 */
+#define SERIAL_LCR          (SERIAL_PORT + 3)   /* line control                             */
+#define SERIAL_MCR          (SERIAL_PORT + 4)   /* modem control                            */
+#define SERIAL_LSR          (SERIAL_PORT + 5)   /* line status                              */
+#define SERIAL_MSR          (SERIAL_PORT + 6)   /* modem status                             */
+#define SERIAL_IRQ          4
+/* register values */
+#define SERIAL_LCR_DLAB     0x80        /* divisor latch access                     */
+#define SERIAL_LCR_8N1      0x03        /* 8 bits, no parity, one stop bit          */
+#define SERIAL_FCR_ENABLE   0xC7        /* enable and clear FIFOs, 14-byte threshold */
+#define SERIAL_MCR_DTR_RTS  0x03        /* data terminal ready, request to send     */
+#define SERIAL_MCR_OUT2     0x08        /* route the UART interrupt to the PIC      */
+#define SERIAL_IER_RDA      0x01        /* interrupt on received data               */
+#define SERIAL_IER_THRE     0x02        /* interrupt on transmitter empty           */
+#define SERIAL_IIR_NONE     0x01        /* no interrupt pending                     */
+#define SERIAL_IIR_ID_MASK  0x0E
+#define SERIAL_IIR_MSR      0x00        /* modem status changed                     */
+#define SERIAL_IIR_THRE     0x02        /* transmitter empty                        */
+#define SERIAL_IIR_RDA      0x04        /* received data available                  */
+#define SERIAL_IIR_LSR      0x06        /* line status error                        */
+#define SERIAL_IIR_TIMEOUT  0x0C        /* received data timeout                    */
+#define SERIAL_LSR_DR       0x01        /* data ready                               */
+#define SERIAL_LSR_THRE     0x20        /* transmitter holding register empty       */
+#define SERIAL_FIFO_SIZE    16          /* bytes the transmit FIFO takes at once    */
+#define SERIAL_BAUD_DIVISOR 1           /* 115200 baud                              */
+#define SERIAL_BYTE_MASK    0xFF
+#define SERIAL_BYTE_SHIFT   8
+
+#define SERIAL_FILE_NAME    "serial"
+
+/* ring buffers, sizes must be powers of 2 */
+#define SERIAL_TX_RING_SIZE 1024
+#define SERIAL_RX_RING_SIZE 256
+#define SERIAL_NO_TERM      -1
+
+/* initialize COM1 and register the serial pseudo file */
+extern void serial_init();
+/* queue a character for COM1, only waits when the transmit ring is full */
+extern void serial_putc(uint8_t c);
+/* queue a string for COM1 */
+extern void serial_puts(const int8_t* s);
+/* transmit everything queued by polling, for paths that never enable interrupts again */
+extern void serial_flush();
+/* feed received characters to a terminal, SERIAL_NO_TERM to keep them for the pseudo file */
+extern void serial_attach(int32_t term_id);
+/* COM1 interrupt handler */
+extern void serial_handler();
+/* read received characters from the serial pseudo file */
+extern int32_t serial_file_read(uint32_t offset, uint8_t* buf, uint32_t nbytes);
+/* write the serial pseudo file, the bytes go out on COM1 */
+extern int32_t serial_file_write(const uint8_t* buf, uint32_t nbytes);
+
+#endif
@@ -0,0 +1,462 @@
+/*
+    shm
+    Shared memory segments. A segment is a set of frames of a 4MB area of physical memory
+    reserved for them, found or created by key with shmget and mapped into the caller with
+    shmat, anywhere in the 4MB window at SHM_VIRTUAL_ADDR that every process has next to its
+    program page. A segment lives as long as some process holds it: shmget and shmat take a
+    hold, shmdt and halt drop it, and the last one to let go frees the frames.
+    futex puts a process to sleep while a word still holds the value it expects and wakes
+    sleepers on a word, keyed by its physical address so that processes that map the same
+    page at different addresses meet on it.
+*/
+
+#include "shm.h"
+#include "syscall.h"
+#include "schedule.h"
+#include "elf.h"
+#include "imgcache.h"
+#include "thread.h"
+#include "lib.h"
+
+/* physical and kernel virtual address of a segment frame */
+#define SHM_FRAME_ADDR(f)   (SHM_ADDR + (f) * PAGE_4KB_SIZE)
+
+static shm_seg_t shm_seg[SHM_SEG_NUM];
+/* segments held by every process */
+static shm_hold_t shm_hold[NUM_PROCESS][SHM_PER_PROC];
+/* stack of free frame indexes */
+static uint16_t free_frame[SHM_FRAME_NUM];
+static uint32_t free_frame_num;
+/* the segment memory could be mapped */
+static uint32_t shm_on;
+
+/*
+ * shm_init
+ * DESCRIPTION: map the segment memory for the kernel and put all its frames on the free stack.
+ *              Must run before the application processors copy the page directory.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: page directory changed
+ */
+void shm_init()
+{
+    uint32_t i, j;  /* loop indexes */
+
+    for (i = 0; i < NUM_PROCESS; i++)
+        for (j = 0; j < SHM_PER_PROC; j++)
+            shm_hold[i][j].seg = -1;
+
+    if (paging_map_kernel(SHM_ADDR) == -1)
+        return;
+
+    for (i = 0; i < SHM_FRAME_NUM; i++)
+        free_frame[i] = SHM_FRAME_NUM - 1 - i;
+    free_frame_num = SHM_FRAME_NUM;
+    shm_on = 1;
+}
+
+/*
+ * shm_find_hold
+ * DESCRIPTION: find the hold of a process on a segment
+ * INPUT: pid -- process id
+ *        seg -- segment index, -1 for a free slot
+ * OUTPUT: none
+ * RETURN: the hold, NULL if there is none
+ * SIDE AFFECTS: none
+ */
+static shm_hold_t* shm_find_hold(uint32_t pid, int32_t seg)
+{
+    uint32_t i;     /* loop index for holds */
+
+    for (i = 0; i < SHM_PER_PROC; i++)
+    {
+        if (shm_hold[pid][i].seg == seg)
+            return &shm_hold[pid][i];
+    }
+    return NULL;
+}
+
+/*
+ * shm_take
+ * DESCRIPTION: let a process hold a segment, once
+ * INPUT: pid -- process id
+ *        seg -- segment index
+ * OUTPUT: none
+ * RETURN: the hold, NULL if the process holds SHM_PER_PROC segments already
+ * SIDE AFFECTS: reference count of the segment increased
+ */
+static shm_hold_t* shm_take(uint32_t pid, int32_t seg)
+{
+    shm_hold_t* hold;   /* hold of the process */
+
+    if ((hold = shm_find_hold(pid, seg)) != NULL)
+        return hold;
+    if ((hold = shm_find_hold(pid, -1)) == NULL)
+        return NULL;
+    hold->seg = seg;
+    hold->vaddr = 0;
+    hold->detached = 0;
+    shm_seg[seg].refcnt++;
+    return hold;
+}
+
+/*
+ * shm_unmap
+ * DESCRIPTION: unmap a segment from a process, it still holds it
+ * INPUT: pid -- process id
+ *        hold -- hold of the process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: shm page table of the process changed, TLB flushed
+ */
+static void shm_unmap(uint32_t pid, shm_hold_t* hold)
+{
+    shm_seg_t* seg = &shm_seg[hold->seg];       /* the segment  */
+    uint32_t i;                                 /* loop index   */
+
+    if (hold->vaddr == 0)
+        return;
+    for (i = 0; i < seg->page_num; i++)
+        shm_page_table[pid][((hold->vaddr - SHM_VIRTUAL_ADDR) >> MEM_OFFSET_BITS) + i].p = 0;
+    flush_TLB();
+    hold->vaddr = 0;
+}
+
+/*
+ * shm_drop
+ * DESCRIPTION: unmap a segment from a process and let it go, the last holder frees the frames
+ * INPUT: pid -- process id
+ *        hold -- hold of the process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: shm page table of the process and free frame stack changed, TLB flushed
+ */
+static void shm_drop(uint32_t pid, shm_hold_t* hold)
+{
+    shm_seg_t* seg = &shm_seg[hold->seg];       /* the segment  */
+    uint32_t i;                                 /* loop index   */
+
+    shm_unmap(pid, hold);
+    hold->seg = -1;
+    hold->vaddr = 0;
+
+    if (--seg->refcnt > 0)
+        return;
+    for (i = 0; i < seg->page_num; i++)
+        free_frame[free_frame_num++] = seg->frame[i];
+    seg->page_num = 0;
+    seg->used = 0;
+}
+
+/*
+ * shm_release
+ * DESCRIPTION: called by halt, drop every segment a halting process holds
+ * INPUT: pid -- halting process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: segments may be freed
+ */
+void shm_release(uint32_t pid)
+{
+    uint32_t i;     /* loop index for holds */
+
+    for (i = 0; i < SHM_PER_PROC; i++)
+    {
+        if (shm_hold[pid][i].seg != -1)
+            shm_drop(pid, &shm_hold[pid][i]);
+    }
+}
+
+/*
+ * shm_reap
+ * DESCRIPTION: called when the last thread of a program is joined, drop the segments it detached
+ *              while it had threads. No other processor runs the program any more, none of them
+ *              has the pages in its TLB.
+ * INPUT: mm_pid -- leader of the program
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: segments may be freed
+ */
+void shm_reap(uint32_t mm_pid)
+{
+    uint32_t i;     /* loop index for holds */
+
+    for (i = 0; i < SHM_PER_PROC; i++)
+    {
+        if (shm_hold[mm_pid][i].seg != -1 && shm_hold[mm_pid][i].detached)
+            shm_drop(mm_pid, &shm_hold[mm_pid][i]);
+    }
+}
+
+/*
+ * shmget
+ * DESCRIPTION: system call shmget, find the segment of a key or create it, zero-filled. The caller
+ *              holds it from now on, until shmdt or halt.
+ * INPUT: key -- any number shared by the processes, SHM_KEY_PRIVATE for a new segment every time
+ *        size -- size in bytes, rounded up to pages; an existing segment must be at least as
+ *                large, 0 only finds one
+ * OUTPUT: none
+ * RETURN: segment id, -1 for failure
+ * SIDE AFFECTS: a segment may be created
+ */
+int32_t shmget(uint32_t key, uint32_t size)
+{
+    uint32_t page_num = (size + PAGE_4KB_SIZE - 1) / PAGE_4KB_SIZE;    /* size in pages    */
+    int32_t seg = -1;                                                   /* segment found    */
+    int32_t free_seg = -1;                                              /* unused segment   */
+    uint32_t i;                                                         /* loop index       */
+
+    if (!shm_on || curr_pid == -1 || size > PAGE_4MB_SIZE)
+        return -1;
+
+    for (i = 0; i < SHM_SEG_NUM; i++)
+    {
+        if (!shm_seg[i].used)
+            free_seg = i;
+        else if (key != SHM_KEY_PRIVATE && shm_seg[i].key == key)
+            seg = i;
+    }
+
+    if (seg != -1)
+    {
+        if (page_num > shm_seg[seg].page_num)
+            return -1;
+    }
+    else
+    {
+        if (page_num == 0 || free_seg == -1 || page_num > free_frame_num)
+            return -1;
+        /* a slot to hold it, so that it is not created for nobody */
+        if (shm_find_hold(curr_mm, -1) == NULL)
+            return -1;
+        seg = free_seg;
+        shm_seg[seg].used = 1;
+        shm_seg[seg].key = key;
+        shm_seg[seg].refcnt = 0;
+        shm_seg[seg].page_num = page_num;
+        for (i = 0; i < page_num; i++)
+        {
+            shm_seg[seg].frame[i] = free_frame[--free_frame_num];
+            memset((void*)SHM_FRAME_ADDR(shm_seg[seg].frame[i]), 0, PAGE_4KB_SIZE);
+        }
+    }
+
+    if (shm_take(curr_mm, seg) == NULL)
+        return -1;
+    return seg;
+}
+
+/*
+ * shm_range_free
+ * DESCRIPTION: check that pages of the shm window of a process are free
+ * INPUT: pid -- process id
+ *        vaddr -- first page
+ *        page_num -- number of pages
+ * OUTPUT: none
+ * RETURN: 1 if nothing is mapped there and it fits in the window, 0 otherwise
+ * SIDE AFFECTS: none
+ */
+static uint32_t shm_range_free(uint32_t pid, uint32_t vaddr, uint32_t page_num)
+{
+    uint32_t first = (vaddr - SHM_VIRTUAL_ADDR) >> MEM_OFFSET_BITS;    /* first page index */
+    uint32_t i;                                                         /* loop index       */
+
+    if (first + page_num > NUM_PT_ENTRY)
+        return 0;
+    for (i = first; i < first + page_num; i++)
+    {
+        if (shm_page_table[pid][i].p)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * shmat
+ * DESCRIPTION: system call shmat, map a segment into the caller, read/write. A process attaches
+ *              a segment once; attaching it again at the same address or at 0 returns where it is.
+ * INPUT: shmid -- segment id from shmget, in this or another process
+ *        addr -- page aligned address in the shm window, 0 to take the lowest free range
+ * OUTPUT: none
+ * RETURN: address the segment is mapped at, -1 for failure
+ * SIDE AFFECTS: shm page table of the caller changed, TLB flushed
+ */
+int32_t shmat(int32_t shmid, void* addr)
+{
+    uint32_t vaddr = (uint32_t)addr;    /* address asked for    */
+    shm_hold_t* hold;                   /* hold of the caller   */
+    shm_seg_t* seg;                     /* the segment          */
+    page_table_entry_t* pte;            /* entries of its pages */
+    uint32_t i;                         /* loop index           */
+
+    if (curr_pid == -1 || shmid < 0 || shmid >= SHM_SEG_NUM || !shm_seg[shmid].used)
+        return -1;
+    seg = &shm_seg[shmid];
+    if (vaddr != 0 && (vaddr < SHM_VIRTUAL_ADDR || vaddr >= SHM_VIRTUAL_ADDR + PAGE_4MB_SIZE ||
+                       (vaddr & (PAGE_4KB_SIZE - 1)) != 0))
+        return -1;
+
+    hold = shm_find_hold(curr_mm, shmid);
+    if (hold != NULL && hold->vaddr != 0)
+        return (vaddr == 0 || vaddr == hold->vaddr) ? (int32_t)hold->vaddr : -1;
+
+    if (vaddr == 0)
+    {
+        for (vaddr = SHM_VIRTUAL_ADDR; vaddr < SHM_VIRTUAL_ADDR + PAGE_4MB_SIZE; vaddr += PAGE_4KB_SIZE)
+        {
+            if (shm_range_free(curr_mm, vaddr, seg->page_num))
+                break;
+        }
+        if (vaddr >= SHM_VIRTUAL_ADDR + PAGE_4MB_SIZE)
+            return -1;
+    }
+    else if (!shm_range_free(curr_mm, vaddr, seg->page_num))
+    {
+        return -1;
+    }
+
+    if (hold == NULL && (hold = shm_take(curr_mm, shmid)) == NULL)
+        return -1;
+    hold->vaddr = vaddr;
+    hold->detached = 0;
+    pte = &shm_page_table[curr_mm][(vaddr - SHM_VIRTUAL_ADDR) >> MEM_OFFSET_BITS];
+    for (i = 0; i < seg->page_num; i++, pte++)
+    {
+        pte->base_addr = SHM_FRAME_ADDR(seg->frame[i]) >> MEM_OFFSET_BITS;
+        pte->u_s = 1;
+        pte->r_w = 1;
+        pte->p = 1;
+    }
+    /* not present entries are never cached in the TLB, no flush is needed */
+    return vaddr;
+}
+
+/*
+ * shmdt
+ * DESCRIPTION: system call shmdt, unmap a segment from the caller and let it go. Other processors
+ *              may be running threads of the program with the pages still in their TLB, so while
+ *              it has threads the segment stays held, unmapped, until they are joined (shm_reap).
+ * INPUT: addr -- address returned by shmat
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 if no segment is attached there
+ * SIDE AFFECTS: the segment is freed if nobody else holds it
+ */
+int32_t shmdt(void* addr)
+{
+    uint32_t i;     /* loop index for holds */
+
+    if (curr_pid == -1 || addr == NULL)
+        return -1;
+    for (i = 0; i < SHM_PER_PROC; i++)
+    {
+        if (shm_hold[curr_mm][i].seg != -1 && shm_hold[curr_mm][i].vaddr == (uint32_t)addr)
+        {
+            if (thread_count(curr_mm) > 0)
+            {
+                shm_unmap(curr_mm, &shm_hold[curr_mm][i]);
+                shm_hold[curr_mm][i].detached = 1;
+            }
+            else
+                shm_drop(curr_mm, &shm_hold[curr_mm][i]);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * futex_key
+ * DESCRIPTION: physical address of a word of the current process, what futex sleeps on. A
+ *              page of the program that is not there yet, or still the image cache's, is made
+ *              the process' own first, as a write to it would, so every process finds the
+ *              frame that it and the others really write to.
+ * INPUT: addr -- user address of a word, 4-byte aligned
+ * OUTPUT: none
+ * RETURN: physical address, 0 if the word is not the process' memory
+ * SIDE AFFECTS: a page may be mapped or copied
+ */
+static uint32_t futex_key(uint32_t addr)
+{
+    page_table_entry_t* pte;    /* entry of the page */
+
+    if (addr >= SHM_VIRTUAL_ADDR && addr < SHM_VIRTUAL_ADDR + PAGE_4MB_SIZE)
+    {
+        pte = &shm_page_table[curr_mm][(addr - SHM_VIRTUAL_ADDR) >> MEM_OFFSET_BITS];
+    }
+    else
+    {
+        if ((pte = user_pte(curr_mm, addr)) == NULL)
+            return 0;
+        if (!pte->p && elf_lazy_fault(addr) == -1)
+            return 0;
+        if (pte->avail & PTE_AVAIL_COW)
+            imgcache_cow_fault(addr);
+    }
+    if (!pte->p)
+        return 0;
+    return (pte->base_addr << MEM_OFFSET_BITS) | (addr & (PAGE_4KB_SIZE - 1));
+}
+
+/*
+ * futex
+ * DESCRIPTION: system call futex. FUTEX_WAIT sleeps if *addr still is val, checked with
+ *              interrupts off so that a FUTEX_WAKE after the store the waiter checks against
+ *              cannot be missed. FUTEX_WAKE wakes up to val processes sleeping on the word.
+ *              A waiter may also come back for a signal, callers check their condition again.
+ * INPUT: addr -- user address of the word, 4-byte aligned, in the program page or a segment
+ *        op -- FUTEX_WAIT or FUTEX_WAKE
+ *        val -- value expected, or the number of processes to wake
+ * OUTPUT: none
+ * RETURN: FUTEX_WAIT: 0 after a wakeup, -1 if the word changed already, a signal is pending
+ *                     or for bad arguments
+ *         FUTEX_WAKE: number of processes woken, -1 for bad arguments
+ * SIDE AFFECTS: the caller may sleep, other processes may become runnable
+ */
+int32_t futex(uint32_t* addr, int32_t op, uint32_t val)
+{
+    uint32_t key;       /* physical address of the word */
+    uint32_t pid;       /* loop index for processes     */
+    uint32_t woken = 0; /* processes woken              */
+    uint32_t flags;     /* saved eflags                 */
+    pcb_t* pcb;         /* a sleeping process           */
+
+    if (curr_pid == -1 || ((uint32_t)addr & (sizeof(uint32_t) - 1)) != 0)
+        return -1;
+    if ((key = futex_key((uint32_t)addr)) == 0)
+        return -1;
+
+    switch (op)
+    {
+        case FUTEX_WAIT:
+            cli_and_save(flags);
+            /* a signal raised before the sleep only wakes sleepers, check it here */
+            if (*addr != val || signal_pending(curr_pid))
+            {
+                restore_flags(flags);
+                return -1;
+            }
+            sched_sleep((void*)key);
+            restore_flags(flags);
+            return 0;
+
+        case FUTEX_WAKE:
+            cli_and_save(flags);
+            for (pid = 0; pid < NUM_PROCESS && woken < val; pid++)
+            {
+                if (!is_pid_used(pid))
+                    continue;
+                pcb = get_pcb_ptr(pid);
+                if (pcb->state == PROC_SLEEPING && pcb->wait_chan == (void*)key)
+                {
+                    sched_wakeup_pid(pid);
+                    woken++;
+                }
+            }
+            restore_flags(flags);
+            return woken;
+
+        default:
+            return -1;
+    }
+}
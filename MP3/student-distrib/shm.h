@@ -0,0 +1,62 @@
+/*
+    shm.h header file
+    shared memory segments between processes, and futex wait/wake on them
+*/
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+#include "paging.h"
+
+/* physical memory of the segments: the 4MB after the image cache */
+#define SHM_ADDR                0x6C00000
+#define SHM_FRAME_NUM           (PAGE_4MB_SIZE / PAGE_4KB_SIZE)
+/* segments in the system, and segments one process holds at once */
+#define SHM_SEG_NUM             16
+#define SHM_PER_PROC            8
+/* key of a segment that shmget always creates and nobody else finds */
+#define SHM_KEY_PRIVATE         0
+
+/* operations of futex */
+#define FUTEX_WAIT              0
+#define FUTEX_WAKE              1
+
+/* one segment */
+typedef struct shm_seg_t {
+    uint32_t used;                          /* holds a segment                      */
+    uint32_t key;                           /* key given to shmget                  */
+    uint32_t refcnt;                        /* processes holding it                 */
+    uint32_t page_num;                      /* size in pages                        */
+    uint16_t frame[SHM_FRAME_NUM];          /* frame index in the segment memory    */
+} shm_seg_t;
+
+/* a segment held by a process */
+typedef struct shm_hold_t {
+    int32_t seg;                            /* index in the segments, -1 if free    */
+    uint32_t vaddr;                         /* where it is attached, 0 if it is not */
+    uint32_t detached;                      /* let go by shmdt, see shm_reap        */
+} shm_hold_t;
+
+/* map the segment memory for the kernel, before the processors copy the page directory */
+void shm_init();
+
+/* drop every segment of a halting process */
+void shm_release(uint32_t pid);
+
+/* drop the segments a program detached while it had threads, once they are all joined */
+void shm_reap(uint32_t mm_pid);
+
+/* system call shmget, find or create a segment by key */
+int32_t shmget(uint32_t key, uint32_t size);
+
+/* system call shmat, map a segment into the caller */
+int32_t shmat(int32_t shmid, void* addr);
+
+/* system call shmdt, unmap a segment and let it go */
+int32_t shmdt(void* addr);
+
+/* system call futex, sleep while a word holds a value, or wake the sleepers on it */
+int32_t futex(uint32_t* addr, int32_t op, uint32_t val);
+
+#endif
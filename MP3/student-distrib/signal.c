@@ -0,0 +1,276 @@
+/*
+    signal
+    pending signal bitmaps, user signal frames and the set_handler/sigreturn system calls
+*/
+
+#include "signal.h"
+#include "syscall.h"
+#include "terminal.h"
+#include "schedule.h"
+#include "paging.h"
+#include "x86_desc.h"
+#include "lib.h"
+
+/* signals whose default action kills the process, the others are ignored by default */
+#define SIGNAL_DEFAULT_KILL_MASK    ((1 << SIGNAL_DIV_ZERO) | (1 << SIGNAL_SEGFAULT) | (1 << SIGNAL_INTERRUPT))
+/* hardware context saved at the top of a process' kernel stack when it enters the kernel from user mode */
+#define USER_HW_CONTEXT(pid)        ((hw_context_t*)(KS_BASE_ADDR - KS_SIZE*(pid) - sizeof(int32_t) - sizeof(hw_context_t)))
+
+/* PIT ticks since the last ALARM */
+static uint32_t alarm_ticks = 0;
+
+/*
+ * signal_send
+ * DESCRIPTION: raise a signal for a process, it is delivered when the process next returns to user mode
+ * INPUT: pid -- process id
+ *        signum -- signal number
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: process' pending signal bitmap changed, a sleeping process woken up
+ */
+void signal_send(uint32_t pid, uint32_t signum)
+{
+    /* sanity check */
+    if (pid >= NUM_PROCESS || signum >= SIGNAL_NUM)
+        return;
+
+    get_pcb_ptr(pid)->sig_pending |= 1 << signum;
+    /* a sleeping process checks for the signal and gives up its wait */
+    sched_wakeup_pid(pid);
+}
+
+/*
+ * signal_init_pcb
+ * DESCRIPTION: reset all signal state of a process to default, i.e. nothing pending,
+ *              nothing masked and default action for every signal
+ * INPUT: pid -- process id
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: process' signal state changed
+ */
+void signal_init_pcb(uint32_t pid)
+{
+    int i;                              /* loop index for signal handlers */
+    pcb_t* pcb = get_pcb_ptr(pid);      /* pcb of the process             */
+
+    pcb->sig_pending = 0;
+    pcb->sig_masked = 0;
+    for (i = 0; i < SIGNAL_NUM; i++)
+        pcb->sig_handler[i] = NULL;
+}
+
+/*
+ * signal_pending
+ * DESCRIPTION: check whether a process has a signal which is going to do something when delivered,
+ *              i.e. an unmasked pending signal that has a user handler or kills the process, or
+ *              whether it is a thread that has to halt with its program. Blocking calls use it to
+ *              give up waiting.
+ * INPUT: pid -- process id
+ * OUTPUT: none
+ * RETURN: 1 if there is such signal, 0 if not
+ * SIDE AFFECTS: none
+ */
+int32_t signal_pending(uint32_t pid)
+{
+    int i;                  /* loop index for signal handlers           */
+    uint32_t active_mask;   /* signals which are not ignored            */
+    pcb_t* pcb;             /* pcb of the process                       */
+
+    /* sanity check */
+    if (pid >= NUM_PROCESS)
+        return 0;
+
+    pcb = get_pcb_ptr(pid);
+    if (pcb->killed)
+        return 1;
+    active_mask = SIGNAL_DEFAULT_KILL_MASK;
+    for (i = 0; i < SIGNAL_NUM; i++)
+    {
+        if (pcb->sig_handler[i] != NULL)
+            active_mask |= 1 << i;
+    }
+
+    return (pcb->sig_pending & ~pcb->sig_masked & active_mask) ? 1 : 0;
+}
+
+/*
+ * signal_tick
+ * DESCRIPTION: count PIT ticks and raise ALARM every SIGNAL_ALARM_SECONDS for the
+ *              active process of every running terminal. Called by the PIT handler.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: pending ALARM set
+ */
+void signal_tick()
+{
+    int i;  /* loop index for terminals */
+
+    if (++alarm_ticks < SIGNAL_ALARM_SECONDS * PIT_FREQ)
+        return;
+    alarm_ticks = 0;
+
+    for (i = 0; i < terminal_num; i++)
+    {
+        if (terminals[i].is_running)
+            signal_send(terminals[i].active_pid, SIGNAL_ALARM);
+    }
+}
+
+/*
+ * signal_default
+ * DESCRIPTION: take the default action of a signal, either kill the current process or ignore it
+ * INPUT: signum -- signal number
+ * OUTPUT: none
+ * RETURN: none, does not return if the process is killed
+ * SIDE AFFECTS: current process may be halted
+ */
+static void signal_default(uint32_t signum)
+{
+    switch (signum)
+    {
+        case SIGNAL_DIV_ZERO:
+        case SIGNAL_SEGFAULT:
+            halt(HALT_EXCEPTION);
+            break;
+        case SIGNAL_INTERRUPT:
+            halt(HALT_ABNORMAL);
+            break;
+        default:
+            /* ALARM and USER1 are ignored */
+            break;
+    }
+}
+
+/*
+ * do_signal
+ * DESCRIPTION: deliver pending signals of the current process. Ignored signals are dropped,
+ *              default kill actions halt the process, and for a signal with a user handler a
+ *              frame is built on the user stack:
+ *                  [return address -> trampoline][signum][hw_context_t][sigreturn trampoline]
+ *              then the saved context is changed so that IRET enters the handler.
+ *              A thread whose program is halting halts here instead, see thread_reap_all.
+ *              Called by the linkage code right before returning to user mode.
+ * INPUT: context -- hardware context saved on the kernel stack
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: user stack and saved context changed, current process may be halted
+ */
+void do_signal(hw_context_t* context)
+{
+    uint32_t signum;        /* signal number to deliver                 */
+    uint32_t pending;       /* deliverable signals                      */
+    uint32_t tramp_size;    /* size of the trampoline, 4-byte aligned   */
+    uint32_t tramp_addr;    /* user address of the trampoline           */
+    uint32_t frame_addr;    /* user address of the saved context        */
+    uint32_t user_esp;      /* new user stack pointer                   */
+    pcb_t* pcb;             /* current process' pcb                     */
+
+    /* only deliver when going back to a user program */
+    if (curr_pid == -1 || (context->cs & SIGNAL_CPL_MASK) == 0)
+        return;
+
+    pcb = get_pcb_ptr(curr_pid);
+    if (pcb->killed)
+        halt(HALT_ABNORMAL);
+
+    while ((pending = pcb->sig_pending & ~pcb->sig_masked) != 0)
+    {
+        /* lowest signal number goes first */
+        for (signum = 0; !(pending & (1 << signum)); signum++);
+        pcb->sig_pending &= ~(1 << signum);
+
+        if (pcb->sig_handler[signum] == NULL)
+        {
+            signal_default(signum);
+            continue;
+        }
+
+        /* lay out the signal frame below the interrupted user stack */
+        tramp_size = ((uint32_t)(sigreturn_tramp_end - sigreturn_tramp) + sizeof(int32_t) - 1) & ~(sizeof(int32_t) - 1);
+        tramp_addr = context->esp - tramp_size;
+        frame_addr = tramp_addr - sizeof(hw_context_t);
+        user_esp = frame_addr - 2*sizeof(uint32_t);
+
+        /* the whole frame must be inside the user program page, otherwise the process cannot continue */
+        if (user_esp < ADDR_128MB || context->esp > ADDR_132MB)
+            halt(HALT_EXCEPTION);
+
+        memcpy((void*)tramp_addr, sigreturn_tramp, sigreturn_tramp_end - sigreturn_tramp);
+        memcpy((void*)frame_addr, context, sizeof(hw_context_t));
+        ((uint32_t*)user_esp)[0] = tramp_addr;
+        ((uint32_t*)user_esp)[1] = signum;
+
+        /* IRET into the handler, all signals masked until sigreturn */
+        context->esp = user_esp;
+        context->eip = (uint32_t)pcb->sig_handler[signum];
+        pcb->sig_masked = SIGNAL_ALL_MASK;
+        return;
+    }
+}
+
+/*
+ * set_handler
+ * DESCRIPTION: system call set_handler, install a user handler for a signal.
+ *              NULL handler address restores the default action.
+ * INPUT: signum -- signal number
+ *        handler_address -- user handler address
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 for fail
+ * SIDE AFFECTS: current process' signal handler changed
+ */
+int32_t set_handler(int32_t signum, void* handler_address)
+{
+    /* sanity check */
+    if (signum < 0 || signum >= SIGNAL_NUM || curr_pid == -1)
+        return -1;
+    if (handler_address != NULL && ((uint32_t)handler_address < ADDR_128MB || (uint32_t)handler_address >= ADDR_132MB))
+        return -1;
+
+    get_pcb_ptr(curr_pid)->sig_handler[signum] = handler_address;
+    return 0;
+}
+
+/*
+ * sigreturn
+ * DESCRIPTION: system call sigreturn, called by the trampoline when a user handler returns.
+ *              Copy the hardware context saved on the user stack back to the kernel stack, so
+ *              that the linkage returns to where the signal interrupted the program.
+ *              Segment registers and privileged eflags bits are never taken from the user copy.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: saved eax, so that the linkage does not clobber it, -1 for fail
+ * SIDE AFFECTS: saved context changed, signals unmasked
+ */
+int32_t sigreturn()
+{
+    hw_context_t* context;  /* context saved on the kernel stack by this system call   */
+    hw_context_t* saved;    /* context saved on the user stack by do_signal             */
+    pcb_t* pcb;             /* current process' pcb                                     */
+
+    pcb = get_pcb_ptr(curr_pid);
+    context = USER_HW_CONTEXT(curr_pid);
+
+    /* the handler returned into the trampoline, so user esp points at signum */
+    saved = (hw_context_t*)(context->esp + sizeof(uint32_t));
+
+    /* sanity check */
+    if ((uint32_t)saved < ADDR_128MB || (uint32_t)saved + sizeof(hw_context_t) > ADDR_132MB)
+        return -1;
+
+    context->ebx = saved->ebx;
+    context->ecx = saved->ecx;
+    context->edx = saved->edx;
+    context->esi = saved->esi;
+    context->edi = saved->edi;
+    context->ebp = saved->ebp;
+    context->eax = saved->eax;
+    context->eip = saved->eip;
+    context->esp = saved->esp;
+    context->eflags = (context->eflags & ~SIGNAL_EFLAGS_USER_MASK) | (saved->eflags & SIGNAL_EFLAGS_USER_MASK);
+
+    /* handler finished, accept signals again */
+    pcb->sig_masked = 0;
+
+    return context->eax;
+}
@@ -0,0 +1,84 @@
+/*
+    signal.h header file
+*/
+
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+#include "types.h"
+
+/* signal numbers */
+#define SIGNAL_DIV_ZERO         0
+#define SIGNAL_SEGFAULT         1
+#define SIGNAL_INTERRUPT        2
+#define SIGNAL_ALARM            3
+#define SIGNAL_USER1            4
+#define SIGNAL_NUM              5
+#define SIGNAL_ALL_MASK         ((1 << SIGNAL_NUM) - 1)
+
+/* ALARM is raised every 10 seconds, counted in PIT ticks */
+#define SIGNAL_ALARM_SECONDS    10
+
+/* user privilege level bits in a saved code segment selector */
+#define SIGNAL_CPL_MASK         0x3
+/* eflags bits a user handler is allowed to change through sigreturn */
+#define SIGNAL_EFLAGS_USER_MASK 0x00000DD5
+#define SIGNAL_EFLAGS_IF        0x00000200
+
+/*
+ * hardware context saved on the kernel stack by the interrupt, exception and
+ * system call linkage, in the order the linkage pushes it (lowest address first).
+ * A copy of this struct is also what a user signal handler finds on its stack.
+ */
+typedef struct hw_context_t {
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+    uint32_t eax;
+    uint16_t ds;
+    uint16_t ds_pad;
+    uint16_t es;
+    uint16_t es_pad;
+    uint16_t fs;
+    uint16_t fs_pad;
+    uint32_t irq_exc_no;    /* vector number pushed by the linkage  */
+    uint32_t error_code;    /* error code, 0 if there is none       */
+    /* pushed by the processor */
+    uint32_t eip;
+    uint16_t cs;
+    uint16_t cs_pad;
+    uint32_t eflags;
+    uint32_t esp;           /* only valid when coming from user mode */
+    uint16_t ss;
+    uint16_t ss_pad;
+} __attribute__((packed)) hw_context_t;
+
+/* sigreturn trampoline copied onto the user stack, see syscall_linkage.S */
+extern uint8_t sigreturn_tramp[];
+extern uint8_t sigreturn_tramp_end[];
+
+/* raise a signal for a process, it is delivered when the process next returns to user mode */
+void signal_send(uint32_t pid, uint32_t signum);
+
+/* reset all signal state of a process to default */
+void signal_init_pcb(uint32_t pid);
+
+/* check whether a process has a signal that would interrupt a blocking call */
+int32_t signal_pending(uint32_t pid);
+
+/* count PIT ticks and raise ALARM every SIGNAL_ALARM_SECONDS */
+void signal_tick();
+
+/* deliver pending signals of current process, called before returning to user mode */
+void do_signal(hw_context_t* context);
+
+/* system call set_handler, install a user handler for a signal */
+int32_t set_handler(int32_t signum, void* handler_address);
+
+/* system call sigreturn, restore the hardware context saved when the handler was entered */
+int32_t sigreturn();
+
+#endif
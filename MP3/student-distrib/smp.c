@@ -0,0 +1,572 @@
+/*
+    smp
+    per-processor data, processor discovery through the MP table, application processor
+    start up and the kernel lock.
+
+    The kernel code was written for one processor, so it is protected as a whole by one
+    recursive kernel lock: every interrupt, exception and system call takes it on entry and
+    the outermost return gives it back. User programs run in parallel on all processors.
+    A process waiting inside the kernel sleeps (sched_sleep) and the lock goes with the
+    processor to the next context; the few busy wait loops left call smp_relax so that
+    they do not hold it while waiting for another processor.
+*/
+
+#include "smp.h"
+#include "apic.h"
+#include "spinlock.h"
+#include "syscall.h"
+#include "schedule.h"
+#include "lib.h"
+
+/* MP floating pointer structure */
+typedef struct mp_float_t {
+    uint32_t signature;     /* MP_FLOAT_SIG                         */
+    uint32_t config_addr;   /* physical address of the config table */
+    uint8_t length;         /* in 16 bytes                          */
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t default_type;   /* non zero if there is no config table */
+    uint8_t features[4];
+} __attribute__((packed)) mp_float_t;
+
+/* MP configuration table header, entries follow it */
+typedef struct mp_config_t {
+    uint32_t signature;     /* MP_CONFIG_SIG                        */
+    uint16_t length;        /* header and entries in bytes          */
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t oem_id[8];
+    uint8_t product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_num;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} __attribute__((packed)) mp_config_t;
+
+/* processor entry */
+typedef struct mp_cpu_t {
+    uint8_t type;           /* MP_ENTRY_CPU                         */
+    uint8_t apic_id;
+    uint8_t apic_ver;
+    uint8_t flags;          /* MP_CPU_ENABLED, MP_CPU_BSP           */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} __attribute__((packed)) mp_cpu_t;
+
+/* bus entry */
+typedef struct mp_bus_t {
+    uint8_t type;           /* MP_ENTRY_BUS                         */
+    uint8_t bus_id;
+    uint8_t bus_type[MP_BUS_TYPE_LEN];
+} __attribute__((packed)) mp_bus_t;
+
+/* I/O APIC entry */
+typedef struct mp_ioapic_t {
+    uint8_t type;           /* MP_ENTRY_IOAPIC                      */
+    uint8_t apic_id;
+    uint8_t apic_ver;
+    uint8_t flags;
+    uint32_t addr;
+} __attribute__((packed)) mp_ioapic_t;
+
+/* I/O interrupt assignment entry */
+typedef struct mp_ioint_t {
+    uint8_t type;           /* MP_ENTRY_IOINT                       */
+    uint8_t int_type;       /* MP_IOINT_INT for normal interrupts   */
+    uint16_t flags;
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_apic;
+    uint8_t dst_pin;
+} __attribute__((packed)) mp_ioint_t;
+
+cpu_t cpus[SMP_MAX_CPU] __attribute__((aligned(PAGE_4KB_SIZE)));
+uint32_t cpu_num = 1;
+
+/* the kernel lock */
+static spinlock_t kernel_spinlock = SPINLOCK_INIT;
+
+/* idle stack of the bootstrap processor, it boots on the kernel stack of process 0 */
+static uint8_t bsp_idle_stack[CPU_STACK_SIZE] __attribute__((aligned(PAGE_4KB_SIZE)));
+
+#if SMP_ON
+/* page directories and vidmap page tables of application processors, by cpu id - 1 */
+static page_dir_entry_t ap_page_directory[SMP_MAX_CPU - 1][NUM_PD_ENTRY] __attribute__((aligned(PAGE_4KB_SIZE)));
+static page_table_entry_t ap_vid_page_table[SMP_MAX_CPU - 1][NUM_PT_ENTRY] __attribute__((aligned(PAGE_4KB_SIZE)));
+/* idle stacks of application processors */
+static uint8_t ap_stack[SMP_MAX_CPU - 1][CPU_STACK_SIZE] __attribute__((aligned(PAGE_4KB_SIZE)));
+/* presence of the first 1MB before smp_init mapped it for the BIOS tables and the trampoline */
+static uint8_t low_mem_present[MP_LOW_MEM_END / PAGE_4KB_SIZE];
+/* GDT and IDT of the bootstrap processor, copied by application processors */
+static table_desc_t bsp_gdtr;
+static table_desc_t bsp_idtr;
+/* cpu id of the application processor being started */
+static volatile uint32_t ap_booting = 0;
+
+/*
+ * mp_checksum
+ * DESCRIPTION: add up bytes of an MP structure
+ * INPUT: addr -- start address
+ *        len -- number of bytes
+ * OUTPUT: none
+ * RETURN: sum of the bytes, 0 if the structure is valid
+ * SIDE AFFECTS: none
+ */
+static uint8_t mp_checksum(uint8_t* addr, uint32_t len)
+{
+    uint8_t sum = 0;    /* sum of bytes */
+
+    while (len-- > 0)
+        sum += *addr++;
+    return sum;
+}
+
+/*
+ * mp_search
+ * DESCRIPTION: look for the MP floating pointer in a memory range
+ * INPUT: addr -- start of the range, 16 byte aligned
+ *        len -- length of the range
+ * OUTPUT: none
+ * RETURN: the floating pointer, NULL if not found
+ * SIDE AFFECTS: none
+ */
+static mp_float_t* mp_search(uint32_t addr, uint32_t len)
+{
+    uint32_t p;         /* candidate address */
+    mp_float_t* mp;     /* candidate         */
+
+    for (p = addr; p + sizeof(mp_float_t) <= addr + len; p += MP_FLOAT_ALIGN)
+    {
+        mp = (mp_float_t*)p;
+        if (mp->signature == MP_FLOAT_SIG && mp->length > 0 &&
+            mp_checksum((uint8_t*)mp, mp->length * MP_FLOAT_ALIGN) == 0)
+            return mp;
+    }
+    return NULL;
+}
+
+/*
+ * low_mem_map
+ * DESCRIPTION: make the first 1MB present (identity, kernel only) while the BIOS tables are read
+ *              and application processors start, or give back the presence it had before
+ * INPUT: map -- 1 to map, 0 to restore
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: 0-1MB page table entries changed
+ */
+static void low_mem_map(uint32_t map)
+{
+    uint32_t i;     /* loop index for pages */
+
+    for (i = 0; i < MP_LOW_MEM_END / PAGE_4KB_SIZE; i++)
+    {
+        if (map)
+        {
+            low_mem_present[i] = page_table[i].p;
+            page_table[i].p = 1;
+        }
+        else
+            page_table[i].p = low_mem_present[i];
+    }
+    flush_TLB();
+}
+
+/*
+ * mp_parse
+ * DESCRIPTION: read processors, the I/O APIC and ISA IRQ routing from the MP configuration table
+ * INPUT: lapic_addr -- filled with the local APIC address
+ *        ioapic_addr -- filled with the I/O APIC address
+ *        isa_pin -- filled with the I/O APIC pin of each ISA IRQ
+ * OUTPUT: none
+ * RETURN: 0 for success, -1 if there is no usable table
+ * SIDE AFFECTS: cpus and cpu_num filled
+ */
+static int32_t mp_parse(uint32_t* lapic_addr, uint32_t* ioapic_addr, uint8_t* isa_pin)
+{
+    mp_float_t* mp;                 /* floating pointer             */
+    mp_config_t* conf;              /* configuration table          */
+    uint8_t* entry;                 /* current entry                */
+    uint8_t isa_bus[MP_MAX_BUS];    /* whether a bus is ISA         */
+    uint32_t ebda;                  /* extended BIOS data area      */
+    uint32_t i;                     /* loop index for entries       */
+    mp_cpu_t* cpu;                  /* processor entry              */
+    mp_ioint_t* ioint;              /* interrupt assignment entry   */
+
+    /* EBDA, last KB of base memory, then BIOS ROM */
+    ebda = (uint32_t)(*(uint16_t*)MP_EBDA_SEG_PTR) << 4;
+    mp = NULL;
+    if (ebda != 0 && ebda < MP_LOW_MEM_END)
+        mp = mp_search(ebda, MP_EBDA_SCAN_SIZE);
+    if (mp == NULL)
+        mp = mp_search(MP_BASE_MEM_TOP - MP_EBDA_SCAN_SIZE, MP_EBDA_SCAN_SIZE);
+    if (mp == NULL)
+        mp = mp_search(MP_BIOS_ROM_ADDR, MP_BIOS_ROM_SIZE);
+    /* default configurations without a table are not supported */
+    if (mp == NULL || mp->default_type != 0 || mp->config_addr == 0 || mp->config_addr >= MP_LOW_MEM_END)
+        return -1;
+
+    conf = (mp_config_t*)mp->config_addr;
+    if (conf->signature != MP_CONFIG_SIG || mp_checksum((uint8_t*)conf, conf->length) != 0)
+        return -1;
+
+    *lapic_addr = conf->lapic_addr;
+    *ioapic_addr = IOAPIC_DEFAULT_ADDR;
+    for (i = 0; i < APIC_ISA_IRQ_NUM; i++)
+        isa_pin[i] = i;
+    memset(isa_bus, 0, sizeof(isa_bus));
+
+    cpu_num = 1;
+    entry = (uint8_t*)(conf + 1);
+    for (i = 0; i < conf->entry_num; i++)
+    {
+        switch (*entry)
+        {
+            case MP_ENTRY_CPU:
+                cpu = (mp_cpu_t*)entry;
+                if (cpu->flags & MP_CPU_BSP)
+                    cpus[SMP_BSP_ID].apic_id = cpu->apic_id;
+                else if ((cpu->flags & MP_CPU_ENABLED) && cpu_num < SMP_MAX_CPU)
+                    cpus[cpu_num++].apic_id = cpu->apic_id;
+                entry += sizeof(mp_cpu_t);
+                break;
+            case MP_ENTRY_BUS:
+                if (((mp_bus_t*)entry)->bus_id < MP_MAX_BUS)
+                    isa_bus[((mp_bus_t*)entry)->bus_id] =
+                        !strncmp((int8_t*)((mp_bus_t*)entry)->bus_type, MP_BUS_ISA, sizeof(MP_BUS_ISA) - 1);
+                entry += sizeof(mp_bus_t);
+                break;
+            case MP_ENTRY_IOAPIC:
+                /* only the first I/O APIC is used, ISA IRQs are on it */
+                if (*ioapic_addr == IOAPIC_DEFAULT_ADDR)
+                    *ioapic_addr = ((mp_ioapic_t*)entry)->addr;
+                entry += sizeof(mp_ioapic_t);
+                break;
+            case MP_ENTRY_IOINT:
+                ioint = (mp_ioint_t*)entry;
+                if (ioint->int_type == MP_IOINT_INT && ioint->src_bus < MP_MAX_BUS &&
+                    isa_bus[ioint->src_bus] && ioint->src_irq < APIC_ISA_IRQ_NUM)
+                    isa_pin[ioint->src_irq] = ioint->dst_pin;
+                entry += sizeof(mp_ioint_t);
+                break;
+            case MP_ENTRY_LINT:
+                entry += sizeof(mp_ioint_t);
+                break;
+            default:
+                /* unknown entry, its size is unknown as well */
+                return (cpu_num > 1) ? 0 : -1;
+        }
+    }
+
+    return (cpu_num > 1) ? 0 : -1;
+}
+
+/*
+ * cpu_load_gdt
+ * DESCRIPTION: give a processor its own copy of the bootstrap processor's GDT with its own
+ *              TSS descriptor, and load it, so that this_cpu works on it
+ * INPUT: cpu -- the calling processor
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: GDTR and TR of the calling processor changed
+ */
+static void cpu_load_gdt(cpu_t* cpu)
+{
+    table_desc_t gdtr;  /* new GDTR image */
+    seg_desc_t* desc;   /* TSS descriptor */
+
+    memcpy(cpu->gdt, (void*)bsp_gdtr.base, bsp_gdtr.limit + 1);
+
+    cpu->ap_tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->ap_tss.ss0 = KERNEL_DS;
+    cpu->ap_tss.esp0 = (uint32_t)ap_stack[cpu->id - 1] + CPU_STACK_SIZE;
+    cpu->tss = &cpu->ap_tss;
+    desc = &cpu->gdt[KERNEL_TSS >> 3];
+    SET_TSS_PARAMS((*desc), &cpu->ap_tss, tss_size);
+    desc->type = 0x9;
+
+    gdtr.limit = bsp_gdtr.limit;
+    gdtr.base = (uint32_t)cpu->gdt;
+    asm volatile ("lgdt %0" : : "m"(gdtr) : "memory");
+    ltr(KERNEL_TSS);
+    lldt(KERNEL_LDT);
+}
+#endif
+
+/*
+ * smp_init_bsp
+ * DESCRIPTION: set up the per-processor data of the bootstrap processor. In SMP mode it also
+ *              moves to its own copy of the GDT, after that this_cpu works. Must be called
+ *              before anything uses curr_pid.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: GDTR may change
+ */
+void smp_init_bsp()
+{
+    cpu_t* cpu = &cpus[SMP_BSP_ID];     /* bootstrap processor */
+
+    cpu->id = SMP_BSP_ID;
+    cpu->online = 1;
+    cpu->pid = -1;
+    cpu->fd_array = NULL;
+    cpu->tss = &tss;
+    cpu->pd = page_directory;
+    cpu->vid_pt = vid_page_table;
+    cpu->lock_depth = 0;
+    cpu->ticks = 0;
+    cpu->idle_on = 0;
+    cpu->idle_stack = (uint32_t)bsp_idle_stack + CPU_STACK_SIZE;
+
+#if SMP_ON
+    {
+        table_desc_t gdtr;  /* new GDTR image */
+
+        asm volatile ("sgdt %0" : "=m"(bsp_gdtr));
+        if (bsp_gdtr.limit + 1 > sizeof(cpu->gdt))
+            bsp_gdtr.limit = sizeof(cpu->gdt) - 1;
+        memcpy(cpu->gdt, (void*)bsp_gdtr.base, bsp_gdtr.limit + 1);
+        bsp_gdtr.base = (uint32_t)cpu->gdt;
+
+        /* TR keeps the descriptor it has loaded, the busy copy does not matter */
+        gdtr = bsp_gdtr;
+        asm volatile ("lgdt %0" : : "m"(gdtr) : "memory");
+    }
+#endif
+}
+
+/*
+ * smp_init
+ * DESCRIPTION: find the processors in the MP table and move device interrupts from the 8259
+ *              to the I/O APIC. Nothing changes if SMP is off or there is only one processor.
+ *              Must be called after paging_init and i8259_init and before devices enable IRQs.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: number of processors
+ * SIDE AFFECTS: the first 1MB stays mapped until smp_boot_aps
+ */
+int32_t smp_init()
+{
+#if SMP_ON
+    uint32_t lapic_addr;                    /* local APIC address               */
+    uint32_t ioapic_addr;                   /* I/O APIC address                 */
+    uint8_t isa_pin[APIC_ISA_IRQ_NUM];      /* I/O APIC pin of ISA IRQs         */
+    uint32_t i;                             /* loop index for processors        */
+
+    low_mem_map(1);
+    if (mp_parse(&lapic_addr, &ioapic_addr, isa_pin) == -1 || apic_init(lapic_addr, ioapic_addr, isa_pin) == -1)
+    {
+        cpu_num = 1;
+        low_mem_map(0);
+        printf("SMP: no MP table, running on one processor\n");
+        return cpu_num;
+    }
+
+    /* the MP table may list the bootstrap processor with another id */
+    cpus[SMP_BSP_ID].apic_id = lapic_id();
+
+    for (i = 1; i < cpu_num; i++)
+    {
+        cpus[i].id = i;
+        cpus[i].online = 0;
+        cpus[i].pid = -1;
+        cpus[i].fd_array = NULL;
+        cpus[i].lock_depth = 0;
+        cpus[i].ticks = 0;
+        cpus[i].idle_on = 0;
+        cpus[i].idle_stack = (uint32_t)ap_stack[i - 1] + CPU_STACK_SIZE;
+        cpus[i].pd = ap_page_directory[i - 1];
+        cpus[i].vid_pt = ap_vid_page_table[i - 1];
+    }
+
+    asm volatile ("sidt %0" : "=m"(bsp_idtr));
+#endif
+    return cpu_num;
+}
+
+/*
+ * smp_boot_aps
+ * DESCRIPTION: start the application processors one by one. Each gets a page directory with
+ *              the kernel part of the bootstrap processor's one, enters ap_main through the
+ *              real mode trampoline and then waits in its idle loop for a process to run.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: cpu_num is the number of processors that came online
+ */
+void smp_boot_aps()
+{
+#if SMP_ON
+    uint32_t i;             /* loop index for processors    */
+    uint32_t online;        /* processors online            */
+    uint32_t ms;            /* time waited                  */
+    cpu_t* cpu;             /* processor being started      */
+
+    if (cpu_num == 1)
+        return;
+
+    memcpy((void*)AP_TRAMPOLINE_ADDR, ap_trampoline, ap_trampoline_end - ap_trampoline);
+
+    online = 1;
+    for (i = 1; i < cpu_num; i++)
+    {
+        cpu = &cpus[i];
+
+        /* kernel mappings only, user and vidmap pages are set when it runs a process */
+        memcpy(cpu->pd, page_directory, sizeof(page_directory));
+        cpu->pd[ADDR_128MB / PAGE_4MB_SIZE].p = 0;
+        cpu->pd[VIDMAP_OFFSET].p = 0;
+        memset(cpu->vid_pt, 0, sizeof(vid_page_table));
+
+        *(uint32_t*)(AP_TRAMPOLINE_ADDR + (ap_tramp_cr3 - ap_trampoline)) = (uint32_t)cpu->pd;
+        *(uint32_t*)(AP_TRAMPOLINE_ADDR + (ap_tramp_stack - ap_trampoline)) = (uint32_t)ap_stack[i - 1] + CPU_STACK_SIZE;
+        *(uint32_t*)(AP_TRAMPOLINE_ADDR + (ap_tramp_entry - ap_trampoline)) = (uint32_t)ap_main;
+        ap_booting = i;
+
+        lapic_start_ap(cpu->apic_id, AP_TRAMPOLINE_ADDR);
+        for (ms = 0; ms < SMP_AP_WAIT_MS && !cpu->online; ms++)
+            lapic_delay_us(APIC_US_PER_MS);
+
+        if (cpu->online)
+            online++;
+        else
+            printf("SMP: processor %d (APIC %d) did not start\n", i, cpu->apic_id);
+    }
+
+    /* processors that did not start are dropped, they are the last ones */
+    if (online < cpu_num)
+    {
+        for (i = 1, online = 1; i < cpu_num; i++)
+        {
+            if (cpus[i].online)
+                online++;
+        }
+    }
+    cpu_num = online;
+    low_mem_map(0);
+    printf("SMP: %d processors online\n", cpu_num);
+#endif
+}
+
+/*
+ * ap_main
+ * DESCRIPTION: C entry of an application processor, reached from the trampoline with paging
+ *              on and the idle stack loaded. Load its own GDT, TSS and the IDT, start its local
+ *              APIC timer and enter the idle loop. The timer runs the scheduler, which steals a process
+ *              from the busiest run queue to take it off the idle loop.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: never returns
+ * SIDE AFFECTS: processor marked online
+ */
+void ap_main()
+{
+#if SMP_ON
+    cpu_t* cpu = &cpus[ap_booting];     /* this processor */
+
+    cpu_load_gdt(cpu);
+    asm volatile ("lidt %0" : : "m"(bsp_idtr));
+    /* SSE if the string routines use it, FPU state switched lazily */
+    lib_cpu_enable();
+    fpu_cpu_init(cpu);
+
+    lapic_init();
+    lapic_timer_start();
+    cpu->online = 1;
+    /* the boot stack is the idle loop's from now on */
+    cpu->idle_on = 1;
+#endif
+    cpu_idle();
+}
+
+/*
+ * kernel_enter
+ * DESCRIPTION: take the kernel lock, called by the linkage with interrupts disabled.
+ *              A processor already holding it only counts the nesting.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: may spin until another processor leaves the kernel
+ */
+void kernel_enter()
+{
+    cpu_t* cpu = this_cpu();    /* calling processor */
+
+    if (cpu->lock_depth++ == 0)
+        spin_lock(&kernel_spinlock);
+}
+
+/*
+ * kernel_exit
+ * DESCRIPTION: leave the kernel, called by the linkage with interrupts disabled.
+ *              The outermost exit releases the kernel lock.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: other processors may enter the kernel
+ */
+void kernel_exit()
+{
+    cpu_t* cpu = this_cpu();    /* calling processor */
+
+    if (cpu->lock_depth > 0 && --cpu->lock_depth == 0)
+        spin_unlock(&kernel_spinlock);
+}
+
+/*
+ * kernel_release
+ * DESCRIPTION: give up the kernel lock whatever the nesting is. Used when a new user program is
+ *              entered with IRET instead of through the linkage's return path.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: other processors may enter the kernel
+ */
+void kernel_release()
+{
+    cpu_t* cpu = this_cpu();    /* calling processor */
+
+    if (cpu->lock_depth > 0)
+    {
+        cpu->lock_depth = 0;
+        spin_unlock(&kernel_spinlock);
+    }
+}
+
+/*
+ * smp_relax
+ * DESCRIPTION: called in every iteration of a busy wait loop inside the kernel. With several
+ *              processors the kernel lock is dropped for a moment, so that the processor which
+ *              will end the wait (e.g. by taking the keyboard interrupt) can get in.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: other processors may run kernel code in the meantime
+ */
+void smp_relax()
+{
+#if SMP_ON
+    uint32_t flags;     /* saved eflags                 */
+    uint32_t depth;     /* nesting of the kernel lock   */
+    cpu_t* cpu;         /* calling processor            */
+
+    cli_and_save(flags);
+    cpu = this_cpu();
+    depth = cpu->lock_depth;
+    if (depth > 0)
+    {
+        cpu->lock_depth = 0;
+        spin_unlock(&kernel_spinlock);
+        asm volatile ("pause");
+        spin_lock(&kernel_spinlock);
+        cpu->lock_depth = depth;
+    }
+    restore_flags(flags);
+#else
+    asm volatile ("pause");
+#endif
+}
@@ -0,0 +1,138 @@
+/*
+    smp.h header file
+*/
+
+#ifndef _SMP_H
+#define _SMP_H
+
+/* If it is set to 1, every processor in the MP table is started (e.g. qemu -smp 4) */
+#ifndef SMP_ON
+#define SMP_ON              0
+#endif
+
+#define SMP_MAX_CPU         8
+#define SMP_BSP_ID          0           /* index of the bootstrap processor in cpus */
+#define SMP_AP_WAIT_MS      100         /* time given to an application processor to come online */
+#define CPU_GDT_ENTRIES     16
+#define CPU_STACK_SIZE      8192        /* stack of a processor's idle loop */
+
+/* real mode entry of application processors, copied below 1MB, see ap_boot.S */
+#define AP_TRAMPOLINE_ADDR  0x8000
+/* control register bits set by the trampoline */
+#define CR0_PE              0x00000001
+#define CR0_WP              0x00010000
+#define CR0_PG              0x80000000
+#define CR4_PSE             0x00000010
+/* control register bits for SSE, set by lib_cpu_enable */
+#define CR0_MP              0x00000002  /* WAIT honors CR0.TS       */
+#define CR0_EM              0x00000004  /* no x87, no SSE           */
+#define CR0_TS              0x00000008  /* next FPU use raises #NM  */
+#define CR4_OSFXSR          0x00000200  /* SSE enabled              */
+#define CR4_OSXMMEXCPT      0x00000400  /* SSE exceptions as #XM    */
+
+/* Reference: Intel MultiProcessor Specification 1.4, chapter 4 */
+#define MP_FLOAT_SIG        0x5F504D5F  /* "_MP_" */
+#define MP_CONFIG_SIG       0x504D4350  /* "PCMP" */
+#define MP_FLOAT_ALIGN      16
+#define MP_EBDA_SEG_PTR     0x40E       /* BIOS data area word holding the EBDA segment */
+#define MP_EBDA_SCAN_SIZE   1024
+#define MP_BASE_MEM_TOP     0xA0000     /* the last KB of base memory is searched if there is no EBDA */
+#define MP_BIOS_ROM_ADDR    0xF0000
+#define MP_BIOS_ROM_SIZE    0x10000
+#define MP_LOW_MEM_END      0x100000    /* the whole search and the config table must be below 1MB */
+#define MP_ENTRY_CPU        0
+#define MP_ENTRY_BUS        1
+#define MP_ENTRY_IOAPIC     2
+#define MP_ENTRY_IOINT      3
+#define MP_ENTRY_LINT       4
+#define MP_CPU_ENABLED      0x01
+#define MP_CPU_BSP          0x02
+#define MP_IOINT_INT        0           /* vectored interrupt, as opposed to NMI/SMI/ExtINT */
+#define MP_MAX_BUS          32
+#define MP_BUS_TYPE_LEN     6
+#define MP_BUS_ISA          "ISA"
+
+#ifndef ASM
+
+#include "types.h"
+#include "x86_desc.h"
+#include "paging.h"
+
+struct file_desc_t;
+
+/*
+ * per-processor data. Every processor loads its own copy of the GDT, so the GDT
+ * base found by sgdt is the address of its cpu_t (see this_cpu).
+ */
+typedef struct cpu_t {
+    seg_desc_t gdt[CPU_GDT_ENTRIES];    /* this processor's GDT, must be the first member   */
+    uint32_t id;                        /* index in cpus                                    */
+    uint32_t apic_id;                   /* local APIC id                                    */
+    volatile uint32_t online;           /* set by the processor when it is ready            */
+    uint32_t pid;                       /* current process, -1 when idle                    */
+    struct file_desc_t* fd_array;       /* current process' fd array                        */
+    tss_t* tss;                         /* task state segment loaded on this processor      */
+    page_dir_entry_t* pd;               /* page directory loaded on this processor          */
+    page_table_entry_t* vid_pt;         /* page table of the vidmap page                    */
+    uint32_t lock_depth;                /* nesting of the kernel lock on this processor     */
+    uint32_t ticks;                     /* local timer ticks                                */
+    uint32_t idle_on;                   /* the idle loop has started, see cpu_idle          */
+    uint32_t idle_stack;                /* top of the idle loop's stack                     */
+    uint32_t idle_esp;                  /* idle loop context while a process runs           */
+    uint32_t idle_ebp;
+    uint32_t idle_lock_depth;
+    int32_t fpu_owner;                  /* process whose FPU state is in the registers, -1 if none */
+    tss_t ap_tss;                       /* storage of tss for application processors        */
+} cpu_t;
+
+/* GDTR/IDTR image */
+typedef struct table_desc_t {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) table_desc_t;
+
+/* per-processor data, cpus[SMP_BSP_ID] is the bootstrap processor */
+extern cpu_t cpus[SMP_MAX_CPU];
+/* number of processors in use */
+extern uint32_t cpu_num;
+
+/* per-processor data of the calling processor */
+#if SMP_ON
+static inline cpu_t* this_cpu()
+{
+    table_desc_t gdtr;  /* GDT of this processor */
+
+    asm volatile ("sgdt %0" : "=m"(gdtr));
+    return (cpu_t*)gdtr.base;
+}
+#else
+#define this_cpu()          (&cpus[SMP_BSP_ID])
+#endif
+
+/* set up the per-processor data of the bootstrap processor */
+void smp_init_bsp();
+/* find the processors and switch interrupt delivery to the APICs */
+int32_t smp_init();
+/* start every application processor found by smp_init */
+void smp_boot_aps();
+/* C entry of an application processor, see ap_boot.S */
+void ap_main();
+
+/* take the kernel lock when entering the kernel, nested entries only count */
+void kernel_enter();
+/* leave the kernel, the lock is released by the outermost exit */
+void kernel_exit();
+/* give the kernel lock up completely, right before entering a new user program */
+void kernel_release();
+/* let other processors into the kernel for a moment, called in busy wait loops */
+void smp_relax();
+
+/* real mode trampoline and the slots the bootstrap processor fills in, see ap_boot.S */
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_tramp_cr3[];
+extern uint8_t ap_tramp_stack[];
+extern uint8_t ap_tramp_entry[];
+
+#endif
+#endif
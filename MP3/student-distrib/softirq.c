@@ -0,0 +1,218 @@
+/*
+    softirq
+    bottom halves of interrupt handlers: a top half only acknowledges the device, saves
+    what it read and raises a softirq, the work is done with interrupts enabled on the
+    way out of the interrupt
+*/
+
+#include "softirq.h"
+#include "syscall.h"
+#include "trace.h"
+#include "lib.h"
+
+/* bitmap of raised softirqs */
+static volatile uint32_t softirq_pending = 0;
+/* 1 while some process is inside do_softirq, which process it is */
+static volatile uint32_t softirq_running = 0;
+static volatile int32_t softirq_pid = -1;
+/* scheduled tasklets, in order */
+static tasklet_t* tasklet_head = NULL;
+static tasklet_t* tasklet_tail = NULL;
+
+/*
+ * tasklet_action
+ * DESCRIPTION: softirq handler of SOFTIRQ_TASKLET, take the whole list and run every tasklet once
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: tasklet list emptied
+ */
+static void tasklet_action()
+{
+    tasklet_t* list;    /* tasklets taken from the list */
+    tasklet_t* next;    /* next tasklet to run          */
+    uint32_t flags;     /* saved eflags                 */
+
+    cli_and_save(flags);
+    list = tasklet_head;
+    tasklet_head = tasklet_tail = NULL;
+    restore_flags(flags);
+
+    while (list != NULL)
+    {
+        next = list->next;
+        /* it may be scheduled again by an interrupt while running */
+        list->scheduled = 0;
+        list->func(list->data);
+        list = next;
+    }
+}
+
+/* handlers of softirqs, tasklets are always there */
+static softirq_handler_t softirq_handler[SOFTIRQ_NUM] = {
+    [SOFTIRQ_TASKLET] = tasklet_action
+};
+
+/*
+ * softirq_open
+ * DESCRIPTION: install the handler of a softirq
+ * INPUT: nr -- softirq number
+ *        handler -- handler, NULL to remove
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void softirq_open(uint32_t nr, softirq_handler_t handler)
+{
+    /* sanity check */
+    if (nr >= SOFTIRQ_NUM)
+        return;
+
+    softirq_handler[nr] = handler;
+}
+
+/*
+ * softirq_raise
+ * DESCRIPTION: mark a softirq pending, it runs on the next return from an interrupt,
+ *              exception or system call that is not nested in another softirq
+ * INPUT: nr -- softirq number
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void softirq_raise(uint32_t nr)
+{
+    /* sanity check */
+    if (nr >= SOFTIRQ_NUM)
+        return;
+
+    asm volatile ("lock orl %1, %0" : "+m"(softirq_pending) : "r"(1 << nr) : "memory", "cc");
+}
+
+/*
+ * tasklet_schedule
+ * DESCRIPTION: queue a tasklet, a tasklet already on the list is not queued twice
+ * INPUT: tasklet -- tasklet to run
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: SOFTIRQ_TASKLET raised
+ */
+void tasklet_schedule(tasklet_t* tasklet)
+{
+    uint32_t flags;     /* saved eflags */
+
+    cli_and_save(flags);
+    if (!tasklet->scheduled)
+    {
+        tasklet->scheduled = 1;
+        tasklet->next = NULL;
+        if (tasklet_tail == NULL)
+            tasklet_head = tasklet;
+        else
+            tasklet_tail->next = tasklet;
+        tasklet_tail = tasklet;
+        softirq_raise(SOFTIRQ_TASKLET);
+    }
+    restore_flags(flags);
+}
+
+/*
+ * softirq_busy
+ * DESCRIPTION: check whether the current process is in the middle of do_softirq.
+ *              The scheduler does not switch away from it, so that bottom halves never
+ *              interleave with each other.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: 1 if it is, 0 if not
+ * SIDE AFFECTS: none
+ */
+int32_t softirq_busy()
+{
+    return (softirq_running && softirq_pid == curr_pid) ? 1 : 0;
+}
+
+/*
+ * softirq_leave
+ * DESCRIPTION: a bottom half is about to start a program, which leaves the kernel by iret without
+ *              coming back through do_softirq. Give up the running flag, or the bottom halves of
+ *              every other process would wait until this one is scheduled again.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: 1 if the current process was running softirqs, 0 if not, for softirq_return
+ * SIDE AFFECTS: softirqs may run in other processes
+ */
+int32_t softirq_leave()
+{
+    int32_t busy;       /* whether softirqs were running */
+    uint32_t flags;     /* saved eflags                  */
+
+    cli_and_save(flags);
+    busy = softirq_busy();
+    if (busy)
+        softirq_running = 0;
+    restore_flags(flags);
+    return busy;
+}
+
+/*
+ * softirq_return
+ * DESCRIPTION: back in the bottom half after softirq_leave, take the running flag again. No other
+ *              process holds it, the scheduler does not switch away from one that does.
+ * INPUT: busy -- what softirq_leave returned
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+void softirq_return(int32_t busy)
+{
+    uint32_t flags;     /* saved eflags */
+
+    if (!busy)
+        return;
+
+    cli_and_save(flags);
+    softirq_running = 1;
+    softirq_pid = curr_pid;
+    restore_flags(flags);
+}
+
+/*
+ * do_softirq
+ * DESCRIPTION: run pending softirqs with interrupts enabled. Nothing is done if the interrupted
+ *              code had interrupts disabled (it may be a top half or a cli section) or if
+ *              softirqs are already running, they pick up the new ones before they finish.
+ *              A bottom half may start a shell in a new terminal and come back only when that
+ *              process is scheduled out, it gives the flag up meanwhile with softirq_leave.
+ *              Called by the linkage with interrupts disabled, returns with them disabled.
+ * INPUT: context -- hardware context saved on the kernel stack
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: bottom halves run
+ */
+void do_softirq(hw_context_t* context)
+{
+    uint32_t pending;   /* softirqs taken in this round */
+    uint32_t nr;        /* loop index for softirqs      */
+    int restart;        /* rounds done                  */
+
+    if (!(context->eflags & SIGNAL_EFLAGS_IF) || softirq_running || softirq_pending == 0)
+        return;
+
+    softirq_running = 1;
+    softirq_pid = curr_pid;
+
+    for (restart = 0; restart < SOFTIRQ_MAX_RESTART && (pending = softirq_pending) != 0; restart++)
+    {
+        softirq_pending = 0;
+        TRACE(TRACE_SOFTIRQ, pending, 0);
+        sti();
+        for (nr = 0; nr < SOFTIRQ_NUM; nr++)
+        {
+            if ((pending & (1 << nr)) && softirq_handler[nr] != NULL)
+                softirq_handler[nr]();
+        }
+        cli();
+    }
+
+    softirq_running = 0;
+}
@@ -0,0 +1,49 @@
+/*
+    softirq.h header file
+*/
+
+#ifndef _SOFTIRQ_H
+#define _SOFTIRQ_H
+
+#include "types.h"
+#include "signal.h"
+
+/* softirq numbers, lower number runs first */
+#define SOFTIRQ_KEYBOARD        0   /* scancodes queued by the keyboard handler */
+#define SOFTIRQ_TASKLET         1   /* scheduled tasklets                       */
+#define SOFTIRQ_NUM             2
+
+/* rounds of newly raised softirqs handled in one do_softirq, the rest waits for the next return */
+#define SOFTIRQ_MAX_RESTART     10
+
+/* softirq handler, runs with interrupts enabled */
+typedef void (*softirq_handler_t)();
+
+/* deferred work item, can be scheduled again once it has started running */
+typedef struct tasklet_t {
+    struct tasklet_t* next;         /* next scheduled tasklet           */
+    void (*func)(uint32_t data);    /* work to do                       */
+    uint32_t data;                  /* argument of func                 */
+    volatile uint32_t scheduled;    /* 1 if it is on the list           */
+} tasklet_t;
+
+/* install the handler of a softirq */
+void softirq_open(uint32_t nr, softirq_handler_t handler);
+
+/* mark a softirq pending, can be called from interrupt handlers */
+void softirq_raise(uint32_t nr);
+
+/* queue a tasklet to run once, can be called from interrupt handlers */
+void tasklet_schedule(tasklet_t* tasklet);
+
+/* check whether the current process is running softirqs */
+int32_t softirq_busy();
+
+/* a bottom half starts a program, stop running softirqs until softirq_return */
+int32_t softirq_leave();
+void softirq_return(int32_t busy);
+
+/* run pending softirqs with interrupts enabled, called by the linkage before iret */
+void do_softirq(hw_context_t* context);
+
+#endif
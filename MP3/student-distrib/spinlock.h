@@ -0,0 +1,81 @@
+/*
+    spinlock.h header file
+*/
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+#define SPINLOCK_FREE       0
+#define SPINLOCK_TAKEN      1
+#define SPINLOCK_INIT       { SPINLOCK_FREE }
+
+/* lock word, only changed with xchg */
+typedef struct spinlock_t {
+    volatile uint32_t lock;
+} spinlock_t;
+
+/*
+ * spin_trylock
+ * DESCRIPTION: try to take a spinlock once
+ * INPUT: lock -- spinlock
+ * OUTPUT: none
+ * RETURN: 1 if the lock is taken, 0 if someone else holds it
+ * SIDE AFFECTS: none
+ */
+static inline int32_t spin_trylock(spinlock_t* lock)
+{
+    uint32_t old = SPINLOCK_TAKEN;     /* previous lock word */
+
+    asm volatile ("xchgl %0, %1" : "+r"(old), "+m"(lock->lock) : : "memory");
+    return old == SPINLOCK_FREE;
+}
+
+/*
+ * spin_lock
+ * DESCRIPTION: take a spinlock, spin on plain reads until it looks free
+ * INPUT: lock -- spinlock
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: busy waits
+ */
+static inline void spin_lock(spinlock_t* lock)
+{
+    while (!spin_trylock(lock))
+    {
+        while (lock->lock != SPINLOCK_FREE)
+            asm volatile ("pause" : : : "memory");
+    }
+}
+
+/*
+ * spin_unlock
+ * DESCRIPTION: release a spinlock
+ * INPUT: lock -- spinlock
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static inline void spin_unlock(spinlock_t* lock)
+{
+    asm volatile ("" : : : "memory");
+    lock->lock = SPINLOCK_FREE;
+}
+
+/* take a spinlock with interrupts disabled, keep the old eflags in flags */
+#define spin_lock_irqsave(lock, flags)      \
+do {                                        \
+    cli_and_save(flags);                    \
+    spin_lock(lock);                        \
+} while (0)
+
+/* release a spinlock taken by spin_lock_irqsave */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                        \
+    spin_unlock(lock);                      \
+    restore_flags(flags);                   \
+} while (0)
+
+#endif
@@ -5,6 +5,16 @@
 #include "rtc.h"
 #include "filesys.h"
 #include "terminal.h"
+#include "signal.h"
+#include "trace.h"
+#include "schedule.h"
+#include "elf.h"
+#include "imgcache.h"
+#include "bootlog.h"
+#include "vga.h"
+#include "blink.h"
+#include "shm.h"
+#include "thread.h"
 
 /* file operation table array */
 static file_op_table_t file_op_table_arr[FILE_TYPE_NUM];
@@ -31,6 +41,14 @@ int32_t halt(uint8_t status)
 
     /* get current process' pcb pointer */
     curr_pcb = get_pcb_ptr(curr_pid);
+    TRACE(TRACE_HALT, status, curr_pcb->parent_pid);
+
+    /* a thread returns to nobody, it waits to be joined */
+    if(curr_pcb->mm_pid != curr_pcb->pid)
+        thread_exit((status == HALT_EXCEPTION) ? HALT_EXCEPTION_RETVAL : status);
+
+    /* the program's threads halt before its memory and files go away */
+    thread_reap_all();
 
     /* get current process' terminal id */
     curr_process_term_id = curr_pcb->term_id;
@@ -38,6 +56,18 @@ int32_t halt(uint8_t status)
     /* clear pid */
     pid_array[curr_pcb->pid] = 0;
 
+    /* the program's cached image may be evicted once nobody runs it */
+    imgcache_put(curr_pcb->img_idx);
+
+    /* a program that took the screen leaves it in text mode */
+    vga_release(curr_pcb->pid);
+    /* and its blinking cells stop */
+    blink_release(curr_pcb->pid);
+    /* and lets its shared memory segments go */
+    shm_release(curr_pcb->pid);
+    /* its FPU state is dropped, the parent traps on its first use */
+    fpu_switch(this_cpu(), NULL);
+
     /* get parent pcb, if current process is the base shell, just load itsself as its parent for re-executing */
     parent_pcb = get_pcb_ptr((curr_pcb->parent_pid == NO_PARENT_PID) ? curr_pid : curr_pcb->parent_pid);
 
@@ -53,30 +83,39 @@ int32_t halt(uint8_t status)
     cur_fd_array[1].op = NULL;
     cur_fd_array[1].flags = FD_FLAG_FREE;
 
-    /* restore parent fd array */
-    cur_fd_array = parent_pcb->fd_array;
+    /* restore parent fd array, the parent may be a thread */
+    cur_fd_array = get_pcb_ptr(parent_pcb->mm_pid)->fd_array;
 
     /* restore parent paging */
-    set_paging(parent_pcb->pid);
+    set_paging(parent_pcb->mm_pid);
+    /* execute hid the framebuffer from the child, give it back if the parent owns the screen */
+    vga_map(parent_pcb->mm_pid);
 
     /* restore tss data, i.e. kernel stack pointer */
-    tss.esp0 = KS_BASE_ADDR - KS_SIZE*parent_pcb->pid - sizeof(int32_t);
+    this_cpu()->tss->esp0 = KS_BASE_ADDR - KS_SIZE*parent_pcb->pid - sizeof(int32_t);
 
     /* update terminal info */
     terminals[curr_process_term_id].pnum--;
 
-    /* if it is the base shell, restart it */
+    /* if it is the base shell, restart it in the first terminal and close any other terminal */
     if(curr_pcb->parent_pid == NO_PARENT_PID){
-        clear();
-        sti();
-        execute((uint8_t*)"shell");
+        if(curr_process_term_id == FIRST_TERMINAL_ID){
+            clear();
+            sti();
+            execute((uint8_t*)"shell");
+        }
+        terminal_release(curr_process_term_id);
+        sched_exit();
     }
 
     /* update pid */
     curr_pid = parent_pcb->pid;
 
     /* update terminal info */
-    terminals[curr_process_term_id].curr_pid = curr_pid;
+    terminals[curr_process_term_id].active_pid = curr_pid;
+
+    /* the parent goes on with the kernel lock nesting it had in execute */
+    this_cpu()->lock_depth = parent_pcb->lock_depth;
 
     /* decide return value according to the halt status */
     retval = (status == HALT_EXCEPTION) ? HALT_EXCEPTION_RETVAL : (uint16_t)status;
@@ -120,8 +159,10 @@ int32_t execute(const uint8_t *cmd)
     /* parsed command and argument */
     uint8_t command[MAX_CMD_LEN];
     uint8_t argument[MAX_ARG_LEN];
-    /* file excitability check buffer */
-    uint8_t check_buffer[CHECK_BUFFER_SIZE];
+    /* loadable segments of the program */
+    elf_image_t image;
+    /* image cache entry of the program, -1 if it is loaded privately */
+    int32_t img_idx;
     /* loop index */
     int i;
     /* start, end of the cmd and arg, used in parser */
@@ -190,10 +231,10 @@ int32_t execute(const uint8_t *cmd)
         sti();
         return -1;
     }
-    /* read magic number of the excutable file */
-    read_data(check_dentry.inode_idx, 0, check_buffer, CHECK_BUFFER_SIZE);
-    /* check the magic number of the excutable file: 0x7F, E, L, F */
-    if(check_buffer[0]!=0x7f && check_buffer[1]!='E' && check_buffer[2]!='L' && check_buffer[3]!= 'F')
+    /* a cached program was checked when it was cached, anything else has its ELF headers
+       checked, a malformed program is rejected before anything changes */
+    img_idx = imgcache_get(check_dentry.inode_idx, &image);
+    if(img_idx == -1 && elf_check(check_dentry.inode_idx, get_file_size(&check_dentry), &image) == -1)
     {
         sti();
         return -1;
@@ -210,6 +251,7 @@ int32_t execute(const uint8_t *cmd)
         set_paging(new_pid);
     }else{
         /* Current number of running process exceeds */
+        imgcache_put(img_idx);
         sti();
         return HALT_SPECIAL;
     }
@@ -217,7 +259,17 @@ int32_t execute(const uint8_t *cmd)
     /* ==================== *
      * 4. load user program *
      * ==================== */
-    if(read_data(check_dentry.inode_idx, 0, (uint8_t*)PROGRAM_VIRTUAL_ADDR, get_file_size(&check_dentry)) == -1){
+    /* the first execute of a program fills the cache, a program that does not fit
+       is loaded privately */
+    if(img_idx == -1)
+        img_idx = imgcache_add(&image);
+    if(img_idx != -1)
+        imgcache_map(img_idx, new_pid);
+    else if(elf_load(new_pid, &image) == -1){
+        /* give the pid back and the caller its pages */
+        pid_array[new_pid] = 0;
+        if(curr_pid != -1)
+            set_paging(curr_mm);
         sti();
         return -1;
     }
@@ -245,6 +297,10 @@ int32_t execute(const uint8_t *cmd)
     new_pcb = get_pcb_ptr(new_pid);
     /* set process id */
     new_pcb->pid = new_pid;
+    /* it uses its own memory and files, it is not a thread */
+    new_pcb->mm_pid = new_pid;
+    new_pcb->stack_slot = 0;
+    new_pcb->killed = 0;
     /* set parent process id and terminal id */
     if(terminals[curr_term_id].pnum == 0){
         /* if it is the base shell */
@@ -279,8 +335,29 @@ int32_t execute(const uint8_t *cmd)
     /* set argument */
     strncpy((int8_t*)new_pcb->arg,(int8_t*)argument, MAX_ARG_LEN);
 
+    /* set program name */
+    strncpy((int8_t*)new_pcb->name, (int8_t*)command, MAX_FILE_NAME_LEN);
+    new_pcb->name[MAX_FILE_NAME_LEN] = '\0';
+
+    /* default action for every signal */
+    signal_init_pcb(new_pid);
+
+    /* clear accounting */
+    memset(&new_pcb->acct, 0, sizeof(acct_t));
+
+    /* .bss, heap and stack pages are filled on demand */
+    new_pcb->lazy_start = image.lazy_start;
+    new_pcb->mem_end = image.mem_end;
+    /* released in halt */
+    new_pcb->img_idx = img_idx;
+    /* FPU state is given on first use */
+    fpu_init_pcb(new_pcb);
+    /* not waiting for anything */
+    new_pcb->state = PROC_RUNNABLE;
+    new_pcb->wait_chan = NULL;
+
     /* set kernel stack pointer */
-    tss.esp0 = KS_BASE_ADDR - KS_SIZE * new_pid - sizeof(int32_t);
+    this_cpu()->tss->esp0 = KS_BASE_ADDR - KS_SIZE * new_pid - sizeof(int32_t);
 
     /* store esp and ebp if it is not the first shell of first kernel */
     /* this esp & ebp can be used for halt when system want to restore parent stack info */
@@ -303,23 +380,50 @@ int32_t execute(const uint8_t *cmd)
             "
             : "=r"(curr_pcb->ebp), "=r"(curr_pcb->esp)
         );
+        curr_pcb->lock_depth = this_cpu()->lock_depth;
+        /* the parent's FPU state is kept if it used it */
+        fpu_switch(this_cpu(), curr_pcb);
+        /* a process left behind in another terminal is still ready to run */
+        if(curr_pcb->term_id != new_pcb->term_id && is_pid_used(curr_pid))
+            rq_enqueue(this_cpu()->id, curr_pid);
+    }else if(this_cpu()->idle_on){
+        /* started from an interrupt of the idle loop, e.g. a new terminal, the idle loop goes on later */
+        asm volatile("                                \n\
+            movl %%ebp, %0                            \n\
+            movl %%esp, %1                            \n\
+            "
+            : "=r"(this_cpu()->idle_ebp), "=r"(this_cpu()->idle_esp)
+        );
+        this_cpu()->idle_lock_depth = this_cpu()->lock_depth;
+        fpu_switch(this_cpu(), NULL);
     }
 
+    /* the boot timeline ends when the first program is about to run */
+    boot_finish();
+
     /* update current pid */
+    TRACE(TRACE_EXECUTE, new_pid, 0);
     curr_pid = new_pid;
 
     /* update terminal info */
-    terminals[curr_term_id].curr_pid = curr_pid;
-    terminals[curr_term_id].pnum++;
+    terminals[new_pcb->term_id].active_pid = curr_pid;
+    terminals[new_pcb->term_id].pnum++;
+
+    /* a child of the screen's owner does not see the framebuffer */
+    vga_map(new_pid);
 
     /* ================================ *
      * 6.context switch to user program *
      * ================================ */
 
     /* set the address of the first instruction */
-    new_eip = *(int32_t*)PROGRAM_START_ADDR;
+    new_eip = image.entry;
     new_esp = USER_STACK_ADDR;
 
+    /* the kernel lock is not given back by the interrupt return path here */
+    cli();
+    kernel_release();
+
     /* set infomation for IRET to user program space, enable interrupt */
     asm volatile ("                                                \n\
         movw    %%cx, %%ds                                         \n\
@@ -378,7 +482,7 @@ int32_t open(const char *fname)
         return -1;
 
     /* if success, set the file descriptor */
-    cur_fd_array[fd].inode_idx = (dentry.file_type == FILE_TYPE) ? dentry.inode_idx : -1;
+    cur_fd_array[fd].inode_idx = (dentry.file_type == FILE_TYPE || dentry.file_type == PSEUDO_TYPE || dentry.file_type == DIR_TYPE) ? dentry.inode_idx : -1;
     cur_fd_array[fd].file_offset = 0;
     cur_fd_array[fd].flags = FD_FLAG_BUSY;
 
@@ -427,12 +531,45 @@ int32_t close(int32_t fd)
  */
 int32_t read(int32_t fd, void *buf, int32_t nbytes)
 {
+    int32_t ret;    /* return value of perticular read function */
+
     /* sanity check */
     if (fd < 0 || fd > MAX_FILE_NUM || fd == FD_STDOUT_IDX || buf == NULL || cur_fd_array == NULL || cur_fd_array[fd].flags == FD_FLAG_FREE || cur_fd_array[fd].op == NULL)
         return -1;
 
     /* call corresponding read function */
-    return cur_fd_array[fd].op->read(fd, buf, nbytes);
+    if ((ret = cur_fd_array[fd].op->read(fd, buf, nbytes)) > 0)
+        get_pcb_ptr(curr_pid)->acct.read_bytes += ret;
+    return ret;
+}
+
+/*
+ * getdents
+ * DESCRIPTION: system call getdents, fill the buffer with as many packed directory entries
+ *              as fit (see dirent_t), so that a directory is listed in one call instead of
+ *              one read per name. The position is kept in the file descriptor.
+ * INPUT: fd -- file descriptor of an opened directory
+ *        buf -- buffer to be filled in, in the program page (128MB-132MB)
+ *        nbytes -- size of the buffer
+ * OUTPUT: none
+ * RETURN: number of bytes filled, 0 at the end of the directory, -1 for fail
+ * SIDE AFFECTS: file offset advanced
+ */
+int32_t getdents(int32_t fd, void* buf, int32_t nbytes)
+{
+    int32_t ret;    /* return value of dir_getdents */
+
+    /* sanity check */
+    if (fd < FDA_FILE_START_IDX || fd >= MAX_FILE_NUM || buf == NULL || nbytes < 0 || cur_fd_array == NULL || cur_fd_array[fd].flags == FD_FLAG_FREE || cur_fd_array[fd].op != &file_op_table_arr[DIR_TYPE])
+        return -1;
+
+    /* the entries are written by the kernel, the whole buffer must be in the program page */
+    if ((uint32_t)buf < ADDR_128MB || (uint32_t)buf >= ADDR_132MB || (uint32_t)nbytes > ADDR_132MB - (uint32_t)buf)
+        return -1;
+
+    if ((ret = dir_getdents(fd, buf, nbytes)) > 0)
+        get_pcb_ptr(curr_pid)->acct.read_bytes += ret;
+    return ret;
 }
 
 /*
@@ -447,12 +584,16 @@ int32_t read(int32_t fd, void *buf, int32_t nbytes)
  */
 int32_t write(int32_t fd, void *buf, int32_t nbytes)
 {
+    int32_t ret;    /* return value of perticular write function */
+
     /* sanity check */
     if (fd < 0 || fd > MAX_FILE_NUM || fd == FD_STDIN_IDX || buf == NULL || cur_fd_array == NULL || cur_fd_array[fd].flags == FD_FLAG_FREE || cur_fd_array[fd].op == NULL)
         return -1;
 
     /* call corresponding write function */
-    return cur_fd_array[fd].op->write(fd, buf, nbytes);
+    if ((ret = cur_fd_array[fd].op->write(fd, buf, nbytes)) > 0)
+        get_pcb_ptr(curr_pid)->acct.write_bytes += ret;
+    return ret;
 }
 
 /* 
@@ -489,6 +630,9 @@ int32_t getargs(uint8_t *buf, int32_t nbytes)
  */
 int32_t vidmap(uint8_t** screen_start)
 {
+    page_dir_entry_t* pd;       /* page directory of this processor */
+    page_table_entry_t* vid_pt; /* vidmap page table of this processor */
+
     /* check if the pointer is in user space */
     if ((unsigned int)screen_start <= ADDR_128MB || (unsigned int)screen_start >= ADDR_132MB)
         return -1;
@@ -496,15 +640,17 @@ int32_t vidmap(uint8_t** screen_start)
     /* output vidmem virtual address for user */
     *screen_start = (uint8_t*)VID_VIRTUAL_ADDR;
 
-    /* initialize the VIDMAP page */
-    page_directory[VIDMAP_OFFSET].p           = 1;    // present
-    page_directory[VIDMAP_OFFSET].r_w         = 1;    // enable r/w
-    page_directory[VIDMAP_OFFSET].u_s         = 1;    // user mode
-    page_directory[VIDMAP_OFFSET].base_addr   = (unsigned int)vid_page_table >> MEM_OFFSET_BITS;
-    vid_page_table[0].p = 1;    // present
-    vid_page_table[0].r_w = 1;  // enable r/w
-    vid_page_table[0].u_s = 1;  // user mode
-    vid_page_table[0].base_addr = VID_PHYS_ADDR >> MEM_OFFSET_BITS;
+    /* initialize the VIDMAP page of this processor */
+    pd = this_cpu()->pd;
+    vid_pt = this_cpu()->vid_pt;
+    pd[VIDMAP_OFFSET].p           = 1;    // present
+    pd[VIDMAP_OFFSET].r_w         = 1;    // enable r/w
+    pd[VIDMAP_OFFSET].u_s         = 1;    // user mode
+    pd[VIDMAP_OFFSET].base_addr   = (unsigned int)vid_pt >> MEM_OFFSET_BITS;
+    vid_pt[0].p = 1;    // present
+    vid_pt[0].r_w = 1;  // enable r/w
+    vid_pt[0].u_s = 1;  // user mode
+    vid_pt[0].base_addr = VID_PHYS_ADDR >> MEM_OFFSET_BITS;
 
     /* flush TLB */
     flush_TLB();
@@ -513,16 +659,32 @@ int32_t vidmap(uint8_t** screen_start)
     return 0;
 }
 
-//9 not implemented
-int32_t set_handler()
+/*
+ * vgamode
+ * DESCRIPTION: system call vgamode, switch the screen to mode X or mode 13h and map the 64kB
+ *              graphics window for the caller, or go back to text mode. Only a process of the
+ *              foreground terminal can take the screen, it gets text mode back when it halts.
+ * INPUT: mode -- VGA_MODE_TEXT, VGA_MODE_X or VGA_MODE_13H, or VGA_PLANES | mask to pick the
+ *                planes written in mode X
+ *        screen_start -- where to put the user address of the framebuffer, unused otherwise
+ * OUTPUT: user address of the framebuffer
+ * RETURN: 0 for success, -1 for failure
+ * SIDE AFFECTS: screen mode changed
+ */
+int32_t vgamode(uint32_t mode, uint8_t** screen_start)
 {
-    return -1;
-}
+    uint32_t graphics = (mode == VGA_MODE_X || mode == VGA_MODE_13H);  /* a framebuffer is returned */
 
-//10 not implemented
-int32_t sigreturn()
-{
-    return -1;
+    /* check if the pointer is in user space */
+    if (graphics && ((uint32_t)screen_start <= ADDR_128MB || (uint32_t)screen_start >= ADDR_132MB))
+        return -1;
+
+    if (vga_set_mode(curr_mm, mode) == -1)
+        return -1;
+
+    if (graphics)
+        *screen_start = (uint8_t*)VGA_VIRTUAL_ADDR;
+    return 0;
 }
 
 /* 
@@ -534,19 +696,24 @@ int32_t sigreturn()
  */
 int32_t vid_remap(uint8_t* phys_addr)
 {
+    page_dir_entry_t* pd;       /* page directory of this processor */
+    page_table_entry_t* vid_pt; /* vidmap page table of this processor */
+
     /* sanity check */
     if(phys_addr == NULL)
         return -1;
 
-    /* remap video virtual memory */
-    page_directory[VIDMAP_OFFSET].p           = 1;    // present
-    page_directory[VIDMAP_OFFSET].r_w         = 1;    // enable r/w
-    page_directory[VIDMAP_OFFSET].u_s         = 1;    // user mode
-    page_directory[VIDMAP_OFFSET].base_addr   = (unsigned int)vid_page_table >> MEM_OFFSET_BITS;
-    vid_page_table[0].p = 1;    // present
-    vid_page_table[0].r_w = 1;  // enable r/w
-    vid_page_table[0].u_s = 1;  // user mode
-    vid_page_table[0].base_addr = ((uint32_t)phys_addr) >> MEM_OFFSET_BITS;
+    /* remap video virtual memory of this processor */
+    pd = this_cpu()->pd;
+    vid_pt = this_cpu()->vid_pt;
+    pd[VIDMAP_OFFSET].p           = 1;    // present
+    pd[VIDMAP_OFFSET].r_w         = 1;    // enable r/w
+    pd[VIDMAP_OFFSET].u_s         = 1;    // user mode
+    pd[VIDMAP_OFFSET].base_addr   = (unsigned int)vid_pt >> MEM_OFFSET_BITS;
+    vid_pt[0].p = 1;    // present
+    vid_pt[0].r_w = 1;  // enable r/w
+    vid_pt[0].u_s = 1;  // user mode
+    vid_pt[0].base_addr = ((uint32_t)phys_addr) >> MEM_OFFSET_BITS;
 
     /* flush TLB */
     flush_TLB();
@@ -581,6 +748,33 @@ uint32_t get_new_pid()
     return -1;
 }
 
+/*
+ * put_pid
+ * DESCRIPTION: give a process id back, e.g. of a joined thread
+ * INPUT: pid -- process id
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: pid array changed
+ */
+void put_pid(uint32_t pid)
+{
+    if (pid < NUM_PROCESS)
+        pid_array[pid] = 0;
+}
+
+/*
+ * is_pid_used
+ * DESCRIPTION: check whether a process id is in use
+ * INPUT: pid -- process id
+ * OUTPUT: none
+ * RETURN: 1 if a process is running with this pid, 0 if not
+ * SIDE AFFECTS: none
+ */
+int32_t is_pid_used(uint32_t pid)
+{
+    return (pid < NUM_PROCESS && pid_array[pid]) ? 1 : 0;
+}
+
 /*
  * get_pcb_ptr
  * DESCRIPTION: get process's PCB pointer
@@ -627,4 +821,10 @@ void file_op_table_init()
     file_op_table_arr[STD_TYPE].close = terminal_close;
     file_op_table_arr[STD_TYPE].read  = terminal_read;
     file_op_table_arr[STD_TYPE].write = terminal_write;
+
+    /* init pseudo file operation table */
+    file_op_table_arr[PSEUDO_TYPE].open  = pseudo_open;
+    file_op_table_arr[PSEUDO_TYPE].close = pseudo_close;
+    file_op_table_arr[PSEUDO_TYPE].read  = pseudo_read;
+    file_op_table_arr[PSEUDO_TYPE].write = pseudo_write;
 }
@@ -4,11 +4,16 @@
 #include "types.h"
 #include "filesys.h"
 #include "paging.h"
+#include "signal.h"
+#include "smp.h"
+#include "fpu.h"
+#include "syscall_linkage.h"
 
 #define MAX_CMD_LEN             128
 #define MAX_ARG_LEN             128
-#define NUM_PROCESS             6
-#define CHECK_BUFFER_SIZE       4
+/* a base shell and one more process for each of the TERMINAL_MAX terminals, the program
+   pages of all of them end at 104MB physical, see IMGCACHE_ADDR */
+#define NUM_PROCESS             24
 #define NO_PARENT_PID           NUM_PROCESS
 /* file descriptor related */
 #define MAX_FILE_NUM            8
@@ -21,9 +26,6 @@
 #define KS_SIZE                 8192
 #define KS_BASE_ADDR            0x800000
 #define USER_MEM_ADDR           0x8000000
-#define PROGRAM_VIRTUAL_ADDR    0x8048000
-#define PROGRAM_START_OFFSET    24
-#define PROGRAM_START_ADDR      (PROGRAM_VIRTUAL_ADDR + PROGRAM_START_OFFSET)
 /* sizeof(int32_t) here is because we need to points to the least position of the user stack, not the bottom */
 #define USER_STACK_ADDR         (USER_MEM_ADDR + PAGE_4MB_SIZE - sizeof(int32_t))
 /* halt status code */
@@ -31,6 +33,11 @@
 #define HALT_EXCEPTION          1
 #define HALT_ABNORMAL           2
 #define HALT_EXCEPTION_RETVAL   256
+/* process state, see sched_sleep */
+#define PROC_RUNNABLE           0   /* running or in a run queue            */
+#define PROC_SLEEPING           1   /* waiting for sched_wakeup on wait_chan */
+#define PROC_EXITED             2   /* halted with nobody to return to, see sched_exit,
+                                       a thread keeps its pid in this state until it is joined */
 
 typedef struct file_op_table_t {
     int32_t (*open)  (const char* fname);
@@ -46,26 +53,71 @@ typedef struct file_desc_t {
     uint32_t flags;         /* whether this file descriptor is used */
 } file_desc_t;
 
+/* per-process accounting, see proc.c */
+typedef struct acct_t {
+    uint32_t cpu_ticks;                     /* PIT ticks spent running          */
+    uint32_t ctx_switches;                  /* times scheduled out              */
+    uint32_t syscall_cnt[SYSCALL_NUM + 1];  /* system calls by number           */
+    uint32_t read_bytes;                    /* bytes returned by read           */
+    uint32_t write_bytes;                   /* bytes accepted by write          */
+    uint32_t page_faults;                   /* page faults                      */
+    uint32_t fpu_loads;                     /* FPU states loaded on #NM         */
+    uint32_t fpu_saves;                     /* FPU states saved on a switch     */
+} acct_t;
+
 typedef struct pcb_t {
     /* file descriptor array */
     file_desc_t fd_array[MAX_FILE_NUM];
     /* process id */
     uint32_t pid;
     uint32_t parent_pid;
+    /* process whose memory and files it uses, its own pid unless it is a thread, see thread.c */
+    uint32_t mm_pid;
     /* terminal id */
     uint32_t term_id;
     /* arguments for this process */
     uint8_t arg[MAX_ARG_LEN];
+    /* program name */
+    uint8_t name[MAX_FILE_NAME_LEN + 1];
     /* used for context switch */
     uint32_t ebp;
     uint32_t esp;
+    uint32_t lock_depth;                /* kernel lock nesting when switched out    */
+    uint32_t rq_next;                   /* next process in the same run queue       */
+    uint32_t state;                     /* PROC_RUNNABLE or PROC_SLEEPING           */
+    void* wait_chan;                    /* what a sleeping process waits for        */
+    /* first address of the program page that is zero-filled on demand, see elf.c */
+    uint32_t lazy_start;
+    /* end of the program's segments, thread stacks are above it */
+    uint32_t mem_end;
+    /* image cache entry of the program, -1 if it was loaded privately, see imgcache.c */
+    int32_t img_idx;
+    /* thread state, see thread.c */
+    uint32_t stack_slot;                /* user stack slot, 0 for the leader        */
+    uint32_t user_eip;                  /* where a new thread starts                */
+    uint32_t user_esp;                  /* its first user stack pointer             */
+    uint32_t exit_status;               /* status of a halted thread for thread_join */
+    uint32_t killed;                    /* the leader is halting, halt as soon as possible */
+    /* signal state */
+    uint32_t sig_pending;               /* bitmap of raised but undelivered signals */
+    uint32_t sig_masked;                /* bitmap of signals blocked from delivery  */
+    void* sig_handler[SIGNAL_NUM];      /* user handler, NULL for default action    */
+    /* accounting */
+    acct_t acct;
+    /* FPU state, loaded on first use after a switch, see fpu.c */
+    uint32_t fpu_used;                  /* fpu holds the process' state, else it has not used the FPU yet */
+    int32_t fpu_cpu;                    /* processor whose registers also hold it, -1 if none */
+    fpu_state_t fpu;
 } pcb_t;
 
-/* current process id */
-uint32_t curr_pid;
+/* current process id, per processor */
+#define curr_pid        (this_cpu()->pid)
+
+/* process whose memory and files the current one uses, curr_pid must not be -1 */
+#define curr_mm         (get_pcb_ptr(curr_pid)->mm_pid)
 
-/* pointer pointing to current fd array */
-file_desc_t* cur_fd_array;
+/* pointer pointing to current fd array, per processor */
+#define cur_fd_array    (this_cpu()->fd_array)
 
 /* system call execute, attempts to load and execute a new program, */
 /* handing off the processor to the new program until it terminates.*/
@@ -86,18 +138,30 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes);
 /* system call write, would call particular device's write function according to the file type */
 int32_t write(int32_t fd, void* buf, int32_t nbytes);
 
+/* system call getdents, read many packed directory entries at once */
+int32_t getdents(int32_t fd, void* buf, int32_t nbytes);
+
 /* get args from command and copy it to buffer */
 int32_t getargs(uint8_t *buf, int32_t nbytes);
 
 /* maps user space virtual vidmem to physical video memory  */
 int32_t vidmap(uint8_t** screen_start);
 
+/* switch the screen to a VGA graphics mode and map its framebuffer, or back to text mode */
+int32_t vgamode(uint32_t mode, uint8_t** screen_start);
+
 /* remaps user space virtual vidmem to a physical address */
 int32_t vid_remap(uint8_t* phys_addr);
 
 /* get new process id by finding unoccupied position of pid_array */
 uint32_t get_new_pid();
 
+/* give a process id back */
+void put_pid(uint32_t pid);
+
+/* check whether a process id is in use */
+int32_t is_pid_used(uint32_t pid);
+
 /* remaps user space virtual vidmem to a physical address */
 inline pcb_t* get_pcb_ptr(uint32_t pid);
 
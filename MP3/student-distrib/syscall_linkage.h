@@ -1,5 +1,9 @@
 #ifndef _SYSCALL_LINKAGE_H
 #define _SYSCALL_LINKAGE_H
+
+/* number of system calls, valid numbers are 1-SYSCALL_NUM */
+#define SYSCALL_NUM     18
+
 #ifndef ASM
 
 /* system call linkage code */
@@ -6,8 +6,19 @@
 #include "terminal.h"
 #include "keyboard.h"
 #include "syscall.h"
+#include "signal.h"
+#include "softirq.h"
+#include "trace.h"
+#include "serial.h"
+#include "schedule.h"
+#include "smp.h"
+#include "bootlog.h"
+#include "vga.h"
 #include "lib.h"
 
+/* video buffer frames, vid_buf_used[i] is set while frame i belongs to a terminal */
+static uint8_t vid_buf_used[TERMINAL_MAX];
+
 /* MACRO for the sake of briefness */
 #define CHECK_FAIL_RETURN(value) \
     if (value == -1)             \
@@ -15,43 +26,92 @@
         return -1;               \
     }
 
+/*
+ * terminal_reset
+ * DESCRIPTION: put a terminal back to its state before it is first shown
+ * INPUT: term_id -- terminal id
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void terminal_reset(uint32_t term_id)
+{
+    int j;  /* loop index for terminal buffer */
+
+    terminals[term_id].id = term_id;
+    terminals[term_id].is_running = 0;
+    terminals[term_id].is_ready = 0;
+    terminals[term_id].active_pid = -1;
+    terminals[term_id].pnum = 0;
+    terminals[term_id].cursor_x = 0;
+    terminals[term_id].cursor_y = 0;
+    terminals[term_id].is_enter = 0;
+    terminals[term_id].term_buf_offset = 0;
+    terminals[term_id].vid_buf = NULL;
+    terminals[term_id].backend = TERMINAL_BACKEND_VGA;
+    /* init terminal buffer */
+    for (j = 0; j < MAX_TERMINAL_BUF_SIZE; j++)
+        terminals[term_id].term_buf[j] = '\0';
+}
+
+/*
+ * terminal_setup
+ * DESCRIPTION: give a terminal a video buffer and clear it the first time it is shown
+ * INPUT: term_id -- terminal id
+ * OUTPUT: none
+ * RETURN: 0 if success, -1 if no video buffer is left
+ * SIDE AFFECTS: vid buffer's page setted
+ */
+static int32_t terminal_setup(uint32_t term_id)
+{
+    int j;  /* loop index for video buffer */
+
+    if (terminals[term_id].is_ready)
+        return 0;
+
+    /* init page for video buffer */
+    CHECK_FAIL_RETURN(set_vid_buf_page(term_id));
+    /* init video buffer */
+    for (j = 0; j < VIDBUF_SIZE/2; j++)
+    {
+        *(uint8_t *)(terminals[term_id].vid_buf + (j << 1)) = ' ';
+        *(uint8_t *)(terminals[term_id].vid_buf + (j << 1) + 1) = ATTRIB;
+    }
+    terminals[term_id].is_ready = 1;
+    return 0;
+}
+
 /*
  * terminal_init
- * DESCRIPTION: initialize all terminals structures
+ * DESCRIPTION: initialize all terminals structures. The number of terminals comes from the
+ *              "terms" kernel command line option, TERMINAL_DEFAULT_NUM without it, at most
+ *              TERMINAL_MAX and half of NUM_PROCESS. Only the first terminal gets its video
+ *              buffer now, the others when they are first switched to (terminal_restore).
  * INPUT: none
  * OUTPUT: 0
  * RETURN: 0 if success, 1 if fail
- * SIDE AFFECTS: vid buffers' pages setted
+ * SIDE AFFECTS: first terminal's vid buffer page setted
  */
 int32_t terminal_init()
 {
-    int i;  /* loop index for different terminals               */
-    int j;  /* loop index for terminal buffer and video buffer  */
+    int i;  /* loop index for different terminals */
+
+    terminal_num = boot_param_num(TERMINAL_OPT_NUM, TERMINAL_DEFAULT_NUM);
+    if (terminal_num == 0)
+        terminal_num = 1;
+    if (terminal_num > TERMINAL_MAX)
+        terminal_num = TERMINAL_MAX;
+    /* every running terminal has a base shell, and needs a process id left to run a command */
+    if (terminal_num > NUM_PROCESS / 2)
+        terminal_num = NUM_PROCESS / 2;
+
     /* init every terminal structures */
-    for (i = 0; i < TERMINAL_NUM; i++)
+    for (i = 0; i < TERMINAL_MAX; i++)
     {
-        /* set basic attribute */
-        terminals[i].id = i;
-        terminals[i].is_running = 0;
-        terminals[i].curr_pid = -1;
-        terminals[i].pnum = 0;
-        terminals[i].cursor_x = 0;
-        terminals[i].cursor_y = 0;
-        terminals[i].is_enter = 0;
-        terminals[i].term_buf_offset = 0;
-        terminals[i].vid_buf = (uint8_t *)(VIDEO+(i+1)*PAGE_4KB_SIZE);
-        /* init page for video buffer */
-        set_vid_buf_page(i);
-        /* init terminal buffer */
-        for (j = 0; j < MAX_TERMINAL_BUF_SIZE; j++)
-            terminals[i].term_buf[j] = '\0';
-        /* init video buffer */
-        for (j = 0; j < VIDBUF_SIZE/2; j++)
-        {
-            *(uint8_t *)(terminals[i].vid_buf + (j << 1)) = ' ';
-            *(uint8_t *)(terminals[i].vid_buf + (j << 1) + 1) = ATTRIB;
-        }
+        vid_buf_used[i] = 0;
+        terminal_reset(i);
     }
+    CHECK_FAIL_RETURN(terminal_setup(FIRST_TERMINAL_ID));
     /* init current running terminal number */
     running_term_num = 0;
     return 0;
@@ -60,8 +120,10 @@ int32_t terminal_init()
 /*
  * terminal_switch
  * DESCRIPTION: switch to terminal with term_id, if the terminal is running, just switch;
- *              if not, run a shell for this new terminal
- *              ATTENTION: this program must be called from a program who has disable the interrupt
+ *              if not, run a shell for this new terminal. If the shell cannot be started, e.g.
+ *              no process id is left, the screen goes back to the previous terminal.
+ *              ATTENTION: this program must not race with the scheduler, call it with interrupts
+ *              disabled or from a bottom half (see softirq.h)
  * INPUT: term_id -- terminal id
  * OUTPUT: none
  * RETURN: 0 if success, 1 if fail
@@ -69,21 +131,31 @@ int32_t terminal_init()
  */
 int32_t terminal_switch(uint32_t term_id)
 {
+    uint32_t prev_term_id = curr_term_id;   /* terminal switched away from */
+    int32_t in_softirq;                     /* switched from a bottom half */
+
     /* if it is the current terminal, do nothing */
     if (curr_term_id == term_id)
         return 0;
 
+    /* the screen belongs to a program in a graphics mode until it gives it back */
+    if (vga_owner != -1)
+        return -1;
+
     /* save terminal info */
     CHECK_FAIL_RETURN(terminal_save(curr_term_id));
 
     /* restore terminal info */
     CHECK_FAIL_RETURN(terminal_restore(term_id));
 
-    /* check whether the terminal is runnning */
+    /* check whether the terminal is runnning, nothing is mapped for the idle loop */
     if (terminals[curr_term_id].is_running)
     {
+        uint32_t curr_process_term_id;
+        if (curr_pid == -1)
+            return 0;
         /* remap the virtual video memory because terminal changes */
-        uint32_t curr_process_term_id = get_pcb_ptr(curr_pid)->term_id;
+        curr_process_term_id = get_pcb_ptr(curr_pid)->term_id;
         if (curr_process_term_id != curr_term_id)
         {
             /* if the current process is executed by current terminal, remap virtual vidmem to physical vidmem */
@@ -105,8 +177,25 @@ int32_t terminal_switch(uint32_t term_id)
         running_term_num++;
         CHECK_FAIL_RETURN(vid_remap((uint8_t *)VIDEO));
 
-        /* execute new shell for this new terminal */
+        /* execute new shell for this new terminal, from the keyboard bottom half the shell does
+           not return through do_softirq */
+        cli();
+        in_softirq = softirq_leave();
         execute((uint8_t *)"shell");
+        softirq_return(in_softirq);
+
+        /* back here either when the interrupted process is scheduled again, with the shell
+           running, or at once because it could not start: then the switch is undone */
+        if (terminals[term_id].is_running && terminals[term_id].pnum == 0)
+        {
+            CHECK_FAIL_RETURN(terminal_restore(prev_term_id));
+            if (curr_pid != -1 && get_pcb_ptr(curr_pid)->term_id != curr_term_id)
+                CHECK_FAIL_RETURN(vid_remap(terminals[get_pcb_ptr(curr_pid)->term_id].vid_buf));
+            running_term_num--;
+            clr_vid_buf_page(term_id);
+            terminal_reset(term_id);
+            return -1;
+        }
     }
 
     /* success, return 0 */
@@ -125,7 +214,7 @@ int32_t terminal_switch(uint32_t term_id)
 int32_t terminal_save(uint32_t term_id)
 {
     /* sanity check */
-    if (term_id >= TERMINAL_NUM)
+    if (term_id >= terminal_num)
         return -1;
 
     /* save current cursor position */
@@ -150,9 +239,12 @@ int32_t terminal_save(uint32_t term_id)
 int32_t terminal_restore(uint32_t term_id)
 {
     /* sanity check */
-    if (term_id >= TERMINAL_NUM)
+    if (term_id >= terminal_num)
         return -1;
 
+    /* a terminal shown for the first time gets its video buffer now */
+    CHECK_FAIL_RETURN(terminal_setup(term_id));
+
     /* set current terminal id */
     curr_term_id = term_id;
 
@@ -169,13 +261,13 @@ int32_t terminal_restore(uint32_t term_id)
 
 /*
  * launch_first_terminal
- * DESCRIPTION: launch the first terminal and shell
- * INPUT: none
+ * DESCRIPTION: launch the first terminal and its program, normally the shell
+ * INPUT: command -- program of the first terminal
  * OUTPUT: none
  * RETURN: never return, 1 if fail
  * SIDE AFFECTS: none
  */
-int32_t launch_first_terminal(){
+int32_t launch_first_terminal(const uint8_t* command){
     /* get init terminal info */
     CHECK_FAIL_RETURN(terminal_restore(FIRST_TERMINAL_ID));
 
@@ -183,8 +275,8 @@ int32_t launch_first_terminal(){
     running_term_num = 1;
     terminals[FIRST_TERMINAL_ID].is_running = 1;
 
-    /* launch the first shell */
-    CHECK_FAIL_RETURN(execute((uint8_t*)"shell"));
+    /* launch the first program */
+    CHECK_FAIL_RETURN(execute(command));
 
     /* never reach here */
     return -1;
@@ -246,16 +338,24 @@ int32_t terminal_read(int32_t fd, void *buf, int32_t nbytes)
         until the foreground terminal program take an enter and is scheduled
         then the loop breaks
     */
+    /* disable interrupt, no enter may come between the check and the sleep */
+    cli();
     while (1)
     {
         /* get current running process' terminal id */
         curr_process_term_id = get_pcb_ptr(curr_pid)->term_id;
         if (terminals[curr_process_term_id].is_enter == 1)
             break;
+        /* give up waiting if a signal is going to be delivered, e.g. ctrl+C */
+        if (signal_pending(curr_pid))
+        {
+            sti();
+            return -1;
+        }
+        /* sleep until the enter, or a signal, wakes the process up */
+        sched_sleep(&terminals[curr_process_term_id]);
     }
-
-    /* disable interrupt, avoid shcduling causing some page fault */
-    cli();
+    TRACE(TRACE_WAKEUP, TRACE_KEYBOARD, 0);
 
     /* get current running process' terminal buffer */
     read_buffer = terminals[curr_process_term_id].term_buf;
@@ -290,6 +390,100 @@ int32_t terminal_read(int32_t fd, void *buf, int32_t nbytes)
     return ret;
 }
 
+/*
+ * terminal_set_backend
+ * DESCRIPTION: choose where a terminal reads and writes. Only one terminal can be
+ *              on COM1, attaching another one gives the previous one back to VGA.
+ * INPUT: term_id -- terminal id
+ *        backend -- TERMINAL_BACKEND_VGA or TERMINAL_BACKEND_SERIAL
+ * OUTPUT: none
+ * RETURN: 0 if success, -1 if fail
+ * SIDE AFFECTS: COM1 input goes to the terminal
+ */
+int32_t terminal_set_backend(uint32_t term_id, uint32_t backend)
+{
+    int i;  /* loop index for terminals */
+
+    /* sanity check */
+    if (term_id >= terminal_num)
+        return -1;
+
+    switch (backend)
+    {
+        case TERMINAL_BACKEND_SERIAL:
+            for (i = 0; i < terminal_num; i++)
+                terminals[i].backend = TERMINAL_BACKEND_VGA;
+            terminals[term_id].backend = TERMINAL_BACKEND_SERIAL;
+            serial_attach(term_id);
+            return 0;
+        case TERMINAL_BACKEND_VGA:
+            if (terminals[term_id].backend == TERMINAL_BACKEND_SERIAL)
+                serial_attach(SERIAL_NO_TERM);
+            terminals[term_id].backend = TERMINAL_BACKEND_VGA;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * terminal_input
+ * DESCRIPTION: line discipline of a non-keyboard backend, the character is put into the
+ *              terminal's read buffer and echoed back the way the keyboard handler does it.
+ *              Carriage return ends a line, DEL and backspace erase, ctrl+C interrupts.
+ *              Called from the backend's interrupt handler.
+ * INPUT: term_id -- terminal id
+ *        c -- received character
+ * OUTPUT: echo on the backend
+ * RETURN: none
+ * SIDE AFFECTS: terminal's read buffer changed, terminal_read may wake up
+ */
+void terminal_input(uint32_t term_id, uint8_t c)
+{
+    terminal_t* term;   /* terminal taking the input */
+
+    /* sanity check */
+    if (term_id >= terminal_num)
+        return;
+    term = &terminals[term_id];
+
+    switch (c)
+    {
+        case '\r':
+        case '\n':
+            if (term->term_buf_offset >= MAX_TERMINAL_BUF_SIZE)
+                break;
+            term->term_buf[term->term_buf_offset] = '\n';
+            term->term_buf_offset += 1;
+            term->is_enter = 1;
+            sched_wakeup(term);
+            serial_putc('\n');
+            break;
+        case TERMINAL_ASCII_DEL:
+        case TERMINAL_ASCII_BS:
+            if (term->term_buf_offset > 0)
+            {
+                term->term_buf_offset -= 1;
+                term->term_buf[term->term_buf_offset] = '\0';
+                serial_puts("\b \b");
+            }
+            break;
+        case TERMINAL_ASCII_ETX:
+            if (term->is_running)
+                signal_send(term->active_pid, SIGNAL_INTERRUPT);
+            break;
+        default:
+            /* keep the last slot for the newline, like the keyboard does */
+            if (c >= ' ' && c < TERMINAL_ASCII_DEL && term->term_buf_offset < READ_BUFFER_SIZE)
+            {
+                term->term_buf[term->term_buf_offset] = c;
+                term->term_buf_offset += 1;
+                serial_putc(c);
+            }
+            break;
+    }
+}
+
 /*
  *  terminal_write
  *  Description:    write the corresponding number of bytes of a buffer of the terminal
@@ -316,8 +510,20 @@ int32_t terminal_write(int32_t fd, void *buf, int32_t nbytes)
     /* disable interrupt, avoid scheduling problem */
     cli();
 
+    /* a serial terminal has no screen, everything goes to COM1 */
+    if (terminals[get_pcb_ptr(curr_pid)->term_id].backend == TERMINAL_BACKEND_SERIAL)
+    {
+        for (i = 0; i < nbytes; i++)
+        {
+            if (((char *)buf)[i] != '\0')
+            {
+                serial_putc(((char *)buf)[i]);
+                ret++;
+            }
+        }
+    }
     /* check whether current process' terminal is the foreground terminal */
-    if (get_pcb_ptr(curr_pid)->term_id == curr_term_id)
+    else if (get_pcb_ptr(curr_pid)->term_id == curr_term_id)
     {
         /* iterate through the input buffer */
         for (i = 0; i < nbytes; i++)
@@ -353,19 +559,55 @@ int32_t terminal_write(int32_t fd, void *buf, int32_t nbytes)
     return ret;
 }
 
+/*
+ * terminal_release
+ * DESCRIPTION: close a terminal whose last process halted: the video buffer is given back and
+ *              the terminal starts over when it is switched to again. If it is on the screen, the
+ *              first terminal is shown instead. The first terminal is never released, its base
+ *              shell is restarted by halt.
+ * INPUT: term_id -- terminal id
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: terminal switched, vid buffer's page cleared
+ */
+void terminal_release(uint32_t term_id)
+{
+    if (term_id >= terminal_num || term_id == FIRST_TERMINAL_ID || !terminals[term_id].is_running)
+        return;
+
+    if (curr_term_id == term_id)
+        terminal_switch(FIRST_TERMINAL_ID);
+
+    if (terminals[term_id].backend == TERMINAL_BACKEND_SERIAL)
+        serial_attach(SERIAL_NO_TERM);
+    running_term_num--;
+    clr_vid_buf_page(term_id);
+    terminal_reset(term_id);
+}
+
 /*
  * set_vid_buf_page
- * DESCRIPTION: set terminal's video buffer page according to the terminal id
+ * DESCRIPTION: give a terminal a free frame of the video buffer memory and map it for the kernel
  *              no need to set page directory because vid buffer's address is in 0-3MB, which has enabled
- * INPUT: none
+ * INPUT: term_id -- terminal id
  * OUTPUT: none
- * RETURN: never return, 1 if fail
- * SIDE AFFECTS: none
+ * RETURN: 0 if success, -1 if all frames are taken
+ * SIDE AFFECTS: vid_buf of the terminal set
  */
-void set_vid_buf_page(int term_id){
+int32_t set_vid_buf_page(int term_id){
+
+    uint32_t frame;     /* loop index for frames */
+    uint32_t index;     /* page table index      */
+
+    /* take a free frame */
+    for (frame = 0; frame < TERMINAL_MAX && vid_buf_used[frame]; frame++);
+    if (frame == TERMINAL_MAX)
+        return -1;
+    vid_buf_used[frame] = 1;
+    terminals[term_id].vid_buf = (uint8_t *)(TERMINAL_VIDBUF_ADDR + frame * PAGE_4KB_SIZE);
 
     /* get page table index */
-    uint32_t index = (uint32_t)(terminals[term_id].vid_buf) >> MEM_OFFSET_BITS;
+    index = (uint32_t)(terminals[term_id].vid_buf) >> MEM_OFFSET_BITS;
 
     /* set paging */
     page_table[index].p = 1;        // Present
@@ -380,6 +622,32 @@ void set_vid_buf_page(int term_id){
     page_table[index].avail = 0;    // Available for our use, won't use, does not matter
     page_table[index].base_addr = index;// Page-Table Base Address
 
+    /* flush TLB */
+    flush_TLB();
+    return 0;
+}
+
+/*
+ * clr_vid_buf_page
+ * DESCRIPTION: unmap the video buffer of a terminal and give its frame back, a stray write to it
+ *              faults instead of drawing into the next terminal using the frame
+ * INPUT: term_id -- terminal id
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: vid_buf of the terminal cleared
+ */
+void clr_vid_buf_page(int term_id){
+
+    uint32_t index;     /* page table index */
+
+    if (terminals[term_id].vid_buf == NULL)
+        return;
+
+    index = (uint32_t)(terminals[term_id].vid_buf) >> MEM_OFFSET_BITS;
+    page_table[index].p = 0;
+    vid_buf_used[((index << MEM_OFFSET_BITS) - TERMINAL_VIDBUF_ADDR) / PAGE_4KB_SIZE] = 0;
+    terminals[term_id].vid_buf = NULL;
+
     /* flush TLB */
     flush_TLB();
 }
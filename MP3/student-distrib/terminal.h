@@ -8,27 +8,45 @@
 #include "types.h"
 
 #define MAX_TERMINAL_BUF_SIZE   128
-#define TERMINAL_NUM            3
+#define TERMINAL_MAX            12      /* one for each of F1 to F12                        */
+#define TERMINAL_DEFAULT_NUM    3
+#define TERMINAL_OPT_NUM        "terms" /* kernel command line option, e.g. "terms=6"       */
 #define FIRST_TERMINAL_ID       0
 
+/* physical memory of the video buffers, a 4kB frame for every terminal being used */
+#define TERMINAL_VIDBUF_ADDR    0x100000
+
+/* where a terminal's input comes from and its output goes to */
+#define TERMINAL_BACKEND_VGA    0   /* keyboard and video memory    */
+#define TERMINAL_BACKEND_SERIAL 1   /* COM1, see serial.h           */
+/* control characters handled by terminal_input */
+#define TERMINAL_ASCII_ETX      0x03    /* ctrl+C       */
+#define TERMINAL_ASCII_BS       0x08    /* backspace    */
+#define TERMINAL_ASCII_DEL      0x7F    /* delete       */
+
 /* terminal info struct */
 typedef struct terminal_t{
 
     uint32_t id;            /* terminal id                                  */
     uint32_t is_running;    /* indicate whether the terminal is running     */
-    uint32_t curr_pid;      /* current process id of THIS terminal          */
+    uint32_t is_ready;      /* video buffer mapped and cleared              */
+    uint32_t active_pid;    /* current process id of THIS terminal          */
     uint32_t pnum;          /* number of process running in this terminal   */
     uint32_t cursor_x;      /* cursor x position of this terminal           */
     uint32_t cursor_y;      /* cursor y position of this terminal           */
     volatile uint32_t is_enter;                         /* indicate whether enter is pressed for this terminal */
     volatile uint8_t term_buf[MAX_TERMINAL_BUF_SIZE];   /* read buffer for this terminal                       */
     volatile uint8_t term_buf_offset;                   /* offset of read buffer for this terminal             */
-    uint8_t *vid_buf;                                   /* pointer points to this terminal's video buffer      */
+    uint8_t *vid_buf;                                   /* this terminal's video buffer, NULL until it is shown */
+    uint32_t backend;                                   /* TERMINAL_BACKEND_VGA or TERMINAL_BACKEND_SERIAL     */
 
 } terminal_t;
 
 /* array of terminal info */
-terminal_t terminals[TERMINAL_NUM];
+terminal_t terminals[TERMINAL_MAX];
+
+/* number of terminals, from the kernel command line */
+uint32_t terminal_num;
 
 /* foreground terminal id */
 uint32_t curr_term_id;
@@ -48,8 +66,14 @@ int32_t terminal_save(uint32_t term_id);
 /* restore terminal info */
 int32_t terminal_restore();
 
-/* launch the first terminal and shell */
-int32_t launch_first_terminal();
+/* launch the first terminal and its program */
+int32_t launch_first_terminal(const uint8_t* command);
+
+/* choose the backend of a terminal */
+int32_t terminal_set_backend(uint32_t term_id, uint32_t backend);
+
+/* take one input character for a terminal from a non-keyboard backend */
+void terminal_input(uint32_t term_id, uint8_t c);
 
 /* open a terminal */
 int32_t terminal_open(const char* filename);
@@ -63,7 +87,13 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 /* write the corresponding number of bytes of a buffer to the terminal */
 int32_t terminal_write(int32_t fd, void* buf, int32_t nbytes);
 
-/* set terminal's video buffer page according to the terminal id */
-void set_vid_buf_page(int i);
+/* close a terminal whose last process halted */
+void terminal_release(uint32_t term_id);
+
+/* give a terminal a video buffer page */
+int32_t set_vid_buf_page(int term_id);
+
+/* take the video buffer page of a terminal back */
+void clr_vid_buf_page(int term_id);
 
 #endif
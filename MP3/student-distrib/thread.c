@@ -0,0 +1,366 @@
+/*
+    thread
+    Threads of a user program. A thread is a process id of its own, with a pcb and kernel stack,
+    that shares the program page, the shared memory window and the file descriptors of the
+    process that executed the program, its leader (pcb_t.mm_pid). The scheduler runs, queues,
+    steals and puts threads to sleep like any process, only the page tables and fd array it
+    switches to are the leader's. A thread gets a user stack slot of THREAD_STACK_SIZE below the
+    main stack, as long as it stays above the end of the program's segments, and starts on an
+    empty kernel stack the first time it is scheduled (thread_start). Its function returns into
+    a trampoline that halts it; a halted thread keeps its pid until it is joined. When the leader
+    halts, every thread is asked to halt and reaped before the program's memory goes away.
+*/
+
+#include "thread.h"
+#include "syscall.h"
+#include "schedule.h"
+#include "signal.h"
+#include "terminal.h"
+#include "blink.h"
+#include "imgcache.h"
+#include "shm.h"
+#include "x86_desc.h"
+#include "lib.h"
+
+/*
+ * thread_of
+ * DESCRIPTION: tell whether a process id is a thread of a program, the leader itself is not
+ * INPUT: pid -- process id
+ *        mm_pid -- leader of the program
+ * OUTPUT: none
+ * RETURN: 1 if it is one of its threads, 0 if not
+ * SIDE AFFECTS: none
+ */
+static int32_t thread_of(uint32_t pid, uint32_t mm_pid)
+{
+    pcb_t* pcb;     /* pcb of the process id */
+
+    if (pid == mm_pid || !is_pid_used(pid))
+        return 0;
+    pcb = get_pcb_ptr(pid);
+    return (pcb->mm_pid == mm_pid) ? 1 : 0;
+}
+
+/*
+ * thread_count
+ * DESCRIPTION: count the threads of a program that have not halted, the leader is not counted
+ * INPUT: mm_pid -- leader of the program
+ * OUTPUT: none
+ * RETURN: number of threads
+ * SIDE AFFECTS: none
+ */
+uint32_t thread_count(uint32_t mm_pid)
+{
+    uint32_t pid;           /* loop index       */
+    uint32_t count = 0;     /* threads found    */
+
+    for (pid = 0; pid < NUM_PROCESS; pid++)
+    {
+        if (thread_of(pid, mm_pid) && get_pcb_ptr(pid)->state != PROC_EXITED)
+            count++;
+    }
+    return count;
+}
+
+/*
+ * thread_stack_slot
+ * DESCRIPTION: find the lowest user stack slot no thread of a program has, its stack must be
+ *              above the end of the program's segments
+ * INPUT: mm_pcb -- pcb of the leader
+ * OUTPUT: none
+ * RETURN: slot number from 1, 0 if there is no room
+ * SIDE AFFECTS: none
+ */
+static uint32_t thread_stack_slot(pcb_t* mm_pcb)
+{
+    uint32_t slot;      /* slot tried       */
+    uint32_t pid;       /* loop index       */
+
+    for (slot = 1; THREAD_STACK_TOP(slot) - THREAD_STACK_SIZE >= mm_pcb->mem_end; slot++)
+    {
+        for (pid = 0; pid < NUM_PROCESS; pid++)
+        {
+            if (thread_of(pid, mm_pcb->pid) && get_pcb_ptr(pid)->stack_slot == slot)
+                break;
+        }
+        if (pid == NUM_PROCESS)
+            return slot;
+    }
+    return 0;
+}
+
+/*
+ * thread_create
+ * DESCRIPTION: system call thread_create, start a thread that runs func(arg) in the caller's program.
+ *              Its user stack is laid out as:
+ *                  [return address -> trampoline][arg] ... [thread exit trampoline]
+ *              so that returning from func halts the thread with the returned value. It is put on
+ *              this processor's run queue and first runs in thread_start.
+ * INPUT: func -- user address of the thread function
+ *        arg -- its argument
+ * OUTPUT: none
+ * RETURN: thread id for success, -1 for fail
+ * SIDE AFFECTS: a process id taken, the new thread's stack pages filled, cached image pages
+ *               of the program copied
+ */
+int32_t thread_create(int32_t (*func)(void*), void* arg)
+{
+    pcb_t *curr_pcb, *mm_pcb, *new_pcb;     /* caller, leader and new thread        */
+    uint32_t new_pid;                       /* new thread id                        */
+    uint32_t slot;                          /* user stack slot                      */
+    uint32_t tramp_size;                    /* size of the trampoline, 4-byte aligned */
+    uint32_t tramp_addr;                    /* user address of the trampoline       */
+    uint32_t user_esp;                      /* first user stack pointer             */
+    uint32_t page;                          /* loop index for program pages         */
+    uint32_t flags;                         /* saved eflags                         */
+    int i;                                  /* loop index                           */
+
+    /* sanity check */
+    if (curr_pid == -1 || (uint32_t)func < ADDR_128MB || (uint32_t)func >= ADDR_132MB)
+        return -1;
+
+    cli_and_save(flags);
+    curr_pcb = get_pcb_ptr(curr_pid);
+    mm_pcb = get_pcb_ptr(curr_pcb->mm_pid);
+
+    /* the leader is halting and reaping, a new thread would not be told to halt */
+    if (curr_pcb->killed)
+    {
+        restore_flags(flags);
+        return -1;
+    }
+
+    if ((slot = thread_stack_slot(mm_pcb)) == 0 || (new_pid = get_new_pid()) == -1)
+    {
+        restore_flags(flags);
+        return -1;
+    }
+
+    /* there is no TLB shootdown, a page copied on write while threads run on other processors
+       could stay read-only and stale for them: the program owns all its pages before it has any */
+    for (page = ELF_USER_START; page < mm_pcb->lazy_start; page += PAGE_4KB_SIZE)
+        imgcache_cow_fault(page);
+
+    /* the stack pages fault in zero-filled like the rest above the program's segments */
+    tramp_size = ((uint32_t)(thread_exit_tramp_end - thread_exit_tramp) + sizeof(int32_t) - 1) & ~(sizeof(int32_t) - 1);
+    tramp_addr = THREAD_STACK_TOP(slot) - tramp_size;
+    user_esp = tramp_addr - 2*sizeof(uint32_t);
+    memcpy((void*)tramp_addr, thread_exit_tramp, thread_exit_tramp_end - thread_exit_tramp);
+    ((uint32_t*)user_esp)[0] = tramp_addr;
+    ((uint32_t*)user_esp)[1] = (uint32_t)arg;
+
+    new_pcb = get_pcb_ptr(new_pid);
+    new_pcb->pid = new_pid;
+    new_pcb->parent_pid = curr_pid;
+    new_pcb->mm_pid = mm_pcb->pid;
+    new_pcb->term_id = curr_pcb->term_id;
+
+    /* files are the leader's, its own fd array stays empty */
+    for (i = 0; i < MAX_FILE_NUM; i++)
+    {
+        new_pcb->fd_array[i].op = NULL;
+        new_pcb->fd_array[i].inode_idx = -1;
+        new_pcb->fd_array[i].file_offset = 0;
+        new_pcb->fd_array[i].flags = FD_FLAG_FREE;
+    }
+    memcpy(new_pcb->arg, mm_pcb->arg, MAX_ARG_LEN);
+    memcpy(new_pcb->name, mm_pcb->name, MAX_FILE_NAME_LEN + 1);
+
+    /* memory is the leader's too, the image is released by the leader only */
+    new_pcb->lazy_start = mm_pcb->lazy_start;
+    new_pcb->mem_end = mm_pcb->mem_end;
+    new_pcb->img_idx = -1;
+    new_pcb->stack_slot = slot;
+
+    signal_init_pcb(new_pid);
+    memset(&new_pcb->acct, 0, sizeof(acct_t));
+    fpu_init_pcb(new_pcb);
+
+    /* esp 0 tells the scheduler to start it in thread_start */
+    new_pcb->ebp = 0;
+    new_pcb->esp = 0;
+    new_pcb->lock_depth = 0;
+    new_pcb->user_eip = (uint32_t)func;
+    new_pcb->user_esp = user_esp;
+    new_pcb->exit_status = 0;
+    new_pcb->killed = 0;
+    new_pcb->state = PROC_RUNNABLE;
+    new_pcb->wait_chan = NULL;
+    rq_enqueue(this_cpu()->id, new_pid);
+
+    restore_flags(flags);
+    return new_pid;
+}
+
+/*
+ * thread_join
+ * DESCRIPTION: system call thread_join, wait until a thread of the caller's program halts, then
+ *              free its thread id. Any thread of the program may join any other but the leader.
+ * INPUT: tid -- thread id given by thread_create
+ * OUTPUT: none
+ * RETURN: exit status of the thread (256 if it died by an exception), -1 for fail or if the
+ *         wait was given up for a signal
+ * SIDE AFFECTS: the caller may sleep, detached segments dropped after the last thread
+ */
+int32_t thread_join(int32_t tid)
+{
+    pcb_t *curr_pcb, *pcb;      /* caller and thread joined */
+    int32_t ret;                /* exit status              */
+    uint32_t flags;             /* saved eflags             */
+
+    /* sanity check */
+    if (curr_pid == -1 || tid < 0 || tid >= NUM_PROCESS || tid == curr_pid)
+        return -1;
+
+    cli_and_save(flags);
+    curr_pcb = get_pcb_ptr(curr_pid);
+    pcb = get_pcb_ptr(tid);
+
+    /* no wakeup may come between the check and the sleep, a halting thread wakes its leader's pcb */
+    while (thread_of(tid, curr_pcb->mm_pid) && pcb->state != PROC_EXITED)
+    {
+        if (signal_pending(curr_pid))
+        {
+            restore_flags(flags);
+            return -1;
+        }
+        sched_sleep(get_pcb_ptr(curr_pcb->mm_pid));
+    }
+
+    /* somebody else joined it first */
+    if (!thread_of(tid, curr_pcb->mm_pid))
+    {
+        restore_flags(flags);
+        return -1;
+    }
+    ret = pcb->exit_status;
+    put_pid(tid);
+
+    /* segments detached while the program had threads can go now */
+    if (thread_count(curr_pcb->mm_pid) == 0)
+        shm_reap(curr_pcb->mm_pid);
+
+    restore_flags(flags);
+    return ret;
+}
+
+/*
+ * thread_start
+ * DESCRIPTION: first code a new thread runs, the scheduler jumps here on the top of its kernel
+ *              stack with the kernel lock held. It enters the thread function with IRET like
+ *              execute does for a program, unless the program is already halting.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: never returns
+ * SIDE AFFECTS: kernel lock released
+ */
+void thread_start()
+{
+    pcb_t* pcb;     /* the new thread */
+
+    cli();
+    pcb = get_pcb_ptr(curr_pid);
+    if (pcb->killed)
+        thread_exit(HALT_ABNORMAL);
+
+    /* the kernel lock is not given back by the interrupt return path here */
+    kernel_release();
+
+    /* set infomation for IRET to the thread function, enable interrupt */
+    asm volatile ("                                                \n\
+        movw    %%cx, %%ds                                         \n\
+        pushl   %%ecx                                              \n\
+        pushl   %%ebx                                              \n\
+        pushfl                                                     \n\
+        popl    %%ecx                                              \n\
+        orl     $0x0200, %%ecx                                     \n\
+        pushl   %%ecx                                              \n\
+        pushl   %%edx                                              \n\
+        pushl   %%eax                                              \n\
+        iret                                                       \n\
+        "
+        :
+        : "a"(pcb->user_eip), "b"(pcb->user_esp), "c"(USER_DS), "d"(USER_CS)
+        : "memory"
+    );
+}
+
+/*
+ * thread_exit
+ * DESCRIPTION: halt part of a thread, called by halt. Nothing is returned to a parent: the thread
+ *              keeps its id with the exit status until it is joined and the processor goes on with
+ *              something else. Files, memory and the screen belong to the leader and stay.
+ *              Called with interrupts disabled.
+ * INPUT: retval -- exit status, as halt returns it to a parent
+ * OUTPUT: none
+ * RETURN: never returns
+ * SIDE AFFECTS: joiners woken up
+ */
+void thread_exit(uint16_t retval)
+{
+    pcb_t* pcb;     /* the halting thread */
+
+    pcb = get_pcb_ptr(curr_pid);
+
+    /* its blinking cells stop, its FPU state is dropped */
+    blink_release(pcb->pid);
+    fpu_switch(this_cpu(), NULL);
+
+    /* a program it executed has halted back to it, the terminal goes back to the leader */
+    if (terminals[pcb->term_id].active_pid == pcb->pid)
+        terminals[pcb->term_id].active_pid = pcb->mm_pid;
+
+    pcb->exit_status = retval;
+    sched_wakeup(get_pcb_ptr(pcb->mm_pid));
+    sched_exit();
+}
+
+/*
+ * thread_reap_all
+ * DESCRIPTION: called by halt of a leader before the program's memory and files go away. Every
+ *              thread is asked to halt: it does on its way back to user mode (see do_signal) and
+ *              a blocking call it sleeps in, or is about to sleep in (terminal read, futex wait,
+ *              thread_join), gives up as for a signal. Threads asked cannot create new ones. The
+ *              leader sleeps until all have halted, frees their ids and drops the segments they
+ *              left detached. A thread waiting in execute for a program it started halts when
+ *              that program does.
+ *              Called with interrupts disabled.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: the caller may sleep, thread ids freed
+ */
+void thread_reap_all()
+{
+    uint32_t mm_pid = curr_pid;     /* the halting leader       */
+    uint32_t pid;                   /* loop index               */
+    uint32_t live;                  /* threads not halted yet   */
+
+    for (pid = 0; pid < NUM_PROCESS; pid++)
+    {
+        if (!thread_of(pid, mm_pid))
+            continue;
+        get_pcb_ptr(pid)->killed = 1;
+        sched_wakeup_pid(pid);
+    }
+
+    while (1)
+    {
+        live = 0;
+        for (pid = 0; pid < NUM_PROCESS; pid++)
+        {
+            if (!thread_of(pid, mm_pid))
+                continue;
+            if (get_pcb_ptr(pid)->state == PROC_EXITED)
+                put_pid(pid);
+            else
+                live++;
+        }
+        if (live == 0)
+        {
+            shm_reap(mm_pid);
+            return;
+        }
+        sched_sleep(get_pcb_ptr(mm_pid));
+    }
+}
@@ -0,0 +1,42 @@
+/*
+    thread.h header file
+    threads of a user program, sharing its memory and open files
+*/
+
+#ifndef _THREAD_H
+#define _THREAD_H
+
+#include "types.h"
+#include "elf.h"
+
+/* user stack of a thread, stacked down from below the main stack of the program */
+#define THREAD_STACK_SIZE       ELF_STACK_RESERVE
+#define THREAD_STACK_TOP(slot)  (ELF_USER_END - ((slot) - 1) * THREAD_STACK_SIZE)
+
+#ifndef ASM
+
+/* thread exit trampoline, copied onto a new thread's stack as the return address of its function */
+extern uint8_t thread_exit_tramp[];
+extern uint8_t thread_exit_tramp_end[];
+
+/* system call thread_create, start a thread running func(arg) in the caller's program, what func
+   returns is its exit status */
+int32_t thread_create(int32_t (*func)(void*), void* arg);
+
+/* system call thread_join, wait for a thread of the caller's program to halt */
+int32_t thread_join(int32_t tid);
+
+/* first code of a new thread on its kernel stack, entered by the scheduler */
+void thread_start();
+
+/* halt part of a thread, it stays until it is joined */
+void thread_exit(uint16_t retval);
+
+/* number of threads of a program that have not halted */
+uint32_t thread_count(uint32_t mm_pid);
+
+/* the leader of a program halts, stop and reap all of its threads first */
+void thread_reap_all();
+
+#endif
+#endif
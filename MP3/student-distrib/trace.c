@@ -0,0 +1,113 @@
+/*
+    trace
+    low-overhead binary event trace. Every event takes a slot of a fixed-size ring
+    with one atomic add, so recording never takes a lock or disables interrupts
+    and an interrupt handler may record in the middle of another record.
+*/
+
+#include "trace.h"
+#include "syscall.h"
+#include "filesys.h"
+#include "lib.h"
+
+/* the ring being recorded into */
+static trace_ring_t trace_ring;
+/* copy of the ring served by the trace pseudo file */
+static trace_ring_t trace_dump;
+
+/*
+ * trace_init
+ * DESCRIPTION: initialize the ring and register the trace pseudo file
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: "trace" appears in the directory
+ */
+void trace_init()
+{
+    trace_ring.magic = TRACE_MAGIC;
+    trace_ring.size = TRACE_RING_SIZE;
+    trace_ring.entry_size = sizeof(trace_entry_t);
+    pseudo_register(TRACE_FILE_NAME, trace_read, NULL);
+}
+
+/*
+ * trace_event
+ * DESCRIPTION: record an event with the current time-stamp counter and process
+ * INPUT: event -- event id
+ *        arg0, arg1 -- event arguments, see trace.h
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: oldest entry of the ring overwritten
+ */
+void trace_event(uint32_t event, uint32_t arg0, uint32_t arg1)
+{
+    uint32_t seq = 1;       /* reserved event number */
+    trace_entry_t* entry;   /* reserved slot         */
+
+    /* reserve a slot, atomic with respect to interrupts on this processor */
+    asm volatile ("lock xaddl %0, %1"
+            : "+r"(seq), "+m"(trace_ring.head)
+            :
+            : "memory", "cc"
+    );
+    entry = &trace_ring.entry[seq & (TRACE_RING_SIZE - 1)];
+
+    rdtsc(entry->tsc_lo, entry->tsc_hi);
+    entry->event = event;
+    entry->pid = (curr_pid == -1) ? TRACE_NO_PID : curr_pid;
+    entry->arg0 = arg0;
+    entry->arg1 = arg1;
+}
+
+/*
+ * trace_syscall
+ * DESCRIPTION: record a system call, called by the system call linkage
+ * INPUT: num -- system call number
+ *        arg -- first argument
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: see trace_event
+ */
+void trace_syscall(uint32_t num, uint32_t arg)
+{
+    trace_event(TRACE_SYSCALL, num, arg);
+}
+
+/*
+ * trace_syscall_ret
+ * DESCRIPTION: record the return value of a system call, called by the system call linkage
+ * INPUT: retval -- return value
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: see trace_event
+ */
+void trace_syscall_ret(uint32_t retval)
+{
+    trace_event(TRACE_SYSCALL_RET, retval, 0);
+}
+
+/*
+ * trace_read
+ * DESCRIPTION: read routine of the trace pseudo file. The content is a trace_ring_t,
+ *              copied from the live ring when reading at offset 0 so that later
+ *              reads of the same dump are consistent.
+ * INPUT: offset -- byte offset in the file
+ *        buf -- buffer to be filled in
+ *        nbytes -- number of bytes needed to be copied
+ * OUTPUT: none
+ * RETURN: number of copied bytes
+ * SIDE AFFECTS: dump copy changed at offset 0
+ */
+int32_t trace_read(uint32_t offset, uint8_t* buf, uint32_t nbytes)
+{
+    if (offset == 0)
+        memcpy(&trace_dump, &trace_ring, sizeof(trace_ring_t));
+
+    if (offset >= sizeof(trace_ring_t))
+        return 0;
+    if (nbytes > sizeof(trace_ring_t) - offset)
+        nbytes = sizeof(trace_ring_t) - offset;
+    memcpy(buf, (uint8_t*)&trace_dump + offset, nbytes);
+    return nbytes;
+}
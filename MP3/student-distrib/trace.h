@@ -0,0 +1,75 @@
+/*
+    trace.h header file
+    binary kernel event trace in a fixed-size ring, see MP3/tools/trace_decode.py
+*/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/* If it is set to 1, kernel events are recorded into the trace ring */
+#define TRACE_ON            1
+
+#define TRACE_FILE_NAME     "trace"
+#define TRACE_MAGIC         0x31435254  /* "TRC1" */
+#define TRACE_RING_SIZE     1024        /* number of entries, must be a power of 2 */
+#define TRACE_NO_PID        0xFFFF
+
+/* event ids */
+#define TRACE_PIT           0   /* arg0: -                  arg1: -             */
+#define TRACE_KEYBOARD      1   /* arg0: scancode           arg1: -             */
+#define TRACE_RTC           2   /* arg0: rtc counter        arg1: -             */
+#define TRACE_SCHED         3   /* arg0: next pid           arg1: -             */
+#define TRACE_EXECUTE       4   /* arg0: new pid            arg1: -             */
+#define TRACE_HALT          5   /* arg0: status             arg1: parent pid    */
+#define TRACE_SYSCALL       6   /* arg0: system call number arg1: first argument*/
+#define TRACE_SYSCALL_RET   7   /* arg0: return value       arg1: -             */
+#define TRACE_WAKEUP        8   /* arg0: waking event id    arg1: -             */
+#define TRACE_SOFTIRQ       9   /* arg0: pending bitmap     arg1: -             */
+
+#ifndef ASM
+
+#include "types.h"
+
+/* one trace record */
+typedef struct trace_entry_t {
+    uint32_t tsc_lo;        /* time-stamp counter when the event happened */
+    uint32_t tsc_hi;
+    uint16_t event;         /* event id                                   */
+    uint16_t pid;           /* current process, TRACE_NO_PID if none      */
+    uint32_t arg0;
+    uint32_t arg1;
+} __attribute__((packed)) trace_entry_t;
+
+/* the ring, which is also the exact content of the trace pseudo file */
+typedef struct trace_ring_t {
+    uint32_t magic;         /* TRACE_MAGIC                                  */
+    uint32_t head;          /* number of events ever recorded               */
+    uint32_t size;          /* TRACE_RING_SIZE                              */
+    uint32_t entry_size;    /* sizeof(trace_entry_t)                        */
+    trace_entry_t entry[TRACE_RING_SIZE];   /* event n is in entry[n % size] */
+} __attribute__((packed)) trace_ring_t;
+
+#if TRACE_ON
+#define TRACE(event, arg0, arg1)    trace_event((event), (uint32_t)(arg0), (uint32_t)(arg1))
+#else
+#define TRACE(event, arg0, arg1)    do {} while (0)
+#endif
+
+/* initialize the ring and register the trace pseudo file */
+void trace_init();
+
+/* record an event */
+void trace_event(uint32_t event, uint32_t arg0, uint32_t arg1);
+
+/* record a system call, called by the system call linkage */
+void trace_syscall(uint32_t num, uint32_t arg);
+
+/* record the return value of a system call, called by the system call linkage */
+void trace_syscall_ret(uint32_t retval);
+
+/* read the trace pseudo file, a frozen copy of the ring taken at offset 0 */
+int32_t trace_read(uint32_t offset, uint8_t* buf, uint32_t nbytes);
+
+#endif /* ASM */
+
+#endif
@@ -0,0 +1,397 @@
+/*
+    vga
+    VGA graphics modes for user programs. The register tables and the way they are
+    written come from MP2/modex.c. A process on the foreground terminal switches to
+    mode X or mode 13h with the vgamode system call and gets the 64kB graphics window
+    mapped at VGA_VIRTUAL_ADDR. Only one process owns the screen at a time, the mapping
+    is only present while it runs, and terminal switching waits until it goes back to
+    text mode or halts. Text mode gets the font back from a copy taken at boot, since
+    the graphics modes write over plane 2, and the terminal's text from its video buffer.
+*/
+
+#include "vga.h"
+#include "terminal.h"
+#include "syscall.h"
+#include "smp.h"
+#include "lib.h"
+
+/*
+ * VGA register settings for mode X, from MP2. The line compare is back to 0x3FF
+ * (bit 8 in register 0x07, bit 9 in register 0x09, the rest in 0x18), MP2 split the
+ * screen for its status bar.
+ */
+static uint16_t mode_X_seq[VGA_NUM_SEQ_REGS] = {
+    0x0100, 0x2101, 0x0F02, 0x0003, 0x0604
+};
+static uint16_t mode_X_CRTC[VGA_NUM_CRTC_REGS] = {
+    0x5F00, 0x4F01, 0x5002, 0x8203, 0x5404, 0x8005, 0xBF06, 0x1F07,
+    0x0008, 0x4109, 0x000A, 0x000B, 0x000C, 0x000D, 0x000E, 0x000F,
+    0x9C10, 0x8E11, 0x8F12, 0x2813, 0x0014, 0x9615, 0xB916, 0xE317,
+    0xFF18
+};
+
+/*
+ * VGA register settings for mode 13h, mode X was derived from it by changing
+ *   Sequencer Memory Mode Register: 0x0E to 0x06 (0x3C4/0x04)
+ *   Underline Location Register   : 0x40 to 0x00 (0x3D4/0x14)
+ *   CRTC Mode Control Register    : 0xA3 to 0xE3 (0x3D4/0x17)
+ */
+static uint16_t mode_13h_seq[VGA_NUM_SEQ_REGS] = {
+    0x0100, 0x2101, 0x0F02, 0x0003, 0x0E04
+};
+static uint16_t mode_13h_CRTC[VGA_NUM_CRTC_REGS] = {
+    0x5F00, 0x4F01, 0x5002, 0x8203, 0x5404, 0x8005, 0xBF06, 0x1F07,
+    0x0008, 0x4109, 0x000A, 0x000B, 0x000C, 0x000D, 0x000E, 0x000F,
+    0x9C10, 0x8E11, 0x8F12, 0x2813, 0x4014, 0x9615, 0xB916, 0xA317,
+    0xFF18
+};
+
+/* attribute and graphics registers are the same for both 256 color modes */
+static uint8_t graphics_attr[VGA_NUM_ATTR_REGS * 2] = {
+    0x00, 0x00, 0x01, 0x01, 0x02, 0x02, 0x03, 0x03,
+    0x04, 0x04, 0x05, 0x05, 0x06, 0x06, 0x07, 0x07,
+    0x08, 0x08, 0x09, 0x09, 0x0A, 0x0A, 0x0B, 0x0B,
+    0x0C, 0x0C, 0x0D, 0x0D, 0x0E, 0x0E, 0x0F, 0x0F,
+    0x10, 0x41, 0x11, 0x00, 0x12, 0x0F, 0x13, 0x00,
+    0x14, 0x00, 0x15, 0x00
+};
+static uint16_t graphics_gfx[VGA_NUM_GFX_REGS] = {
+    0x0000, 0x0001, 0x0002, 0x0003, 0x0004, 0x4005, 0x0506, 0x0F07,
+    0xFF08
+};
+
+/* VGA register settings for text mode 3 (color text), from MP2 */
+static uint16_t text_seq[VGA_NUM_SEQ_REGS] = {
+    0x0100, 0x2001, 0x0302, 0x0003, 0x0204
+};
+static uint16_t text_CRTC[VGA_NUM_CRTC_REGS] = {
+    0x5F00, 0x4F01, 0x5002, 0x8203, 0x5504, 0x8105, 0xBF06, 0x1F07,
+    0x0008, 0x4F09, 0x0D0A, 0x0E0B, 0x000C, 0x000D, 0x000E, 0x000F,
+    0x9C10, 0x8E11, 0x8F12, 0x2813, 0x1F14, 0x9615, 0xB916, 0xA317,
+    0xFF18
+};
+static uint8_t text_attr[VGA_NUM_ATTR_REGS * 2] = {
+    0x00, 0x00, 0x01, 0x01, 0x02, 0x02, 0x03, 0x03,
+    0x04, 0x04, 0x05, 0x05, 0x06, 0x06, 0x07, 0x07,
+    0x08, 0x08, 0x09, 0x09, 0x0A, 0x0A, 0x0B, 0x0B,
+    0x0C, 0x0C, 0x0D, 0x0D, 0x0E, 0x0E, 0x0F, 0x0F,
+    0x10, 0x0C, 0x11, 0x00, 0x12, 0x0F, 0x13, 0x08,
+    0x14, 0x00, 0x15, 0x00
+};
+static uint16_t text_gfx[VGA_NUM_GFX_REGS] = {
+    0x0000, 0x0001, 0x0002, 0x0003, 0x0004, 0x1005, 0x0E06, 0x0007,
+    0xFF08
+};
+
+int32_t vga_owner = -1;
+
+/* current mode */
+static uint32_t vga_mode = VGA_MODE_TEXT;
+/* copy of the text font taken at boot */
+static uint8_t vga_font[VGA_FONT_SIZE];
+/* the graphics memory could be mapped */
+static uint32_t vga_on = 0;
+
+/*
+ * vga_blank
+ * DESCRIPTION: blank or unblank the display
+ * INPUT: blank -- 1 to blank, 0 to unblank
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void vga_blank(uint32_t blank)
+{
+    uint8_t val;    /* clocking mode register */
+
+    /* screen off is bit 5 of sequencer register 1 */
+    outb(0x01, VGA_SEQ_INDEX);
+    val = inb(VGA_SEQ_DATA);
+    outb((val & 0xDF) | ((blank & 1) << 5), VGA_SEQ_DATA);
+    /* set the attribute controller to index state and enable the display */
+    inb(VGA_INPUT_STATUS);
+    outb(0x20, VGA_ATTR_INDEX);
+}
+
+/*
+ * vga_set_seq_regs_and_reset
+ * DESCRIPTION: set the sequencer registers and the miscellaneous output register, the table
+ *              forces a reset of the sequencer which is turned back on after a brief delay
+ * INPUT: table -- sequencer register values
+ *        val -- miscellaneous output register value
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void vga_set_seq_regs_and_reset(uint16_t table[VGA_NUM_SEQ_REGS], uint8_t val)
+{
+    volatile int32_t i;     /* delay loop index */
+
+    for (i = 0; i < VGA_NUM_SEQ_REGS; i++)
+        outw(table[i], VGA_SEQ_INDEX);
+    for (i = 0; i < 10000; i++);
+    outb(val, VGA_MISC_WRITE);
+    /* turn the sequencer on */
+    outw(0x0300, VGA_SEQ_INDEX);
+}
+
+/*
+ * vga_set_CRTC_registers
+ * DESCRIPTION: set the CRT controller registers
+ * INPUT: table -- CRTC register values
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void vga_set_CRTC_registers(uint16_t table[VGA_NUM_CRTC_REGS])
+{
+    int32_t i;      /* loop index */
+
+    /* clear protection bit to enable write access to first few registers */
+    outw(0x0011, VGA_CRTC_INDEX);
+    for (i = 0; i < VGA_NUM_CRTC_REGS; i++)
+        outw(table[i], VGA_CRTC_INDEX);
+}
+
+/*
+ * vga_set_attr_registers
+ * DESCRIPTION: set the attribute registers, index and value go to the same port one after another
+ * INPUT: table -- index/value pairs
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void vga_set_attr_registers(uint8_t table[VGA_NUM_ATTR_REGS * 2])
+{
+    int32_t i;      /* loop index */
+
+    /* reset attribute register to write index next rather than data */
+    inb(VGA_INPUT_STATUS);
+    for (i = 0; i < VGA_NUM_ATTR_REGS * 2; i++)
+        outb(table[i], VGA_ATTR_INDEX);
+}
+
+/*
+ * vga_set_graphics_registers
+ * DESCRIPTION: set the graphics controller registers
+ * INPUT: table -- graphics register values
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void vga_set_graphics_registers(uint16_t table[VGA_NUM_GFX_REGS])
+{
+    int32_t i;      /* loop index */
+
+    for (i = 0; i < VGA_NUM_GFX_REGS; i++)
+        outw(table[i], VGA_GFX_INDEX);
+}
+
+/*
+ * vga_font_access
+ * DESCRIPTION: give the CPU plane 2, where the font is, at VGA_MEM_ADDR, or go back to text mode
+ *              access, as write_font_data in MP2 does
+ * INPUT: on -- 1 for plane 2, 0 for text mode
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: none
+ */
+static void vga_font_access(uint32_t on)
+{
+    if (on)
+    {
+        outw(0x0402, VGA_SEQ_INDEX);
+        outw(0x0704, VGA_SEQ_INDEX);
+        outw(0x0005, VGA_GFX_INDEX);
+        outw(0x0406, VGA_GFX_INDEX);
+        outw(0x0204, VGA_GFX_INDEX);
+    }
+    else
+    {
+        outw(0x0302, VGA_SEQ_INDEX);
+        outw(0x0304, VGA_SEQ_INDEX);
+        outw(0x1005, VGA_GFX_INDEX);
+        outw(0x0E06, VGA_GFX_INDEX);
+        outw(0x0004, VGA_GFX_INDEX);
+    }
+}
+
+/*
+ * vga_init
+ * DESCRIPTION: map the graphics memory window for the kernel and keep a copy of the font the BIOS
+ *              loaded. Must run in text mode, before the application processors copy the page
+ *              directory.
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: kernel page table changed
+ */
+void vga_init()
+{
+    uint32_t i;     /* loop index for pages */
+
+    for (i = 0; i < VGA_PAGE_NUM; i++)
+    {
+        page_table[(VGA_MEM_ADDR >> MEM_OFFSET_BITS) + i].p = 1;
+        page_table[(VGA_MEM_ADDR >> MEM_OFFSET_BITS) + i].r_w = 1;
+    }
+    flush_TLB();
+
+    vga_font_access(1);
+    memcpy(vga_font, (void*)VGA_MEM_ADDR, VGA_FONT_SIZE);
+    vga_font_access(0);
+    vga_on = 1;
+}
+
+/*
+ * vga_text
+ * DESCRIPTION: put the VGA back into text mode 3 with the saved font and show the foreground
+ *              terminal again
+ * INPUT: none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: screen content replaced by the foreground terminal's
+ */
+static void vga_text()
+{
+    vga_blank(1);
+    vga_set_seq_regs_and_reset(text_seq, 0x67);
+    vga_set_CRTC_registers(text_CRTC);
+    vga_set_attr_registers(text_attr);
+    vga_set_graphics_registers(text_gfx);
+    vga_font_access(1);
+    memcpy((void*)VGA_MEM_ADDR, vga_font, VGA_FONT_SIZE);
+    vga_font_access(0);
+    vga_blank(0);
+
+    vga_mode = VGA_MODE_TEXT;
+    vga_owner = -1;
+    terminal_restore(curr_term_id);
+}
+
+/*
+ * vga_set_mode
+ * DESCRIPTION: switch the screen to a mode for a process. A graphics mode can only be entered by a
+ *              process of the foreground terminal while nobody else owns the screen, its text is
+ *              kept in the terminal's video buffer and comes back with text mode. The graphics
+ *              memory is cleared. Text output of the terminal while in a graphics mode is lost.
+ *              In mode X the owner picks the planes it writes with VGA_PLANES.
+ * INPUT: pid -- calling process
+ *        mode -- VGA_MODE_*, or VGA_PLANES | mask
+ * OUTPUT: none
+ * RETURN: 0 if success, -1 if the mode is invalid or the screen is not the process'
+ * SIDE AFFECTS: screen mode changed, framebuffer mapped on this processor
+ */
+int32_t vga_set_mode(uint32_t pid, uint32_t mode)
+{
+    if (!vga_on)
+        return -1;
+    if (vga_owner != -1 && vga_owner != (int32_t)pid)
+        return -1;
+
+    /* a user program has no port access, the kernel sets the map mask for it */
+    if ((mode & ~VGA_PLANE_MASK) == VGA_PLANES)
+    {
+        if (vga_mode != VGA_MODE_X)
+            return -1;
+        outw(((mode & VGA_PLANE_MASK) << 8) | 0x02, VGA_SEQ_INDEX);
+        return 0;
+    }
+    if (mode >= VGA_MODE_NUM)
+        return -1;
+
+    if (mode == VGA_MODE_TEXT)
+    {
+        if (vga_mode != VGA_MODE_TEXT)
+        {
+            vga_text();
+            vga_map(pid);
+        }
+        return 0;
+    }
+
+    if (get_pcb_ptr(pid)->term_id != curr_term_id)
+        return -1;
+    /* keep the text of the terminal for the way back */
+    if (vga_mode == VGA_MODE_TEXT)
+        terminal_save(curr_term_id);
+
+    vga_blank(1);
+    if (mode == VGA_MODE_X)
+    {
+        vga_set_seq_regs_and_reset(mode_X_seq, 0x63);
+        vga_set_CRTC_registers(mode_X_CRTC);
+    }
+    else
+    {
+        vga_set_seq_regs_and_reset(mode_13h_seq, 0x63);
+        vga_set_CRTC_registers(mode_13h_CRTC);
+    }
+    vga_set_attr_registers(graphics_attr);
+    vga_set_graphics_registers(graphics_gfx);
+    /* all four planes are write enabled, this clears each of them */
+    memset((void*)VGA_MEM_ADDR, 0, VGA_MEM_SIZE);
+    vga_blank(0);
+
+    vga_mode = mode;
+    vga_owner = pid;
+    vga_map(pid);
+    return 0;
+}
+
+/*
+ * vga_release
+ * DESCRIPTION: called by halt, a process that owns the screen gives it back in text mode
+ * INPUT: pid -- halting process
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: screen mode changed
+ */
+void vga_release(uint32_t pid)
+{
+    if (vga_owner != (int32_t)pid)
+        return;
+    vga_text();
+    vga_map(-1);
+}
+
+/*
+ * vga_map
+ * DESCRIPTION: make the framebuffer pages of this processor's vidmap page table present for the
+ *              owner of the screen and not present for anybody else. Called whenever a process is
+ *              switched in. The TLB is only flushed if a page changes.
+ * INPUT: pid -- process about to run, -1 for none
+ * OUTPUT: none
+ * RETURN: none
+ * SIDE AFFECTS: vidmap page table of this processor changed
+ */
+void vga_map(int32_t pid)
+{
+    page_dir_entry_t* pd;       /* page directory of this processor         */
+    page_table_entry_t* vid_pt; /* vidmap page table of this processor      */
+    uint32_t first;             /* index of the first framebuffer page      */
+    uint32_t present;           /* the process may use the framebuffer      */
+    uint32_t i;                 /* loop index for pages                     */
+
+    pd = this_cpu()->pd;
+    vid_pt = this_cpu()->vid_pt;
+    first = (VGA_VIRTUAL_ADDR - VID_VIRTUAL_ADDR) >> MEM_OFFSET_BITS;
+    present = (pid != -1 && pid == vga_owner) ? 1 : 0;
+    if (vid_pt[first].p == present)
+        return;
+
+    pd[VIDMAP_OFFSET].p           = 1;    // present
+    pd[VIDMAP_OFFSET].r_w         = 1;    // enable r/w
+    pd[VIDMAP_OFFSET].u_s         = 1;    // user mode
+    pd[VIDMAP_OFFSET].base_addr   = (unsigned int)vid_pt >> MEM_OFFSET_BITS;
+    for (i = 0; i < VGA_PAGE_NUM; i++)
+    {
+        vid_pt[first + i].p = present;
+        vid_pt[first + i].r_w = 1;
+        vid_pt[first + i].u_s = 1;
+        vid_pt[first + i].base_addr = (VGA_MEM_ADDR >> MEM_OFFSET_BITS) + i;
+    }
+
+    /* flush TLB */
+    flush_TLB();
+}
@@ -0,0 +1,56 @@
+/*
+    vga.h header file
+    VGA graphics modes for user programs: mode X and mode 13h with a mapped framebuffer
+*/
+
+#ifndef _VGA_H
+#define _VGA_H
+
+#include "types.h"
+#include "paging.h"
+
+/* modes of the vgamode system call */
+#define VGA_MODE_TEXT           0   /* text mode 3, the terminals                       */
+#define VGA_MODE_X              1   /* 320x200, 256 colors, four planes (see MP2)       */
+#define VGA_MODE_13H            2   /* 320x200, 256 colors, one byte per pixel (chain-4)*/
+#define VGA_MODE_NUM            3
+/* mode X: VGA_PLANES | mask selects the planes the owner's writes go to, bit n for plane n */
+#define VGA_PLANES              0x10
+#define VGA_PLANE_MASK          0x0F
+
+/* graphics memory window, mapped for the owner right after the vidmap page */
+#define VGA_MEM_ADDR            0xA0000
+#define VGA_MEM_SIZE            0x10000
+#define VGA_VIRTUAL_ADDR        (VID_VIRTUAL_ADDR + VGA_MEM_SIZE)
+#define VGA_PAGE_NUM            (VGA_MEM_SIZE / PAGE_4KB_SIZE)
+/* the font lives in plane 2, 32 bytes for each of 256 characters */
+#define VGA_FONT_SIZE           8192
+
+/* VGA ports */
+#define VGA_ATTR_INDEX          0x03C0
+#define VGA_MISC_WRITE          0x03C2
+#define VGA_SEQ_INDEX           0x03C4
+#define VGA_SEQ_DATA            0x03C5
+#define VGA_GFX_INDEX           0x03CE
+#define VGA_CRTC_INDEX          0x03D4
+#define VGA_INPUT_STATUS        0x03DA
+
+/* number of registers in the mode tables */
+#define VGA_NUM_SEQ_REGS        5
+#define VGA_NUM_CRTC_REGS       25
+#define VGA_NUM_GFX_REGS        9
+#define VGA_NUM_ATTR_REGS       22
+
+/* process in a graphics mode, -1 in text mode */
+extern int32_t vga_owner;
+
+/* map the graphics memory for the kernel and keep a copy of the text font */
+void vga_init();
+/* switch the screen for a process to a mode */
+int32_t vga_set_mode(uint32_t pid, uint32_t mode);
+/* back to text mode if the halting process owns the screen */
+void vga_release(uint32_t pid);
+/* map the framebuffer on this processor for its owner only */
+void vga_map(int32_t pid);
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * bench - user side of the benchmark suite, run by a kernel built with RUN_BENCH
+ * in place of the first shell. Every workload writes one line
+ *     BENCH <name> iters=<n> cycles=<n> bytes=<n>
+ * to the "serial" pseudo file, and "BENCH done" at the end.
+ * "bench nop" returns at once and is the child of the execute/halt workload.
+ * See MP3/tools/bench.py.
+ */
+
+#define SYSCALL_ITERS   100000
+#define EXEC_ITERS      200
+#define READ_ROUNDS     50
+#define READ_CHUNK      4096
+#define READ_FILE       "fish"
+#define WRITE_LINES     1000
+#define LINE_LEN        80
+#define BUF_LEN         128
+
+static int32_t serial_fd;
+static uint8_t read_buf[READ_CHUNK];
+
+/* low 32 bits of the time-stamp counter */
+static uint32_t
+tsc (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* append an unsigned decimal number to s, return the end */
+static uint8_t*
+put_num (uint8_t* s, uint32_t val)
+{
+    uint8_t buf[12];
+    int32_t i = 11;
+
+    do {
+        buf[--i] = '0' + val % 10;
+        val /= 10;
+    } while (0 != val && 0 < i);
+    while (i < 11)
+        *s++ = buf[i++];
+    return s;
+}
+
+/* append a string to s, return the end */
+static uint8_t*
+put_str (uint8_t* s, const char* str)
+{
+    while ('\0' != *str)
+        *s++ = *str++;
+    return s;
+}
+
+/* write one result line to the serial port */
+static void
+report (const char* name, uint32_t iters, uint32_t cycles, uint32_t bytes)
+{
+    uint8_t line[BUF_LEN];
+    uint8_t* s = line;
+
+    s = put_str (s, "BENCH ");
+    s = put_str (s, name);
+    s = put_str (s, " iters=");
+    s = put_num (s, iters);
+    s = put_str (s, " cycles=");
+    s = put_num (s, cycles);
+    s = put_str (s, " bytes=");
+    s = put_num (s, bytes);
+    *s++ = '\n';
+    (void)ece391_write (serial_fd, line, s - line);
+}
+
+/* system call round trip, close of a bad descriptor fails right after the dispatch */
+static void
+bench_syscall (void)
+{
+    uint32_t i, cycles;
+
+    cycles = tsc ();
+    for (i = 0; i < SYSCALL_ITERS; i++)
+        (void)ece391_close (-1);
+    report ("syscall", SYSCALL_ITERS, tsc () - cycles, 0);
+}
+
+/* execute a child which halts at once */
+static void
+bench_exec_halt (void)
+{
+    uint32_t i, cycles;
+
+    cycles = tsc ();
+    for (i = 0; i < EXEC_ITERS; i++)
+        (void)ece391_execute ((uint8_t*)"bench nop");
+    report ("exec_halt", EXEC_ITERS, tsc () - cycles, 0);
+}
+
+/* file read throughput through open/read/close */
+static void
+bench_file_read (void)
+{
+    uint32_t i, cycles, calls = 0, bytes = 0;
+    int32_t fd, cnt;
+
+    cycles = tsc ();
+    for (i = 0; i < READ_ROUNDS; i++) {
+        if (-1 == (fd = ece391_open ((uint8_t*)READ_FILE)))
+            return;
+        while (0 < (cnt = ece391_read (fd, read_buf, READ_CHUNK))) {
+            bytes += cnt;
+            calls++;
+        }
+        (void)ece391_close (fd);
+    }
+    report ("file_read", calls, tsc () - cycles, bytes);
+}
+
+/* terminal write throughput, full lines so that every line scrolls */
+static void
+bench_term_write (void)
+{
+    uint8_t line[LINE_LEN];
+    uint32_t i, cycles;
+
+    for (i = 0; i < LINE_LEN - 1; i++)
+        line[i] = 'a' + i % 26;
+    line[LINE_LEN - 1] = '\n';
+
+    cycles = tsc ();
+    for (i = 0; i < WRITE_LINES; i++)
+        (void)ece391_write (1, line, LINE_LEN);
+    report ("term_write", WRITE_LINES, tsc () - cycles, WRITE_LINES * LINE_LEN);
+}
+
+int
+main ()
+{
+    uint8_t buf[BUF_LEN];
+
+    if (0 == ece391_getargs (buf, BUF_LEN) && 0 == ece391_strcmp (buf, (uint8_t*)"nop"))
+        return 0;
+
+    if (-1 == (serial_fd = ece391_open ((uint8_t*)"serial"))) {
+        ece391_fdputs (1, (uint8_t*)"bench: no serial port\n");
+        return 2;
+    }
+
+    bench_syscall ();
+    bench_exec_halt ();
+    bench_file_read ();
+    bench_term_write ();
+
+    (void)ece391_write (serial_fd, "BENCH done\n", 11);
+    (void)ece391_close (serial_fd);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391stdio.h"
+
+/*
+ * cat - copy a file to the terminal through the buffered stdio library, one
+ * read and one write per buffer instead of per line.
+ * Usage: cat <file>
+ */
+
+#define NULL            0
+#define NAME_LEN        1024
+
+static uint8_t buf[ECE391_BUFSIZ];
+
+int
+main ()
+{
+    uint8_t name[NAME_LEN];
+    ECE391_FILE* f;
+    int32_t cnt;
+
+    if (0 != ece391_getargs (name, NAME_LEN)) {
+        ece391_fputs ((uint8_t*)"could not read arguments\n", ece391_stdout);
+        return 3;
+    }
+    if (NULL == (f = ece391_fopen (name, "r"))) {
+        ece391_fputs ((uint8_t*)"file not found\n", ece391_stdout);
+        return 2;
+    }
+
+    while (0 < (cnt = ece391_fread (buf, 1, ECE391_BUFSIZ, f)))
+        ece391_fwrite (buf, 1, cnt, ece391_stdout);
+
+    if (f->err) {
+        ece391_fputs ((uint8_t*)"file read failed\n", ece391_stdout);
+        return 3;
+    }
+    (void)ece391_fclose (f);
+    return 0;
+}
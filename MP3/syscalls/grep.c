@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391stdio.h"
+
+/*
+ * grep - print every line of every file in the directory that contains a
+ * string, as "<file>:<line>".  Files are read through the buffered stdio
+ * library and the directory with getdents, a buffer per system call.
+ * Usage: grep <string>
+ */
+
+#define NULL            0
+#define ARG_LEN         128
+#define NAME_LEN        32
+#define LINE_LEN        1024
+#define BUF_SIZE        2048
+
+static uint8_t dent_buf[BUF_SIZE];
+static uint8_t line[LINE_LEN];
+
+/* does the line contain the pattern of length len */
+static int32_t
+match (const uint8_t* s, const uint8_t* pat, uint32_t len)
+{
+    for (; '\0' != *s; s++)
+        if (0 == ece391_strncmp (s, pat, len))
+            return 1;
+    return 0;
+}
+
+/* search one file, return -1 if it could not be read */
+static int32_t
+search (const uint8_t* name, const uint8_t* pat, uint32_t len)
+{
+    ECE391_FILE* f;
+    uint32_t end;
+
+    if (NULL == (f = ece391_fopen (name, "r"))) {
+        ece391_fputs ((uint8_t*)"file open failed\n", ece391_stdout);
+        return -1;
+    }
+    while (NULL != ece391_fgets (line, LINE_LEN, f)) {
+        if (!match (line, pat, len))
+            continue;
+        /* the last line of a file may have no newline */
+        end = ece391_strlen (line);
+        ece391_printf ("%s:%s%s", name, line, ('\n' == line[end - 1] ? "" : "\n"));
+    }
+    if (f->err) {
+        ece391_fputs ((uint8_t*)"file read failed\n", ece391_stdout);
+        (void)ece391_fclose (f);
+        return -1;
+    }
+    if (-1 == ece391_fclose (f)) {
+        ece391_fputs ((uint8_t*)"file close failed\n", ece391_stdout);
+        return -1;
+    }
+    return 0;
+}
+
+int
+main ()
+{
+    uint8_t pat[ARG_LEN];
+    uint8_t name[NAME_LEN + 1];
+    int32_t fd, cnt, pos, i;
+    uint32_t len;
+    ece391_dirent_t* ent;
+
+    if (0 != ece391_getargs (pat, ARG_LEN)) {
+        ece391_fputs ((uint8_t*)"could not read argument\n", ece391_stdout);
+        return 3;
+    }
+    len = ece391_strlen (pat);
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
+        ece391_fputs ((uint8_t*)"directory open failed\n", ece391_stdout);
+        return 2;
+    }
+
+    while (0 < (cnt = ece391_getdents (fd, dent_buf, BUF_SIZE))) {
+        for (pos = 0; pos < cnt; pos += sizeof (*ent) + ent->name_len) {
+            ent = (ece391_dirent_t*)(dent_buf + pos);
+            /* reading the rtc would only block */
+            if (ECE391_TYPE_FILE != ent->type)
+                continue;
+            for (i = 0; i < ent->name_len && i < NAME_LEN; i++)
+                name[i] = ent->name[i];
+            name[i] = '\0';
+            if (-1 == search (name, pat, len))
+                return 3;
+        }
+    }
+
+    if (-1 == cnt) {
+        ece391_fputs ((uint8_t*)"directory entry read failed\n", ece391_stdout);
+        return 3;
+    }
+    (void)ece391_close (fd);
+    return 0;
+}
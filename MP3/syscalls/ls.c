@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * ls - list the directory with one getdents call per buffer instead of one
+ * read per name.
+ * Usage: ls        names only
+ *        ls -l     type, inode, size and name
+ */
+
+#define BUF_SIZE        2048
+#define NAME_LEN        32
+#define NUM_WIDTH       8
+
+static uint8_t dent_buf[BUF_SIZE];
+
+/* print an unsigned decimal number right aligned in a column of width */
+static void
+put_num (uint32_t val, int32_t width)
+{
+    uint8_t buf[12];
+    int32_t i = 11;
+
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + val % 10;
+        val /= 10;
+    } while (0 != val && 0 < i);
+    while (11 - i < width && 0 < i)
+        buf[--i] = ' ';
+    ece391_fdputs (1, buf + i);
+}
+
+/* print one entry */
+static void
+put_entry (ece391_dirent_t* ent, int32_t long_format)
+{
+    static const char* type_name[] = {"rtc ", "dir ", "file"};
+    uint8_t name[NAME_LEN + 2];
+    int32_t i;
+
+    if (long_format) {
+        ece391_fdputs (1, (uint8_t*)(ent->type <= ECE391_TYPE_FILE ? type_name[ent->type] : "?   "));
+        put_num (ent->inode, NUM_WIDTH);
+        put_num (ent->size, NUM_WIDTH);
+        ece391_fdputs (1, (uint8_t*)" ");
+    }
+    for (i = 0; i < ent->name_len && i < NAME_LEN; i++)
+        name[i] = ent->name[i];
+    name[i++] = '\n';
+    name[i] = '\0';
+    ece391_fdputs (1, name);
+}
+
+int
+main ()
+{
+    uint8_t args[NAME_LEN];
+    int32_t fd, cnt, pos, long_format;
+    ece391_dirent_t* ent;
+
+    long_format = (0 == ece391_getargs (args, NAME_LEN) &&
+                   0 == ece391_strcmp (args, (uint8_t*)"-l"));
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
+        ece391_fdputs (1, (uint8_t*)"directory open failed\n");
+        return 2;
+    }
+
+    while (0 < (cnt = ece391_getdents (fd, dent_buf, BUF_SIZE))) {
+        for (pos = 0; pos < cnt; pos += sizeof (*ent) + ent->name_len) {
+            ent = (ece391_dirent_t*)(dent_buf + pos);
+            put_entry (ent, long_format);
+        }
+    }
+
+    if (-1 == cnt) {
+        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
+        return 3;
+    }
+
+    (void)ece391_close (fd);
+    return 0;
+}
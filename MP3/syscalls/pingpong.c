@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391stdio.h"
+
+/*
+ * pingpong - move data between two processes through a shared memory ring,
+ * with futex waits when the ring is full or empty.  Start the sender and
+ * the receiver on two terminals, in either order; they meet on RING_KEY.
+ * Usage: pingpong ping [kB]      send kB kilobytes (default 4096)
+ *        pingpong pong           receive and check them
+ */
+
+#define NULL            0
+#define ARG_LEN         128
+#define RING_KEY        0x50494e47      /* "PING" */
+#define RING_SIZE       (64 * 1024)
+#define CHUNK           4096
+#define DEFAULT_KB      4096
+
+typedef struct ring {
+    volatile uint32_t head;     /* bytes written by ping                */
+    volatile uint32_t tail;     /* bytes consumed by pong               */
+    volatile uint32_t total;    /* bytes ping sends, 0 until it starts  */
+    uint8_t data[RING_SIZE];
+} ring_t;
+
+/* byte n of the stream, so that pong can check what it got */
+#define PATTERN(n)      ((uint8_t)((n) * 7 + ((n) >> 12)))
+
+static void
+ping (ring_t* ring, uint32_t total)
+{
+    uint32_t head, tail, i;
+
+    ring->total = total;
+    (void)ece391_futex ((uint32_t*)&ring->total, ECE391_FUTEX_WAKE, 1);
+
+    for (head = ring->head; total > head; ) {
+        /* wait for room */
+        while (RING_SIZE == head - (tail = ring->tail))
+            (void)ece391_futex ((uint32_t*)&ring->tail, ECE391_FUTEX_WAIT, tail);
+        for (i = 0; CHUNK > i && total > head && RING_SIZE > head - tail; i++, head++)
+            ring->data[head % RING_SIZE] = PATTERN (head);
+        ring->head = head;
+        (void)ece391_futex ((uint32_t*)&ring->head, ECE391_FUTEX_WAKE, 1);
+    }
+    /* the segment goes away with the last holder, stay until pong has it all */
+    while (total != (tail = ring->tail))
+        (void)ece391_futex ((uint32_t*)&ring->tail, ECE391_FUTEX_WAIT, tail);
+    ece391_printf ("ping: sent %u bytes\n", total);
+}
+
+static int32_t
+pong (ring_t* ring)
+{
+    uint32_t head, tail, total, bad = 0;
+
+    /* wait for ping to say how much comes */
+    while (0 == (total = ring->total))
+        (void)ece391_futex ((uint32_t*)&ring->total, ECE391_FUTEX_WAIT, 0);
+
+    for (tail = ring->tail; total > tail; ) {
+        while ((head = ring->head) == tail)
+            (void)ece391_futex ((uint32_t*)&ring->head, ECE391_FUTEX_WAIT, head);
+        for (; head > tail; tail++)
+            if (PATTERN (tail) != ring->data[tail % RING_SIZE])
+                bad++;
+        ring->tail = tail;
+        (void)ece391_futex ((uint32_t*)&ring->tail, ECE391_FUTEX_WAKE, 1);
+    }
+    ece391_printf ("pong: received %u bytes, %u wrong\n", total, bad);
+    return (0 == bad ? 0 : 1);
+}
+
+int
+main ()
+{
+    uint8_t arg[ARG_LEN];
+    uint8_t* s;
+    uint32_t kb = DEFAULT_KB;
+    int32_t shmid, addr, ret = 0;
+    ring_t* ring;
+
+    if (0 != ece391_getargs (arg, ARG_LEN))
+        arg[0] = '\0';
+    for (s = arg; '\0' != *s && ' ' != *s; s++);
+    if ('\0' != *s) {
+        *s++ = '\0';
+        for (kb = 0; '0' <= *s && '9' >= *s; s++)
+            kb = kb * 10 + (*s - '0');
+    }
+    if ((0 != ece391_strcmp (arg, (uint8_t*)"ping") &&
+         0 != ece391_strcmp (arg, (uint8_t*)"pong")) || 0 == kb ||
+        0x100000 <= kb) {
+        ece391_fputs ((uint8_t*)"usage: pingpong ping [kB] | pingpong pong\n",
+                      ece391_stdout);
+        return 3;
+    }
+
+    if (-1 == (shmid = ece391_shmget (RING_KEY, sizeof (ring_t))) ||
+        -1 == (addr = ece391_shmat (shmid, NULL))) {
+        ece391_fputs ((uint8_t*)"no shared memory\n", ece391_stdout);
+        return 2;
+    }
+    ring = (ring_t*)addr;
+
+    if ('i' == arg[1])
+        ping (ring, kb * 1024);
+    else
+        ret = pong (ring);
+
+    (void)ece391_shmdt (ring);
+    return ret;
+}
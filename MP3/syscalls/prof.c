@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * prof - control the kernel sampling profiler through the "prof" pseudo file.
+ * Usage: prof <rate>   clear the profile and sample at rate Hz (100 to 10000)
+ *        prof stop     stop sampling, the profile is kept
+ *        prof          show the state of the profiler
+ * The profile is symbolized on the host with MP3/tools/prof_report.py.
+ */
+
+#define PROG_NUM        16
+#define NAME_LEN        33
+
+/* head of the pseudo file, see prof_hist_t in student-distrib/prof.h */
+typedef struct prof_head {
+    uint32_t magic;
+    uint32_t rate;
+    uint32_t samples;
+    uint32_t dropped;
+    uint32_t prog_num;
+    uint32_t hist_size;
+    uint8_t prog_name[PROG_NUM][NAME_LEN];
+} __attribute__((packed)) prof_head_t;
+
+/* parse an unsigned decimal number */
+static uint32_t
+parse_num (const uint8_t* s)
+{
+    uint32_t val = 0;
+
+    while (*s >= '0' && *s <= '9')
+        val = val * 10 + (*s++ - '0');
+    return val;
+}
+
+/* print a label and an unsigned decimal number */
+static void
+put_num (const char* label, uint32_t val)
+{
+    uint8_t buf[12];
+    int32_t i = 11;
+
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + val % 10;
+        val /= 10;
+    } while (0 != val && 0 < i);
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, buf + i);
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* print the state of the profiler */
+static int32_t
+show (int32_t fd)
+{
+    prof_head_t head;
+    uint32_t i;
+
+    if (sizeof (head) != ece391_read (fd, &head, sizeof (head))) {
+        ece391_fdputs (1, (uint8_t*)"prof: cannot read profile\n");
+        return 2;
+    }
+    put_num ("rate (Hz): ", head.rate);
+    put_num ("samples:   ", head.samples);
+    put_num ("dropped:   ", head.dropped);
+    ece391_fdputs (1, (uint8_t*)"programs: ");
+    for (i = 0; i < head.prog_num && i < PROG_NUM; i++) {
+        head.prog_name[i][NAME_LEN - 1] = '\0';
+        ece391_fdputs (1, (uint8_t*)" ");
+        ece391_fdputs (1, head.prog_name[i]);
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+    return 0;
+}
+
+int
+main ()
+{
+    uint8_t buf[32];
+    int32_t fd, ret = 0;
+    uint32_t rate;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"prof"))) {
+        ece391_fdputs (1, (uint8_t*)"prof: no profiler in this kernel\n");
+        return 2;
+    }
+
+    if (0 != ece391_getargs (buf, 32) || '\0' == buf[0]) {
+        ret = show (fd);
+    } else {
+        rate = (0 == ece391_strcmp (buf, (uint8_t*)"stop")) ? 0 : parse_num (buf);
+        if (-1 == ece391_write (fd, &rate, 4)) {
+            ece391_fdputs (1, (uint8_t*)"prof: rate must be 100 to 10000 Hz, or stop\n");
+            ret = 2;
+        }
+    }
+
+    (void)ece391_close (fd);
+    return ret;
+}
@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391stdio.h"
+
+/*
+ * threads - keep computing while waiting for the keyboard and the clock.
+ * A worker thread counts primes, a ticker thread reports the count on the
+ * RTC every second, and the first thread answers every line typed with the
+ * count so far.  An empty line stops them all.
+ * Usage: threads [limit]      count primes below limit (default 5000000)
+ */
+
+#define NULL            0
+#define ARG_LEN         128
+#define LINE_LEN        128
+#define DEFAULT_LIMIT   5000000
+#define RTC_FREQ        2
+
+static volatile uint32_t primes = 0;    /* primes found so far          */
+static volatile uint32_t checked = 0;   /* numbers checked so far       */
+static volatile uint32_t stop = 0;      /* set by the first thread      */
+static volatile uint32_t done = 0;      /* set by the worker            */
+
+static int32_t
+worker (void* arg)
+{
+    uint32_t limit = (uint32_t)arg;
+    uint32_t n, d;
+
+    for (n = 2; limit > n && !stop; n++) {
+        for (d = 2; d * d <= n && 0 != n % d; d++);
+        if (d * d > n)
+            primes++;
+        checked = n;
+    }
+    done = 1;
+    return 0;
+}
+
+/* digits of n at s, returns the end; the ticker does not share stdio's buffer */
+static uint8_t*
+put_num (uint8_t* s, uint32_t n)
+{
+    uint8_t digits[10];
+    int32_t len = 0;
+
+    do {
+        digits[len++] = '0' + n % 10;
+        n /= 10;
+    } while (0 != n);
+    while (0 < len)
+        *s++ = digits[--len];
+    return s;
+}
+
+static int32_t
+ticker (void* arg)
+{
+    uint8_t msg[LINE_LEN];
+    uint8_t* s;
+    int32_t fd, freq = RTC_FREQ, garbage, tick;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"rtc")))
+        return 1;
+    (void)ece391_write (fd, &freq, 4);
+    for (tick = 1; !stop && !done; tick++) {
+        (void)ece391_read (fd, &garbage, 4);
+        if (0 != tick % RTC_FREQ)
+            continue;
+        /* one write, so that the line is not mixed with the first thread's */
+        *(s = msg) = '[';
+        s = put_num (s + 1, primes);
+        ece391_strcpy (s, (uint8_t*)" primes below ");
+        s = put_num (s + ece391_strlen (s), checked + 1);
+        ece391_strcpy (s, (uint8_t*)"]\n");
+        (void)ece391_write (1, msg, s + 2 - msg);
+    }
+    (void)ece391_close (fd);
+    return 0;
+}
+
+int
+main ()
+{
+    uint8_t arg[ARG_LEN];
+    uint8_t line[LINE_LEN];
+    uint8_t* s;
+    uint32_t limit = DEFAULT_LIMIT;
+    int32_t work_tid, tick_tid, cnt;
+
+    if (0 == ece391_getargs (arg, ARG_LEN) && '0' <= arg[0] && '9' >= arg[0])
+        for (limit = 0, s = arg; '0' <= *s && '9' >= *s; s++)
+            limit = limit * 10 + (*s - '0');
+
+    if (-1 == (work_tid = ece391_thread_create (worker, (void*)limit))) {
+        ece391_fputs ((uint8_t*)"threads: cannot start the worker\n",
+                      ece391_stdout);
+        return 2;
+    }
+    if (-1 == (tick_tid = ece391_thread_create (ticker, NULL)))
+        ece391_fputs ((uint8_t*)"threads: no ticker\n", ece391_stdout);
+
+    ece391_fputs ((uint8_t*)"type a line for the count, an empty one to stop\n",
+                  ece391_stdout);
+    while (0 < (cnt = ece391_read (0, line, LINE_LEN - 1)) && '\n' != line[0])
+        ece391_printf ("%u primes below %u%s\n", primes, checked + 1,
+                       done ? ", done" : "");
+
+    stop = 1;
+    (void)ece391_thread_join (work_tid);
+    if (-1 != tick_tid)
+        (void)ece391_thread_join (tick_tid);
+    ece391_printf ("%u primes below %u\n", primes, checked + 1);
+    return 0;
+}
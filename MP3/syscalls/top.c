@@ -0,0 +1,230 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * top - show per-process CPU usage, context switches, I/O and page faults,
+ * refreshed in place every second from the kernel's "proc" pseudo file.
+ * Usage: top [number of refreshes], default 10, ctrl+C quits early.
+ */
+
+#define NULL            0
+#define NUM_COLS        80
+#define NUM_ROWS        25
+#define ATTRIB          0x7
+#define PROC_BUF_SIZE   8192    /* as the kernel's, the whole proc file */
+#define MAX_PROCS       24
+#define NAME_LEN        33
+#define DEFAULT_ROUNDS  10
+#define RTC_FREQ        2
+
+typedef struct proc_stat {
+    uint32_t pid;
+    uint32_t ticks;
+    uint32_t fields[6];     /* PPID TERM SWITCH RBYTES WBYTES PGFLT */
+    uint8_t name[NAME_LEN];
+} proc_stat_t;
+
+static uint8_t proc_buf[PROC_BUF_SIZE + 1];
+static uint8_t* vmem_base_addr;
+static proc_stat_t prev[MAX_PROCS];
+static int32_t prev_num = 0;
+static uint32_t prev_uptime = 0;
+
+/* read the whole proc file into proc_buf, up to its end, return its length or -1 */
+static int32_t
+read_proc (void)
+{
+    int32_t fd, cnt, len = 0;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"proc")))
+        return -1;
+    while (0 < (cnt = ece391_read (fd, proc_buf + len, PROC_BUF_SIZE - len)))
+        len += cnt;
+    (void)ece391_close (fd);
+    proc_buf[len] = '\0';
+    return len;
+}
+
+/* parse an unsigned decimal number, advance *s past it and following spaces */
+static uint32_t
+parse_num (uint8_t** s)
+{
+    uint32_t val = 0;
+
+    while (**s >= '0' && **s <= '9')
+        val = val * 10 + (*(*s)++ - '0');
+    while (' ' == **s)
+        (*s)++;
+    return val;
+}
+
+/* skip to the start of the next line */
+static uint8_t*
+next_line (uint8_t* s)
+{
+    while ('\0' != *s && '\n' != *s)
+        s++;
+    return ('\n' == *s) ? s + 1 : s;
+}
+
+/* write a string at (row, col) of the screen, return the column after it */
+static int32_t
+put_str (int32_t row, int32_t col, const uint8_t* s)
+{
+    while ('\0' != *s && '\n' != *s && col < NUM_COLS) {
+        vmem_base_addr[(row * NUM_COLS + col) << 1] = *s++;
+        vmem_base_addr[((row * NUM_COLS + col) << 1) + 1] = ATTRIB;
+        col++;
+    }
+    return col;
+}
+
+/* write a number right aligned in a column of width, return the column after it and a space */
+static int32_t
+put_num (int32_t row, int32_t col, uint32_t val, int32_t width)
+{
+    uint8_t buf[12];
+    int32_t i = 11, len;
+
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + val % 10;
+        val /= 10;
+    } while (0 != val && 0 < i);
+    len = 11 - i;
+    if (width > len)
+        col += width - len;
+    put_str (row, col, buf + i);
+    return col + len + 1;
+}
+
+/* clear one row of the screen */
+static void
+clear_row (int32_t row)
+{
+    int32_t col;
+
+    for (col = 0; col < NUM_COLS; col++) {
+        vmem_base_addr[(row * NUM_COLS + col) << 1] = ' ';
+        vmem_base_addr[((row * NUM_COLS + col) << 1) + 1] = ATTRIB;
+    }
+}
+
+/* CPU ticks of pid in the previous refresh, 0 if it is new */
+static uint32_t
+prev_ticks (uint32_t pid, uint8_t* name)
+{
+    int32_t i;
+
+    for (i = 0; i < prev_num; i++)
+        if (prev[i].pid == pid && 0 == ece391_strcmp (prev[i].name, name))
+            return prev[i].ticks;
+    return 0;
+}
+
+/* parse a proc snapshot and draw it */
+static void
+refresh (void)
+{
+    proc_stat_t cur[MAX_PROCS];
+    int32_t cur_num = 0, row, col, i, j;
+    uint32_t uptime, elapsed, delta;
+    uint8_t* s;
+
+    if (0 >= read_proc ())
+        return;
+
+    /* "uptime N" */
+    s = proc_buf;
+    while (' ' != *s && '\0' != *s)
+        s++;
+    while (' ' == *s)
+        s++;
+    uptime = parse_num (&s);
+    elapsed = (uptime > prev_uptime) ? uptime - prev_uptime : 1;
+
+    /* process table, up to the second "PID" header */
+    s = next_line (next_line (proc_buf));
+    while ('\0' != *s && 'P' != *s && cur_num < MAX_PROCS) {
+        cur[cur_num].pid = parse_num (&s);
+        for (i = 0; i < 6; i++) {
+            cur[cur_num].fields[i] = parse_num (&s);
+            if (1 == i)
+                cur[cur_num].ticks = parse_num (&s);
+        }
+        (void)parse_num (&s);   /* FPULD, not shown */
+        for (j = 0; j < NAME_LEN - 1 && '\n' != s[j] && '\0' != s[j]; j++)
+            cur[cur_num].name[j] = s[j];
+        cur[cur_num].name[j] = '\0';
+        s = next_line (s);
+        cur_num++;
+    }
+
+    for (row = 0; row < NUM_ROWS; row++)
+        clear_row (row);
+
+    col = put_str (0, 0, (uint8_t*)"top - uptime ");
+    col = put_num (0, col, uptime, 0);
+    put_str (0, col, (uint8_t*)"ticks");
+    put_str (2, 0, (uint8_t*)"  PID  %CPU   TICKS  SWITCH    RBYTES    WBYTES   PGFLT  NAME");
+    for (i = 0; i < cur_num && 3 + i < NUM_ROWS; i++) {
+        row = 3 + i;
+        delta = cur[i].ticks - prev_ticks (cur[i].pid, cur[i].name);
+        col = put_num (row, 0, cur[i].pid, 5);
+        col = put_num (row, col, delta * 100 / elapsed, 5);
+        col = put_num (row, col, cur[i].ticks, 7);
+        col = put_num (row, col, cur[i].fields[2], 7);
+        col = put_num (row, col, cur[i].fields[3], 9);
+        col = put_num (row, col, cur[i].fields[4], 9);
+        col = put_num (row, col, cur[i].fields[5], 7);
+        put_str (row, col + 1, cur[i].name);
+    }
+
+    /* system call table as it is */
+    row = 4 + cur_num;
+    while ('\0' != *s && row < NUM_ROWS) {
+        put_str (row++, 0, s);
+        s = next_line (s);
+    }
+
+    for (i = 0; i < cur_num; i++)
+        prev[i] = cur[i];
+    prev_num = cur_num;
+    prev_uptime = uptime;
+}
+
+int
+main ()
+{
+    uint8_t buf[32];
+    uint8_t* s;
+    int32_t rtc_fd, rounds, i, garbage, freq;
+
+    rounds = DEFAULT_ROUNDS;
+    if (0 == ece391_getargs (buf, 32)) {
+        s = buf;
+        rounds = parse_num (&s);
+    }
+
+    if (-1 == ece391_vidmap (&vmem_base_addr)) {
+        ece391_fdputs (1, (uint8_t*)"top: vidmap failed\n");
+        return 2;
+    }
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"top: cannot open rtc\n");
+        return 2;
+    }
+    freq = RTC_FREQ;
+    (void)ece391_write (rtc_fd, &freq, 4);
+
+    for (i = 0; i < rounds; i++) {
+        refresh ();
+        /* one second between refreshes */
+        (void)ece391_read (rtc_fd, &garbage, 4);
+        (void)ece391_read (rtc_fd, &garbage, 4);
+    }
+
+    (void)ece391_close (rtc_fd);
+    return 0;
+}
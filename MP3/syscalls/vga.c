@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * vga - draw moving color bars straight into the graphics framebuffer, paced
+ * by the RTC, then go back to text mode.
+ * Usage: vga [x] [frames]    mode 13h, or mode X with "x"; default 256 frames
+ */
+
+#define NULL            0
+#define SCREEN_X        320
+#define SCREEN_Y        200
+#define PLANE_NUM       4
+#define PLANE_X         (SCREEN_X / PLANE_NUM)
+#define DEFAULT_FRAMES  256
+#define RTC_FREQ        64
+#define ARG_LEN         64
+
+/* parse an unsigned decimal number */
+static int32_t
+parse_num (const uint8_t* s)
+{
+    int32_t val = 0;
+
+    while (*s >= '0' && *s <= '9')
+        val = val * 10 + (*s++ - '0');
+    return val;
+}
+
+/* color of a pixel in frame t, diagonal bands through the 256 color palette */
+static uint8_t
+color (int32_t x, int32_t y, int32_t t)
+{
+    return (uint8_t)((x + y + t) & 0xFF);
+}
+
+/* one frame in mode 13h, pixel (x, y) is byte y * 320 + x */
+static void
+draw_13h (uint8_t* screen, int32_t t)
+{
+    int32_t x, y;
+
+    for (y = 0; y < SCREEN_Y; y++)
+        for (x = 0; x < SCREEN_X; x++)
+            screen[y * SCREEN_X + x] = color (x, y, t);
+}
+
+/* one frame in mode X, pixel (x, y) is byte y * 80 + x / 4 of plane x % 4 */
+static int32_t
+draw_mode_x (uint8_t* screen, int32_t t)
+{
+    int32_t p, x, y;
+
+    for (p = 0; p < PLANE_NUM; p++) {
+        if (-1 == ece391_vgamode (ECE391_VGA_PLANES | (1 << p), NULL))
+            return -1;
+        for (y = 0; y < SCREEN_Y; y++)
+            for (x = 0; x < PLANE_X; x++)
+                screen[y * PLANE_X + x] = color (x * PLANE_NUM + p, y, t);
+    }
+    return 0;
+}
+
+int
+main ()
+{
+    uint8_t buf[ARG_LEN];
+    uint8_t* arg = buf;
+    uint8_t* screen;
+    int32_t mode = ECE391_VGA_MODE_13H;
+    int32_t frames = DEFAULT_FRAMES;
+    int32_t rtc_fd, freq = RTC_FREQ, garbage, t;
+
+    if (0 == ece391_getargs (buf, ARG_LEN)) {
+        if ('x' == arg[0]) {
+            mode = ECE391_VGA_MODE_X;
+            for (arg++; ' ' == *arg; arg++);
+        }
+        if ('\0' != *arg)
+            frames = parse_num (arg);
+    }
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc")) ||
+        -1 == ece391_write (rtc_fd, &freq, sizeof (freq))) {
+        ece391_fdputs (1, (uint8_t*)"vga: cannot open rtc\n");
+        return 2;
+    }
+    if (-1 == ece391_vgamode (mode, &screen)) {
+        ece391_fdputs (1, (uint8_t*)"vga: cannot switch to graphics, another program has the screen\n");
+        return 2;
+    }
+
+    for (t = 0; t < frames; t++) {
+        if (ECE391_VGA_MODE_X == mode) {
+            if (-1 == draw_mode_x (screen, t))
+                break;
+        } else {
+            draw_13h (screen, t);
+        }
+        (void)ece391_read (rtc_fd, &garbage, sizeof (garbage));
+    }
+
+    (void)ece391_vgamode (ECE391_VGA_TEXT, NULL);
+    (void)ece391_close (rtc_fd);
+    return 0;
+}
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""
+bench.py
+boot a benchmark kernel headless in QEMU and collect its results
+
+The kernel must be built with RUN_BENCH set (see student-distrib/kernel.c), e.g.
+    make dep && make CPPFLAGS="-nostdinc -g -DRUN_BENCH=1" bootimg
+and the file system image must contain the "bench" program from MP3/syscalls.
+With --fsdir the image is made here with createfs from a copy of that directory
+plus syscalls/bench.
+
+Every result is a serial line "BENCH <name> key=value ...". The run ends at
+"BENCH done" or after --timeout seconds.
+
+Usage:
+    bench.py                                  run once, print a table
+    bench.py -r 5 -o new.json                 5 runs, keep the median, save results
+    bench.py -b old.json                      compare against saved results
+    bench.py --fsdir ../fsdir                 make the file system image first
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MP3 = os.path.dirname(HERE)
+
+
+def make_fs(fsdir, bench_prog, createfs):
+    """file system image of fsdir plus the bench program, in a temporary directory"""
+    tmp = tempfile.mkdtemp(prefix="bench")
+    root = os.path.join(tmp, "fsdir")
+    shutil.copytree(fsdir, root)
+    shutil.copy(bench_prog, os.path.join(root, "bench"))
+    image = os.path.join(tmp, "filesys_img")
+    subprocess.check_call([createfs, "-i", root, "-o", image])
+    return image
+
+
+def run_once(args, fs_image):
+    """boot the kernel, return {name: {key: value}} of one run"""
+    cmd = [args.qemu, "-kernel", args.kernel, "-initrd", fs_image, "-m", "256",
+           "-serial", "stdio", "-display", "none", "-no-reboot", "-monitor", "none"]
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    results = {}
+    # a hung kernel prints nothing, so the timeout cannot wait for a line
+    timer = threading.Timer(args.timeout, proc.kill)
+    timer.start()
+    try:
+        for raw in proc.stdout:
+            line = raw.decode("ascii", "replace").strip()
+            if args.verbose:
+                print(line)
+            fields = line.split()
+            if len(fields) < 2 or fields[0] != "BENCH":
+                continue
+            if fields[1] == "done":
+                break
+            results[fields[1]] = dict((k, int(v)) for k, v in
+                                      (f.split("=", 1) for f in fields[2:] if "=" in f))
+    finally:
+        timer.cancel()
+        proc.kill()
+        proc.wait()
+    return results
+
+
+def derive(results):
+    """cycles and time per operation, and MB/s where bytes are moved"""
+    khz = results.get("tsc", {}).get("khz", 0)
+    table = {}
+    for name, r in results.items():
+        if "iters" not in r or not r["iters"]:
+            continue
+        row = {"cycles_per_op": r["cycles"] / r["iters"]}
+        if khz:
+            row["us_per_op"] = row["cycles_per_op"] / khz * 1000
+            if r.get("bytes"):
+                row["mb_per_s"] = r["bytes"] / (r["cycles"] / (khz * 1000.0)) / 1e6
+        table[name] = row
+    return khz, table
+
+
+def median(values):
+    values = sorted(values)
+    return values[len(values) // 2]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="run the kernel benchmark suite in QEMU")
+    parser.add_argument("-k", "--kernel", default=os.path.join(MP3, "student-distrib", "bootimg"))
+    parser.add_argument("-f", "--fs", default=os.path.join(MP3, "student-distrib", "filesys_img"))
+    parser.add_argument("--fsdir", help="make the file system image from this directory plus bench")
+    parser.add_argument("--createfs", default=os.path.join(MP3, "createfs"))
+    parser.add_argument("--bench-prog", default=os.path.join(MP3, "syscalls", "bench"))
+    parser.add_argument("--qemu", default="qemu-system-i386")
+    parser.add_argument("-r", "--runs", type=int, default=1, help="runs, the median of each value is kept")
+    parser.add_argument("-t", "--timeout", type=float, default=120)
+    parser.add_argument("-o", "--output", help="save the results as JSON")
+    parser.add_argument("-b", "--baseline", help="compare against results saved with -o")
+    parser.add_argument("-v", "--verbose", action="store_true", help="echo the serial port")
+    args = parser.parse_args()
+
+    fs_image = make_fs(args.fsdir, args.bench_prog, args.createfs) if args.fsdir else args.fs
+
+    runs = []
+    for i in range(args.runs):
+        khz, table = derive(run_once(args, fs_image))
+        if not table:
+            sys.exit("run %d: no results, is the kernel built with RUN_BENCH?" % i)
+        runs.append(table)
+
+    table = {}
+    for name in runs[0]:
+        table[name] = dict((key, median([r[name][key] for r in runs if name in r and key in r[name]]))
+                           for key in runs[0][name])
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    print("TSC %.1f MHz, %d run(s)" % (khz / 1000.0, len(runs)))
+    print("%-12s %14s %12s %10s %10s" % ("workload", "cycles/op", "us/op", "MB/s", "vs base"))
+    for name in sorted(table):
+        row = table[name]
+        change = ""
+        if name in baseline:
+            old = baseline[name]["cycles_per_op"]
+            change = "%+.1f%%" % ((row["cycles_per_op"] - old) * 100.0 / old)
+        print("%-12s %14.1f %12s %10s %10s" % (
+            name, row["cycles_per_op"],
+            "%.3f" % row["us_per_op"] if "us_per_op" in row else "-",
+            "%.1f" % row["mb_per_s"] if "mb_per_s" in row else "-", change))
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(table, f, indent=2, sort_keys=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""
+elfcheck.py
+check user programs against the rules of the kernel ELF loader (see student-distrib/elf.c)
+
+For every program it prints the loadable segments, the pages the loader fills at execute,
+how many of them the image cache (student-distrib/imgcache.c) shares read-only and how
+many it maps copy-on-write, and where the lazily zero-filled area starts. A program the kernel would
+reject is reported with the reason, and the exit status is 1.
+
+With --corpus, malformed variants of a good program (built by syscalls/Makefile with
+elfconvert) are written to a directory, one per loader rule. Copied into fsdir, each of
+them must fail to execute from the shell while the original still runs.
+
+Usage:
+    elfcheck.py ../fsdir/*                      check programs
+    elfcheck.py --corpus out ../fsdir/sigtest   write malformed variants of a program
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+PAGE = 4096
+ELF_MAGIC = b"\x7fELF"
+ELF_CLASS_32, ELF_DATA_LSB, ELF_VERSION_CURRENT = 1, 1, 1
+ELF_TYPE_EXEC, ELF_MACHINE_386 = 2, 3
+PT_LOAD = 1
+PF_X, PF_W, PF_R = 1, 2, 4
+ELF_MAX_PHDR = 16
+USER_START = 0x08000000
+USER_END = 0x08400000 - 0x10000
+IMGCACHE_MAX_PAGES = 64
+
+EHDR = struct.Struct("<16sHHIIIIIHHHHHH")
+PHDR = struct.Struct("<IIIIIIII")
+
+# field positions in EHDR and PHDR
+E_IDENT, E_TYPE, E_MACHINE, E_VERSION, E_ENTRY, E_PHOFF = 0, 1, 2, 3, 4, 5
+E_PHENTSIZE, E_PHNUM = 9, 10
+P_TYPE, P_OFFSET, P_VADDR, P_PADDR, P_FILESZ, P_MEMSZ, P_FLAGS = range(7)
+
+
+class Reject(Exception):
+    """the kernel loader would refuse the program"""
+
+
+def check(data):
+    """apply the elf_check rules, return (entry, loadable segments, lazy start)"""
+    if len(data) < EHDR.size:
+        raise Reject("shorter than the ELF header")
+    ehdr = EHDR.unpack_from(data)
+    ident = ehdr[E_IDENT]
+    if ident[:4] != ELF_MAGIC:
+        raise Reject("bad magic")
+    if (ident[4], ident[5], ident[6]) != (ELF_CLASS_32, ELF_DATA_LSB, ELF_VERSION_CURRENT):
+        raise Reject("not a little endian ELF32 file")
+    if (ehdr[E_TYPE], ehdr[E_MACHINE], ehdr[E_VERSION]) != (ELF_TYPE_EXEC, ELF_MACHINE_386, ELF_VERSION_CURRENT):
+        raise Reject("not an i386 executable")
+    phoff, phnum = ehdr[E_PHOFF], ehdr[E_PHNUM]
+    if ehdr[E_PHENTSIZE] != PHDR.size or not 0 < phnum <= ELF_MAX_PHDR:
+        raise Reject("bad program header table")
+    if phoff > len(data) or phnum * PHDR.size > len(data) - phoff:
+        raise Reject("program header table outside the file")
+
+    entry = ehdr[E_ENTRY]
+    segs = []
+    prev_end = file_end = USER_START
+    entry_ok = False
+    for i in range(phnum):
+        ph = PHDR.unpack_from(data, phoff + i * PHDR.size)
+        if ph[P_TYPE] != PT_LOAD:
+            continue
+        off, vaddr, filesz, memsz, flags = ph[P_OFFSET], ph[P_VADDR], ph[P_FILESZ], ph[P_MEMSZ], ph[P_FLAGS]
+        if filesz > memsz or off > len(data) or filesz > len(data) - off:
+            raise Reject("segment %d: file data outside the file" % i)
+        if vaddr < prev_end or vaddr >= USER_END or memsz > USER_END - vaddr:
+            raise Reject("segment %d: out of order or outside the user area" % i)
+        if (off ^ vaddr) & (PAGE - 1):
+            raise Reject("segment %d: offset and address differ in the page" % i)
+        if flags & PF_X and vaddr <= entry < vaddr + filesz:
+            entry_ok = True
+        prev_end = vaddr + memsz
+        if filesz:
+            file_end = vaddr + filesz
+        segs.append(ph)
+    if not segs:
+        raise Reject("no loadable segment")
+    if not entry_ok:
+        raise Reject("entry point not in an executable segment")
+    return entry, segs, (file_end + PAGE - 1) & ~(PAGE - 1)
+
+
+def report(name, data):
+    """print what the loader does with a program, return False if it is rejected"""
+    try:
+        entry, segs, lazy_start = check(data)
+    except Reject as err:
+        print("%s: rejected, %s" % (name, err))
+        return False
+    pages = set()
+    writable = set()
+    copied = 0
+    print("%s: entry 0x%08x, %d bytes" % (name, entry, len(data)))
+    for ph in segs:
+        vaddr, filesz, memsz, flags = ph[P_VADDR], ph[P_FILESZ], ph[P_MEMSZ], ph[P_FLAGS]
+        perm = "".join(c if flags & f else "-" for c, f in (("R", PF_R), ("W", PF_W), ("X", PF_X)))
+        print("    LOAD 0x%08x file 0x%05x mem 0x%05x %s" % (vaddr, filesz, memsz, perm))
+        # elf_page_flags: every page of the segment below the lazy area
+        seg_pages = [p for p in range(vaddr // PAGE, (vaddr + memsz + PAGE - 1) // PAGE) if p * PAGE < lazy_start]
+        pages.update(seg_pages)
+        if flags & PF_W:
+            writable.update(seg_pages)
+        copied += filesz
+    print("    %d pages filled, %d bytes copied, zero-filled on demand from 0x%08x" % (len(pages), copied, lazy_start))
+    if len(pages) > IMGCACHE_MAX_PAGES:
+        print("    too big for the image cache, loaded privately")
+    else:
+        print("    cached: %d pages shared read-only, %d copy-on-write" % (len(pages - writable), len(writable)))
+    return True
+
+
+def patch(data, fmt, pos, value):
+    """copy of data with one packed field replaced"""
+    out = bytearray(data)
+    struct.pack_into(fmt, out, pos, value)
+    return bytes(out)
+
+
+def corpus(data):
+    """malformed variants of a good program, by the rule each one breaks"""
+    ehdr = EHDR.unpack_from(data)
+    phoff = ehdr[E_PHOFF]
+    load = [phoff + i * PHDR.size for i in range(ehdr[E_PHNUM])
+            if PHDR.unpack_from(data, phoff + i * PHDR.size)[P_TYPE] == PT_LOAD]
+    first, last = load[0], load[-1]
+    return {
+        "truncated": data[:EHDR.size - 1],
+        "badmagic": b"\x7fELG" + data[4:],
+        "elf64": data[:4] + b"\x02" + data[5:],
+        "bigendian": data[:5] + b"\x02" + data[6:],
+        "notexec": patch(data, "<H", 16, 3),
+        "phnum0": patch(data, "<H", 44, 0),
+        "phoff": patch(data, "<I", 28, len(data)),
+        "pastend": patch(data, "<I", last + 4 * P_FILESZ, len(data)),
+        "filesz": patch(data, "<I", last + 4 * P_MEMSZ, 0),
+        "lowaddr": patch(data, "<I", first + 4 * P_VADDR, USER_START - PAGE),
+        "stack": patch(data, "<I", last + 4 * P_MEMSZ, USER_END),
+        "misalign": patch(data, "<I", last + 4 * P_OFFSET, PHDR.unpack_from(data, last)[P_OFFSET] + 4),
+        "overlap": patch(data, "<I", last + 4 * P_VADDR, PHDR.unpack_from(data, first)[P_VADDR]),
+        "entry": patch(data, "<I", 24, PHDR.unpack_from(data, last)[P_VADDR]),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="check user programs against the kernel ELF loader")
+    parser.add_argument("--corpus", metavar="DIR", help="write malformed variants of the programs to DIR")
+    parser.add_argument("programs", nargs="+")
+    args = parser.parse_args()
+
+    ok = True
+    for path in args.programs:
+        with open(path, "rb") as f:
+            data = f.read()
+        name = os.path.basename(path)
+        if data[:4] != ELF_MAGIC:
+            continue
+        ok = report(name, data) and ok
+        if not args.corpus:
+            continue
+        os.makedirs(args.corpus, exist_ok=True)
+        for rule, bad in sorted(corpus(data).items()):
+            # a variant must break exactly the rule it is named after
+            try:
+                check(bad)
+                sys.exit("%s: variant %s is not rejected" % (name, rule))
+            except Reject:
+                pass
+            with open(os.path.join(args.corpus, "%s.%s" % (name, rule)), "wb") as f:
+                f.write(bad)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
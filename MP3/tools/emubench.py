@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""
+emubench.py
+run user programs on Linux through fish/ece391emulate.c and report their system calls
+
+Build the programs first with
+    make -C ../syscalls emulated && make -C ../fish fish_emulated
+Each workload runs in a temporary copy of fsdir, with the emulated programs copied in
+under their fsdir names so that execute finds them. ece391emulate.c appends one line
+per system call used and a summary to the file named by ECE391_BENCH:
+    EMU <prog> call=<name> count=<n> errors=<n> ns=<n> bytes=<n>
+    EMU <prog> total ns=<n> read=<n> written=<n> frames=<n>
+Only the lines of the program started for the workload count, not those of its children.
+
+fish needs root for /dev/mem; its frames/sec is that of the RTC unless --rtc-fast.
+
+Usage:
+    emubench.py                               run the default workloads, print a table
+    emubench.py "cat frame0.txt" "grep fish"  run these command lines instead
+    emubench.py -r 5 -o new.json              5 runs, keep the median, save results
+    emubench.py -b old.json                   compare against saved results
+    emubench.py --replay keys.txt shell       terminal input from a file, a line per read
+"""
+
+import argparse
+import glob
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MP3 = os.path.dirname(HERE)
+
+DEFAULT_WORKLOADS = [
+    "cat verylargetextwithverylongname.txt",
+    "cat frame0.txt",
+    "grep the",
+    "ls -l",
+]
+
+
+def make_root(fsdir):
+    """copy of fsdir with every emulated program in place of its fsdir binary"""
+    tmp = tempfile.mkdtemp(prefix="emubench")
+    root = os.path.join(tmp, "fsdir")
+    shutil.copytree(fsdir, root)
+    progs = glob.glob(os.path.join(MP3, "syscalls", "*_emulated"))
+    progs += glob.glob(os.path.join(MP3, "fish", "*_emulated"))
+    for prog in progs:
+        name = os.path.basename(prog)[:-len("_emulated")]
+        shutil.copy(prog, os.path.join(root, name))
+    return tmp, root
+
+
+def run_once(args, root, workload):
+    """run one command line, return {"calls": {name: {key: value}}, "total": {key: value}}"""
+    words = workload.split()
+    report = os.path.join(os.path.dirname(root), "report")
+    if os.path.exists(report):
+        os.remove(report)
+    env = dict(os.environ, ECE391_BENCH=report)
+    if args.replay:
+        env["ECE391_REPLAY"] = os.path.abspath(args.replay)
+    if args.rtc_fast:
+        env["ECE391_RTC_FAST"] = "1"
+
+    with open(os.devnull, "w") as null:
+        status = subprocess.call(["./" + words[0]] + words[1:], cwd=root, env=env,
+                                 stdin=subprocess.DEVNULL, stdout=None if args.verbose else null)
+    if status != 0 and args.verbose:
+        print("%s: exit status %d" % (workload, status))
+
+    result = {"calls": {}, "total": {}}
+    if not os.path.exists(report):
+        return result
+    with open(report) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) < 3 or fields[0] != "EMU" or fields[1] != words[0]:
+                continue
+            values = dict(f.split("=", 1) for f in fields[2:] if "=" in f)
+            if fields[2] == "total":
+                result["total"] = dict((k, int(v)) for k, v in values.items())
+            else:
+                name = values.pop("call")
+                result["calls"][name] = dict((k, int(v)) for k, v in values.items())
+    return result
+
+
+def derive(result):
+    """elapsed time, system calls, and throughput of one run"""
+    total = result["total"]
+    if not total.get("ns"):
+        return None
+    secs = total["ns"] / 1e9
+    row = {
+        "ms": total["ns"] / 1e6,
+        "syscalls": sum(c["count"] for c in result["calls"].values()),
+        "syscall_ms": sum(c["ns"] for c in result["calls"].values()) / 1e6,
+        "kb_per_s": (total["read"] + total["written"]) / secs / 1000,
+    }
+    if total["frames"]:
+        row["frames_per_s"] = total["frames"] / secs
+    for name, c in result["calls"].items():
+        row["calls." + name] = c["count"]
+    return row
+
+
+def median(values):
+    values = sorted(values)
+    return values[len(values) // 2]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="benchmark user programs on Linux with ece391emulate.c")
+    parser.add_argument("workloads", nargs="*", help="command lines, as typed at the shell")
+    parser.add_argument("--fsdir", default=os.path.join(MP3, "fsdir"))
+    parser.add_argument("--replay", help="file of terminal input, one line per read")
+    parser.add_argument("--rtc-fast", action="store_true", help="rtc reads do not wait for a tick")
+    parser.add_argument("-r", "--runs", type=int, default=1, help="runs, the median of each value is kept")
+    parser.add_argument("-o", "--output", help="save the results as JSON")
+    parser.add_argument("-b", "--baseline", help="compare against results saved with -o")
+    parser.add_argument("-c", "--calls", action="store_true", help="show the count of each system call")
+    parser.add_argument("-v", "--verbose", action="store_true", help="show the output of the programs")
+    args = parser.parse_args()
+
+    tmp, root = make_root(args.fsdir)
+    table = {}
+    try:
+        for workload in args.workloads or DEFAULT_WORKLOADS:
+            runs = [r for r in (derive(run_once(args, root, workload)) for i in range(args.runs)) if r]
+            if not runs:
+                print("%s: no report, is the program built with 'make emulated'?" % workload,
+                      file=sys.stderr)
+                continue
+            table[workload] = dict((key, median([r[key] for r in runs if key in r])) for key in runs[0])
+    finally:
+        shutil.rmtree(tmp)
+    if not table:
+        sys.exit(1)
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    print("%-40s %10s %10s %10s %10s %10s %10s" % (
+        "workload", "ms", "syscalls", "in calls", "kB/s", "frames/s", "vs base"))
+    for name in sorted(table):
+        row = table[name]
+        change = ""
+        if name in baseline:
+            old = baseline[name]["ms"]
+            change = "%+.1f%%" % ((row["ms"] - old) * 100.0 / old)
+        print("%-40s %10.2f %10d %10.2f %10.1f %10s %10s" % (
+            name, row["ms"], row["syscalls"], row["syscall_ms"], row["kb_per_s"],
+            "%.1f" % row["frames_per_s"] if "frames_per_s" in row else "-", change))
+        if args.calls:
+            for key in sorted(k for k in row if k.startswith("calls.")):
+                print("    %-36s %10d" % (key[len("calls."):], row[key]))
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(table, f, indent=2, sort_keys=True)
+
+
+if __name__ == "__main__":
+    main()
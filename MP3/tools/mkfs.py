@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+mkfs.py
+make a file system image with nested directories (see student-distrib/filesys.h)
+
+createfs only makes flat images of at most 63 files. This tool lays out the same
+boot block, inodes and data blocks, and turns every subdirectory of the source
+tree into a directory inode whose data is an array of 64-byte dentries, starting
+with "." and "..". The root directory stays in the boot block, so the image
+still mounts on kernels without path walking, which only see the top level.
+
+With --extent the image is version 1: every inode is a list of (file block,
+start, length) runs of contiguous data blocks instead of one index per block,
+so a file is not limited to 1023 blocks (4MB). Files are laid out contiguously,
+so each takes a single extent.
+
+Usage:
+    mkfs.py -i fsdir -o filesys_img
+    mkfs.py --extent -i fsdir -o filesys_img
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+BLOCK_SIZE = 4096
+NAME_LEN = 32
+DENTRY = struct.Struct("<32sII24x")
+MAX_ROOT_DENTRY = (BLOCK_SIZE - 64) // 64
+MAX_INODE_BLOCKS = (BLOCK_SIZE - 4) // 4
+MAX_INODE_EXTENTS = (BLOCK_SIZE - 8) // 12
+
+FS_VERSION_DIRECT, FS_VERSION_EXTENT = 0, 1
+
+RTC_TYPE, DIR_TYPE, FILE_TYPE = 0, 1, 2
+ROOT_INODE = 0xFFFFFFFF
+
+
+class Image(object):
+    """inodes and data blocks being laid out, inode 0 is reserved like createfs does"""
+
+    def __init__(self, version):
+        self.version = version
+        self.inodes = [None]
+        self.blocks = []
+
+    def add_inode(self, data):
+        """store data in new blocks, return the inode index"""
+        blocks = []
+        for off in range(0, len(data), BLOCK_SIZE):
+            blocks.append(len(self.blocks))
+            self.blocks.append(data[off:off + BLOCK_SIZE].ljust(BLOCK_SIZE, b"\0"))
+        if self.version == FS_VERSION_DIRECT and len(blocks) > MAX_INODE_BLOCKS:
+            raise ValueError("file of %d bytes does not fit in one inode, try --extent" % len(data))
+        self.inodes.append((len(data), blocks))
+        return len(self.inodes) - 1
+
+    def pack_inode(self, idx):
+        """inode block in the format of the image version"""
+        size, blocks = self.inodes[idx] if self.inodes[idx] else (0, [])
+        if self.version == FS_VERSION_DIRECT:
+            raw = struct.pack("<I%dI" % len(blocks), size, *blocks)
+        else:
+            extents = []
+            for i, block in enumerate(blocks):
+                if extents and extents[-1][1] + extents[-1][2] == block:
+                    extents[-1][2] += 1
+                else:
+                    extents.append([i, block, 1])
+            if len(extents) > MAX_INODE_EXTENTS:
+                raise ValueError("inode %d has too many extents" % idx)
+            raw = struct.pack("<II", size, len(extents))
+            raw += b"".join(struct.pack("<III", *e) for e in extents)
+        return raw.ljust(BLOCK_SIZE, b"\0")
+
+    def reserve_inode(self):
+        self.inodes.append(None)
+        return len(self.inodes) - 1
+
+    def set_inode(self, idx, data):
+        """store data for an inode reserved earlier, so a directory knows its own index"""
+        last = self.add_inode(data)
+        self.inodes[idx] = self.inodes.pop()
+        assert last == len(self.inodes)
+
+
+def dentry(name, ftype, inode):
+    raw = name.encode("ascii", "replace")
+    if len(raw) > NAME_LEN:
+        sys.stderr.write("warning: name truncated to %d chars: %s\n" % (NAME_LEN, name))
+    return DENTRY.pack(raw[:NAME_LEN], ftype, inode)
+
+
+def add_tree(image, path, self_inode, parent_inode):
+    """dentries of the children of a directory, subdirectories are added recursively"""
+    entries = []
+    for name in sorted(os.listdir(path)):
+        full = os.path.join(path, name)
+        if os.path.isdir(full):
+            sub = image.reserve_inode()
+            data = dentry(".", DIR_TYPE, sub) + dentry("..", DIR_TYPE, self_inode)
+            data += b"".join(add_tree(image, full, sub, self_inode))
+            image.set_inode(sub, data)
+            entries.append(dentry(name, DIR_TYPE, sub))
+        elif os.path.isfile(full):
+            with open(full, "rb") as f:
+                entries.append(dentry(name, FILE_TYPE, image.add_inode(f.read())))
+    return entries
+
+
+def main():
+    parser = argparse.ArgumentParser(description="make a file system image with nested directories")
+    parser.add_argument("-i", "--input", required=True, help="source directory")
+    parser.add_argument("-o", "--output", required=True, help="image file")
+    parser.add_argument("--no-rtc", action="store_true", help="do not add the rtc device file")
+    parser.add_argument("--extent", action="store_true", help="extent inodes (version 1), for files over 4MB")
+    args = parser.parse_args()
+
+    image = Image(FS_VERSION_EXTENT if args.extent else FS_VERSION_DIRECT)
+    root = [dentry(".", DIR_TYPE, 0)]
+    if not args.no_rtc:
+        root.append(dentry("rtc", RTC_TYPE, 0))
+    try:
+        root += add_tree(image, args.input, ROOT_INODE, ROOT_INODE)
+    except ValueError as e:
+        sys.exit(str(e))
+    if len(root) > MAX_ROOT_DENTRY:
+        sys.exit("%d entries in the top level, at most %d fit in the boot block, "
+                 "move some into subdirectories" % (len(root), MAX_ROOT_DENTRY))
+
+    boot = struct.pack("<IIII48x", len(root), len(image.inodes), len(image.blocks), image.version)
+    out = [(boot + b"".join(root)).ljust(BLOCK_SIZE, b"\0")]
+    try:
+        out += [image.pack_inode(i) for i in range(len(image.inodes))]
+    except ValueError as e:
+        sys.exit(str(e))
+    out += image.blocks
+
+    with open(args.output, "wb") as f:
+        f.write(b"".join(out))
+    print("%d top level entries, %d inodes, %d data blocks" % (len(root), len(image.inodes), len(image.blocks)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+prof_report.py
+symbolize a kernel profiler dump (see student-distrib/prof.h) into flat profiles
+
+Start the profiler in the OS with "prof 1000", run the workload, "prof stop",
+then get the dump with gdb:
+    (gdb) dump binary value prof.bin prof_hist
+
+Usage:
+    prof_report.py prof.bin                   per function profile of every program
+    prof_report.py -n 20 prof.bin             only the 20 hottest functions
+    prof_report.py -a prof.bin                per address instead of per function
+    prof_report.py -k bootimg -d fsdir prof.bin
+
+Kernel samples are symbolized against bootimg. User samples are symbolized against
+the program with the same name, the unstripped <name>.exe in the search directories
+is preferred over the stripped one in fsdir.
+"""
+
+import argparse
+import bisect
+import os
+import struct
+import subprocess
+import sys
+
+PROF_MAGIC = 0x31465250
+PROG_NUM = 16
+NAME_LEN = 33
+
+HEADER = struct.Struct("<IIIIII")
+BUCKET = struct.Struct("<IHHI")
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MP3 = os.path.dirname(HERE)
+
+
+def load(path):
+    """return (header dict, program names, [(eip, pid, prog, count)])"""
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, rate, samples, dropped, prog_num, hist_size = HEADER.unpack_from(data, 0)
+    if magic != PROF_MAGIC:
+        sys.exit("%s: bad magic 0x%08x" % (path, magic))
+    off = HEADER.size
+    names = []
+    for i in range(PROG_NUM):
+        raw = data[off + i * NAME_LEN: off + (i + 1) * NAME_LEN]
+        names.append(raw.split(b"\0")[0].decode("ascii", "replace"))
+    names = names[:prog_num]
+    off += PROG_NUM * NAME_LEN
+    buckets = []
+    for i in range(hist_size):
+        eip, pid, prog, count = BUCKET.unpack_from(data, off + i * BUCKET.size)
+        if count:
+            buckets.append((eip, pid, prog, count))
+    head = {"rate": rate, "samples": samples, "dropped": dropped}
+    return head, names, buckets
+
+
+class Symbols(object):
+    """function symbols of an ELF file, looked up by address"""
+
+    def __init__(self, path):
+        self.path = path
+        self.addrs = []
+        self.names = []
+        if path is None:
+            return
+        try:
+            out = subprocess.check_output(["nm", "-n", "--defined-only", path],
+                                          stderr=subprocess.DEVNULL).decode()
+        except (OSError, subprocess.CalledProcessError):
+            return
+        for line in out.splitlines():
+            fields = line.split()
+            if len(fields) == 3 and fields[1] in "tTwW":
+                self.addrs.append(int(fields[0], 16))
+                self.names.append(fields[2])
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return "0x%08x" % addr
+        return self.names[i]
+
+
+def find_image(name, kernel, dirs):
+    """path of the ELF file for a program name, None if there is none"""
+    if name == "bootimg":
+        return kernel
+    for d in dirs:
+        exe = os.path.join(d, name + ".exe")
+        if os.path.isfile(exe):
+            return exe
+    for d in dirs:
+        plain = os.path.join(d, name)
+        if os.path.isfile(plain):
+            return plain
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="symbolize a kernel profiler dump")
+    parser.add_argument("dump")
+    parser.add_argument("-k", "--kernel", default=os.path.join(MP3, "student-distrib", "bootimg"),
+                        help="kernel image, default student-distrib/bootimg")
+    parser.add_argument("-d", "--dir", action="append",
+                        help="directory with user programs, may be repeated, default syscalls, fish and fsdir")
+    parser.add_argument("-n", "--top", type=int, default=0, help="only print the hottest entries")
+    parser.add_argument("-a", "--address", action="store_true", help="profile per address instead of per function")
+    args = parser.parse_args()
+    dirs = args.dir or [os.path.join(MP3, d) for d in ("syscalls", "fish", "fsdir")]
+
+    head, names, buckets = load(args.dump)
+    symbols = {}
+    for prog, name in enumerate(names):
+        path = find_image(name, args.kernel, dirs)
+        symbols[prog] = Symbols(path)
+        if not symbols[prog].addrs:
+            sys.stderr.write("warning: no symbols for %s (%s)\n" % (name, path or "not found"))
+
+    flat = {}
+    for eip, pid, prog, count in buckets:
+        name = names[prog] if prog < len(names) else "?"
+        where = "0x%08x" % eip if args.address else symbols.get(prog, Symbols(None)).lookup(eip)
+        key = (name, where)
+        flat[key] = flat.get(key, 0) + count
+
+    total = sum(flat.values())
+    print("rate %d Hz, %d samples, %d dropped" % (head["rate"], head["samples"], head["dropped"]))
+    if total == 0:
+        return
+    print("%7s %7s  %-10s %s" % ("%", "samples", "program", "function" if not args.address else "address"))
+    rows = sorted(flat.items(), key=lambda kv: -kv[1])
+    if args.top:
+        rows = rows[:args.top]
+    for (name, where), count in rows:
+        print("%6.2f%% %7d  %-10s %s" % (100.0 * count / total, count, name, where))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+trace_decode.py
+decode a kernel event trace dump (see student-distrib/trace.h)
+
+Get a dump from a running kernel with gdb:
+    (gdb) dump binary value trace.bin trace_ring
+
+Usage:
+    trace_decode.py trace.bin            print the events and a latency summary
+    trace_decode.py -s trace.bin         only print the latency summary
+    trace_decode.py -m 33.3 trace.bin    use a known TSC rate in MHz
+"""
+
+import argparse
+import struct
+import sys
+
+TRACE_MAGIC = 0x31435254
+TRACE_NO_PID = 0xFFFF
+PIT_FREQ = 100
+SOFTIRQ_KEYBOARD = 0
+
+HEADER = struct.Struct("<IIII")
+ENTRY = struct.Struct("<IIHHII")
+
+EVENT_NAMES = [
+    "PIT", "KEYBOARD", "RTC", "SCHED", "EXECUTE",
+    "HALT", "SYSCALL", "SYSCALL_RET", "WAKEUP", "SOFTIRQ",
+]
+(TRACE_PIT, TRACE_KEYBOARD, TRACE_RTC, TRACE_SCHED, TRACE_EXECUTE,
+ TRACE_HALT, TRACE_SYSCALL, TRACE_SYSCALL_RET, TRACE_WAKEUP,
+ TRACE_SOFTIRQ) = range(len(EVENT_NAMES))
+
+SYSCALL_NAMES = {
+    1: "halt", 2: "execute", 3: "read", 4: "write", 5: "open",
+    6: "close", 7: "getargs", 8: "vidmap", 9: "set_handler", 10: "sigreturn",
+}
+
+
+def load(path):
+    """return the events of a dump in recording order as (tsc, event, pid, arg0, arg1)"""
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, head, size, entry_size = HEADER.unpack_from(data, 0)
+    if magic != TRACE_MAGIC:
+        sys.exit("%s: bad magic 0x%08x" % (path, magic))
+    if entry_size != ENTRY.size:
+        sys.exit("%s: entry size %d, expected %d" % (path, entry_size, ENTRY.size))
+
+    # events head-size .. head-1 survive in the ring, event n is in slot n % size
+    first = max(0, head - size)
+    events = []
+    for seq in range(first, head):
+        lo, hi, event, pid, arg0, arg1 = ENTRY.unpack_from(data, HEADER.size + (seq % size) * ENTRY.size)
+        events.append(((hi << 32) | lo, event, pid, arg0, arg1))
+    # a slot is reserved before it is filled, so order by timestamp
+    events.sort(key=lambda e: e[0])
+    return head, events
+
+
+def tsc_mhz(events):
+    """estimate the TSC rate from the PIT ticks, which come at PIT_FREQ Hz"""
+    ticks = [e[0] for e in events if e[1] == TRACE_PIT]
+    if len(ticks) < 2:
+        return None
+    return (ticks[-1] - ticks[0]) * PIT_FREQ / (len(ticks) - 1) / 1e6
+
+
+def describe(event, arg0, arg1):
+    if event == TRACE_KEYBOARD:
+        return "scancode=0x%02x" % arg0
+    if event == TRACE_RTC:
+        return "count=%d" % arg0
+    if event in (TRACE_SCHED, TRACE_EXECUTE):
+        return "pid=%d" % arg0
+    if event == TRACE_HALT:
+        return "status=%d parent=%d" % (arg0, struct.unpack("<i", struct.pack("<I", arg1))[0])
+    if event == TRACE_SYSCALL:
+        return "%s(0x%x)" % (SYSCALL_NAMES.get(arg0, str(arg0)), arg1)
+    if event == TRACE_SYSCALL_RET:
+        return "ret=%d" % struct.unpack("<i", struct.pack("<I", arg0))[0]
+    if event == TRACE_WAKEUP:
+        return "by %s" % (EVENT_NAMES[arg0] if arg0 < len(EVENT_NAMES) else arg0)
+    if event == TRACE_SOFTIRQ:
+        return "pending=0x%x" % arg0
+    return ""
+
+
+def stats(name, samples, mhz):
+    if not samples:
+        return
+    samples.sort()
+    us = lambda c: c / mhz if mhz else c
+    unit = "us" if mhz else "cycles"
+    print("%-24s n=%-6d min=%-10.2f p50=%-10.2f p99=%-10.2f max=%.2f %s" % (
+        name, len(samples), us(samples[0]), us(samples[len(samples) // 2]),
+        us(samples[min(len(samples) - 1, len(samples) * 99 // 100)]), us(samples[-1]), unit))
+
+
+def summary(events, mhz):
+    """interrupt-to-wakeup latency, context switch cost and system call latency"""
+    last_irq = {}
+    wakeup = {TRACE_RTC: [], TRACE_KEYBOARD: []}
+    switch = []
+    bottom_half = []
+    syscalls = {}
+    enter = {}
+    last_pit = None
+
+    for tsc, event, pid, arg0, arg1 in events:
+        if event in (TRACE_RTC, TRACE_KEYBOARD):
+            last_irq[event] = tsc
+        elif event == TRACE_WAKEUP and arg0 in last_irq:
+            wakeup[arg0].append(tsc - last_irq[arg0])
+        elif event == TRACE_SOFTIRQ and (arg0 & (1 << SOFTIRQ_KEYBOARD)) and TRACE_KEYBOARD in last_irq:
+            bottom_half.append(tsc - last_irq[TRACE_KEYBOARD])
+        elif event == TRACE_PIT:
+            last_pit = tsc
+        elif event == TRACE_SCHED and last_pit is not None:
+            switch.append(tsc - last_pit)
+        elif event == TRACE_SYSCALL:
+            enter[pid] = (tsc, arg0)
+        elif event == TRACE_SYSCALL_RET and pid in enter:
+            start, num = enter.pop(pid)
+            syscalls.setdefault(num, []).append(tsc - start)
+
+    stats("rtc irq -> wakeup", wakeup[TRACE_RTC], mhz)
+    stats("keyboard irq -> wakeup", wakeup[TRACE_KEYBOARD], mhz)
+    stats("keyboard irq -> softirq", bottom_half, mhz)
+    stats("pit irq -> switch", switch, mhz)
+    for num in sorted(syscalls):
+        stats("syscall " + SYSCALL_NAMES.get(num, str(num)), syscalls[num], mhz)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="decode a kernel event trace dump")
+    parser.add_argument("dump")
+    parser.add_argument("-m", "--mhz", type=float, help="TSC rate in MHz, estimated from PIT ticks if omitted")
+    parser.add_argument("-s", "--summary", action="store_true", help="only print the latency summary")
+    args = parser.parse_args()
+
+    head, events = load(args.dump)
+    mhz = args.mhz or tsc_mhz(events)
+    print("%d events recorded, %d in dump, TSC %s" % (
+        head, len(events), ("%.1f MHz" % mhz) if mhz else "rate unknown"))
+    if not events:
+        return
+
+    if not args.summary:
+        base = events[0][0]
+        for tsc, event, pid, arg0, arg1 in events:
+            when = (tsc - base) / mhz if mhz else tsc - base
+            print("%14.2f  %-3s %-12s %s" % (
+                when, "-" if pid == TRACE_NO_PID else pid,
+                EVENT_NAMES[event] if event < len(EVENT_NAMES) else event,
+                describe(event, arg0, arg1)))
+        print()
+    summary(events, mhz)
+
+
+if __name__ == "__main__":
+    main()